@@ -0,0 +1,682 @@
+#include "app_state.h"
+
+#include <algorithm>
+#include <climits>
+#include <cstdio>
+#include <cwchar>
+#include <unordered_set>
+
+#include "archive.h"
+#include "binary_history.h"
+#include "civil_time.h"
+#include "time_format.h"
+#include "trace.h"
+
+static bool fileExists(const std::string& path) {
+    FILE* file = std::fopen(path.c_str(), "rb");
+    if (!file) {
+        return false;
+    }
+    std::fclose(file);
+    return true;
+}
+
+// Adds the unsnapshotted sessions with a day key in [firstDay, lastDay)
+// that sessions, read from the snapshot (oldest first), does not hold, and
+// restores start order. Another instance may have compacted sessions older
+// than ours into the snapshot, so the snapshot's newest start alone does not
+// tell; a session with the same start second is the same session.
+static void addUnsnapshotted(std::vector<WorkDay>& sessions, const std::vector<WorkDay>& tail, int64_t snapshotHead,
+                             int64_t firstDay, int64_t lastDay) {
+    auto byStart = [](const WorkDay& a, const WorkDay& b) { return a.startMs < b.startMs; };
+    size_t snapshotCount = sessions.size();
+    for (const auto& day : tail) {
+        int64_t dayKey = day.dayKey();
+        if (dayKey < firstDay || dayKey >= lastDay) {
+            continue;
+        }
+        if (day.startMs <= snapshotHead) {
+            WorkDay second;
+            second.startMs = day.startMs / 1000 * 1000;
+            auto end = sessions.begin() + static_cast<std::ptrdiff_t>(snapshotCount);
+            auto it = std::lower_bound(sessions.begin(), end, second, byStart);
+            if (it != end && it->startMs / 1000 == day.startMs / 1000) {
+                continue;
+            }
+        }
+        sessions.push_back(day);
+    }
+    if (!std::is_sorted(sessions.begin(), sessions.end(), byStart)) {
+        std::stable_sort(sessions.begin(), sessions.end(), byStart);
+    }
+}
+
+AppState::AppState(LogFn logFn)
+    : persistence(journal,
+                  [this](Config& snapshotConfig, std::vector<WorkDay>& snapshotHistory) {
+                      std::shared_lock<std::shared_mutex> guard(historyLock);
+                      snapshotConfig = config;
+                      // history.bin: the journal reads the rest from the mapped snapshot.
+                      snapshotHistory = windowed ? unsnapshotted : history.chronological();
+                      compactingTail = windowed ? unsnapshotted.size() : 0;
+                      return true;
+                  },
+                  [this](const char* message) { log(message); },
+                  [this] { dropCompactedTail(); }),
+      log(logFn ? std::move(logFn) : LogFn([](const char*) {})) {}
+
+AppState::~AppState() {
+    if (loader.joinable()) {
+        loader.join();
+    }
+}
+
+bool AppState::loadData(const std::string& binaryPath, const std::string& textPath, bool useTextStore) {
+    TraceScope trace(TraceSpan::Load);
+    if (useTextStore) {
+        journal.open(textPath, SnapshotFormat::Text);
+    } else {
+        if (!fileExists(binaryPath) && fileExists(textPath)) {
+            if (migrateTextStore(textPath, binaryPath)) {
+                log("Migrated data.txt to history.bin.\n");
+            } else {
+                log("Failed to migrate data.txt, it will be retried.\n");
+            }
+        }
+        journal.open(binaryPath, SnapshotFormat::Binary);
+    }
+    snapshotPath = useTextStore ? textPath : binaryPath;
+    windowed = !useTextStore;
+    unsnapshotted.clear();
+    unsnapshottedSeconds.clear();
+    if (windowed) {
+        if (currentViewMonth.tm_mday == 0) {
+            std::time_t now = std::time(nullptr);
+            currentViewMonth = *std::localtime(&now);
+            currentViewMonth.tm_mday = 1;
+        }
+        // The view opens on the current month, so this seals closed years.
+        sealCutoff = daysFromCivil(currentViewMonth.tm_year + 1900 - hotYears + 1, 1, 1);
+        journal.setSealCutoff(sealCutoff);
+    }
+
+    bool found;
+    if (windowed) {
+        // Only the snapshot header and the journal are read here; the
+        // months are paged in from the mapped file.
+        std::vector<WorkDay> none;
+        int64_t snapshotHead;
+        found = journal.loadSnapshotRange(0, 0, config, none, snapshotHead);
+        found = journal.loadJournal(snapshotHead, config, unsnapshotted) || found;
+        for (const auto& day : unsnapshotted) {
+            unsnapshottedSeconds.insert(day.startMs / 1000);
+        }
+        int month = monthIndex(currentViewMonth);
+        loadWindow(month - 1, month + 1);
+    } else {
+        std::vector<WorkDay> sessions;
+        found = journal.load(config, sessions);
+        history.assign(std::move(sessions));
+    }
+    if (!found) {
+        log("No existing data file found. Using defaults.\n");
+        return false;
+    }
+    {
+        std::unique_lock<std::shared_mutex> guard(historyLock);
+        rollups.rebuild(history);
+        rollupsComplete = !windowed;
+    }
+    for (const auto& error : journal.loadErrors()) {
+        log(("Skipped malformed record: " + error + "\n").c_str());
+    }
+    log("Data loaded successfully.\n");
+    if (journal.pendingRecords() > 0) {
+        saveData();
+    }
+    return true;
+}
+
+bool AppState::startBackgroundLoad(std::function<void()> onLoaded) {
+    if (!windowed || loader.joinable()) {
+        return false;
+    }
+    onHistoryLoaded = onLoaded;
+    loader = std::thread([this, onLoaded] {
+        TraceScope trace(TraceSpan::Load);
+        // Sealed years count through the archive's summaries; only the
+        // sessions after it are read.
+        std::shared_ptr<const HistoryArchive> sealed = journal.archive();
+        std::vector<WorkDay> sessions;
+        loadHistorySince(sealed ? sealed->endDay() : INT64_MIN, sessions, loadedUnsnapshotted);
+        sealPending = std::any_of(sessions.begin(), sessions.end(),
+                                  [this](const WorkDay& day) { return day.dayKey() < sealCutoff; });
+        loadedHistory.assign(std::move(sessions));
+        loadedRollups.rebuild(loadedHistory);
+        loadedRollups.setArchive(sealed);
+        if (onLoaded) {
+            onLoaded();
+        }
+    });
+    return true;
+}
+
+void AppState::finishBackgroundLoad() {
+    if (!loader.joinable()) {
+        return;
+    }
+    loader.join();
+    {
+        std::unique_lock<std::shared_mutex> guard(historyLock);
+        // Sessions punched or synced while the loader ran are not in its
+        // rollups yet, unless another instance had compacted them into the
+        // snapshot it read.
+        rollups = std::move(loadedRollups);
+        for (size_t i = loadedUnsnapshotted; i < unsnapshotted.size(); ++i) {
+            const WorkDay& day = unsnapshotted[i];
+            auto loaded = loadedHistory.day(day.dayKey());
+            if (std::none_of(loaded.begin(), loaded.end(),
+                             [&](const WorkDay& other) { return other.startMs / 1000 == day.startMs / 1000; })) {
+                rollups.add(day);
+            }
+        }
+        rollupsComplete = true;
+    }
+    loadedHistory.clear();
+    int month = monthIndex(currentViewMonth);
+    loadWindow(month - kResidentMonthRadius, month + kResidentMonthRadius);
+    if (sealPending) {
+        sealPending = false;
+        saveData();
+    }
+    if (reloadPending) {
+        reloadPending = false;
+        reloadStore();
+    }
+}
+
+// The sessions a compaction just folded into the snapshot are the first
+// compactingTail. They stay while a background load is pending: it counts
+// positions in unsnapshotted (loadedUnsnapshotted).
+void AppState::dropCompactedTail() {
+    std::unique_lock<std::shared_mutex> guard(historyLock);
+    if (compactingTail == 0 || !rollupsComplete) {
+        return;
+    }
+    unsnapshotted.erase(unsnapshotted.begin(), unsnapshotted.begin() + static_cast<std::ptrdiff_t>(compactingTail));
+    unsnapshottedSeconds.clear();
+    for (const auto& day : unsnapshotted) {
+        unsnapshottedSeconds.insert(day.startMs / 1000);
+    }
+}
+
+// Copied before the snapshot is read: a compaction drops sessions from
+// unsnapshotted only once the snapshot holding them is in place, so a reader
+// finds each session in one or the other.
+std::vector<WorkDay> AppState::unsnapshottedDays(int64_t firstDay, int64_t lastDay, size_t& unsnapshottedCount) {
+    std::shared_lock<std::shared_mutex> guard(historyLock);
+    std::vector<WorkDay> tail;
+    for (const auto& day : unsnapshotted) {
+        if (day.dayKey() >= firstDay && day.dayKey() < lastDay) {
+            tail.push_back(day);
+        }
+    }
+    unsnapshottedCount = unsnapshotted.size();
+    return tail;
+}
+
+bool AppState::loadHistorySince(int64_t firstDay, std::vector<WorkDay>& sessions, size_t& unsnapshottedCount) {
+    if (!windowed) {
+        std::shared_lock<std::shared_mutex> guard(historyLock);
+        sessions = history.chronological();
+        unsnapshottedCount = 0;
+        return true;
+    }
+    // A session's local day is within 14 hours of its UTC start.
+    const int64_t kMaxOffsetMs = 14 * 3600000LL;
+    int64_t fromMs = firstDay == INT64_MIN ? INT64_MIN : firstDay * 86400000LL - kMaxOffsetMs;
+    std::vector<WorkDay> tail = unsnapshottedDays(firstDay, INT64_MAX, unsnapshottedCount);
+    Config snapshotConfig;
+    int64_t snapshotHead;
+    if (!journal.loadSnapshotRange(fromMs, INT64_MAX, snapshotConfig, sessions, snapshotHead) &&
+        (fileExists(snapshotPath) || fileExists(snapshotPath + ".archive"))) {
+        return false; // unreadable
+    }
+    auto before = std::remove_if(sessions.begin(), sessions.end(),
+                                 [firstDay](const WorkDay& day) { return day.dayKey() < firstDay; });
+    sessions.erase(before, sessions.end());
+    addUnsnapshotted(sessions, tail, snapshotHead, firstDay, INT64_MAX);
+    return true;
+}
+
+bool AppState::historyDays(int64_t& firstDay, int64_t& lastDay) {
+    int64_t firstMs = INT64_MAX, lastMs = INT64_MIN;
+    {
+        // Before the snapshot, as in unsnapshottedDays().
+        std::shared_lock<std::shared_mutex> guard(historyLock);
+        auto widen = [&](const WorkDay& day) {
+            firstMs = std::min(firstMs, day.startMs);
+            lastMs = std::max(lastMs, day.startMs);
+        };
+        if (windowed) {
+            std::for_each(unsnapshotted.begin(), unsnapshotted.end(), widen);
+        } else {
+            std::for_each(history.begin(), history.end(), widen);
+        }
+    }
+    if (windowed) {
+        int64_t snapshotFirst = INT64_MAX, snapshotLast = INT64_MIN;
+        if (journal.snapshotStarts(snapshotFirst, snapshotLast)) {
+            firstMs = std::min(firstMs, snapshotFirst);
+            lastMs = std::max(lastMs, snapshotLast);
+        }
+    }
+    if (firstMs > lastMs) {
+        return false;
+    }
+    // A session's local day is within 14 hours of its UTC start.
+    const int64_t kMaxOffsetMs = 14 * 3600000LL;
+    firstDay = floorDiv(firstMs - kMaxOffsetMs, 86400000LL);
+    lastDay = floorDiv(lastMs + kMaxOffsetMs, 86400000LL) + 1;
+    return true;
+}
+
+void AppState::changeMonth(int delta) {
+    currentViewMonth.tm_mon += delta;
+    std::mktime(&currentViewMonth); // Normalize the date
+    int month = monthIndex(currentViewMonth);
+    if (windowed && (month < residentFirstMonth || month > residentLastMonth)) {
+        loadWindow(month - kResidentMonthRadius, month + kResidentMonthRadius);
+    }
+}
+
+void AppState::loadWindow(int firstMonth, int lastMonth) {
+    int64_t firstDay = daysFromCivil(firstMonth / 12, static_cast<unsigned>(firstMonth % 12 + 1), 1);
+    int64_t lastDay = daysFromCivil((lastMonth + 1) / 12, static_cast<unsigned>((lastMonth + 1) % 12 + 1), 1);
+    // A session's local day is within 14 hours of its UTC start.
+    const int64_t kMaxOffsetMs = 14 * 3600000LL;
+
+    size_t unsnapshottedCount;
+    std::vector<WorkDay> tail = unsnapshottedDays(firstDay, lastDay, unsnapshottedCount);
+    Config snapshotConfig;
+    std::vector<WorkDay> sessions;
+    int64_t snapshotHead;
+    journal.loadSnapshotRange(firstDay * 86400000LL - kMaxOffsetMs, lastDay * 86400000LL + kMaxOffsetMs,
+                              snapshotConfig, sessions, snapshotHead);
+    addUnsnapshotted(sessions, tail, snapshotHead, firstDay, lastDay);
+    auto outside = std::remove_if(sessions.begin(), sessions.end(), [&](const WorkDay& day) {
+        return day.dayKey() < firstDay || day.dayKey() >= lastDay;
+    });
+    sessions.erase(outside, sessions.end());
+    {
+        std::unique_lock<std::shared_mutex> guard(historyLock);
+        history.assign(std::move(sessions));
+        residentFirstMonth = firstMonth;
+        residentLastMonth = lastMonth;
+    }
+}
+
+// Asks the writer thread to fold the journal into a fresh snapshot
+// (temp file + fsync + atomic rename).
+void AppState::saveData() {
+    persistence.enqueueCompact();
+}
+
+std::wstring AppState::formatDuration(long long ms) {
+    wchar_t buffer[kDurationChars];
+    return std::wstring(buffer, formatDurationHM(ms, buffer));
+}
+
+static int64_t nowMs() {
+    using std::chrono::duration_cast;
+    using std::chrono::milliseconds;
+    return duration_cast<milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+void AppState::punchIn() {
+    TraceScope trace(TraceSpan::Punch);
+    {
+        std::unique_lock<std::shared_mutex> guard(historyLock);
+        isWorking = true;
+        currentSession.startTime = std::chrono::system_clock::now();
+        currentSession.sessionHourlyGross = config.hourlyGross;
+        currentSession.sessionHourlyNet = config.hourlyNet;
+    }
+    writeCheckpoint(0, false);
+    log("PUNCH IN\n");
+}
+
+void AppState::punchOut() {
+    TraceScope trace(TraceSpan::Punch);
+    {
+        std::unique_lock<std::shared_mutex> guard(historyLock);
+        isWorking = false;
+    }
+    using std::chrono::duration_cast;
+    using std::chrono::milliseconds;
+    int64_t startMs = duration_cast<milliseconds>(currentSession.startTime.time_since_epoch()).count();
+    int64_t endMs = nowMs();
+    // Checkpointed first: if the app dies before the journal append lands,
+    // the next start finds the closed session here.
+    writeCheckpoint(endMs, false);
+    recordSession(startMs, endMs, currentSession.sessionHourlyGross, currentSession.sessionHourlyNet);
+}
+
+bool AppState::openCheckpoint(const std::string& path, SessionCheckpointState& interrupted) {
+    if (!checkpoint.open(path)) {
+        log("Could not open the session checkpoint.\n");
+        return false;
+    }
+    if (!checkpoint.read(interrupted)) {
+        return false;
+    }
+    if (!interrupted.working && interrupted.endMs != 0 && !hasSession(interrupted.startMs)) {
+        recordSession(interrupted.startMs, interrupted.endMs, interrupted.hourlyGross, interrupted.hourlyNet);
+        log("Recovered a punch out that had not reached the journal.\n");
+    }
+    return interrupted.working;
+}
+
+void AppState::resumeSession(const SessionCheckpointState& interrupted) {
+    {
+        std::unique_lock<std::shared_mutex> guard(historyLock);
+        isWorking = true;
+        currentSession.startTime = std::chrono::system_clock::time_point(std::chrono::milliseconds(interrupted.startMs));
+        currentSession.sessionHourlyGross = interrupted.hourlyGross;
+        currentSession.sessionHourlyNet = interrupted.hourlyNet;
+    }
+    writeCheckpoint(0, false);
+    log("Resumed the interrupted session.\n");
+}
+
+void AppState::closeSessionAt(const SessionCheckpointState& interrupted, int64_t endMs) {
+    {
+        std::unique_lock<std::shared_mutex> guard(historyLock);
+        isWorking = false;
+        currentSession.startTime = std::chrono::system_clock::time_point(std::chrono::milliseconds(interrupted.startMs));
+        currentSession.sessionHourlyGross = interrupted.hourlyGross;
+        currentSession.sessionHourlyNet = interrupted.hourlyNet;
+    }
+    endMs = std::max(endMs, interrupted.startMs);
+    writeCheckpoint(endMs, false);
+    recordSession(interrupted.startMs, endMs, interrupted.hourlyGross, interrupted.hourlyNet);
+}
+
+void AppState::heartbeat() {
+    if (isWorking) {
+        checkpoint.touch(nowMs());
+    }
+}
+
+void AppState::checkpointOnExit() {
+    if (isWorking) {
+        writeCheckpoint(0, true);
+    }
+}
+
+// Flushed before returning, so a punch is on disk before the UI shows it.
+void AppState::writeCheckpoint(int64_t endMs, bool closedCleanly) {
+    using std::chrono::duration_cast;
+    using std::chrono::milliseconds;
+    SessionCheckpointState state;
+    state.working = isWorking;
+    state.closedCleanly = closedCleanly;
+    state.startMs = duration_cast<milliseconds>(currentSession.startTime.time_since_epoch()).count();
+    state.endMs = endMs;
+    state.lastSeenMs = endMs != 0 ? endMs : nowMs();
+    state.hourlyGross = currentSession.sessionHourlyGross;
+    state.hourlyNet = currentSession.sessionHourlyNet;
+    checkpoint.write(state, true);
+}
+
+// Matched to the second: the journal stores start times without milliseconds.
+bool AppState::hasSession(int64_t startMs) {
+    int64_t second = startMs / 1000;
+    auto sameStart = [second](const WorkDay& day) { return day.startMs / 1000 == second; };
+    {
+        std::shared_lock<std::shared_mutex> guard(historyLock);
+        if (unsnapshottedSeconds.count(second)) {
+            return true;
+        }
+    }
+    if (!windowed) {
+        return std::any_of(history.begin(), history.end(), sameStart);
+    }
+    Config snapshotConfig;
+    std::vector<WorkDay> sessions;
+    int64_t snapshotHead;
+    journal.loadSnapshotRange(second * 1000, second * 1000 + 1000, snapshotConfig, sessions, snapshotHead);
+    return !sessions.empty();
+}
+
+void AppState::recordSession(int64_t startMs, int64_t endMs, double hourlyGross, double hourlyNet) {
+    WorkDay day;
+    day.startMs = startMs;
+    day.endMs = endMs;
+    day.startUtcOffsetMin = localOffsetCache().offsetMinutes(day.startMs / 1000);
+    day.endUtcOffsetMin = localOffsetCache().offsetMinutes(day.endMs / 1000);
+    day.rateId = rateTable().intern(hourlyGross, hourlyNet);
+
+    {
+        std::unique_lock<std::shared_mutex> guard(historyLock);
+        if (windowed) {
+            unsnapshotted.push_back(day);
+            unsnapshottedSeconds.insert(day.startMs / 1000);
+        }
+        if (isResident(day.dayKey())) {
+            history.append(day);
+        }
+        rollups.add(day);
+    }
+
+    log("PUNCH OUT, queueing journal append...\n");
+    persistence.enqueueAppend(day);
+}
+
+bool AppState::isResident(int64_t dayKey) const {
+    if (!windowed) {
+        return true;
+    }
+    int year; unsigned month, dayOfMonth;
+    civilFromDays(dayKey, year, month, dayOfMonth);
+    int index = year * 12 + static_cast<int>(month) - 1;
+    return index >= residentFirstMonth && index <= residentLastMonth;
+}
+
+// --- Sharing the store (see journal.h) ---
+
+// A session of another instance's that is also in a month this one has not
+// paged in, and not in its journal tail, is counted again; that takes two
+// instances recording the same start second.
+bool AppState::knowsSession(const WorkDay& day) const {
+    int64_t second = day.startMs / 1000;
+    if (unsnapshottedSeconds.count(second)) {
+        return true;
+    }
+    auto sameStart = [second](const WorkDay& other) { return other.startMs / 1000 == second; };
+    auto resident = history.day(day.dayKey());
+    return std::any_of(resident.begin(), resident.end(), sameStart);
+}
+
+bool AppState::syncExternalChanges(bool& changed) {
+    TraceScope trace(TraceSpan::Sync);
+    changed = false;
+    std::vector<WorkDay> records;
+    bool reloadNeeded;
+    if (!journal.readNewRecords(records, reloadNeeded)) {
+        return false;
+    }
+    if (reloadNeeded) {
+        log("Missed a compaction by another instance, reloading the store.\n");
+        reloadStore();
+        changed = true;
+        return true;
+    }
+    std::vector<WorkDay> fresh;
+    {
+        std::shared_lock<std::shared_mutex> guard(historyLock);
+        std::unordered_set<int64_t> seen;
+        for (const auto& day : records) {
+            if (seen.insert(day.startMs / 1000).second && !knowsSession(day)) {
+                fresh.push_back(day);
+            }
+        }
+    }
+    if (fresh.empty()) {
+        return true;
+    }
+    {
+        std::unique_lock<std::shared_mutex> guard(historyLock);
+        std::vector<WorkDay> resident;
+        for (const auto& day : fresh) {
+            if (windowed) {
+                unsnapshotted.push_back(day);
+                unsnapshottedSeconds.insert(day.startMs / 1000);
+            }
+            if (isResident(day.dayKey())) {
+                resident.push_back(day);
+            }
+            rollups.add(day);
+        }
+        // Each older session rebuilds the day index, so merge a batch at once.
+        if (resident.size() > 1) {
+            resident.insert(resident.end(), history.begin(), history.end());
+            history.assign(std::move(resident));
+        } else if (!resident.empty()) {
+            history.append(resident.front());
+        }
+    }
+    char message[96];
+    std::snprintf(message, sizeof(message), "Merged %zu sessions from another instance.\n", fresh.size());
+    log(message);
+    changed = true;
+    return true;
+}
+
+// Reads the store as loadData() does, keeping the sessions this instance
+// has recorded but not yet written.
+void AppState::reloadStore() {
+    Config unused;
+    if (!windowed) {
+        std::vector<WorkDay> sessions;
+        journal.load(unused, sessions);
+        std::unordered_set<int64_t> stored;
+        for (const auto& day : sessions) {
+            stored.insert(day.startMs / 1000);
+        }
+        for (const auto& day : history) {
+            if (!stored.count(day.startMs / 1000)) {
+                sessions.push_back(day);
+            }
+        }
+        std::unique_lock<std::shared_mutex> guard(historyLock);
+        history.assign(std::move(sessions));
+        rollups.rebuild(history);
+        return;
+    }
+    std::vector<WorkDay> none, tail;
+    int64_t snapshotHead;
+    journal.loadSnapshotRange(0, 0, unused, none, snapshotHead);
+    journal.loadJournal(snapshotHead, unused, tail);
+    {
+        std::unique_lock<std::shared_mutex> guard(historyLock);
+        for (const auto& day : tail) {
+            if (!knowsSession(day)) {
+                unsnapshotted.push_back(day);
+                unsnapshottedSeconds.insert(day.startMs / 1000);
+            }
+        }
+    }
+    loadWindow(residentFirstMonth, residentLastMonth);
+    if (loader.joinable()) {
+        reloadPending = true;
+        return;
+    }
+    {
+        std::unique_lock<std::shared_mutex> guard(historyLock);
+        rollupsComplete = false;
+    }
+    startBackgroundLoad(onHistoryLoaded);
+}
+
+long long AppState::runningSessionMs() const {
+    if (!isWorking) {
+        return 0;
+    }
+    auto duration = std::chrono::system_clock::now() - currentSession.startTime;
+    return std::chrono::duration_cast<std::chrono::milliseconds>(duration).count();
+}
+
+Totals AppState::queryTotals(int64_t firstDay, int64_t lastDay, bool& complete) {
+    std::shared_lock<std::shared_mutex> guard(historyLock);
+    complete = rollupsComplete;
+    return rollups.range(firstDay, lastDay);
+}
+
+bool AppState::querySessions(int64_t firstDay, int64_t lastDay, std::vector<WorkDay>& sessions) {
+    sessions.clear();
+    {
+        std::shared_lock<std::shared_mutex> guard(historyLock);
+        bool resident = !windowed;
+        if (windowed && residentFirstMonth <= residentLastMonth) {
+            int first = residentFirstMonth, next = residentLastMonth + 1;
+            int64_t residentFirst = daysFromCivil(first / 12, static_cast<unsigned>(first % 12 + 1), 1);
+            int64_t residentLast = daysFromCivil(next / 12, static_cast<unsigned>(next % 12 + 1), 1);
+            resident = firstDay >= residentFirst && lastDay <= residentLast;
+        }
+        if (resident) {
+            for (const WorkDay& day : history.days(firstDay, lastDay)) {
+                sessions.push_back(day);
+            }
+            return true;
+        }
+    }
+    // A session's local day is within 14 hours of its UTC start.
+    const int64_t kMaxOffsetMs = 14 * 3600000LL;
+    size_t unsnapshottedCount;
+    std::vector<WorkDay> tail = unsnapshottedDays(firstDay, lastDay, unsnapshottedCount);
+    Config snapshotConfig;
+    int64_t snapshotHead;
+    if (!journal.loadSnapshotRange(firstDay * 86400000LL - kMaxOffsetMs, lastDay * 86400000LL + kMaxOffsetMs,
+                                   snapshotConfig, sessions, snapshotHead) &&
+        (fileExists(snapshotPath) || fileExists(snapshotPath + ".archive"))) {
+        return false;
+    }
+    addUnsnapshotted(sessions, tail, snapshotHead, firstDay, lastDay);
+    auto outside = std::remove_if(sessions.begin(), sessions.end(), [&](const WorkDay& day) {
+        return day.dayKey() < firstDay || day.dayKey() >= lastDay;
+    });
+    sessions.erase(outside, sessions.end());
+    return true;
+}
+
+AppState::SessionStatus AppState::querySession() {
+    std::shared_lock<std::shared_mutex> guard(historyLock);
+    SessionStatus status;
+    status.working = isWorking;
+    if (isWorking) {
+        using std::chrono::duration_cast;
+        using std::chrono::milliseconds;
+        status.startMs = duration_cast<milliseconds>(currentSession.startTime.time_since_epoch()).count();
+        status.rate = Rate{ currentSession.sessionHourlyGross, currentSession.sessionHourlyNet };
+    }
+    return status;
+}
+
+std::wstring AppState::getMonthStatsString(int64_t todayKey) {
+    Rate rate = { currentSession.sessionHourlyGross, currentSession.sessionHourlyNet };
+    MonthProjection p = rollups.projectMonth(todayKey, runningSessionMs(), rate);
+    wchar_t duration[kDurationChars];
+    formatDurationHM(p.monthToDate.durationMs, duration);
+    wchar_t buffer[128];
+    swprintf(buffer, 128, L"📊 Ce mois : %ls · %.2f € net · projection %.2f €",
+             duration, p.monthToDate.netCents() / 100.0, p.projectedNetCents / 100.0);
+    return buffer;
+}
+
+std::wstring AppState::getWorkedDurationString() {
+    if (!isWorking) {
+        return L"0h 00m";
+    }
+    return formatDuration(runningSessionMs());
+}
@@ -0,0 +1,182 @@
+#pragma once
+
+#include <chrono>
+#include <ctime>
+#include <functional>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+#include "history_store.h"
+#include "journal.h"
+#include "persistence.h"
+#include "rollup.h"
+#include "session_checkpoint.h"
+#include "workday.h"
+
+// --- Application State and Logic ---
+//
+// Everything the tracker does apart from drawing: the punch state machine,
+// the indexed history and its rollups, and persistence. Platform-neutral so
+// it can be built and benchmarked outside the Windows UI.
+//
+// With history.bin, `history` holds only a window of months around the one
+// on screen; other months are read from the mapped snapshot when viewed.
+// The legacy text store has no random access and is kept whole. Years
+// before the last `hotYears` are sealed into the archive (archive.h) and
+// count towards the rollups through its per-month totals.
+
+class AppState {
+public:
+    using LogFn = std::function<void(const char*)>;
+
+    // Months kept resident on each side of the viewed month.
+    static const int kResidentMonthRadius = 6;
+
+    // Calendar years, the current one included, kept out of the archive.
+    static const int kDefaultHotYears = 2;
+
+    explicit AppState(LogFn log = nullptr);
+    ~AppState();
+
+    bool isWorking = false;
+    Config config;
+    CurrentSession currentSession;
+    HistoryStore history;           // the resident months (see above)
+    std::shared_mutex historyLock;  // taken shared by the persistence and loader threads
+    RollupEngine rollups;
+    std::tm currentViewMonth = {};
+    int hotYears = kDefaultHotYears;   // read by loadData()
+    Journal journal;
+    // Every write after loadData() goes through here, off the UI thread.
+    PersistenceService persistence;
+    // The punch state, so a session survives a crash (see session_checkpoint.h).
+    SessionCheckpoint checkpoint;
+
+    // Opens the store (migrating a legacy data.txt to history.bin unless
+    // useTextStore is set) and loads what the first paint needs: the months
+    // next to currentViewMonth, the journal tail, and rollups over those.
+    // Returns false when no data exists.
+    bool loadData(const std::string& binaryPath, const std::string& textPath, bool useTextStore);
+    // Rebuilds the rollups over the unsealed history on a loader thread,
+    // then calls onLoaded there. Returns false when there is nothing left to
+    // load.
+    bool startBackgroundLoad(std::function<void()> onLoaded);
+    // On the UI thread once onLoaded has run: installs the full rollups,
+    // widens the resident window and seals any year that has closed.
+    void finishBackgroundLoad();
+    // Day keys [firstDay, lastDay) that hold every session, for walking the
+    // store range by range (exports). False when it is empty.
+    bool historyDays(int64_t& firstDay, int64_t& lastDay);
+    void saveData();
+
+    // The snapshot file; the store is the files next to it that share its name.
+    const std::string& storePath() const { return snapshotPath; }
+    // On the UI thread when the store changed on disk (see file_watcher.h):
+    // takes in the sessions other instances have recorded since the last
+    // call, at a cost in the number of new sessions. changed is set when
+    // anything shown may have moved. If another instance compacted more than once in between,
+    // the resident months and the journal tail are reloaded and the rollups
+    // rebuilt in the background, as at startup. Returns false when the store
+    // is locked by a writer; call again shortly.
+    bool syncExternalChanges(bool& changed);
+
+    // Maps the checkpoint file. Returns true when it holds a session that
+    // was still running when the app last stopped; the caller then either
+    // resumes it or closes it at its last-seen time.
+    bool openCheckpoint(const std::string& path, SessionCheckpointState& interrupted);
+    void resumeSession(const SessionCheckpointState& interrupted);
+    void closeSessionAt(const SessionCheckpointState& interrupted, int64_t endMs);
+    // Records that the app is still alive; one 64-byte store, no flush.
+    void heartbeat();
+    // On a normal exit while punched in: the next start resumes silently.
+    void checkpointOnExit();
+
+    void togglePunch() {
+        if (isWorking) {
+            punchOut();
+        } else {
+            punchIn();
+        }
+    }
+
+    // Moves the view and pages the month in if it is not resident.
+    void changeMonth(int delta);
+
+    std::wstring formatDuration(long long ms);
+
+    void punchIn();
+    void punchOut();
+
+    long long runningSessionMs() const;
+
+    // --- Reads from other threads (see query_service.h) ---
+    //
+    // Safe while the UI thread punches and pages months: every write to the
+    // state these read is made under historyLock, and they take it shared
+    // only briefly.
+
+    struct SessionStatus {
+        bool working = false;
+        int64_t startMs = 0;
+        Rate rate;
+    };
+
+    // Totals over day keys in [firstDay, lastDay). complete is false while
+    // the background load has not yet brought in the months outside the
+    // initial window.
+    Totals queryTotals(int64_t firstDay, int64_t lastDay, bool& complete);
+    // The closed sessions whose local day is in [firstDay, lastDay), oldest
+    // first. Resident months are copied; others are read from the mapped
+    // snapshot without holding the lock.
+    bool querySessions(int64_t firstDay, int64_t lastDay, std::vector<WorkDay>& sessions);
+    SessionStatus querySession();
+
+    // Month-to-date totals and the end-of-month projection, O(log N) per call.
+    std::wstring getMonthStatsString(int64_t todayKey);
+    std::wstring getWorkedDurationString();
+
+private:
+    static int monthIndex(const std::tm& month) { return (month.tm_year + 1900) * 12 + month.tm_mon; }
+    // Makes `history` hold exactly the months [firstMonth, lastMonth].
+    void loadWindow(int firstMonth, int lastMonth);
+    // The sessions from firstDay on, oldest first.
+    bool loadHistorySince(int64_t firstDay, std::vector<WorkDay>& sessions, size_t& unsnapshottedCount);
+    // The unsnapshotted sessions with a day key in [firstDay, lastDay), and
+    // how many there are in all.
+    std::vector<WorkDay> unsnapshottedDays(int64_t firstDay, int64_t lastDay, size_t& unsnapshottedCount);
+    // On the writer thread after a compaction: trims unsnapshotted.
+    void dropCompactedTail();
+    void recordSession(int64_t startMs, int64_t endMs, double hourlyGross, double hourlyNet);
+    void writeCheckpoint(int64_t endMs, bool closedCleanly);
+    bool hasSession(int64_t startMs);
+    // Whether this instance already counts a session starting that second.
+    // Caller holds historyLock.
+    bool knowsSession(const WorkDay& day) const;
+    bool isResident(int64_t dayKey) const;
+    void reloadStore();
+
+    LogFn log;
+    std::string snapshotPath;
+    bool windowed = false;
+    int64_t sealCutoff = INT64_MIN;
+    int residentFirstMonth = 0;     // month indices (year * 12 + month - 1), inclusive
+    int residentLastMonth = -1;
+    // Journal tail and punches since load, oldest first, until a compaction
+    // of ours folds them in. Another instance's may have done so already;
+    // readers skip those by start time.
+    std::vector<WorkDay> unsnapshotted;
+    std::unordered_set<int64_t> unsnapshottedSeconds;  // their start seconds
+    size_t compactingTail = 0;      // writer thread: how many of them the compaction under way holds
+
+    std::thread loader;
+    std::function<void()> onHistoryLoaded;
+    RollupEngine loadedRollups;
+    HistoryStore loadedHistory;     // what loadedRollups were built from, until installed
+    size_t loadedUnsnapshotted = 0; // how much of unsnapshotted loadedRollups covers
+    bool reloadPending = false;     // the store must be read again once the loader is done
+    bool sealPending = false;       // the loader found hot sessions before sealCutoff
+    bool rollupsComplete = false;   // the rollups cover every unsealed day
+};
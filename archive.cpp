@@ -0,0 +1,379 @@
+#include "archive.h"
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <utility>
+
+#include "civil_time.h"
+#include "crc32c.h"
+#include "journal.h"
+
+static const char kMagic[8] = { 'T', 'T', 'P', 'A', 'R', 'C', 'H', '\0' };
+
+namespace {
+
+// A session's local day is within 14 hours of its UTC start.
+const int64_t kMaxOffsetMs = 14 * 3600000LL;
+
+uint64_t zigzag(int64_t v) {
+    return (static_cast<uint64_t>(v) << 1) ^ static_cast<uint64_t>(v >> 63);
+}
+
+int64_t unzigzag(uint64_t v) {
+    return static_cast<int64_t>(v >> 1) ^ -static_cast<int64_t>(v & 1);
+}
+
+void putVarint(std::vector<char>& out, uint64_t v) {
+    while (v >= 0x80) {
+        out.push_back(static_cast<char>((v & 0x7f) | 0x80));
+        v >>= 7;
+    }
+    out.push_back(static_cast<char>(v));
+}
+
+bool getVarint(const char*& p, const char* end, uint64_t& v) {
+    v = 0;
+    for (int shift = 0; p != end && shift < 64; shift += 7) {
+        uint8_t byte = static_cast<uint8_t>(*p++);
+        v |= static_cast<uint64_t>(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Whole seconds (the usual case) cost one varint byte less.
+void putTime(std::vector<char>& out, int64_t ms) {
+    if (ms % 1000 == 0) {
+        putVarint(out, zigzag(ms / 1000) << 1);
+    } else {
+        putVarint(out, (zigzag(ms) << 1) | 1);
+    }
+}
+
+bool getTime(const char*& p, const char* end, int64_t& ms) {
+    uint64_t v;
+    if (!getVarint(p, end, v)) {
+        return false;
+    }
+    ms = unzigzag(v >> 1);
+    if ((v & 1) == 0) {
+        ms *= 1000;
+    }
+    return true;
+}
+
+int monthOfDay(int64_t dayKey) {
+    int year; unsigned month, day;
+    civilFromDays(dayKey, year, month, day);
+    return year * 12 + static_cast<int>(month) - 1;
+}
+
+int64_t firstDayOfMonth(int month) {
+    return daysFromCivil(month / 12, static_cast<unsigned>(month % 12 + 1), 1);
+}
+
+// Version 1 index entries stop before crc.
+const size_t kVersion1BlockInfoBytes = offsetof(ArchiveBlockInfo, crc);
+
+std::string monthName(int month) {
+    char name[16];
+    std::snprintf(name, sizeof(name), "%04d-%02d", month / 12, month % 12 + 1);
+    return name;
+}
+
+uint32_t headerChecksum(ArchiveHeader header, const char* rates, size_t ratesBytes) {
+    header.crc = 0;
+    return crc32c(rates, ratesBytes, crc32c(&header, sizeof(header)));
+}
+
+uint32_t entryChecksum(const ArchiveBlockInfo& block) {
+    return crc32c(&block, offsetof(ArchiveBlockInfo, crc));
+}
+
+// Before version 3 the money fields hold euros as doubles.
+int64_t eurosToMsCents(int64_t bits) {
+    double euros;
+    std::memcpy(&euros, &bits, sizeof(euros));
+    return std::llround(euros * 100.0) * MsCents::kMsPerHour;
+}
+
+int countDays(uint32_t mask) {
+    int count = 0;
+    for (; mask != 0; mask &= mask - 1) {
+        ++count;
+    }
+    return count;
+}
+
+} // namespace
+
+bool HistoryArchive::load(const std::string& path) {
+    header = ArchiveHeader();
+    bytes.clear();
+    blocks.clear();
+    rateIds.clear();
+    corrupt.clear();
+
+    FILE* file = std::fopen(path.c_str(), "rb");
+    if (!file) {
+        return false;
+    }
+    std::fseek(file, 0, SEEK_END);
+    long size = std::ftell(file);
+    std::fseek(file, 0, SEEK_SET);
+    bool ok = size >= static_cast<long>(sizeof(ArchiveHeader));
+    if (ok) {
+        bytes.resize(static_cast<size_t>(size));
+        ok = std::fread(bytes.data(), 1, bytes.size(), file) == bytes.size();
+    }
+    std::fclose(file);
+    if (!ok) {
+        bytes.clear();
+        return false;
+    }
+
+    std::memcpy(&header, bytes.data(), sizeof(header));
+    bool checked = header.version >= 2;
+    size_t entryBytes = checked ? sizeof(ArchiveBlockInfo) : kVersion1BlockInfoBytes;
+    size_t ratesBytes = static_cast<size_t>(header.rateCount) * 2 * sizeof(double);
+    size_t indexBytes = static_cast<size_t>(header.blockCount) * entryBytes;
+    const char* p = bytes.data() + sizeof(header);
+    if (std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 || header.version < 1 ||
+        header.version > kArchiveVersion || sizeof(header) + ratesBytes + indexBytes > bytes.size() ||
+        (checked && headerChecksum(header, p, ratesBytes) != header.crc)) {
+        bytes.clear();
+        return false;
+    }
+
+    rateIds.reserve(header.rateCount);
+    for (uint32_t i = 0; i < header.rateCount; ++i, p += 2 * sizeof(double)) {
+        double rate[2];
+        std::memcpy(rate, p, sizeof(rate));
+        rateIds.push_back(rateTable().intern(rate[0], rate[1]));
+    }
+    std::vector<size_t> failed;
+    if (checked) {
+        crc32cCheckRecords(p, entryBytes, offsetof(ArchiveBlockInfo, crc), header.blockCount, failed);
+    }
+    auto nextFailed = failed.begin();
+    blocks.reserve(header.blockCount);
+    for (uint32_t i = 0; i < header.blockCount; ++i, p += entryBytes) {
+        ArchiveBlockInfo block = {};
+        std::memcpy(&block, p, entryBytes);
+        if (header.version < 3) {
+            block.grossMsCents = eurosToMsCents(block.grossMsCents);
+            block.netMsCents = eurosToMsCents(block.netMsCents);
+        }
+        bool inFile = block.offset <= bytes.size() && block.bytes <= bytes.size() - block.offset;
+        if (!checked && !inFile) {
+            bytes.clear();
+            blocks.clear();
+            return false;
+        }
+        bool intact = nextFailed == failed.end() || *nextFailed != i;
+        if (!intact) {
+            ++nextFailed;
+        }
+        if (checked && (!inFile || !intact)) {
+            std::string stored = hexBytes(p, entryBytes);
+            if (inFile) {
+                stored += " " + hexBytes(bytes.data() + block.offset, block.bytes);
+            }
+            corrupt.push_back({ monthName(block.month), "index checksum mismatch", stored });
+            continue;
+        }
+        blocks.push_back(block);
+    }
+    return true;
+}
+
+bool HistoryArchive::write(const std::string& path, const std::vector<WorkDay>& sessions, int64_t endDay) {
+    // Grouped by the month of the local start day, oldest first within each.
+    std::vector<std::pair<int, WorkDay>> byMonth;
+    byMonth.reserve(sessions.size());
+    for (const auto& day : sessions) {
+        byMonth.emplace_back(monthOfDay(day.dayKey()), day);
+    }
+    std::stable_sort(byMonth.begin(), byMonth.end(), [](const auto& a, const auto& b) {
+        return a.first != b.first ? a.first < b.first : a.second.startMs < b.second.startMs;
+    });
+
+    std::map<uint32_t, uint32_t> dictionary;  // process rate id -> index
+    std::vector<uint32_t> dictionaryRates;
+    std::vector<ArchiveBlockInfo> index;
+    std::vector<char> data;
+    ArchiveHeader h = {};
+    std::memcpy(h.magic, kMagic, sizeof(kMagic));
+    h.version = kArchiveVersion;
+    h.sessionCount = sessions.size();
+    h.firstDay = sessions.empty() ? endDay : INT64_MAX;
+    h.endDay = endDay;
+    h.lastStartMs = INT64_MIN;
+
+    for (size_t i = 0; i < byMonth.size();) {
+        ArchiveBlockInfo block = {};
+        block.month = byMonth[i].first;
+        block.offset = data.size();
+        block.firstStartMs = byMonth[i].second.startMs;
+        int64_t prevStart = block.firstStartMs;
+        int16_t prevOffset = 0;
+        int64_t monthFirst = firstDayOfMonth(block.month);
+        uint32_t daysSeen = 0;  // bit d: day monthFirst + d has a session
+        for (; i < byMonth.size() && byMonth[i].first == block.month; ++i) {
+            const WorkDay& day = byMonth[i].second;
+            auto rate = dictionary.emplace(day.rateId, static_cast<uint32_t>(dictionaryRates.size()));
+            if (rate.second) {
+                dictionaryRates.push_back(day.rateId);
+            }
+            putTime(data, day.startMs - prevStart);
+            putTime(data, day.durationMs());
+            putVarint(data, rate.first->second);
+            putVarint(data, zigzag(day.startUtcOffsetMin - prevOffset));
+            putVarint(data, zigzag(day.endUtcOffsetMin - day.startUtcOffsetMin));
+            prevStart = day.startMs;
+            prevOffset = day.startUtcOffsetMin;
+
+            int64_t key = day.dayKey();
+            block.sessions++;
+            daysSeen |= 1u << (key - monthFirst);
+            block.durationMs += day.durationMs();
+            block.grossMsCents += grossMsCents(day);
+            block.netMsCents += netMsCents(day);
+            h.firstDay = std::min(h.firstDay, key);
+            h.lastStartMs = std::max(h.lastStartMs, day.startMs);
+        }
+        block.bytes = static_cast<uint32_t>(data.size() - block.offset);
+        block.daysWorked = static_cast<uint32_t>(countDays(daysSeen));
+        index.push_back(block);
+    }
+    h.blockCount = static_cast<uint32_t>(index.size());
+    h.rateCount = static_cast<uint32_t>(dictionaryRates.size());
+    std::vector<double> rates;
+    for (uint32_t id : dictionaryRates) {
+        rates.push_back(rateTable()[id].hourlyGross);
+        rates.push_back(rateTable()[id].hourlyNet);
+    }
+    h.crc = headerChecksum(h, reinterpret_cast<const char*>(rates.data()), rates.size() * sizeof(double));
+    uint64_t dataStart = sizeof(h) + rates.size() * sizeof(double) + index.size() * sizeof(ArchiveBlockInfo);
+    for (auto& block : index) {
+        block.dataCrc = crc32c(data.data() + block.offset, block.bytes);
+        block.offset += dataStart;
+        block.crc = entryChecksum(block);
+    }
+
+    FILE* file = std::fopen(path.c_str(), "wb");
+    if (!file) {
+        return false;
+    }
+    bool ok = std::fwrite(&h, sizeof(h), 1, file) == 1;
+    ok = ok && (rates.empty() || std::fwrite(rates.data(), sizeof(double), rates.size(), file) == rates.size());
+    ok = ok && (index.empty() || std::fwrite(index.data(), sizeof(ArchiveBlockInfo), index.size(), file) == index.size());
+    ok = ok && (data.empty() || std::fwrite(data.data(), 1, data.size(), file) == data.size());
+    ok = ok && syncFile(file);
+    ok = (std::fclose(file) == 0) && ok;
+    return ok;
+}
+
+bool HistoryArchive::decodeBlock(size_t i, std::vector<WorkDay>& out) const {
+    const ArchiveBlockInfo& block = blocks[i];
+    const char* p = bytes.data() + block.offset;
+    const char* end = p + block.bytes;
+    if (header.version >= 2 && crc32c(p, block.bytes) != block.dataCrc) {
+        return false;
+    }
+    size_t first = out.size();
+    int64_t start = block.firstStartMs;
+    int16_t offset = 0;
+    for (uint32_t n = 0; n < block.sessions; ++n) {
+        int64_t delta, duration;
+        uint64_t rate, offsetDelta, endOffset;
+        if (!getTime(p, end, delta) || !getTime(p, end, duration) || !getVarint(p, end, rate) ||
+            !getVarint(p, end, offsetDelta) || !getVarint(p, end, endOffset) || rate >= rateIds.size()) {
+            out.resize(first);
+            return false;
+        }
+        start += delta;
+        offset = static_cast<int16_t>(offset + unzigzag(offsetDelta));
+        WorkDay day;
+        day.startMs = start;
+        day.endMs = start + duration;
+        day.rateId = rateIds[rate];
+        day.startUtcOffsetMin = offset;
+        day.endUtcOffsetMin = static_cast<int16_t>(offset + unzigzag(endOffset));
+        out.push_back(day);
+    }
+    return true;
+}
+
+void HistoryArchive::decodeRange(int64_t fromMs, int64_t toMs, std::vector<WorkDay>& out,
+                                 std::vector<QuarantinedRecord>* corrupt) const {
+    for (size_t i = 0; i < blocks.size(); ++i) {
+        int64_t monthFirstMs = firstDayOfMonth(blocks[i].month) * 86400000LL - kMaxOffsetMs;
+        int64_t monthEndMs = firstDayOfMonth(blocks[i].month + 1) * 86400000LL + kMaxOffsetMs;
+        if (monthEndMs <= fromMs || monthFirstMs >= toMs) {
+            continue;
+        }
+        size_t first = out.size();
+        if (!decodeBlock(i, out)) {
+            if (corrupt) {
+                const ArchiveBlockInfo& block = blocks[i];
+                corrupt->push_back({ monthName(block.month), "data checksum mismatch",
+                                     hexBytes(bytes.data() + block.offset, block.bytes) });
+            }
+            continue;
+        }
+        auto outside = std::remove_if(out.begin() + first, out.end(), [&](const WorkDay& day) {
+            return day.startMs < fromMs || day.startMs >= toMs;
+        });
+        out.erase(outside, out.end());
+    }
+}
+
+Totals HistoryArchive::totals(int64_t firstDay, int64_t lastDay) const {
+    Totals t;
+    firstDay = std::max(firstDay, header.firstDay);
+    lastDay = std::min(lastDay, header.endDay);
+    if (lastDay <= firstDay) {
+        return t;
+    }
+    std::vector<WorkDay> edge;
+    for (size_t i = 0; i < blocks.size(); ++i) {
+        const ArchiveBlockInfo& block = blocks[i];
+        int64_t monthFirst = firstDayOfMonth(block.month);
+        int64_t monthEnd = firstDayOfMonth(block.month + 1);
+        if (monthEnd <= firstDay || monthFirst >= lastDay) {
+            continue;
+        }
+        if (monthFirst >= firstDay && monthEnd <= lastDay) {
+            t.durationMs += block.durationMs;
+            t.gross.add(block.grossMsCents);
+            t.net.add(block.netMsCents);
+            t.sessions += static_cast<int>(block.sessions);
+            t.daysWorked += static_cast<int>(block.daysWorked);
+            continue;
+        }
+        edge.clear();
+        decodeBlock(i, edge);
+        uint32_t daysSeen = 0;
+        for (const auto& day : edge) {
+            int64_t key = day.dayKey();
+            if (key < firstDay || key >= lastDay) {
+                continue;
+            }
+            t.durationMs += day.durationMs();
+            t.gross.add(grossMsCents(day));
+            t.net.add(netMsCents(day));
+            t.sessions++;
+            daysSeen |= 1u << (key - monthFirst);
+        }
+        t.daysWorked += countDays(daysSeen);
+    }
+    return t;
+}
@@ -0,0 +1,537 @@
+#include "badge_ingest.h"
+
+#include <algorithm>
+#include <climits>
+#include <cstdio>
+#include <cstring>
+#include <string_view>
+#include <unordered_set>
+
+#include "civil_time.h"
+#include "journal.h"
+#include "profiles.h"
+
+namespace {
+
+// Lines are handed over in blocks of at least this size.
+const size_t kBlockBytes = 4 * 1024 * 1024;
+
+struct RawEvent {
+    int64_t ms;
+    std::string_view person;    // into the block being processed
+    uint32_t hash;
+    int16_t offsetMin;
+    uint8_t out;
+};
+
+struct Punch {
+    int64_t ms;
+    int16_t offsetMin;
+    uint8_t out;
+};
+
+// Same instant: the OUT first, so exiting and re-entering at once closes
+// the open session before starting the next.
+bool punchBefore(const Punch& a, const Punch& b) {
+    return a.ms < b.ms || (a.ms == b.ms && a.out > b.out);
+}
+
+struct PersonState {
+    std::vector<Punch> pending;     // not yet paired, in arrival order
+    std::vector<WorkDay> sessions;
+    Punch last{};                   // last punch paired, for double badges
+    Punch open{};
+    bool haveLast = false;
+    bool isOpen = false;
+    bool queued = false;
+};
+
+uint32_t hashId(std::string_view id) {
+    uint32_t h = 2166136261u;   // FNV-1a
+    for (unsigned char c : id) {
+        h = (h ^ c) * 16777619u;
+    }
+    return h;
+}
+
+std::string_view trimField(const char* p, const char* end) {
+    while (p < end && (*p == ' ' || *p == '"')) ++p;
+    while (end > p && (end[-1] == ' ' || end[-1] == '"' || end[-1] == '\r')) --end;
+    return std::string_view(p, static_cast<size_t>(end - p));
+}
+
+// "YYYY-MM-DD[T ]HH:MM:SS[.fff][Z|+HH:MM|+HHMM]".
+bool parseBadgeTime(std::string_view s, int16_t localOffsetMin, int64_t& utcMs, int16_t& offsetMin) {
+    int64_t days;
+    int h, mi, se;
+    if (s.size() < 19 || (s[10] != 'T' && s[10] != ' ') || s[13] != ':' || s[16] != ':' ||
+        !parseDateKey(s, days) || !parseDigits(s.data() + 11, 2, h) || !parseDigits(s.data() + 14, 2, mi) ||
+        !parseDigits(s.data() + 17, 2, se) || h > 23 || mi > 59 || se > 60) {
+        return false;
+    }
+    int64_t localMs = ((days * 24 + h) * 60 + mi) * 60000LL + se * 1000LL;
+    size_t i = 19;
+    if (i < s.size() && s[i] == '.') {
+        int fraction = 0, digits = 0;
+        for (++i; i < s.size() && s[i] >= '0' && s[i] <= '9'; ++i) {
+            if (digits < 3) {
+                fraction = fraction * 10 + (s[i] - '0');
+                digits++;
+            }
+        }
+        while (digits++ < 3) {
+            fraction *= 10;
+        }
+        localMs += fraction;
+    }
+    offsetMin = localOffsetMin;
+    if (i < s.size() && (s[i] == 'Z' || s[i] == 'z')) {
+        offsetMin = 0;
+        ++i;
+    } else if (i < s.size() && (s[i] == '+' || s[i] == '-')) {
+        int oh, om;
+        size_t minutesAt = i + 3 < s.size() && s[i + 3] == ':' ? i + 4 : i + 3;
+        if (minutesAt + 2 > s.size() || !parseDigits(s.data() + i + 1, 2, oh) ||
+            !parseDigits(s.data() + minutesAt, 2, om) || oh > 14 || om > 59) {
+            return false;
+        }
+        offsetMin = static_cast<int16_t>((s[i] == '-' ? -1 : 1) * (oh * 60 + om));
+        i = minutesAt + 2;
+    }
+    if (i != s.size()) {
+        return false;
+    }
+    utcMs = localMs - offsetMin * 60000LL;
+    return true;
+}
+
+// 0 = in, 1 = out, -1 = neither.
+int parseDirection(std::string_view s) {
+    if (s.size() > 7) {
+        return -1;
+    }
+    char lower[8];
+    for (size_t i = 0; i < s.size(); ++i) {
+        lower[i] = static_cast<char>(s[i] >= 'A' && s[i] <= 'Z' ? s[i] - 'A' + 'a' : s[i]);
+    }
+    std::string_view word(lower, s.size());
+    if (word == "in" || word == "i" || word == "e" || word == "1" || word == "entry" || word == "entree") {
+        return 0;
+    }
+    if (word == "out" || word == "o" || word == "s" || word == "0" || word == "exit" || word == "sortie") {
+        return 1;
+    }
+    return -1;
+}
+
+inline bool isSeparator(char c) {
+    return c == ',' || c == ';' || c == '\t';
+}
+
+struct ParseCounts {
+    uint64_t lines = 0;
+    uint64_t events = 0;
+    uint64_t skipped = 0;
+};
+
+// Calls sink(RawEvent) for each event line in [p, end).
+template <class Sink>
+void parseLines(const char* p, const char* end, int16_t localOffsetMin, ParseCounts& counts, Sink&& sink) {
+    while (p < end) {
+        const char* eol = static_cast<const char*>(std::memchr(p, '\n', static_cast<size_t>(end - p)));
+        if (!eol) {
+            eol = end;
+        }
+        const char* line = p;
+        p = eol + 1;
+        counts.lines++;
+        const char* fields[4] = { line, nullptr, nullptr, nullptr };
+        int count = 1;
+        for (const char* c = line; c < eol && count < 4; ++c) {
+            if (isSeparator(*c)) {
+                fields[count++] = c + 1;
+            }
+        }
+        if (count < 3) {
+            if (!trimField(line, eol).empty()) {
+                counts.skipped++;
+            }
+            continue;
+        }
+        const char* directionEnd = count > 3 ? fields[3] - 1 : eol;
+        RawEvent event;
+        event.person = trimField(fields[1], fields[2] - 1);
+        int direction = parseDirection(trimField(fields[2], directionEnd));
+        if (direction < 0 || event.person.empty() ||
+            !parseBadgeTime(trimField(fields[0], fields[1] - 1), localOffsetMin, event.ms, event.offsetMin)) {
+            counts.skipped++;
+            continue;
+        }
+        event.out = static_cast<uint8_t>(direction);
+        event.hash = hashId(event.person);
+        counts.events++;
+        sink(event);
+    }
+}
+
+// The partition of a person: the high bits of the hash, so the low bits
+// still spread people over each partition's table.
+inline size_t partitionOf(uint32_t hash, size_t partitions) {
+    return static_cast<size_t>((static_cast<uint64_t>(hash) * partitions) >> 32);
+}
+
+} // namespace
+
+// The people whose hash falls in one partition, with their waiting events
+// and pairing state. Only one thread touches a partition at a time.
+struct BadgeIngest::Partition {
+    std::vector<std::string> ids;
+    std::vector<uint32_t> hashes;
+    std::vector<PersonState> people;
+    std::vector<uint32_t> slots;        // open addressing: person index + 1, 0 = free
+    std::vector<uint32_t> queue;        // people with waiting events
+    std::vector<std::vector<RawEvent>> inbox;   // per parsing chunk, parallel mode
+    size_t pending = 0;
+    int64_t newest = INT64_MIN;
+    BadgeIngestStats stats;
+
+    uint32_t intern(std::string_view id, uint32_t hash) {
+        if (slots.empty() || ids.size() * 2 >= slots.size()) {
+            rehash(slots.empty() ? 64 : slots.size() * 2);
+        }
+        size_t mask = slots.size() - 1;
+        for (size_t i = hash & mask;; i = (i + 1) & mask) {
+            uint32_t slot = slots[i];
+            if (slot == 0) {
+                slots[i] = static_cast<uint32_t>(ids.size()) + 1;
+                ids.emplace_back(id);
+                hashes.push_back(hash);
+                people.emplace_back();
+                return slots[i] - 1;
+            }
+            if (hashes[slot - 1] == hash && ids[slot - 1] == id) {
+                return slot - 1;
+            }
+        }
+    }
+
+    void rehash(size_t size) {
+        slots.assign(size, 0);
+        for (size_t person = 0; person < ids.size(); ++person) {
+            size_t i = hashes[person] & (size - 1);
+            while (slots[i] != 0) {
+                i = (i + 1) & (size - 1);
+            }
+            slots[i] = static_cast<uint32_t>(person) + 1;
+        }
+    }
+
+    void add(const RawEvent& event, int64_t horizon) {
+        if (event.ms < horizon) {
+            stats.late++;
+            return;
+        }
+        uint32_t index = intern(event.person, event.hash);
+        PersonState& person = people[index];
+        person.pending.push_back(Punch{ event.ms, event.offsetMin, event.out });
+        if (!person.queued) {
+            person.queued = true;
+            queue.push_back(index);
+        }
+        pending++;
+        newest = std::max(newest, event.ms);
+    }
+
+    // Pairs every waiting event before watermark.
+    void advance(int64_t watermark, const BadgeIngestOptions& options) {
+        size_t kept = 0;
+        for (uint32_t index : queue) {
+            PersonState& person = people[index];
+            auto& waiting = person.pending;
+            if (!std::is_sorted(waiting.begin(), waiting.end(), punchBefore)) {
+                std::sort(waiting.begin(), waiting.end(), punchBefore);
+            }
+            auto ready = waiting.begin();
+            for (; ready != waiting.end() && ready->ms < watermark; ++ready) {
+                pair(person, *ready, options);
+            }
+            pending -= static_cast<size_t>(ready - waiting.begin());
+            waiting.erase(waiting.begin(), ready);
+            if (waiting.empty()) {
+                person.queued = false;
+            } else {
+                queue[kept++] = index;
+            }
+        }
+        queue.resize(kept);
+    }
+
+    void pair(PersonState& person, const Punch& punch, const BadgeIngestOptions& options) {
+        if (person.haveLast && punch.out == person.last.out && punch.ms - person.last.ms <= options.duplicateWindowMs) {
+            stats.duplicates++;
+            return;
+        }
+        person.last = punch;
+        person.haveLast = true;
+        if (!punch.out) {
+            stats.missingOut += person.isOpen ? 1 : 0;
+            person.open = punch;
+            person.isOpen = true;
+            return;
+        }
+        if (!person.isOpen) {
+            stats.missingIn++;
+            return;
+        }
+        person.isOpen = false;
+        if (punch.ms - person.open.ms > options.maxSessionMs) {
+            stats.missingOut++;
+            stats.missingIn++;
+            return;
+        }
+        WorkDay day;
+        day.startMs = person.open.ms;
+        day.endMs = punch.ms;
+        day.startUtcOffsetMin = person.open.offsetMin;
+        day.endUtcOffsetMin = punch.offsetMin;
+        person.sessions.push_back(day);
+        stats.sessions++;
+    }
+};
+
+BadgeIngest::BadgeIngest(const BadgeIngestOptions& options, ThreadPool* pool)
+    : options(options), pool(pool), horizon(INT64_MIN) {
+    size_t count = pool ? pool->concurrency() : 1;
+    for (size_t i = 0; i < count; ++i) {
+        partitions.push_back(std::make_unique<Partition>());
+        partitions.back()->inbox.resize(count > 1 ? count : 0);
+    }
+}
+
+BadgeIngest::~BadgeIngest() = default;
+
+void BadgeIngest::feed(const char* data, size_t size) {
+    totals.bytes += size;
+    if (!started && size > 0) {
+        started = true;
+        // Spreadsheet exports may start with a UTF-8 BOM.
+        static const char kBom[] = "\xEF\xBB\xBF";
+        size_t bom = 0;
+        while (bom < 3 && bom < size && data[bom] == kBom[bom]) {
+            ++bom;
+        }
+        if (bom == 3) {
+            data += 3;
+            size -= 3;
+        }
+    }
+    block.insert(block.end(), data, data + size);
+    if (block.size() < kBlockBytes) {
+        return;
+    }
+    size_t whole = block.size();
+    while (whole > 0 && block[whole - 1] != '\n') {
+        --whole;
+    }
+    if (whole == 0) {
+        return;
+    }
+    processBlock(block.data(), whole);
+    block.erase(block.begin(), block.begin() + static_cast<std::ptrdiff_t>(whole));
+}
+
+void BadgeIngest::processBlock(const char* data, size_t size) {
+    if (partitions.size() == 1) {
+        ParseCounts counts;
+        Partition& partition = *partitions[0];
+        parseLines(data, data + size, options.utcOffsetMin, counts,
+                   [&](const RawEvent& event) { partition.add(event, horizon); });
+        totals.lines += counts.lines;
+        totals.events += counts.events;
+        totals.skippedLines += counts.skipped;
+        advance(false);
+        return;
+    }
+
+    // Parse: one chunk of whole lines per participant, each routing its
+    // events to per-partition inboxes.
+    size_t chunks = partitions.size();
+    std::vector<const char*> bounds(chunks + 1, data + size);
+    bounds[0] = data;
+    for (size_t i = 1; i < chunks; ++i) {
+        const char* at = std::max(bounds[i - 1], data + size * i / chunks);
+        const char* eol = static_cast<const char*>(std::memchr(at, '\n', static_cast<size_t>(data + size - at)));
+        bounds[i] = eol ? eol + 1 : data + size;
+    }
+    std::vector<ParseCounts> counts(chunks);
+    pool->parallelFor(chunks, [&](size_t chunk, unsigned) {
+        parseLines(bounds[chunk], bounds[chunk + 1], options.utcOffsetMin, counts[chunk], [&](const RawEvent& event) {
+            partitions[partitionOf(event.hash, chunks)]->inbox[chunk].push_back(event);
+        });
+    });
+    for (const ParseCounts& c : counts) {
+        totals.lines += c.lines;
+        totals.events += c.events;
+        totals.skippedLines += c.skipped;
+    }
+    // Route: each partition takes its events in file order.
+    pool->parallelFor(chunks, [&](size_t index, unsigned) {
+        Partition& partition = *partitions[index];
+        for (auto& inbox : partition.inbox) {
+            for (const RawEvent& event : inbox) {
+                partition.add(event, horizon);
+            }
+            inbox.clear();
+        }
+    });
+    advance(false);
+}
+
+// Moves the horizon to reorderWindowMs before the newest event (or past
+// everything) and pairs what it passed, partitions in parallel.
+void BadgeIngest::advance(bool everything) {
+    int64_t newest = INT64_MIN;
+    size_t pending = 0;
+    for (const auto& partition : partitions) {
+        newest = std::max(newest, partition->newest);
+        pending += partition->pending;
+    }
+    totals.peakPendingEvents = std::max(totals.peakPendingEvents, pending);
+    if (newest == INT64_MIN) {
+        return;
+    }
+    int64_t watermark = everything || pending > options.maxPendingEvents ? newest + 1 : newest - options.reorderWindowMs;
+    if (watermark <= horizon) {
+        return;
+    }
+    horizon = watermark;
+    auto run = [&](size_t index, unsigned) { partitions[index]->advance(watermark, options); };
+    if (partitions.size() > 1) {
+        pool->parallelFor(partitions.size(), run);
+    } else {
+        run(0, 0);
+    }
+}
+
+std::vector<BadgePerson> BadgeIngest::finish() {
+    if (!block.empty()) {
+        processBlock(block.data(), block.size());
+        block.clear();
+    }
+    advance(true);
+    std::vector<BadgePerson> out;
+    for (auto& partition : partitions) {
+        for (PersonState& person : partition->people) {
+            partition->stats.missingOut += person.isOpen ? 1 : 0;
+            person.isOpen = false;
+        }
+        const BadgeIngestStats& s = partition->stats;
+        totals.duplicates += s.duplicates;
+        totals.late += s.late;
+        totals.missingIn += s.missingIn;
+        totals.missingOut += s.missingOut;
+        totals.sessions += s.sessions;
+        totals.people += partition->ids.size();
+        partition->stats = BadgeIngestStats();
+        for (size_t i = 0; i < partition->ids.size(); ++i) {
+            out.push_back(BadgePerson{ std::move(partition->ids[i]), std::move(partition->people[i].sessions) });
+        }
+        partition->ids.clear();
+        partition->hashes.clear();
+        partition->people.clear();
+        partition->slots.clear();
+    }
+    std::sort(out.begin(), out.end(), [](const BadgePerson& a, const BadgePerson& b) { return a.id < b.id; });
+    return out;
+}
+
+bool ingestBadgeLogFile(const std::string& path, const BadgeIngestOptions& options, ThreadPool* pool,
+                        std::vector<BadgePerson>& people, BadgeIngestStats& stats, std::string& error) {
+    FILE* file = std::fopen(path.c_str(), "rb");
+    if (!file) {
+        error = "cannot open " + path;
+        return false;
+    }
+    BadgeIngest ingest(options, pool);
+    std::vector<char> buffer(1024 * 1024);
+    size_t n;
+    while ((n = std::fread(buffer.data(), 1, buffer.size(), file)) > 0) {
+        ingest.feed(buffer.data(), n);
+    }
+    bool ok = !std::ferror(file);
+    std::fclose(file);
+    if (!ok) {
+        error = "read error in " + path;
+        return false;
+    }
+    people = ingest.finish();
+    stats = ingest.stats();
+    return true;
+}
+
+bool storeBadgeSessions(const std::string& root, const std::vector<BadgePerson>& people, ThreadPool& pool,
+                        BadgeStoreStats& stats) {
+    std::vector<BadgeStoreStats> partials(pool.concurrency());
+    pool.parallelFor(people.size(), [&](size_t index, unsigned participant) {
+        const BadgePerson& person = people[index];
+        BadgeStoreStats& partial = partials[participant];
+        if (!isValidProfileName(person.id)) {
+            partial.invalidIds.push_back(person.id);
+            return;
+        }
+        if (person.sessions.empty()) {
+            return;
+        }
+        if (!ensureProfileDirectory(root, person.id)) {
+            partial.failedProfiles.push_back(person.id);
+            return;
+        }
+        Journal journal;
+        journal.open(profileStorePath(root, person.id), SnapshotFormat::Binary);
+        Config config;
+        std::vector<WorkDay> history;
+        journal.load(config, history);
+
+        std::unordered_set<int64_t> known;
+        known.reserve(history.size());
+        for (const auto& wd : history) {
+            known.insert(wd.startMs);
+        }
+        uint32_t rateId = rateTable().intern(config.hourlyGross, config.hourlyNet);
+        size_t before = history.size();
+        for (WorkDay wd : person.sessions) {
+            if (!known.insert(wd.startMs).second) {
+                partial.alreadyStored++;
+                continue;
+            }
+            wd.rateId = rateId;
+            history.push_back(wd);
+        }
+        if (history.size() == before) {
+            return;
+        }
+        partial.added += history.size() - before;
+        // Journaled first, so an instance running on the profile sees them.
+        std::vector<WorkDay> added(history.begin() + static_cast<std::ptrdiff_t>(before), history.end());
+        // Both runs are in start order already.
+        std::inplace_merge(history.begin(), history.begin() + static_cast<std::ptrdiff_t>(before), history.end(),
+                           [](const WorkDay& a, const WorkDay& b) { return a.startMs < b.startMs; });
+        if (!journal.append(added) || !journal.compact(config, history)) {
+            partial.failedProfiles.push_back(person.id);
+            return;
+        }
+        partial.profiles++;
+    });
+
+    for (const auto& partial : partials) {
+        stats.profiles += partial.profiles;
+        stats.added += partial.added;
+        stats.alreadyStored += partial.alreadyStored;
+        stats.invalidIds.insert(stats.invalidIds.end(), partial.invalidIds.begin(), partial.invalidIds.end());
+        stats.failedProfiles.insert(stats.failedProfiles.end(), partial.failedProfiles.begin(),
+                                    partial.failedProfiles.end());
+    }
+    std::sort(stats.invalidIds.begin(), stats.invalidIds.end());
+    std::sort(stats.failedProfiles.begin(), stats.failedProfiles.end());
+    return stats.failedProfiles.empty();
+}
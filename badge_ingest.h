@@ -0,0 +1,116 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "thread_pool.h"
+#include "workday.h"
+
+// --- Badge Log Ingest ---
+//
+// Turns raw door badge exports into WorkDay sessions. One event per line,
+// fields separated by ',', ';' or a tab:
+//
+//   2024-03-05T08:12:33+01:00;E1042;IN
+//   2024-03-05 17:40:02;E1042;out;Door 3
+//
+// The timestamp may use 'T' or a space, carry fractional seconds, and end in
+// 'Z' or a UTC offset; without one it is local time at
+// BadgeIngestOptions::utcOffsetMin. The direction is IN/OUT, I/O, E/S
+// (entrée/sortie) or 1/0, in any case. Further fields are ignored, and lines
+// that do not parse (such as a header row) are counted and skipped.
+//
+// Exports arrive out of order and overlap. The log is read in blocks;
+// events wait per person until the newest timestamp seen is reorderWindowMs
+// past them, then are sorted and paired. Memory holds one block plus the
+// events inside the window, however long the log is. Pairing runs across
+// days, so a night shift that crosses midnight is one session (on the day
+// it started, like a punch in the app). A second punch in the same
+// direction within duplicateWindowMs is a double badge and is dropped. An
+// IN with no OUT before the next IN or within maxSessionMs, and an OUT with
+// no open IN, are counted as missing punches and produce no session.
+//
+// With a pool, each block is split across the participants for parsing and
+// the events are routed to one partition per participant by a hash of the
+// person, so every person is paired by a single thread. The output is the
+// same as the single-threaded one.
+
+struct BadgeIngestOptions {
+    int64_t reorderWindowMs = 6 * 3600000LL;
+    int64_t duplicateWindowMs = 60000;
+    int64_t maxSessionMs = 16 * 3600000LL;
+    int16_t utcOffsetMin = 0;               // for timestamps without an offset
+    // Past this many waiting events, everything waiting is paired at once;
+    // events older than that arrive late.
+    size_t maxPendingEvents = size_t(1) << 22;
+};
+
+struct BadgeIngestStats {
+    uint64_t bytes = 0;
+    uint64_t lines = 0;
+    uint64_t events = 0;
+    uint64_t skippedLines = 0;      // blank lines not included
+    uint64_t duplicates = 0;
+    uint64_t late = 0;              // older than an already paired stretch
+    uint64_t missingIn = 0;
+    uint64_t missingOut = 0;
+    uint64_t sessions = 0;
+    size_t people = 0;
+    size_t peakPendingEvents = 0;
+};
+
+struct BadgePerson {
+    std::string id;
+    std::vector<WorkDay> sessions;  // oldest first, rate id 0
+};
+
+class BadgeIngest {
+public:
+    explicit BadgeIngest(const BadgeIngestOptions& options = BadgeIngestOptions(), ThreadPool* pool = nullptr);
+    ~BadgeIngest();
+    BadgeIngest(const BadgeIngest&) = delete;
+    BadgeIngest& operator=(const BadgeIngest&) = delete;
+
+    // Any slice of the log; lines may span calls.
+    void feed(const char* data, size_t size);
+    // Pairs what is left and returns everyone seen, sorted by id.
+    std::vector<BadgePerson> finish();
+
+    // Pairing counts (duplicates onwards) are filled in by finish().
+    const BadgeIngestStats& stats() const { return totals; }
+
+private:
+    struct Partition;
+
+    void processBlock(const char* data, size_t size);
+    void advance(bool everything);
+
+    BadgeIngestOptions options;
+    ThreadPool* pool;
+    std::vector<std::unique_ptr<Partition>> partitions;
+    std::vector<char> block;
+    int64_t horizon;                // events before this are already paired
+    bool started = false;
+    BadgeIngestStats totals;
+};
+
+bool ingestBadgeLogFile(const std::string& path, const BadgeIngestOptions& options, ThreadPool* pool,
+                        std::vector<BadgePerson>& people, BadgeIngestStats& stats, std::string& error);
+
+struct BadgeStoreStats {
+    size_t profiles = 0;            // shards written
+    size_t added = 0;
+    size_t alreadyStored = 0;       // same start time as a stored session
+    std::vector<std::string> invalidIds;    // not usable as a profile name
+    std::vector<std::string> failedProfiles;
+};
+
+// Adds each person's sessions to <root>/profiles/<id>/, creating the shard
+// if needed, at the shard's configured rate. Each shard is loaded once and
+// compacted once, whatever the number of sessions; shards are written in
+// parallel on the pool.
+bool storeBadgeSessions(const std::string& root, const std::vector<BadgePerson>& people, ThreadPool& pool,
+                        BadgeStoreStats& stats);
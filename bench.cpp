@@ -0,0 +1,1740 @@
+// --- Tracker Benchmark ---
+//
+// Times the core library on synthetic histories (1, 10 and 30 years, four
+// sessions a day). Prints one JSON object per line, so runs can be diffed
+// or fed to a tracking script:
+//
+//   - formatting, UI ticks, tracing, the display list and the text cache
+//   - checkpoint writes, money kernels, predicate queries, checksums
+//   - load, save, punch and export at each history size
+//   - team aggregation, web import and badge ingest
+//   - the query service, and two instances sharing one store
+//
+//   make bench && ./build/native/tracker_bench [--quick] [--dir <path>]
+//
+// Exits non-zero if any correctness check fails; `make test` runs --quick.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <iomanip>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+#include "app_state.h"
+#include "archive.h"
+#include "badge_ingest.h"
+#include "binary_history.h"
+#include "calendar_model.h"
+#include "civil_time.h"
+#include "crc32c.h"
+#include "export.h"
+#include "history_query.h"
+#include "profiles.h"
+#include "query_service.h"
+#include "session_checkpoint.h"
+#include "session_columns.h"
+#include "team_report.h"
+#include "text_cache.h"
+#include "text_parser.h"
+#include "tick_scheduler.h"
+#include "time_format.h"
+#include "trace.h"
+#include "web_import.h"
+
+namespace {
+
+using BenchClock = std::chrono::steady_clock;
+
+double elapsedMs(BenchClock::time_point since) {
+    return std::chrono::duration<double, std::milli>(BenchClock::now() - since).count();
+}
+
+long peakRssKb() {
+#ifdef _WIN32
+    return -1;
+#else
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+#endif
+}
+
+// A snapshot with its journal and the lock file every Journal creates.
+void removeStore(const std::string& path) {
+    std::remove(path.c_str());
+    std::remove((path + ".journal").c_str());
+    std::remove((path + ".lock").c_str());
+}
+
+long fileBytes(const std::string& path) {
+    FILE* file = std::fopen(path.c_str(), "rb");
+    if (!file) {
+        return 0;
+    }
+    std::fseek(file, 0, SEEK_END);
+    long size = std::ftell(file);
+    std::fclose(file);
+    return size;
+}
+
+// Checks that failed in any record; main returns non-zero if there were any, so `make test` catches them.
+int g_failedChecks = 0;
+
+void expect(const char* bench, const char* what, bool passed) {
+    if (!passed) {
+        std::fprintf(stderr, "%s: %s\n", bench, what);
+        g_failedChecks++;
+    }
+}
+
+std::tm monthOf(int64_t dayKey) {
+    int year; unsigned month, day;
+    civilFromDays(dayKey, year, month, day);
+    std::tm tm = {};
+    tm.tm_year = year - 1900;
+    tm.tm_mon = static_cast<int>(month) - 1;
+    tm.tm_mday = 1;
+    return tm;
+}
+
+// Startup as the window sees it: load, then build what the first paint
+// shows (the current month's calendar and the month stats row).
+double firstPaintMs(const std::string& binPath, const std::string& textPath, int64_t today) {
+    AppState state;
+    state.currentViewMonth = monthOf(today);
+    auto t0 = BenchClock::now();
+    state.loadData(binPath, textPath, false);
+    std::vector<CalendarDayModel> days;
+    buildCalendarMonth(state.history, state.currentViewMonth.tm_year + 1900, state.currentViewMonth.tm_mon + 1,
+                       today, days);
+    state.getMonthStatsString(today);
+    return elapsedMs(t0);
+}
+
+// Four sessions every day at UTC+1: 08:00-10:00, 10:15-12:30, 13:30-15:45
+// and 16:00-17:30, with the rate changing once a year.
+std::vector<WorkDay> generateHistory(int years, int64_t lastDay) {
+    static const int kSlots[][2] = { { 480, 600 }, { 615, 750 }, { 810, 945 }, { 960, 1050 } };
+    const int16_t offset = 60;
+
+    std::vector<WorkDay> sessions;
+    int64_t firstDay = lastDay - years * 365;
+    sessions.reserve(static_cast<size_t>(lastDay - firstDay) * 4);
+    for (int64_t day = firstDay; day < lastDay; ++day) {
+        int year; unsigned month, dayOfMonth;
+        civilFromDays(day, year, month, dayOfMonth);
+        uint32_t rateId = rateTable().intern(12.0 + (year % 10) * 0.25, 9.6 + (year % 10) * 0.2);
+        for (const auto& slot : kSlots) {
+            WorkDay wd;
+            wd.startMs = ((day * 1440) + slot[0] - offset) * 60000;
+            wd.endMs = ((day * 1440) + slot[1] - offset) * 60000;
+            wd.rateId = rateId;
+            wd.startUtcOffsetMin = offset;
+            wd.endUtcOffsetMin = offset;
+            sessions.push_back(wd);
+        }
+    }
+    return sessions;
+}
+
+void runWorkload(int years, const std::string& dir) {
+    const std::string binPath = dir + "/bench_history.bin";
+    const std::string textPath = dir + "/bench_data.txt";
+    const std::string exportPath = dir + "/bench_export.out";
+    const std::string archivePath = binPath + ".archive";
+    removeStore(binPath);
+    std::remove(archivePath.c_str());
+    removeStore(textPath);
+
+    int64_t today = daysFromCivil(2024, 6, 15);
+    std::vector<WorkDay> sessions = generateHistory(years, today);
+    size_t sessionCount = sessions.size();
+
+    // save: a full compaction through the persistence thread, sealing the
+    // years before the last two as loadData() would.
+    int64_t sealCutoff = daysFromCivil(2024 - AppState::kDefaultHotYears + 1, 1, 1);
+    double saveMs;
+    {
+        AppState state;
+        state.journal.open(binPath, SnapshotFormat::Binary);
+        state.journal.setSealCutoff(sealCutoff);
+        state.history.assign(sessions);
+        state.persistence.start();
+        auto t0 = BenchClock::now();
+        state.saveData();
+        state.persistence.flush();
+        saveMs = elapsedMs(t0);
+    }
+
+    // load: first paint against an empty install and this history, the
+    // background load of the rest, then the legacy text store (loaded whole).
+    double emptyFirstPaintMs = firstPaintMs(dir + "/bench_missing.bin", dir + "/bench_missing.txt", today);
+    double firstPaint = firstPaintMs(binPath, textPath, today);
+    double loadMs, backgroundLoadMs, loadTextMs, parseMBps;
+    size_t residentSessions;
+    {
+        AppState state;
+        state.currentViewMonth = monthOf(today);
+        auto t0 = BenchClock::now();
+        state.loadData(binPath, textPath, false);
+        loadMs = elapsedMs(t0);
+        t0 = BenchClock::now();
+        state.startBackgroundLoad(nullptr);
+        state.finishBackgroundLoad();
+        backgroundLoadMs = elapsedMs(t0);
+        residentSessions = state.history.size();
+    }
+    {
+        writeTextHistory(textPath, Config(), sessions);
+        AppState state;
+        auto t0 = BenchClock::now();
+        state.loadData(binPath, textPath, true);
+        loadTextMs = elapsedMs(t0);
+
+        ParsedHistory parsed;
+        t0 = BenchClock::now();
+        parseTextHistoryFile(textPath, parsed);
+        parseMBps = fileBytes(textPath) / 1e3 / elapsedMs(t0);
+    }
+
+    AppState state;
+    state.currentViewMonth = monthOf(today);
+    state.loadData(binPath, textPath, false);
+    state.startBackgroundLoad(nullptr);
+    state.finishBackgroundLoad();
+    state.persistence.start();
+
+    // punch: what the UI thread pays per punch out (the disk write is queued).
+    // Punches in the same second are one session to the store.
+    const int kPunches = 1000;
+    double punchUs;
+    double punchFlushMs;
+    std::unordered_set<int64_t> punchSeconds;
+    {
+        double total = 0;
+        for (int i = 0; i < kPunches; ++i) {
+            state.punchIn();
+            punchSeconds.insert(std::chrono::duration_cast<std::chrono::seconds>(
+                                    state.currentSession.startTime.time_since_epoch()).count());
+            auto t0 = BenchClock::now();
+            state.punchOut();
+            total += elapsedMs(t0);
+        }
+        punchUs = total * 1000.0 / kPunches;
+        auto t0 = BenchClock::now();
+        state.persistence.flush();
+        punchFlushMs = elapsedMs(t0);
+    }
+
+    // compact: folds those punches into history.bin, reading back only its
+    // hot years, and trims them from the tail kept in memory.
+    double compactMs;
+    {
+        auto t0 = BenchClock::now();
+        state.saveData();
+        state.persistence.flush();
+        compactMs = elapsedMs(t0);
+    }
+
+    // calendar: every month of the history, paging months in as the view
+    // moves forward.
+    double calendarUs;
+    {
+        std::vector<CalendarDayModel> days;
+        int months = 0;
+        auto t0 = BenchClock::now();
+        state.changeMonth(-years * 12);
+        for (; months < years * 12; ++months) {
+            buildCalendarMonth(state.history, state.currentViewMonth.tm_year + 1900,
+                               state.currentViewMonth.tm_mon + 1, today, days);
+            state.changeMonth(1);
+        }
+        calendarUs = elapsedMs(t0) * 1000.0 / months;
+    }
+
+    // export: the whole history streamed from the store a range at a time,
+    // as the export button does, CSV then JSON Lines.
+    double exportCsvMs, exportJsonMs;
+    long exportCsvBytes, exportJsonBytes;
+    size_t exportRows, exportWeekendRows = 0, weekendSessions = 0;
+    {
+        ExportProgress progress;
+        ExportOptions options;
+        state.historyDays(options.firstDay, options.lastDay);
+        auto load = [&state](int64_t first, int64_t last, std::vector<WorkDay>& sessions) {
+            return state.querySessions(first, last, sessions);
+        };
+        FILE* file = std::fopen(exportPath.c_str(), "wb");
+        auto t0 = BenchClock::now();
+        writeExportRanges(load, file, options, progress);
+        std::fclose(file);
+        exportCsvMs = elapsedMs(t0);
+        exportCsvBytes = fileBytes(exportPath);
+        exportRows = progress.rowsWritten;
+
+        options.format = ExportFormat::JsonLines;
+        file = std::fopen(exportPath.c_str(), "wb");
+        t0 = BenchClock::now();
+        writeExportRanges(load, file, options, progress);
+        std::fclose(file);
+        exportJsonMs = elapsedMs(t0);
+        exportJsonBytes = fileBytes(exportPath);
+
+        // Filtered: the weekend sessions, against counting them by hand.
+        options.format = ExportFormat::JsonLines;
+        file = std::fopen(exportPath.c_str(), "wb");
+        writeExportRanges(load, file, options, progress, onWeekend());
+        std::fclose(file);
+        file = std::fopen(exportPath.c_str(), "rb");
+        for (int ch; file && (ch = std::fgetc(file)) != EOF;) {
+            exportWeekendRows += ch == '\n' ? 1 : 0;
+        }
+        if (file) {
+            std::fclose(file);
+        }
+        std::vector<WorkDay> sessions;
+        for (int64_t first = options.firstDay; first < options.lastDay; first += kExportRangeDays) {
+            state.querySessions(first, std::min(options.lastDay, first + kExportRangeDays), sessions);
+            for (const WorkDay& day : sessions) {
+                weekendSessions += weekdayFromDays(day.dayKey()) >= 5 ? 1 : 0;
+            }
+        }
+    }
+    state.persistence.stop();
+
+    // archive: sealed years against data.txt, opening them, totals from the
+    // block summaries against decoding every session, one month's decode.
+    double archiveOpenMs, summaryUs, decodeAllMs, blockDecodeUs;
+    bool totalsMatch, roundTrip;
+    HistoryArchive archive;
+    {
+        auto t0 = BenchClock::now();
+        archive.load(archivePath);
+        archiveOpenMs = elapsedMs(t0);
+
+        const int kQueries = 1000;
+        Totals summary;
+        t0 = BenchClock::now();
+        for (int i = 0; i < kQueries; ++i) {
+            summary = archive.totals(INT64_MIN, INT64_MAX);
+        }
+        summaryUs = elapsedMs(t0) * 1000.0 / kQueries;
+
+        std::vector<WorkDay> decoded;
+        t0 = BenchClock::now();
+        archive.decodeRange(INT64_MIN, INT64_MAX, decoded);
+        // Round trip: the sealed sessions come back as generated.
+        size_t expectedSealed = 0;
+        roundTrip = true;
+        for (const WorkDay& day : sessions) {
+            if (day.dayKey() >= sealCutoff) {
+                continue;
+            }
+            const WorkDay* back = expectedSealed < decoded.size() ? &decoded[expectedSealed] : nullptr;
+            roundTrip = roundTrip && back && back->startMs == day.startMs && back->endMs == day.endMs &&
+                        back->startUtcOffsetMin == day.startUtcOffsetMin &&
+                        back->endUtcOffsetMin == day.endUtcOffsetMin && back->rateId == day.rateId;
+            expectedSealed++;
+        }
+        roundTrip = roundTrip && expectedSealed > 0 && decoded.size() == expectedSealed;
+        HistoryStore sealed;
+        sealed.assign(std::move(decoded));
+        RollupEngine scan;
+        scan.rebuild(sealed);
+        Totals scanned = scan.range(INT64_MIN / 2, INT64_MAX / 2);
+        decodeAllMs = elapsedMs(t0);
+        totalsMatch = scanned.sessions == summary.sessions && scanned.durationMs == summary.durationMs &&
+                      scanned.daysWorked == summary.daysWorked && scanned.grossCents() == summary.grossCents() &&
+                      scanned.netCents() == summary.netCents();
+
+        t0 = BenchClock::now();
+        for (int i = 0; i < kQueries && archive.blockCount() > 0; ++i) {
+            decoded.clear();
+            archive.decodeBlock(static_cast<size_t>(i) % archive.blockCount(), decoded);
+        }
+        blockDecodeUs = elapsedMs(t0) * 1000.0 / kQueries;
+    }
+    long textBytes = fileBytes(textPath);
+    long sealedTextBytes = archive.sessionCount() ? static_cast<long>(static_cast<double>(textBytes) *
+                                                                     archive.sessionCount() / sessionCount) : 0;
+    double archiveRatio = archive.byteSize() ? static_cast<double>(sealedTextBytes) / archive.byteSize() : 0.0;
+    std::printf("{\"bench\":\"archive\",\"years\":%d,\"sealed_sessions\":%llu,\"archive_bytes\":%ld,"
+                "\"hot_bytes\":%ld,\"data_txt_bytes_for_sealed\":%ld,\"ratio\":%.1f,\"open_ms\":%.3f,"
+                "\"summary_totals_us\":%.3f,\"decode_all_ms\":%.3f,\"block_decode_us\":%.3f,\"totals_match\":%s}\n",
+                years, static_cast<unsigned long long>(archive.sessionCount()), fileBytes(archivePath),
+                fileBytes(binPath), sealedTextBytes,
+                archiveRatio, archiveOpenMs, summaryUs, decodeAllMs, blockDecodeUs, totalsMatch ? "true" : "false");
+    expect("archive", "summary totals differ from the sessions", totalsMatch);
+    expect("archive", "the sealed sessions did not come back as written", roundTrip);
+    expect("archive", "the archive is not 10x smaller than data.txt", archiveRatio >= 10);
+
+    std::printf("{\"bench\":\"workload\",\"years\":%d,\"sessions\":%zu,"
+                "\"save_ms\":%.3f,\"first_paint_ms\":%.3f,\"empty_first_paint_ms\":%.3f,\"load_ms\":%.3f,"
+                "\"background_load_ms\":%.3f,\"resident_sessions\":%zu,\"load_text_ms\":%.3f,\"parse_mb_per_s\":%.1f,"
+                "\"punch_us\":%.3f,\"punch_flush_ms\":%.3f,\"compact_ms\":%.3f,\"calendar_month_us\":%.3f,"
+                "\"export_rows\":%zu,\"export_csv_ms\":%.3f,\"export_csv_bytes\":%ld,\"export_jsonl_ms\":%.3f,"
+                "\"export_jsonl_bytes\":%ld,\"peak_rss_kb\":%ld}\n",
+                years, sessionCount, saveMs, firstPaint, emptyFirstPaintMs, loadMs, backgroundLoadMs, residentSessions,
+                loadTextMs, parseMBps, punchUs, punchFlushMs, compactMs, calendarUs, exportRows,
+                exportCsvMs, exportCsvBytes, exportJsonMs, exportJsonBytes, peakRssKb());
+    expect("workload", "the export missed sessions", exportRows == sessionCount + punchSeconds.size());
+    expect("workload", "the weekend export disagrees with the hand-written loop",
+           weekendSessions > 0 && exportWeekendRows == weekendSessions);
+    std::fflush(stdout);
+
+    removeStore(binPath);
+    std::remove(archivePath.c_str());
+    removeStore(textPath);
+    std::remove(exportPath.c_str());
+    removeStore(dir + "/bench_missing.bin");
+    removeStore(dir + "/bench_missing.txt");
+}
+
+// The formatters time_format.h replaced, as they were: localtime/gmtime,
+// then put_time into a stringstream.
+std::string oldFormatTime(std::chrono::system_clock::time_point tp) {
+    std::time_t time = std::chrono::system_clock::to_time_t(tp);
+    std::tm local_tm;
+    localtime_r(&time, &local_tm);
+    std::stringstream ss;
+    ss << std::put_time(&local_tm, "%H:%M");
+    return ss.str();
+}
+
+std::string oldFormatDate(std::chrono::system_clock::time_point tp) {
+    std::time_t time = std::chrono::system_clock::to_time_t(tp);
+    std::tm local_tm;
+    localtime_r(&time, &local_tm);
+    std::stringstream ss;
+    ss << std::put_time(&local_tm, "%Y-%m-%d");
+    return ss.str();
+}
+
+std::string oldFormatISO(std::chrono::system_clock::time_point tp) {
+    std::time_t time = std::chrono::system_clock::to_time_t(tp);
+    std::tm utc_tm;
+    gmtime_r(&time, &utc_tm);
+    std::stringstream ss;
+    ss << std::put_time(&utc_tm, "%Y-%m-%dT%H:%M:%SZ");
+    return ss.str();
+}
+
+std::wstring oldFormatDuration(long long ms) {
+    long long hours = ms / (1000 * 60 * 60);
+    long long minutes = (ms % (1000 * 60 * 60)) / (1000 * 60);
+    std::wstringstream wss;
+    wss << hours << "h " << std::setw(2) << std::setfill(L'0') << minutes << "m";
+    return wss.str();
+}
+
+// ns per call for each formatter, old against new, on the same instants
+// (7 minutes and 13 seconds apart, so DST changes are crossed). Outputs
+// that differ count as mismatches.
+void runFormatting(bool quick) {
+    const int kCalls = quick ? 100000 : 1000000;
+    const int64_t kFirstMs = 1680000000000LL;   // March 2023
+    auto instant = [&](int i) { return kFirstMs + static_cast<int64_t>(i) * 433000; };
+    size_t sink = 0, mismatches = 0;
+
+    auto nsPerCall = [&](auto&& format) {
+        auto t0 = BenchClock::now();
+        for (int i = 0; i < kCalls; ++i) {
+            sink += format(i);
+        }
+        return elapsedMs(t0) * 1e6 / kCalls;
+    };
+    using std::chrono::milliseconds;
+    using std::chrono::system_clock;
+    auto at = [&](int i) { return system_clock::time_point(milliseconds(instant(i))); };
+    char date[kDateChars], clock[kClockChars], iso[kISOChars];
+    wchar_t duration[kDurationChars];
+
+    double timeOldNs = nsPerCall([&](int i) { return oldFormatTime(at(i)).size(); });
+    double timeNewNs = nsPerCall([&](int i) { return formatLocalClock(localOffsetCache().toLocalMinutes(instant(i)), clock); });
+    double dateOldNs = nsPerCall([&](int i) { return oldFormatDate(at(i)).size(); });
+    double dateNewNs = nsPerCall([&](int i) { return formatLocalDate(localOffsetCache().toLocalMinutes(instant(i)), date); });
+    double isoOldNs = nsPerCall([&](int i) { return oldFormatISO(at(i)).size(); });
+    double isoNewNs = nsPerCall([&](int i) { return formatUtcISO(instant(i), iso); });
+    double durationOldNs = nsPerCall([&](int i) { return oldFormatDuration(static_cast<long long>(i) * 61000).size(); });
+    double durationNewNs = nsPerCall([&](int i) { return formatDurationHM(static_cast<long long>(i) * 61000, duration); });
+
+    for (int i = 0; i < kCalls; i += 97) {
+        int64_t local = localOffsetCache().toLocalMinutes(instant(i));
+        formatLocalClock(local, clock);
+        formatLocalDate(local, date);
+        formatUtcISO(instant(i), iso);
+        formatDurationHM(static_cast<long long>(i) * 61000, duration);
+        mismatches += oldFormatTime(at(i)) != clock || oldFormatDate(at(i)) != date || oldFormatISO(at(i)) != iso ||
+                      oldFormatDuration(static_cast<long long>(i) * 61000) != duration;
+    }
+    std::printf("{\"bench\":\"format\",\"calls\":%d,\"mismatches\":%zu,\"time_old_ns\":%.1f,\"time_new_ns\":%.2f,"
+                "\"date_old_ns\":%.1f,\"date_new_ns\":%.2f,\"iso_old_ns\":%.1f,\"iso_new_ns\":%.2f,"
+                "\"duration_old_ns\":%.1f,\"duration_new_ns\":%.2f,\"sink\":%zu}\n",
+                kCalls, mismatches, timeOldNs, timeNewNs, dateOldNs, dateNewNs, isoOldNs, isoNewNs, durationOldNs,
+                durationNewNs, sink);
+    expect("format", "old and new formatters disagree", mismatches == 0);
+
+    // Export rows round times before 1970 down, as the formatters do.
+    WorkDay early;
+    early.startMs = -30000;     // 1969-12-31 23:59:30 UTC
+    early.endMs = 3600000;
+    std::string row(256, '\0');
+    if (FILE* file = std::tmpfile()) {
+        ExportStream stream(file, ExportFormat::JsonLines);
+        stream.writeRow(early);
+        stream.finish();
+        std::rewind(file);
+        row.resize(std::fread(&row[0], 1, row.size(), file));
+        std::fclose(file);
+    }
+    formatLocalDate(-1, date);
+    formatLocalClock(-1, clock);
+    expect("format", "an export row before 1970 has the wrong date or time",
+           row.find(std::string("\"date\":\"") + date + "\"") != std::string::npos &&
+               row.find(std::string("\"startTime\":\"") + clock + "\"") != std::string::npos);
+}
+
+void runTicks() {
+    // An 8-hour session starting at 09:00 UTC; count UI wakeups until 17:00.
+    int64_t dayStartMs = daysFromCivil(2024, 6, 14) * 86400000LL;
+    VirtualClock clock(dayStartMs + 9 * 3600000LL, 0);
+    TickScheduler scheduler(clock);
+    scheduler.setSession(true, clock.nowMs());
+    int wakeups = countWakeups(scheduler, clock, dayStartMs + 17 * 3600000LL);
+    std::printf("{\"bench\":\"ticks\",\"wakeups_per_8h_session\":%d}\n", wakeups);
+}
+
+// A punch's checkpoint write (one page, flushed) and the per-tick heartbeat.
+void runCheckpoint(const std::string& dir) {
+    const std::string path = dir + "/bench_session.chk";
+    SessionCheckpoint checkpoint;
+    checkpoint.open(path);
+    SessionCheckpointState state;
+    state.working = true;
+    state.startMs = 1718438400000LL;
+    state.hourlyGross = 12.0;
+    state.hourlyNet = 9.6;
+
+    const int kPunches = 200;
+    auto t0 = BenchClock::now();
+    for (int i = 0; i < kPunches; ++i) {
+        state.lastSeenMs = state.startMs + i;
+        checkpoint.write(state, true);
+    }
+    double punchUs = elapsedMs(t0) * 1000.0 / kPunches;
+
+    const int kTicks = 1000000;
+    t0 = BenchClock::now();
+    for (int i = 0; i < kTicks; ++i) {
+        checkpoint.touch(state.startMs + kPunches + i);
+    }
+    double touchNs = elapsedMs(t0) * 1e6 / kTicks;
+    checkpoint.close();
+    std::printf("{\"bench\":\"checkpoint\",\"durable_write_us\":%.2f,\"heartbeat_ns\":%.2f,\"file_bytes\":%ld}\n",
+                punchUs, touchNs, fileBytes(path));
+    std::remove(path.c_str());
+}
+
+// Exact money sums over columnar sessions: every kernel and the rollup
+// trees against an independent 128-bit reference on random inputs, then 10M
+// sessions per kernel, and how far summing grossEarning() doubles drifts.
+MoneyTotals referenceMoney(const SessionColumns& columns, int64_t firstDay, int64_t lastDay) {
+    MoneyTotals t;
+    __int128 gross = 0, net = 0;
+    for (size_t i = 0; i < columns.size(); ++i) {
+        int64_t key = columns.dayKeys()[i];
+        if (key < firstDay || key >= lastDay) {
+            continue;
+        }
+        const Rate& rate = rateTable()[columns.rateIds()[i]];
+        int64_t d = columns.durationMs()[i];
+        t.durationMs += d;
+        gross += static_cast<__int128>(d) * centsPerHour(rate.hourlyGross);
+        net += static_cast<__int128>(d) * centsPerHour(rate.hourlyNet);
+        t.sessions++;
+    }
+    auto round = [](__int128 msCents) {
+        __int128 half = 1800000;
+        return static_cast<int64_t>(msCents >= 0 ? (msCents + half) / 3600000 : -((-msCents + half) / 3600000));
+    };
+    t.grossCents = round(gross);
+    t.netCents = round(net);
+    return t;
+}
+
+void runMoney(bool quick) {
+    uint64_t seed = 0x9e3779b97f4a7c15ULL;
+    auto next = [&seed]() {
+        seed ^= seed << 13;
+        seed ^= seed >> 7;
+        seed ^= seed << 17;
+        return seed;
+    };
+    std::vector<uint32_t> rateIds;
+    for (int i = 0; i < 16; ++i) {
+        rateIds.push_back(rateTable().intern(11.0 + i * 0.37, 8.8 + i * 0.29));
+    }
+    auto randomSession = [&](int64_t firstDay, int days) {
+        WorkDay day;
+        day.startMs = (firstDay + static_cast<int64_t>(next() % days)) * 86400000LL + next() % 86400000LL;
+        day.endMs = day.startMs + static_cast<int64_t>(next() % (next() % 8 == 0 ? 86400000 : 14400000));
+        day.rateId = rateIds[next() % rateIds.size()];
+        return day;
+    };
+
+    const SimdLevel kLevels[] = { SimdLevel::Scalar, SimdLevel::Sse2, SimdLevel::Avx2 };
+    int cases = 0, mismatches = 0;
+    for (; cases < 2000; ++cases) {
+        SessionColumns columns;
+        RollupEngine rollups;
+        size_t n = next() % 200;
+        for (size_t i = 0; i < n; ++i) {
+            WorkDay day = randomSession(19000, 60);
+            columns.append(day);
+            rollups.add(day);
+        }
+        int64_t firstDay = 19000 + static_cast<int64_t>(next() % 70) - 5;
+        int64_t lastDay = firstDay + static_cast<int64_t>(next() % 70);
+        MoneyTotals expected = referenceMoney(columns, firstDay, lastDay);
+        for (SimdLevel level : kLevels) {
+            mismatches += columns.sum(firstDay, lastDay, level) != expected ? 1 : 0;
+        }
+        Totals rolled = rollups.range(firstDay, lastDay);
+        mismatches += rolled.durationMs != expected.durationMs || rolled.grossCents() != expected.grossCents ||
+                      rolled.netCents() != expected.netCents || rolled.sessions != expected.sessions;
+    }
+
+    const size_t kSessions = quick ? 1000000 : 10000000;
+    SessionColumns columns;
+    double doubleGross = 0.0;
+    for (size_t i = 0; i < kSessions; ++i) {
+        WorkDay day = randomSession(10000, 10950);
+        doubleGross += day.grossEarning();
+        columns.append(day);
+    }
+    MoneyTotals expected = referenceMoney(columns, INT64_MIN, INT64_MAX);
+    double ms[3];
+    for (int l = 0; l < 3; ++l) {
+        ms[l] = 1e9;
+        for (int run = 0; run < 5; ++run) {
+            auto t0 = BenchClock::now();
+            MoneyTotals t = columns.sum(INT64_MIN, INT64_MAX, kLevels[l]);
+            ms[l] = std::min(ms[l], elapsedMs(t0));
+            mismatches += t != expected ? 1 : 0;
+        }
+    }
+    auto t0 = BenchClock::now();
+    columns.sum(10000 + 365, 10000 + 730);
+    double yearMs = elapsedMs(t0);
+    std::printf("{\"bench\":\"money\",\"simd\":\"%s\",\"random_cases\":%d,\"mismatches\":%d,\"sessions\":%zu,"
+                "\"scalar_ms\":%.3f,\"sse2_ms\":%.3f,\"avx2_ms\":%.3f,\"one_year_masked_ms\":%.3f,"
+                "\"gross_cents\":%lld,\"double_drift_cents\":%.3f}\n",
+                simdLevelName(bestSimdLevel()), cases, mismatches, kSessions, ms[0], ms[1], ms[2], yearMs,
+                static_cast<long long>(expected.grossCents), doubleGross * 100.0 - expected.grossCents);
+    expect("money", "cent kernels or rollups disagree with the reference", mismatches == 0);
+}
+
+// Predicate queries over 30 years against hand-written loops: a month
+// through the date pushdown versus the same filter over every session,
+// week/month grouping, and grouping by a custom key. Any difference counts
+// as a mismatch.
+void runQuery() {
+    const int64_t today = daysFromCivil(2024, 6, 15);
+    HistoryStore history;
+    history.assign(generateHistory(30, today + 1));
+    auto sameTotals = [](const Totals& a, const Totals& b) {
+        return a.durationMs == b.durationMs && a.sessions == b.sessions && a.daysWorked == b.daysWorked &&
+               a.grossCents() == b.grossCents() && a.netCents() == b.netCents();
+    };
+    auto addTo = [](Totals& t, const WorkDay& day, bool newDay) {
+        t.durationMs += day.durationMs();
+        t.gross.add(grossMsCents(day));
+        t.net.add(netMsCents(day));
+        t.sessions++;
+        t.daysWorked += newDay ? 1 : 0;
+    };
+    int mismatches = 0;
+
+    auto weekendShort = query(history, inMonth(2024, 3) && onWeekend() && shorterThan(8100000));
+    Totals expected;
+    int64_t lastDay = 0;
+    auto t0 = BenchClock::now();
+    for (const WorkDay& day : history.all()) {
+        int64_t key = day.dayKey();
+        int year; unsigned month, dayOfMonth;
+        civilFromDays(key, year, month, dayOfMonth);
+        if (year == 2024 && month == 3 && weekdayFromDays(key) >= 5 && day.durationMs() < 8100000) {
+            addTo(expected, day, key != lastDay);
+            lastDay = key;
+        }
+    }
+    double scanUs = elapsedMs(t0) * 1000.0;
+    t0 = BenchClock::now();
+    Totals got = weekendShort.totals();
+    double pushdownUs = elapsedMs(t0) * 1000.0;
+    mismatches += sameTotals(got, expected) ? 0 : 1;
+
+    double groupMs[2];
+    const GroupBy kGroupings[] = { GroupBy::Week, GroupBy::Month };
+    for (int g = 0; g < 2; ++g) {
+        t0 = BenchClock::now();
+        std::vector<GroupTotals> groups = query(history, onWorkweek()).groupBy(kGroupings[g]);
+        groupMs[g] = elapsedMs(t0);
+        size_t compared = 0;
+        for (const GroupTotals& group : groups) {
+            Totals want;
+            for (const WorkDay& day : history.all()) {
+                int64_t key = day.dayKey();
+                if (weekdayFromDays(key) < 5 && groupStart(key, kGroupings[g]) == group.key) {
+                    addTo(want, day, want.sessions == 0 || key != lastDay);
+                    lastDay = key;
+                }
+            }
+            mismatches += sameTotals(group.totals, want) ? 0 : 1;
+            compared += static_cast<size_t>(want.sessions);
+            if (g == 0 && group.key > groups.front().key + 7 * 104) {
+                break;  // two years of weeks is enough to compare
+            }
+        }
+        mismatches += compared == 0 ? 1 : 0;
+    }
+
+    // A custom key that comes back to earlier groups, larger and smaller
+    // (1, 2, 0, 1, ...): one group per key.
+    auto weekdayMod3 = [](const WorkDay& day) { return (weekdayFromDays(day.dayKey()) + 1) % 3; };
+    std::vector<GroupTotals> byKey =
+        query(history, inDays(daysFromCivil(2023, 1, 1), daysFromCivil(2024, 1, 1))).groupBy(weekdayMod3);
+    mismatches += byKey.size() == 3 ? 0 : 1;
+    for (const GroupTotals& group : byKey) {
+        Totals want;
+        for (const WorkDay& day : history.all()) {
+            int64_t key = day.dayKey();
+            int year; unsigned month, dayOfMonth;
+            civilFromDays(key, year, month, dayOfMonth);
+            if (year == 2023 && weekdayMod3(day) == group.key) {
+                addTo(want, day, want.sessions == 0 || key != lastDay);
+                lastDay = key;
+            }
+        }
+        mismatches += sameTotals(group.totals, want) ? 0 : 1;
+    }
+    std::printf("{\"bench\":\"query\",\"years\":30,\"sessions\":%zu,\"mismatches\":%d,"
+                "\"month_scan_us\":%.1f,\"month_pushdown_us\":%.1f,\"group_week_ms\":%.3f,"
+                "\"group_month_ms\":%.3f}\n",
+                history.size(), mismatches, scanUs, pushdownUs, groupMs[0], groupMs[1]);
+    expect("query", "a query or grouping disagrees with the hand-written loop", mismatches == 0);
+}
+
+// CRC32C throughput, and what verification adds to loading 30 years:
+// history.bin read whole and data.txt parsed, each against the same file
+// without checksums. Then one flipped byte, which should cost one session.
+void runChecksums(const std::string& dir) {
+    const std::string binPath = dir + "/bench_crc.bin";
+    const std::string legacyBinPath = dir + "/bench_crc_v1.bin";
+    const std::string textPath = dir + "/bench_crc.txt";
+    const std::string legacyTextPath = dir + "/bench_crc_legacy.txt";
+
+    std::vector<char> buffer(1 << 20);
+    for (size_t i = 0; i < buffer.size(); ++i) {
+        buffer[i] = static_cast<char>(i * 131 + 7);
+    }
+    double hardwareMs = 1e9, softwareMs = 1e9;
+    uint32_t sink = 0;
+    for (int run = 0; run < 20; ++run) {
+        auto t0 = BenchClock::now();
+        sink ^= crc32c(buffer.data(), buffer.size());
+        hardwareMs = std::min(hardwareMs, elapsedMs(t0));
+        t0 = BenchClock::now();
+        sink ^= crc32cSoftware(buffer.data(), buffer.size());
+        softwareMs = std::min(softwareMs, elapsedMs(t0));
+    }
+
+    std::vector<WorkDay> sessions = generateHistory(30, daysFromCivil(2024, 6, 15));
+    auto rewrite = [](const std::string& from, const std::string& to, auto edit) {
+        FILE* in = std::fopen(from.c_str(), "rb");
+        std::string bytes;
+        char chunk[65536];
+        size_t n;
+        while (in && (n = std::fread(chunk, 1, sizeof(chunk), in)) > 0) {
+            bytes.append(chunk, n);
+        }
+        if (in) {
+            std::fclose(in);
+        }
+        edit(bytes);
+        FILE* out = std::fopen(to.c_str(), "wb");
+        std::fwrite(bytes.data(), 1, bytes.size(), out);
+        std::fclose(out);
+    };
+    writeBinaryHistory(binPath, Config(), sessions);
+    rewrite(binPath, legacyBinPath, [](std::string& bytes) {
+        uint32_t version = 1;
+        std::memcpy(&bytes[8], &version, sizeof(version));
+    });
+    writeTextHistory(textPath, Config(), sessions);
+    rewrite(textPath, legacyTextPath, [](std::string& bytes) {
+        std::string legacy;
+        for (size_t at = 0, nl; (nl = bytes.find('\n', at)) != std::string::npos; at = nl + 1) {
+            legacy.append(bytes, at, bytes.rfind('|', nl) - at);
+            legacy += '\n';
+        }
+        bytes.swap(legacy);
+    });
+
+    auto loadMs = [](const std::string& path) {
+        Journal journal;
+        journal.open(path, SnapshotFormat::Binary);
+        Config config;
+        std::vector<WorkDay> history;
+        auto t0 = BenchClock::now();
+        journal.load(config, history);
+        return elapsedMs(t0);
+    };
+    auto parseMs = [](const std::string& path) {
+        ParsedHistory parsed;
+        auto t0 = BenchClock::now();
+        parseTextHistoryFile(path, parsed, false, 1);
+        return elapsedMs(t0);
+    };
+    // The first load of a file verifies every block; later ones, as each
+    // window, query and compaction is, only what has not passed yet.
+    // Alternated, so that drift in the machine's speed hits both alike.
+    double binFirstLoadMs = loadMs(binPath), binMs = binFirstLoadMs, legacyBinMs = 1e9;
+    for (int run = 0; run < 30; ++run) {
+        legacyBinMs = std::min(legacyBinMs, loadMs(legacyBinPath));
+        binMs = std::min(binMs, loadMs(binPath));
+    }
+    double textMs = 1e9, legacyTextMs = 1e9;
+    for (int run = 0; run < 15; ++run) {
+        legacyTextMs = std::min(legacyTextMs, parseMs(legacyTextPath));
+        textMs = std::min(textMs, parseMs(textPath));
+    }
+
+    // A checked file with one line's checksum cut off loses that line; a
+    // file with none is read as written before checksums.
+    ParsedHistory legacyParsed, cutParsed;
+    parseTextHistoryFile(legacyTextPath, legacyParsed, false, 1);
+    rewrite(textPath, textPath, [](std::string& bytes) {
+        size_t nl = bytes.find('\n', bytes.size() / 2);
+        nl = bytes.find('\n', nl + 1);
+        size_t bar = bytes.rfind('|', nl);
+        bytes.erase(bar, nl - bar);
+    });
+    parseTextHistoryFile(textPath, cutParsed, false, 1);
+    expect("checksum", "a checked text file accepted a line without its checksum",
+           cutParsed.errors.size() == 1 && cutParsed.errors[0].message == std::string("missing checksum") &&
+               cutParsed.days.size() == sessions.size() - 1);
+    expect("checksum", "a text file from before checksums did not load",
+           !legacyParsed.checksummed && legacyParsed.errors.empty() && legacyParsed.days.size() == sessions.size());
+
+    rewrite(binPath, binPath, [](std::string& bytes) { bytes[sizeof(BinaryHistoryHeader) + 1000 * 64 + 5] ^= 1; });
+    std::remove((binPath + ".quarantine").c_str());
+    Journal journal;
+    journal.open(binPath, SnapshotFormat::Binary);
+    Config config;
+    std::vector<WorkDay> history;
+    journal.load(config, history);
+    std::printf("{\"bench\":\"checksum\",\"hardware\":%s,\"crc_hw_mb_per_s\":%.0f,\"crc_sw_mb_per_s\":%.0f,"
+                "\"sessions\":%zu,\"bin_first_load_ms\":%.3f,\"bin_load_ms\":%.3f,\"bin_unchecked_ms\":%.3f,"
+                "\"bin_overhead_pct\":%.1f,"
+                "\"text_parse_ms\":%.3f,\"text_unchecked_ms\":%.3f,\"text_overhead_pct\":%.1f,"
+                "\"flipped_byte_sessions_lost\":%zu,\"quarantined\":%zu,\"sink\":%u}\n",
+                crc32cHardware() ? "true" : "false", 1.048576e3 / hardwareMs, 1.048576e3 / softwareMs,
+                sessions.size(), binFirstLoadMs, binMs, legacyBinMs, (binMs / legacyBinMs - 1) * 100, textMs, legacyTextMs,
+                (textMs / legacyTextMs - 1) * 100, sessions.size() - history.size(), journal.loadErrors().size(),
+                static_cast<unsigned>(sink & 1));
+    expect("checksum", "a flipped byte went unnoticed",
+           journal.loadErrors().size() == 1 && history.size() < sessions.size());
+
+    // The journal of a checked snapshot is checked as well.
+    writeBinaryHistory(legacyBinPath, Config(), {});
+    std::remove((legacyBinPath + ".quarantine").c_str());
+    if (FILE* file = std::fopen((legacyBinPath + ".journal").c_str(), "wb")) {
+        std::string cut = formatWorkDayRecord(sessions[0]);
+        cut.erase(cut.rfind('|')).push_back('\n');
+        std::string records = cut + formatWorkDayRecord(sessions[1]);
+        std::fwrite(records.data(), 1, records.size(), file);
+        std::fclose(file);
+    }
+    std::vector<std::string> followedErrors;
+    std::vector<WorkDay> tail;
+    {
+        Journal followed;
+        followed.open(legacyBinPath, SnapshotFormat::Binary);
+        followed.load(config, tail);
+        followedErrors = followed.loadErrors();
+    }
+    expect("checksum", "a journal line without its checksum was accepted",
+           tail.size() == 1 && followedErrors.size() == 1 &&
+               followedErrors[0].find("missing checksum") != std::string::npos);
+    std::remove((legacyBinPath + ".quarantine").c_str());
+    for (const std::string& path : { binPath, legacyBinPath, textPath, legacyTextPath }) {
+        removeStore(path);
+    }
+    std::remove((binPath + ".quarantine").c_str());
+}
+
+// Cost of a TraceScope with tracing off (the shipping default) and on.
+void runTrace() {
+    const int kSpans = 10000000;
+    setTraceEnabled(false);
+    auto t0 = BenchClock::now();
+    for (int i = 0; i < kSpans; ++i) {
+        TraceScope scope(TraceSpan::Paint);
+    }
+    double disabledNs = elapsedMs(t0) * 1e6 / kSpans;
+
+    const int kEnabledSpans = 1000000;
+    setTraceEnabled(true);
+    t0 = BenchClock::now();
+    for (int i = 0; i < kEnabledSpans; ++i) {
+        TraceScope scope(TraceSpan::Paint);
+    }
+    double enabledNs = elapsedMs(t0) * 1e6 / kEnabledSpans;
+    setTraceEnabled(false);
+
+    TraceSummary summary = traceSummary(TraceSpan::Paint);
+    std::printf("{\"bench\":\"trace\",\"disabled_ns_per_span\":%.2f,\"enabled_ns_per_span\":%.2f,"
+                "\"recorded\":%llu,\"p50_ns\":%llu,\"p99_ns\":%llu}\n",
+                disabledNs, enabledNs, static_cast<unsigned long long>(summary.count),
+                static_cast<unsigned long long>(summary.p50Ns), static_cast<unsigned long long>(summary.p99Ns));
+}
+
+// A 460x720 window, working, showing a month whose first day falls on
+// firstWeekday (0 = Monday), padded with the neighbouring months' days.
+DisplayState windowState(const wchar_t* title, int firstWeekday, int monthDays, int previousMonthDays, int today) {
+    DisplayState state;
+    state.client = { 0, 0, 460, 720 };
+    state.header = { 20, 20, 440, 60 };
+    state.punchButton = { 20, 80, 440, 130 };
+    state.workedTimeLabel = { 20, 150, 230, 180 };
+    state.workedTimeValue = { 230, 150, 440, 180 };
+    state.monthStats = { 20, 185, 440, 210 };
+    state.monthNavPrev = { 20, 230, 60, 270 };
+    state.monthNavNext = { 400, 230, 440, 270 };
+    state.monthNavDisplay = { 60, 230, 400, 270 };
+    state.calendarHeader = { 20, 280, 440, 300 };
+    state.exportButton = { 20, 670, 440, 705 };
+    state.isWorking = true;
+    state.headerText = L"TimeTracker Pro";
+    state.workedTimeLabelText = L"Temps travaillé :";
+    state.workedTimeText = L"03:00:00";
+    state.monthStatsText = L"112 h, 1520.00 €";
+    state.monthNavPrevText = L"◀";
+    state.monthNavNextText = L"▶";
+    state.monthTitle = title;
+    state.exportButtonText = L"📤 Exporter";
+    for (int i = 0; i < 42; ++i) {
+        CalendarCell cell;
+        cell.rect = { 20 + (i % 7) * 60, 300 + (i / 7) * 60, 20 + (i % 7 + 1) * 60, 300 + (i / 7 + 1) * 60 };
+        int day = i - firstWeekday + 1;
+        if (day < 1) {
+            cell.dayNumber = previousMonthDays + day;
+            cell.type = DayType::OtherMonth;
+        } else if (day > monthDays) {
+            cell.dayNumber = day - monthDays;
+            cell.type = DayType::OtherMonth;
+        } else {
+            cell.dayNumber = day;
+            cell.type = day == today ? DayType::Today : DayType::FullDay;
+        }
+        state.calendar.push_back(cell);
+    }
+    return state;
+}
+
+// The display list against what OnPaint relies on: ids that survive a
+// rebuild, a tick that dirties nothing but the running time, and a month
+// change that dirties the calendar.
+void runDisplayList() {
+    DisplayState june = windowState(L"juin 2024", 5, 30, 31, 15);
+    DisplayList frame = buildDisplayList(june);
+    auto idsOf = [](const DisplayList& list) {
+        std::vector<uint32_t> ids;
+        for (const auto& item : list) {
+            ids.push_back(item.id);
+        }
+        return ids;
+    };
+    std::vector<uint32_t> ids = idsOf(frame);
+    std::vector<uint32_t> sortedIds = ids;
+    std::sort(sortedIds.begin(), sortedIds.end());
+    bool stableIds = std::adjacent_find(sortedIds.begin(), sortedIds.end()) == sortedIds.end() &&
+                     idsOf(buildDisplayList(june)) == ids;
+    DisplayDiff same = diffDisplayLists(frame, buildDisplayList(june));
+    stableIds = stableIds && !same.full && same.dirty.empty() && same.changedText.empty();
+
+    DisplayState tick = june;
+    tick.workedTimeText = L"03:00:01";
+    DisplayList tickFrame = buildDisplayList(tick);
+    DisplayDiff tickDiff = diffDisplayLists(frame, tickFrame);
+    bool tickOnlyWorkedTime = idsOf(tickFrame) == ids && !tickDiff.full && tickDiff.dirty.size() == 1 &&
+                              tickDiff.dirty[0] == june.workedTimeValue &&
+                              tickDiff.changedText == std::vector<uint32_t>{ kItemWorkedTimeValue };
+
+    // July 2024 starts on a Monday, so every cell's day number moves.
+    DisplayState july = windowState(L"juillet 2024", 0, 31, 30, 0);
+    DisplayList julyFrame = buildDisplayList(july);
+    DisplayDiff monthDiff = diffDisplayLists(frame, julyFrame, 64);
+    bool monthDirtiesCalendar = !monthDiff.full && std::binary_search(monthDiff.changedText.begin(),
+                                                                      monthDiff.changedText.end(), kItemMonthTitle);
+    for (const auto& item : julyFrame) {
+        if (item.id < kItemCalendarFirst) {
+            continue;
+        }
+        auto before = std::find_if(frame.begin(), frame.end(),
+                                   [&item](const DisplayItem& o) { return o.id == item.id; });
+        if (before != frame.end() && before->sameAppearance(item)) {
+            continue;
+        }
+        bool covered = std::any_of(monthDiff.dirty.begin(), monthDiff.dirty.end(), [&item](const DisplayRect& r) {
+            return r.left <= item.rect.left && r.top <= item.rect.top && item.rect.right <= r.right &&
+                   item.rect.bottom <= r.bottom;
+        });
+        bool listed = item.kind != DisplayItemKind::Text ||
+                      std::binary_search(monthDiff.changedText.begin(), monthDiff.changedText.end(), item.id);
+        monthDirtiesCalendar = monthDirtiesCalendar && covered && listed;
+    }
+
+    const int kFrames = 20000;
+    auto t0 = BenchClock::now();
+    for (int i = 0; i < kFrames; ++i) {
+        tickFrame = buildDisplayList(tick);
+    }
+    double buildUs = elapsedMs(t0) * 1e3 / kFrames;
+    t0 = BenchClock::now();
+    size_t dirtyRects = 0;
+    for (int i = 0; i < kFrames; ++i) {
+        dirtyRects += diffDisplayLists(frame, tickFrame).dirty.size();
+    }
+    double diffUs = elapsedMs(t0) * 1e3 / kFrames;
+    std::printf("{\"bench\":\"display\",\"items\":%zu,\"stable_ids\":%s,\"tick_changes_only_worked_time\":%s,"
+                "\"month_change_dirties_calendar\":%s,\"month_dirty_rects\":%zu,\"build_us\":%.2f,"
+                "\"diff_us\":%.2f,\"sink\":%zu}\n",
+                frame.size(), stableIds ? "true" : "false", tickOnlyWorkedTime ? "true" : "false",
+                monthDirtiesCalendar ? "true" : "false", monthDiff.dirty.size(), buildUs, diffUs, dirtyRects);
+    expect("display", "ids changed between identical frames", stableIds);
+    expect("display", "a tick dirtied more than the worked time", tickOnlyWorkedTime);
+    expect("display", "a month change left calendar items clean", monthDirtiesCalendar);
+}
+
+// The text cache headless: its LRU against a plain list on random keys,
+// then an hour of one-second ticks painted the way OnPaint does, counting
+// how many text items still have to be rasterized per tick.
+struct FakeTextImage {
+    uint32_t serial;
+};
+
+void runTextCache() {
+    std::vector<TextKey> pool;
+    std::mt19937 rng(25);
+    for (int i = 0; i < 300; ++i) {
+        TextKey key;
+        key.text = std::to_wstring(i % 100);
+        key.font = static_cast<FontRole>(i % 4);
+        key.argb = 0xFF000000u | static_cast<uint32_t>(i / 100);
+        key.width = 20 + static_cast<int>(rng() % 200);
+        key.height = 20 + static_cast<int>(rng() % 40);
+        pool.push_back(key);
+    }
+    const size_t kBudget = 256 * 1024;
+    TextRasterCache<FakeTextImage> cache(kBudget);
+    std::vector<std::pair<size_t, uint32_t>> reference;   // pool index and serial, most recent first
+    size_t mismatches = 0;
+    for (uint32_t serial = 0; serial < 200000; ++serial) {
+        size_t k = rng() % pool.size();
+        auto at = std::find_if(reference.begin(), reference.end(), [k](const std::pair<size_t, uint32_t>& e) { return e.first == k; });
+        FakeTextImage* image = cache.find(pool[k]);
+        if ((image != nullptr) != (at != reference.end()) || (image && image->serial != at->second)) {
+            mismatches++;
+        }
+        if (at != reference.end()) {
+            auto entry = *at;
+            reference.erase(at);
+            reference.insert(reference.begin(), entry);
+            continue;
+        }
+        cache.insert(pool[k], std::unique_ptr<FakeTextImage>(new FakeTextImage{ serial }));
+        reference.insert(reference.begin(), { k, serial });
+        size_t used = 0;
+        for (size_t i = 0; i < reference.size(); ++i) {
+            used += textImageBytes(pool[reference[i].first]);
+            if (used > kBudget && i > 0) {
+                reference.resize(i);
+                break;
+            }
+        }
+    }
+    // The reference stops at the first entry past budget, the cache evicts
+    // from the tail; both keep the longest prefix that fits.
+    mismatches += cache.size() != reference.size();
+    mismatches += splitGlyphs(L"e\u0301\uFE0F1 ").size() != 3;
+    mismatches += layoutGlyphRun({ 10.0f, 10.0f }, TextAlign::Far, 30) != std::vector<int>{ 10, 20 };
+    mismatches += layoutGlyphRun({ 10.0f, 10.0f }, TextAlign::Center, 30) != std::vector<int>{ 5, 15 };
+    mismatches += !layoutGlyphRun({ 10.0f, 10.0f }, TextAlign::Near, 19).empty();
+
+    DisplayState state = windowState(L"juin 2024", 5, 30, 31, 15);
+
+    // As OnPaint draws: changed strings as glyph runs (8 px per glyph here),
+    // the rest as whole strings.
+    TextRasterCache<FakeTextImage> texts;
+    TextRasterCache<FakeTextImage> glyphCache(1024 * 1024);
+    uint32_t rasterized = 0;
+    auto render = [&rasterized](const TextKey&) { return std::unique_ptr<FakeTextImage>(new FakeTextImage{ rasterized++ }); };
+    size_t blits = 0;
+    auto drawText = [&](const DisplayItem& item, bool changedText) {
+        if (changedText) {
+            std::vector<std::wstring> glyphs = splitGlyphs(item.text);
+            std::vector<int> lefts = layoutGlyphRun(std::vector<float>(glyphs.size(), 8.0f), item.align, item.rect.width());
+            if (lefts.size() == glyphs.size()) {
+                for (const auto& glyph : glyphs) {
+                    TextKey key;
+                    key.text = glyph;
+                    key.font = item.font;
+                    key.align = TextAlign::Near;
+                    key.argb = item.argb;
+                    key.width = 12;
+                    key.height = item.rect.height();
+                    glyphCache.fetch(key, render);
+                    blits++;
+                }
+                return;
+            }
+        }
+        texts.fetch(textKeyOf(item), render);
+        blits++;
+    };
+    DisplayList lastFrame;
+    size_t firstFrameTexts = 0, tickTexts = 0, tickRasterized = 0, tickBlits = 0;
+    const int kTicks = 3600;
+    auto t0 = BenchClock::now();
+    for (int tick = 0; tick <= kTicks; ++tick) {
+        int seconds = 3 * 3600 + tick;
+        wchar_t buffer[64];
+        swprintf(buffer, 64, L"%02d:%02d:%02d", seconds / 3600, seconds / 60 % 60, seconds % 60);
+        state.workedTimeText = buffer;
+        swprintf(buffer, 64, L"Juin : 112 h, %.2f €", 1520.0 + seconds * 12.0 / 3600);
+        state.monthStatsText = buffer;
+
+        DisplayList frame = buildDisplayList(state);
+        DisplayDiff diff = diffDisplayLists(lastFrame, frame);
+        uint32_t before = rasterized;
+        size_t drawn = 0, blitsBefore = blits;
+        for (const auto& dirty : diff.dirty) {
+            for (const auto& item : frame) {
+                if (item.kind == DisplayItemKind::Text && !item.rect.empty() && item.rect.intersects(dirty)) {
+                    drawText(item, std::binary_search(diff.changedText.begin(), diff.changedText.end(), item.id));
+                    drawn++;
+                }
+            }
+        }
+        if (tick == 0) {
+            firstFrameTexts = drawn;
+        } else if (tick > 60) {
+            tickTexts += drawn;
+            tickRasterized += rasterized - before;
+            tickBlits += blits - blitsBefore;
+        }
+        lastFrame = std::move(frame);
+    }
+    double tickUs = elapsedMs(t0) * 1e3 / (kTicks + 1);
+
+    // Every text item of a full frame, all hits.
+    DisplayList frame = buildDisplayList(state);
+    const int kFrames = 20000;
+    size_t lookups = 0;
+    t0 = BenchClock::now();
+    for (int i = 0; i < kFrames; ++i) {
+        for (const auto& item : frame) {
+            if (item.kind == DisplayItemKind::Text && !item.rect.empty()) {
+                drawText(item, false);
+                lookups++;
+            }
+        }
+    }
+    double lookupNs = elapsedMs(t0) * 1e6 / lookups;
+
+    // Ticks after the first minute, once every digit has been seen.
+    const double kSteadyTicks = kTicks - 60;
+    std::printf("{\"bench\":\"text_cache\",\"mismatches\":%zu,\"first_frame_texts\":%zu,"
+                "\"texts_per_tick\":%.2f,\"rasterized_per_tick\":%.3f,\"blits_per_tick\":%.2f,"
+                "\"tick_paint_model_us\":%.2f,\"lookup_ns\":%.1f,\"entries\":%zu,\"cache_kb\":%zu,"
+                "\"glyphs\":%zu,\"evictions\":%llu}\n",
+                mismatches, firstFrameTexts, tickTexts / kSteadyTicks, tickRasterized / kSteadyTicks,
+                tickBlits / kSteadyTicks, tickUs, lookupNs, texts.size(), texts.bytes() / 1024, glyphCache.size(),
+                static_cast<unsigned long long>(texts.evictions() + glyphCache.evictions()));
+    expect("text_cache", "cache or glyph layout disagrees with the reference", mismatches == 0);
+}
+
+// 200 profiles with five years each, aggregated on the thread pool.
+void runTeam(const std::string& dir, int profileCount, int years) {
+    std::string root = dir + "/team";
+#ifndef _WIN32
+    mkdir(root.c_str(), 0755);
+#endif
+    int64_t today = daysFromCivil(2024, 6, 15);
+    std::vector<std::string> names;
+    for (int i = 0; i < profileCount; ++i) {
+        char name[32];
+        std::snprintf(name, sizeof(name), "employee-%03d", i);
+        names.push_back(name);
+        ensureProfileDirectory(root, name);
+        // Staggered start dates so shards differ in length.
+        writeBinaryHistory(profileStorePath(root, name), Config(), generateHistory(years, today - i));
+    }
+
+    ThreadPool pool;
+    auto t0 = BenchClock::now();
+    TeamReport report = aggregateTeam(root, listProfiles(root), pool);
+    double aggregateMs = elapsedMs(t0);
+
+    std::printf("{\"bench\":\"team\",\"profiles\":%zu,\"years\":%d,\"sessions\":%zu,\"threads\":%u,"
+                "\"aggregate_ms\":%.3f,\"peak_rss_kb\":%ld}\n",
+                report.profiles, years, report.sessions, pool.concurrency(), aggregateMs, peakRssKb());
+    std::fflush(stdout);
+    // The report only reads: it leaves no journal or lock file behind.
+    size_t created = 0;
+    for (const auto& name : names) {
+        for (const char* suffix : { ".journal", ".lock" }) {
+            if (FILE* file = std::fopen((profileStorePath(root, name) + suffix).c_str(), "rb")) {
+                std::fclose(file);
+                created++;
+            }
+        }
+    }
+    expect("team", "the report created files in the profiles it read",
+           created == 0 && report.profiles == names.size());
+
+    for (const auto& name : names) {
+        removeStore(profileStorePath(root, name));
+        std::remove(profileDirectory(root, name).c_str());
+    }
+    std::remove(profilesDirectory(root).c_str());
+    std::remove(root.c_str());
+}
+
+// Writes `json` as the body of a JSON string.
+void writeJsonEscaped(FILE* file, const std::string& json) {
+    for (char c : json) {
+        if (c == '"' || c == '\\') {
+            std::fputc('\\', file);
+        }
+        std::fputc(c, file);
+    }
+}
+
+// A raw localStorage dump (history as a JSON string inside JSON, the worst
+// case for the importer): one day a day with two pauses, for `years` years.
+void runWebImport(const std::string& dir, int years) {
+    const std::string path = dir + "/bench_web.json";
+    FILE* file = std::fopen(path.c_str(), "wb");
+    if (!file) {
+        return;
+    }
+    std::fputs("{\"timetracker_config\":\"", file);
+    writeJsonEscaped(file, "{\"hourlyGross\":12.5,\"hourlyNet\":10}");
+    std::fputs("\",\"timetracker_history\":\"[", file);
+
+    // The web app writes ISO strings with milliseconds.
+    auto iso = [](int64_t ms) {
+        char text[kISOChars];
+        formatUtcISO(ms, text);
+        return std::string(text, 19) + ".000Z";
+    };
+    int64_t lastDay = daysFromCivil(2024, 6, 15);
+    for (int64_t day = lastDay - years * 365; day < lastDay; ++day) {
+        int64_t startMs = (day * 1440 + 7 * 60 + 30) * 60000;   // 08:30 at UTC+1
+        char date[kDateChars];
+        formatLocalDate(day * 1440, date);
+        std::string record = std::string(day == lastDay - years * 365 ? "" : ",") +
+            "{\"date\":\"" + date + "\",\"startTime\":\"08:30\",\"endTime\":\"17:30\","
+            "\"startDateTime\":\"" + iso(startMs) + "\",\"endDateTime\":\"" + iso(startMs + 9 * 3600000LL) + "\","
+            "\"duration\":\"7h 45m\",\"durationMs\":27900000,\"totalPauseMs\":4500000,\"pauses\":["
+            "{\"start\":\"" + iso(startMs + 3 * 3600000LL) + "\",\"end\":\"" + iso(startMs + 4 * 3600000LL) + "\",\"duration\":3600000},"
+            "{\"start\":\"" + iso(startMs + 6 * 3600000LL) + "\",\"end\":\"" + iso(startMs + 6 * 3600000LL + 900000) + "\",\"duration\":900000}],"
+            "\"grossEarning\":\"96.88\",\"netEarning\":\"77.50\",\"hourlyGross\":12.5,\"hourlyNet\":10}";
+        writeJsonEscaped(file, record);
+    }
+    std::fputs("]\"}", file);
+    std::fclose(file);
+
+    WebImportStats stats;
+    std::string error;
+    size_t sessions = 0;
+    long rssBefore = peakRssKb();
+    auto t0 = BenchClock::now();
+    bool ok = importWebHistoryFile(path, [&](const WorkDay&) { sessions++; }, stats, error);
+    double ms = elapsedMs(t0);
+    std::printf("{\"bench\":\"web_import\",\"ok\":%s,\"years\":%d,\"bytes\":%llu,\"days\":%zu,\"sessions\":%zu,"
+                "\"import_ms\":%.3f,\"mb_per_s\":%.1f,\"rss_growth_kb\":%ld}\n",
+                ok ? "true" : "false", years, static_cast<unsigned long long>(stats.bytes), stats.days, sessions, ms,
+                stats.bytes / 1e3 / ms, peakRssKb() - rssBefore);
+    expect("web_import", "import failed", ok);
+    std::fflush(stdout);
+    std::remove(path.c_str());
+}
+
+// A year of door badge events for `people` employees: two stretches a
+// workday, a tenth of them on night shifts across midnight, with double
+// badges and lost punches, written up to two hours out of order as readers
+// sync late.
+void runBadgeIngest(const std::string& dir, int people) {
+    const std::string path = dir + "/bench_badges.csv";
+    FILE* file = std::fopen(path.c_str(), "wb");
+    if (!file) {
+        return;
+    }
+    struct Event {
+        int64_t sortKey;
+        int64_t ms;
+        int person;
+        bool out;
+    };
+    std::vector<Event> events;
+    std::mt19937 rng(22);
+    int64_t firstDay = daysFromCivil(2023, 6, 1);
+    for (int person = 0; person < people; ++person) {
+        bool nights = person % 10 == 0;
+        for (int64_t day = firstDay; day < firstDay + 365; ++day) {
+            if (weekdayFromDays(day) >= 5) {
+                continue;
+            }
+            int64_t start = (day * 1440 + (nights ? 21 * 60 : 7 * 60) + static_cast<int>(rng() % 90)) * 60000;
+            int64_t stretches[2][2] = { { start, start + 4 * 3600000LL }, { start + 5 * 3600000LL, start + 9 * 3600000LL } };
+            for (auto& stretch : stretches) {
+                for (int end = 0; end < 2; ++end) {
+                    if (rng() % 100 == 0) {
+                        continue;   // lost punch
+                    }
+                    int copies = rng() % 40 == 0 ? 2 : 1;
+                    for (int copy = 0; copy < copies; ++copy) {
+                        int64_t ms = stretch[end] + copy * 15000;
+                        events.push_back(Event{ ms + static_cast<int64_t>(rng() % 7200000), ms, person, end == 1 });
+                    }
+                }
+            }
+        }
+    }
+    std::sort(events.begin(), events.end(), [](const Event& a, const Event& b) { return a.sortKey < b.sortKey; });
+    std::fputs("Horodatage;Badge;Sens;Porte\n", file);
+    for (const Event& e : events) {
+        int64_t local = e.ms + 3600000;     // written at UTC+1
+        int year;
+        unsigned month, day;
+        civilFromDays(floorDiv(local, 86400000), year, month, day);
+        int64_t second = floorDiv(local, 1000) - floorDiv(local, 86400000) * 86400;
+        std::fprintf(file, "%04d-%02u-%02uT%02d:%02d:%02d+01:00;E%05d;%s;Hall\n", year, month, day,
+                     static_cast<int>(second / 3600), static_cast<int>(second / 60 % 60), static_cast<int>(second % 60),
+                     e.person, e.out ? "OUT" : "IN");
+    }
+    std::fclose(file);
+    events = std::vector<Event>();
+
+    ThreadPool pool;
+    BadgeIngestOptions options;
+    std::vector<BadgePerson> serial, parallel;
+    BadgeIngestStats serialStats, parallelStats;
+    std::string error;
+    long rssBefore = peakRssKb();
+    auto t0 = BenchClock::now();
+    bool ok = ingestBadgeLogFile(path, options, nullptr, serial, serialStats, error);
+    double serialMs = elapsedMs(t0);
+    long rssGrowth = peakRssKb() - rssBefore;
+    t0 = BenchClock::now();
+    ok = ingestBadgeLogFile(path, options, &pool, parallel, parallelStats, error) && ok;
+    double parallelMs = elapsedMs(t0);
+
+    // Partitioning by person must not change a single session.
+    size_t mismatches = serial.size() == parallel.size() ? 0 : 1;
+    for (size_t i = 0; mismatches == 0 && i < serial.size(); ++i) {
+        const auto& a = serial[i].sessions;
+        const auto& b = parallel[i].sessions;
+        mismatches += serial[i].id != parallel[i].id || a.size() != b.size();
+        for (size_t j = 0; j < a.size() && j < b.size(); ++j) {
+            mismatches += a[j].startMs != b[j].startMs || a[j].endMs != b[j].endMs;
+        }
+    }
+
+    std::string root = dir + "/badges";
+#ifndef _WIN32
+    mkdir(root.c_str(), 0755);
+#endif
+    BadgeStoreStats stored;
+    t0 = BenchClock::now();
+    ok = storeBadgeSessions(root, serial, pool, stored) && ok;
+    double storeMs = elapsedMs(t0);
+
+    const BadgeIngestStats& s = serialStats;
+    std::printf("{\"bench\":\"badge_ingest\",\"ok\":%s,\"people\":%zu,\"bytes\":%llu,\"events\":%llu,"
+                "\"sessions\":%llu,\"duplicates\":%llu,\"missing_in\":%llu,\"missing_out\":%llu,\"late\":%llu,"
+                "\"serial_ms\":%.1f,\"serial_events_per_s\":%.0f,\"threads\":%u,\"parallel_ms\":%.1f,"
+                "\"parallel_events_per_s\":%.0f,\"mismatches\":%zu,\"peak_pending\":%zu,\"rss_growth_kb\":%ld,"
+                "\"store_ms\":%.1f,\"profiles_written\":%zu}\n",
+                ok ? "true" : "false", s.people, static_cast<unsigned long long>(s.bytes),
+                static_cast<unsigned long long>(s.events), static_cast<unsigned long long>(s.sessions),
+                static_cast<unsigned long long>(s.duplicates), static_cast<unsigned long long>(s.missingIn),
+                static_cast<unsigned long long>(s.missingOut), static_cast<unsigned long long>(s.late), serialMs,
+                s.events / (serialMs / 1e3), pool.concurrency(), parallelMs, s.events / (parallelMs / 1e3), mismatches,
+                s.peakPendingEvents, rssGrowth, storeMs, stored.profiles);
+    expect("badge_ingest", "ingest or store failed", ok);
+    expect("badge_ingest", "parallel ingest differs from serial", mismatches == 0);
+    std::fflush(stdout);
+
+    for (const auto& person : serial) {
+        removeStore(profileStorePath(root, person.id));
+        std::remove(profileDirectory(root, person.id).c_str());
+    }
+    std::remove(profilesDirectory(root).c_str());
+    std::remove(root.c_str());
+    std::remove(path.c_str());
+}
+
+#ifndef _WIN32
+// Writes request and reads until `lines` answers have arrived.
+bool queryRoundTrip(int fd, const std::string& request, size_t lines, std::string& answers) {
+    answers.clear();
+    if (write(fd, request.data(), request.size()) != static_cast<ssize_t>(request.size())) {
+        return false;
+    }
+    char buffer[64 * 1024];
+    size_t seen = 0;
+    while (seen < lines) {
+        ssize_t n = read(fd, buffer, sizeof(buffer));
+        if (n <= 0) {
+            return false;
+        }
+        seen += static_cast<size_t>(std::count(buffer, buffer + n, '\n'));
+        answers.append(buffer, static_cast<size_t>(n));
+    }
+    return true;
+}
+
+int connectQuerySocket(const std::string& path) {
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    std::snprintf(address.sun_path, sizeof(address.sun_path), "%s", path.c_str());
+    if (fd >= 0 && connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+        close(fd);
+        fd = -1;
+    }
+    return fd;
+}
+
+// A headless AppState over ten years, queried through the Unix socket:
+// pipelined batches of month totals and day sessions, single round trips,
+// answers checked against HistoryQuery, and how long the UI thread waits
+// for the history lock while a client floods the service.
+void runQueryService(const std::string& dir) {
+    const std::string root = dir + "/query";
+    mkdir(root.c_str(), 0755);
+    int64_t today = daysFromCivil(2024, 6, 15);
+    std::vector<WorkDay> sessions = generateHistory(10, today);
+    writeBinaryHistory(root + "/history.bin", Config(), sessions);
+    HistoryStore reference;
+    reference.assign(sessions);
+
+    AppState state;
+    state.currentViewMonth.tm_year = 2024 - 1900;
+    state.currentViewMonth.tm_mon = 5;
+    state.currentViewMonth.tm_mday = 1;
+    state.hotYears = 20;
+    state.loadData(root + "/history.bin", root + "/data.txt", false);
+    state.startBackgroundLoad(nullptr);
+    state.finishBackgroundLoad();
+
+    QueryService service(state);
+    QueryServer server(service);
+    const std::string socketPath = root + "/query.sock";
+    bool ok = server.start(socketPath);
+    int fd = ok ? connectQuerySocket(socketPath) : -1;
+    ok = fd >= 0;
+
+    // Every month of the history, totals then the first day's sessions.
+    std::string batch;
+    size_t mismatches = 0, batchLines = 0;
+    std::vector<std::string> expected;
+    for (int64_t month = groupStart(today - 3650, GroupBy::Month); month <= today;
+         month = groupStart(month + 32, GroupBy::Month)) {
+        int year;
+        unsigned m, d;
+        civilFromDays(month, year, m, d);
+        char request[160];
+        std::snprintf(request, sizeof(request),
+                      "{\"op\":\"totals\",\"month\":\"%04d-%02u\"}\n{\"op\":\"sessions\",\"date\":\"%04d-%02u-01\"}\n",
+                      year, m, year, m);
+        batch += request;
+        batchLines += 2;
+        Totals t = query(reference, inMonth(year, static_cast<int>(m))).totals();
+        char totals[96];
+        std::snprintf(totals, sizeof(totals), "\"durationMs\":%lld,\"gross\":%.2f,\"net\":%.2f,\"sessions\":%d,",
+                      t.durationMs, t.grossCents() / 100.0, t.netCents() / 100.0, t.sessions);
+        expected.push_back(totals);
+        expected.push_back(std::to_string(query(reference, onDay(month)).count()));
+    }
+    std::string answers;
+    ok = ok && queryRoundTrip(fd, batch, batchLines, answers);
+    size_t at = 0;
+    for (size_t i = 0; ok && i < expected.size(); ++i) {
+        size_t eol = answers.find('\n', at);
+        std::string line = answers.substr(at, eol - at);
+        at = eol + 1;
+        if (i % 2 == 0) {
+            mismatches += line.find(expected[i]) == std::string::npos;
+        } else {
+            size_t count = 0;
+            for (size_t p = line.find("\"start\""); p != std::string::npos; p = line.find("\"start\"", p + 1)) {
+                count++;
+            }
+            mismatches += std::to_string(count) != expected[i];
+        }
+    }
+
+    const int kBatches = 200;
+    auto t0 = BenchClock::now();
+    for (int i = 0; ok && i < kBatches; ++i) {
+        ok = queryRoundTrip(fd, batch, batchLines, answers);
+    }
+    double pipelinedMs = elapsedMs(t0);
+    const int kRoundTrips = 5000;
+    t0 = BenchClock::now();
+    for (int i = 0; ok && i < kRoundTrips; ++i) {
+        ok = queryRoundTrip(fd, "{\"op\":\"totals\",\"month\":\"2024-05\"}\n", 1, answers);
+    }
+    double roundTripMs = elapsedMs(t0);
+
+    // The UI thread's worst case: taking the history lock exclusively to
+    // record a punch, idle and then under a pipelining client.
+    auto lockWaits = [&](std::vector<double>& waits) {
+        waits.clear();
+        for (int i = 0; i < 2000; ++i) {
+            auto start = BenchClock::now();
+            { std::unique_lock<std::shared_mutex> guard(state.historyLock); }
+            waits.push_back(elapsedMs(start) * 1000.0);
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+        }
+        std::sort(waits.begin(), waits.end());
+    };
+    std::vector<double> idle, busy;
+    lockWaits(idle);
+    std::atomic<bool> flooding{true};
+    std::thread flood([&] {
+        int floodFd = connectQuerySocket(socketPath);
+        std::string floodAnswers;
+        while (floodFd >= 0 && flooding && queryRoundTrip(floodFd, batch, batchLines, floodAnswers)) {
+        }
+        if (floodFd >= 0) {
+            close(floodFd);
+        }
+    });
+    lockWaits(busy);
+    flooding = false;
+    flood.join();
+
+    if (fd >= 0) {
+        close(fd);
+    }
+    server.stop();
+    std::printf("{\"bench\":\"query_service\",\"ok\":%s,\"sessions\":%zu,\"mismatches\":%zu,\"batch_requests\":%zu,"
+                "\"pipelined_qps\":%.0f,\"round_trip_qps\":%.0f,\"round_trip_us\":%.1f,"
+                "\"ui_lock_wait_us_p50_idle\":%.2f,\"ui_lock_wait_us_p50_busy\":%.2f,\"ui_lock_wait_us_p99_busy\":%.2f,"
+                "\"ui_lock_wait_us_max_busy\":%.2f}\n",
+                ok ? "true" : "false", sessions.size(), mismatches, batchLines,
+                kBatches * batchLines / (pipelinedMs / 1e3), kRoundTrips / (roundTripMs / 1e3),
+                roundTripMs * 1e3 / kRoundTrips, idle[idle.size() / 2], busy[busy.size() / 2],
+                busy[busy.size() * 99 / 100], busy.back());
+    expect("query_service", "a request failed", ok);
+    expect("query_service", "answers differ from AppState", mismatches == 0);
+    std::fflush(stdout);
+    state.persistence.stop();
+    removeStore(root + "/history.bin");
+    std::remove(root.c_str());
+}
+
+// Two instances on one store: A takes in what the other appended, for
+// deltas of 1 to 1000 sessions spread over the whole history, against
+// loading the store afresh; then once more across a compaction, checking
+// A's totals against a fresh load.
+void runStoreSync(const std::string& dir, int years) {
+    const std::string root = dir + "/sync";
+    mkdir(root.c_str(), 0755);
+    const std::string path = root + "/history.bin";
+    int64_t today = daysFromCivil(2024, 6, 15);
+    std::vector<WorkDay> sessions = generateHistory(years, today);
+    writeBinaryHistory(path, Config(), sessions);
+    int64_t firstDay = today - years * 365;
+
+    auto loadState = [&](AppState& state) {
+        state.currentViewMonth.tm_year = 2024 - 1900;
+        state.currentViewMonth.tm_mon = 5;
+        state.currentViewMonth.tm_mday = 1;
+        state.loadData(path, root + "/data.txt", false);
+        state.startBackgroundLoad(nullptr);
+        state.finishBackgroundLoad();
+    };
+    AppState a;
+    loadState(a);
+    Journal other;
+    other.open(path, SnapshotFormat::Binary);
+    Config config;
+    std::vector<WorkDay> loaded;
+    other.load(config, loaded);
+
+    // 18:20-18:50 local, a free slot, a second later on each pass over the days.
+    int64_t added = 0;
+    auto nextSessions = [&](int count) {
+        std::vector<WorkDay> batch;
+        for (int i = 0; i < count; ++i, ++added) {
+            int64_t day = firstDay + added % (today - firstDay);
+            WorkDay wd;
+            wd.startMs = ((day * 1440) + 1100 - 60) * 60000 + added / (today - firstDay) * 1000;
+            wd.endMs = wd.startMs + 30 * 60000;
+            wd.rateId = sessions.front().rateId;
+            wd.startUtcOffsetMin = 60;
+            wd.endUtcOffsetMin = 60;
+            batch.push_back(wd);
+            sessions.push_back(wd);
+        }
+        return batch;
+    };
+
+    std::printf("{\"bench\":\"store_sync\",\"years\":%d,\"sessions\":%zu", years, sessions.size());
+    bool ok = true;
+    static const int kDeltas[] = { 1, 10, 100, 1000 };
+    for (int delta : kDeltas) {
+        other.append(nextSessions(delta));
+        bool changed = false;
+        auto t0 = BenchClock::now();
+        ok = a.syncExternalChanges(changed) && changed && ok;
+        std::printf(",\"sync_%d_ms\":%.3f", delta, elapsedMs(t0));
+    }
+    double reloadMs;
+    {
+        auto t0 = BenchClock::now();
+        AppState fresh;
+        loadState(fresh);
+        reloadMs = elapsedMs(t0);
+        fresh.persistence.stop();
+    }
+
+    // The other instance compacts between two appends.
+    other.append(nextSessions(10));
+    std::sort(sessions.begin(), sessions.end(),
+              [](const WorkDay& x, const WorkDay& y) { return x.startMs < y.startMs; });
+    other.compact(config, sessions);
+    other.append(nextSessions(10));
+    bool changed = false;
+    auto t0 = BenchClock::now();
+    ok = a.syncExternalChanges(changed) && changed && ok;
+    double compactedMs = elapsedMs(t0);
+
+    size_t mismatches = 0;
+    {
+        AppState fresh;
+        loadState(fresh);
+        for (int64_t day = firstDay; day < today; day += 30) {
+            bool complete = false;
+            Totals mine = a.queryTotals(day, day + 30, complete);
+            Totals theirs = fresh.queryTotals(day, day + 30, complete);
+            mismatches += mine.durationMs != theirs.durationMs || mine.sessions != theirs.sessions ||
+                          mine.daysWorked != theirs.daysWorked || mine.grossCents() != theirs.grossCents() ||
+                          mine.netCents() != theirs.netCents();
+        }
+        fresh.persistence.stop();
+    }
+    std::printf(",\"full_reload_ms\":%.3f,\"sync_after_compaction_ms\":%.3f,\"ok\":%s,\"mismatches\":%zu}\n",
+                reloadMs, compactedMs, ok ? "true" : "false", mismatches);
+    expect("store_sync", "sync failed", ok);
+    expect("store_sync", "totals differ from a fresh load", mismatches == 0);
+    std::fflush(stdout);
+    a.persistence.stop();
+
+    // An append that fails part way, here at the file size limit, leaves the
+    // journal as it was, so the next one starts on a line of its own.
+    long journalBytes = fileBytes(path + ".journal");
+    rlimit saved, limit;
+    getrlimit(RLIMIT_FSIZE, &saved);
+    limit = saved;
+    limit.rlim_cur = static_cast<rlim_t>(journalBytes + 100);
+    std::signal(SIGXFSZ, SIG_IGN);
+    setrlimit(RLIMIT_FSIZE, &limit);
+    bool appended = other.append(nextSessions(10));
+    setrlimit(RLIMIT_FSIZE, &saved);
+    bool rolledBack = !appended && fileBytes(path + ".journal") == journalBytes;
+    other.append(nextSessions(1));
+    Journal check;
+    check.open(path, SnapshotFormat::Binary, StoreAccess::ReadOnly);
+    check.load(config, loaded);
+    expect("store_sync", "a failed append left a partial record behind",
+           rolledBack && check.loadErrors().empty());
+    removeStore(path);
+    std::remove(root.c_str());
+}
+#endif
+
+} // namespace
+
+int main(int argc, char** argv) {
+    std::string dir = ".";
+    bool quick = false;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--quick") == 0) {
+            quick = true;
+        } else if (std::strcmp(argv[i], "--dir") == 0 && i + 1 < argc) {
+            dir = argv[++i];
+        } else {
+            std::fprintf(stderr, "usage: %s [--quick] [--dir <path>]\n", argv[0]);
+            return 2;
+        }
+    }
+#ifndef _WIN32
+    mkdir(dir.c_str(), 0755);
+#endif
+
+    runFormatting(quick);
+    runTicks();
+    runTrace();
+    runDisplayList();
+    runTextCache();
+    runCheckpoint(dir);
+    runMoney(quick);
+    runQuery();
+    runChecksums(dir);
+    // Ascending sizes, so peak_rss_kb is attributable to the latest workload.
+    // The first (the quick run's) spans more than the hot years, so it seals.
+    static const int kYears[] = { AppState::kDefaultHotYears + 1, 10, 30 };
+    for (int years : kYears) {
+        runWorkload(years, dir);
+        if (quick) {
+            break;
+        }
+    }
+    runTeam(dir, quick ? 20 : 200, 5);
+    runWebImport(dir, quick ? 1 : 30);
+    runBadgeIngest(dir, quick ? 100 : 1500);
+#ifndef _WIN32
+    runQueryService(dir);
+    runStoreSync(dir, 1);
+    if (!quick) {
+        runStoreSync(dir, 30);
+    }
+#endif
+    return g_failedChecks == 0 ? 0 : 1;
+}
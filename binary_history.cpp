@@ -0,0 +1,186 @@
+#include "binary_history.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <mutex>
+
+#include "crc32c.h"
+#include "journal.h"
+
+static const char kMagic[8] = { 'T', 'T', 'P', 'H', 'I', 'S', 'T', '\0' };
+
+// Which blocks of a file version have passed; set once, never cleared.
+struct BinaryHistoryView::CheckedBlocks {
+    explicit CheckedBlocks(size_t blocks) : intact(blocks) {}
+    std::vector<std::atomic<bool>> intact;
+};
+
+// Replaced snapshots leave their entries behind; past this many the map
+// starts over, and views still open keep theirs.
+static const size_t kMaxCheckedFiles = 64;
+
+bool BinaryHistoryView::open(const std::string& path) {
+    close();
+    if (!file.open(path) || file.size() < sizeof(BinaryHistoryHeader)) {
+        file.close();
+        return false;
+    }
+    const BinaryHistoryHeader* h = reinterpret_cast<const BinaryHistoryHeader*>(file.data());
+    size_t fits = (file.size() - sizeof(BinaryHistoryHeader)) / sizeof(BinaryWorkDay);
+    checked = h->version >= 2;
+    intactHeader = !checked || crc32c(h, offsetof(BinaryHistoryHeader, crc)) == h->crc;
+    if (std::memcmp(h->magic, kMagic, sizeof(kMagic)) != 0 || h->version < 1 || h->version > kBinaryHistoryVersion ||
+        (intactHeader && (h->recordSize != sizeof(BinaryWorkDay) || h->recordCount > fits))) {
+        file.close();
+        return false;
+    }
+    header = h;
+    records = intactHeader ? static_cast<size_t>(h->recordCount) : fits;
+    recordsBase = reinterpret_cast<const BinaryWorkDay*>(file.data() + sizeof(BinaryHistoryHeader));
+    if (checked) {
+        static std::mutex checkedFilesMutex;
+        static std::map<MappedFile::Identity, std::shared_ptr<CheckedBlocks>> checkedFiles;
+        std::lock_guard<std::mutex> guard(checkedFilesMutex);
+        auto it = checkedFiles.find(file.identity());
+        if (it == checkedFiles.end()) {
+            if (checkedFiles.size() >= kMaxCheckedFiles) {
+                checkedFiles.clear();
+            }
+            size_t blocks = (records + kCheckedBlockRecords - 1) / kCheckedBlockRecords;
+            it = checkedFiles.emplace(file.identity(), std::make_shared<CheckedBlocks>(blocks)).first;
+        }
+        checkedBlocks = it->second;
+    }
+    return true;
+}
+
+bool BinaryHistoryView::recordIntact(const BinaryWorkDay& record) const {
+    return !checked || crc32c(&record, offsetof(BinaryWorkDay, crc)) == record.crc;
+}
+
+void BinaryHistoryView::findCorrupt(size_t first, size_t last, std::vector<size_t>& out) const {
+    if (!checked || last <= first) {
+        return;
+    }
+    std::vector<size_t> failed;
+    for (size_t block = first / kCheckedBlockRecords; block * kCheckedBlockRecords < last; ++block) {
+        if (checkedBlocks->intact[block]) {
+            continue;
+        }
+        size_t from = block * kCheckedBlockRecords;
+        size_t count = std::min(kCheckedBlockRecords, records - from);
+        failed.clear();
+        crc32cCheckRecords(recordsBase + from, sizeof(BinaryWorkDay), offsetof(BinaryWorkDay, crc), count, failed);
+        if (failed.empty()) {
+            checkedBlocks->intact[block] = true;
+        }
+        for (size_t i : failed) {
+            if (from + i >= first && from + i < last) {
+                out.push_back(from + i);
+            }
+        }
+    }
+}
+
+Config BinaryHistoryView::config() const {
+    Config config;
+    if (header && intactHeader) {
+        config.hourlyGross = header->hourlyGross;
+        config.hourlyNet = header->hourlyNet;
+    }
+    return config;
+}
+
+BinaryWorkDay toBinaryWorkDay(const WorkDay& day) {
+    BinaryWorkDay r = {};
+    r.startMs = day.startMs;
+    r.endMs = day.endMs;
+    r.durationMs = day.durationMs();
+    r.grossEarning = day.grossEarning();
+    r.netEarning = day.netEarning();
+    r.hourlyGross = day.hourlyGross();
+    r.hourlyNet = day.hourlyNet();
+    r.startUtcOffsetMin = day.startUtcOffsetMin;
+    r.endUtcOffsetMin = day.endUtcOffsetMin;
+    r.crc = crc32c(&r, offsetof(BinaryWorkDay, crc));
+    return r;
+}
+
+WorkDay fromBinaryWorkDay(const BinaryWorkDay& r) {
+    WorkDay day;
+    day.startMs = r.startMs;
+    day.endMs = r.startMs + r.durationMs;
+    day.startUtcOffsetMin = r.startUtcOffsetMin;
+    day.endUtcOffsetMin = r.endUtcOffsetMin;
+    day.rateId = rateTable().intern(r.hourlyGross, r.hourlyNet);
+    return day;
+}
+
+bool writeBinaryHistory(const std::string& path, const Config& config, const std::vector<WorkDay>& history) {
+    FILE* file = std::fopen(path.c_str(), "wb");
+    if (!file) {
+        return false;
+    }
+    BinaryHistoryHeader header = {};
+    std::memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = kBinaryHistoryVersion;
+    header.recordSize = sizeof(BinaryWorkDay);
+    header.recordCount = history.size();
+    header.hourlyGross = config.hourlyGross;
+    header.hourlyNet = config.hourlyNet;
+    header.crc = crc32c(&header, offsetof(BinaryHistoryHeader, crc));
+
+    // Written with one call: written a record at a time, the file takes
+    // measurably longer to map and read afterwards.
+    std::vector<char> bytes(sizeof(header) + history.size() * sizeof(BinaryWorkDay));
+    std::memcpy(bytes.data(), &header, sizeof(header));
+    for (size_t i = 0; i < history.size(); ++i) {
+        BinaryWorkDay record = toBinaryWorkDay(history[i]);
+        std::memcpy(bytes.data() + sizeof(header) + i * sizeof(record), &record, sizeof(record));
+    }
+    bool ok = std::fwrite(bytes.data(), 1, bytes.size(), file) == bytes.size();
+    ok = ok && syncFile(file);
+    ok = (std::fclose(file) == 0) && ok;
+    return ok;
+}
+
+bool migrateTextStore(const std::string& textPath, const std::string& binaryPath) {
+    Config config;
+    std::vector<WorkDay> history;
+    {
+        Journal text;
+        text.open(textPath, SnapshotFormat::Text);
+        if (!text.load(config, history)) {
+            return false;
+        }
+    }
+
+    std::string tmpPath = binaryPath + ".tmp";
+    if (!writeBinaryHistory(tmpPath, config, history) || !atomicReplace(tmpPath, binaryPath)) {
+        std::remove(tmpPath.c_str());
+        return false;
+    }
+    std::remove((textPath + ".migrated").c_str());
+    std::rename(textPath.c_str(), (textPath + ".migrated").c_str());
+    std::remove((textPath + ".journal").c_str());
+    return true;
+}
+
+bool exportBinaryHistoryAsText(const std::string& binaryPath, const std::string& textPath) {
+    BinaryHistoryView view;
+    if (!view.open(binaryPath)) {
+        return false;
+    }
+    std::vector<WorkDay> history;
+    history.reserve(view.size());
+    for (const auto& record : view) {
+        if (view.recordIntact(record)) {
+            history.push_back(fromBinaryWorkDay(record));
+        }
+    }
+    return writeTextHistory(textPath, view.config(), history);
+}
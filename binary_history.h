@@ -0,0 +1,107 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "mapped_file.h"
+#include "workday.h"
+
+// --- Binary History Format ---
+//
+// history.bin is a 64-byte header followed by recordCount fixed-width 64-byte
+// records in chronological order. Everything is little-endian and naturally
+// aligned so the file can be memory-mapped and read in place. Earnings are
+// stored for external readers only; loading uses the timestamps, offsets and
+// rates.
+//
+// Version 2 ends the header and each record with a CRC32C of the bytes
+// before it. A record that fails is skipped on its own; if the header fails,
+// the settings are not trusted and the record count comes from the file
+// size. Version 1 files (no checksums) still load, unchecked.
+//
+// Every window, query and compaction reads history.bin again, so record
+// checksums are verified a block at a time and a block that passed is not
+// checked again while the file keeps its identity (MappedFile::Identity).
+// Views of the same file share what has been verified.
+
+const uint32_t kBinaryHistoryVersion = 2;
+
+struct BinaryHistoryHeader {
+    char magic[8];          // "TTPHIST\0"
+    uint32_t version;
+    uint32_t recordSize;
+    uint64_t recordCount;
+    double hourlyGross;     // Config
+    double hourlyNet;
+    uint32_t crc;           // version 2: CRC32C of the fields above
+    uint8_t reserved[20];
+};
+
+struct BinaryWorkDay {
+    int64_t startMs;        // UTC, milliseconds since epoch
+    int64_t endMs;
+    int64_t durationMs;
+    double grossEarning;
+    double netEarning;
+    double hourlyGross;
+    double hourlyNet;
+    int16_t startUtcOffsetMin;
+    int16_t endUtcOffsetMin;
+    uint32_t crc;           // version 2: CRC32C of the fields above
+};
+
+static_assert(sizeof(BinaryHistoryHeader) == 64, "header must stay 64 bytes");
+static_assert(sizeof(BinaryWorkDay) == 64, "record must stay 64 bytes");
+
+// A mapped history.bin. Records are read in place.
+class BinaryHistoryView {
+public:
+    // Records per verified block: 16 KB.
+    static const size_t kCheckedBlockRecords = 256;
+
+    bool open(const std::string& path);
+    void close() { file.close(); header = nullptr; recordsBase = nullptr; records = 0; }
+
+    // Checksum results; always true for version 1 files.
+    bool headerIntact() const { return intactHeader; }
+    // Version 2 or later: records carry checksums.
+    bool checksummed() const { return checked; }
+    bool recordIntact(const BinaryWorkDay& record) const;
+    // Appends the indices in [first, last) of records that fail, ascending.
+    // Checks the blocks the range touches that have not passed yet, whole.
+    void findCorrupt(size_t first, size_t last, std::vector<size_t>& out) const;
+    const char* headerBytes() const { return reinterpret_cast<const char*>(header); }
+
+    size_t size() const { return records; }
+    const BinaryWorkDay& operator[](size_t i) const { return recordsBase[i]; }
+    const BinaryWorkDay* begin() const { return recordsBase; }
+    const BinaryWorkDay* end() const { return recordsBase + size(); }
+    // Defaults when the header failed its checksum.
+    Config config() const;
+
+private:
+    struct CheckedBlocks;
+
+    MappedFile file;
+    const BinaryHistoryHeader* header = nullptr;
+    const BinaryWorkDay* recordsBase = nullptr;
+    size_t records = 0;
+    bool checked = false;
+    bool intactHeader = true;
+    std::shared_ptr<CheckedBlocks> checkedBlocks;
+};
+
+BinaryWorkDay toBinaryWorkDay(const WorkDay& day);
+WorkDay fromBinaryWorkDay(const BinaryWorkDay& record);
+
+// Writes a complete file from a chronological history.
+bool writeBinaryHistory(const std::string& path, const Config& config, const std::vector<WorkDay>& history);
+
+// One-shot migration of the pipe-delimited store (data.txt + its journal)
+// into history.bin. The text files are kept as data.txt.migrated.
+bool migrateTextStore(const std::string& textPath, const std::string& binaryPath);
+
+// Debug export of history.bin back to the pipe-delimited text format.
+bool exportBinaryHistoryAsText(const std::string& binaryPath, const std::string& textPath);
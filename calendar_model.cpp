@@ -0,0 +1,47 @@
+#include "calendar_model.h"
+
+#include "civil_time.h"
+#include "history_query.h"
+
+int daysInMonth(int year, int month) {
+    if (month == 4 || month == 6 || month == 9 || month == 11) {
+        return 30;
+    }
+    if (month == 2) {
+        bool is_leap = (year % 4 == 0 && (year % 100 != 0 || year % 400 == 0));
+        return is_leap ? 29 : 28;
+    }
+    return 31;
+}
+
+void buildCalendarMonth(const HistoryStore& history, int year, int month, int64_t todayKey,
+                        std::vector<CalendarDayModel>& days) {
+    days.clear();
+
+    int64_t first_day_key = daysFromCivil(year, static_cast<unsigned>(month), 1);
+    int weekday_start = weekdayFromDays(first_day_key);
+    int days_in_month = daysInMonth(year, month);
+
+    long long worked_ms[31] = {};
+    for (const GroupTotals& worked : query(history, inDays(first_day_key, first_day_key + days_in_month))
+                                         .groupBy(GroupBy::Day)) {
+        worked_ms[worked.key - first_day_key] = worked.totals.durationMs;
+    }
+
+    for (int current_day = 1; current_day <= days_in_month; ++current_day) {
+        CalendarDayModel day;
+        int cell = weekday_start + current_day - 1;
+        day.row = cell / 7;
+        day.col = cell % 7;
+        day.dayNumber = current_day;
+        day.dayKey = first_day_key + current_day - 1;
+        day.type = (day.dayKey == todayKey) ? DayType::Today : DayType::Normal;
+
+        day.sessions = history.day(day.dayKey);
+        day.totalMs = worked_ms[current_day - 1];
+        if (!day.sessions.empty()) {
+            day.type = (day.totalMs >= kFullDayMs) ? DayType::FullDay : DayType::PartialDay;
+        }
+        days.push_back(day);
+    }
+}
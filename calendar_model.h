@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "history_store.h"
+
+// --- Calendar Month Model ---
+//
+// The month grid behind the calendar view, independent of any layout: which
+// cell each day lands in, its colour class and the sessions that started
+// on it.
+
+enum DayType { Normal, Today, OtherMonth, FullDay, PartialDay };
+
+// A day with at least this much work is shown as a full day.
+const long long kFullDayMs = 7LL * 3600 * 1000;
+
+struct CalendarDayModel {
+    int row = 0;                    // 0-5, weeks start on Monday
+    int col = 0;                    // 0-6
+    int dayNumber = 0;
+    int64_t dayKey = 0;
+    DayType type = DayType::Normal;
+    HistoryStore::Range sessions;   // every session that started that day
+    long long totalMs = 0;
+};
+
+int daysInMonth(int year, int month);
+
+// Fills `days` with one entry per day of the month, in order.
+void buildCalendarMonth(const HistoryStore& history, int year, int month, int64_t todayKey,
+                        std::vector<CalendarDayModel>& days);
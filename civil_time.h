@@ -0,0 +1,90 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+
+// --- Civil Date Arithmetic ---
+//
+// Proleptic Gregorian conversions between (year, month, day) and days since
+// 1970-01-01, without going through mktime/localtime. Based on Howard
+// Hinnant's public-domain algorithms.
+
+inline int64_t daysFromCivil(int y, unsigned m, unsigned d) {
+    y -= m <= 2;
+    const int64_t era = (y >= 0 ? y : y - 399) / 400;
+    const unsigned yoe = static_cast<unsigned>(y - era * 400);
+    const unsigned doy = (153 * (m > 2 ? m - 3 : m + 9) + 2) / 5 + d - 1;
+    const unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + static_cast<int64_t>(doe) - 719468;
+}
+
+inline void civilFromDays(int64_t z, int& y, unsigned& m, unsigned& d) {
+    z += 719468;
+    const int64_t era = (z >= 0 ? z : z - 146096) / 146097;
+    const unsigned doe = static_cast<unsigned>(z - era * 146097);
+    const unsigned yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    const unsigned doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    const unsigned mp = (5 * doy + 2) / 153;
+    d = doy - (153 * mp + 2) / 5 + 1;
+    m = mp < 10 ? mp + 3 : mp - 9;
+    y = static_cast<int>(yoe) + static_cast<int>(era * 400) + (m <= 2);
+}
+
+// Floor division for negative epoch values.
+inline int64_t floorDiv(int64_t a, int64_t b) {
+    int64_t q = a / b;
+    return (a % b != 0 && ((a < 0) != (b < 0))) ? q - 1 : q;
+}
+
+// 0 = Monday ... 6 = Sunday, matching the calendar grid.
+inline int weekdayFromDays(int64_t days) {
+    int r = static_cast<int>((days + 3) % 7);
+    return r < 0 ? r + 7 : r;
+}
+
+// Parses fixed-width digits; returns false on any non-digit.
+inline bool parseDigits(const char* p, int count, int& out) {
+    int v = 0;
+    for (int i = 0; i < count; ++i) {
+        if (p[i] < '0' || p[i] > '9') {
+            return false;
+        }
+        v = v * 10 + (p[i] - '0');
+    }
+    out = v;
+    return true;
+}
+
+// "YYYY-MM-DD" -> days since epoch.
+inline bool parseDateKey(std::string_view s, int64_t& days) {
+    int y, m, d;
+    if (s.size() < 10 || s[4] != '-' || s[7] != '-' ||
+        !parseDigits(s.data(), 4, y) || !parseDigits(s.data() + 5, 2, m) || !parseDigits(s.data() + 8, 2, d) ||
+        m < 1 || m > 12 || d < 1 || d > 31) {
+        return false;
+    }
+    days = daysFromCivil(y, static_cast<unsigned>(m), static_cast<unsigned>(d));
+    return true;
+}
+
+// "HH:MM" -> minutes since midnight.
+inline bool parseClockMinutes(std::string_view s, int& minutes) {
+    int h, m;
+    if (s.size() < 5 || s[2] != ':' || !parseDigits(s.data(), 2, h) || !parseDigits(s.data() + 3, 2, m)) {
+        return false;
+    }
+    minutes = h * 60 + m;
+    return true;
+}
+
+// "YYYY-MM-DDTHH:MM:SSZ" (UTC) -> seconds since epoch.
+inline bool parseISOSeconds(std::string_view s, int64_t& seconds) {
+    int64_t days;
+    int h, mi, se;
+    if (s.size() < 19 || s[10] != 'T' || s[13] != ':' || s[16] != ':' || !parseDateKey(s, days) ||
+        !parseDigits(s.data() + 11, 2, h) || !parseDigits(s.data() + 14, 2, mi) || !parseDigits(s.data() + 17, 2, se)) {
+        return false;
+    }
+    seconds = days * 86400 + h * 3600 + mi * 60 + se;
+    return true;
+}
@@ -0,0 +1,223 @@
+#include "crc32c.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define TT_X86 1
+#include <immintrin.h>
+#endif
+
+namespace {
+
+const uint32_t kPolynomial = 0x82f63b78;  // reflected Castagnoli
+
+// table[k][b]: the CRC of byte b followed by k zero bytes.
+struct SlicingTables {
+    uint32_t table[8][256];
+
+    SlicingTables() {
+        for (uint32_t b = 0; b < 256; ++b) {
+            uint32_t crc = b;
+            for (int bit = 0; bit < 8; ++bit) {
+                crc = (crc >> 1) ^ (kPolynomial & (0u - (crc & 1)));
+            }
+            table[0][b] = crc;
+        }
+        for (uint32_t b = 0; b < 256; ++b) {
+            for (int k = 1; k < 8; ++k) {
+                table[k][b] = (table[k - 1][b] >> 8) ^ table[0][table[k - 1][b] & 0xff];
+            }
+        }
+    }
+};
+
+const SlicingTables& tables() {
+    static const SlicingTables t;
+    return t;
+}
+
+uint32_t softwareUpdate(const unsigned char* p, size_t size, uint32_t crc) {
+    const auto& t = tables().table;
+    for (; size >= 8; p += 8, size -= 8) {
+        uint32_t lo, hi;
+        std::memcpy(&lo, p, 4);
+        std::memcpy(&hi, p + 4, 4);
+        lo ^= crc;
+        crc = t[7][lo & 0xff] ^ t[6][(lo >> 8) & 0xff] ^ t[5][(lo >> 16) & 0xff] ^ t[4][lo >> 24] ^
+              t[3][hi & 0xff] ^ t[2][(hi >> 8) & 0xff] ^ t[1][(hi >> 16) & 0xff] ^ t[0][hi >> 24];
+    }
+    for (; size > 0; ++p, --size) {
+        crc = (crc >> 8) ^ t[0][(crc ^ *p) & 0xff];
+    }
+    return crc;
+}
+
+#ifdef TT_X86
+
+__attribute__((target("sse4.2"))) uint32_t hardwareUpdate(const unsigned char* p, size_t size, uint32_t crc) {
+    uint64_t crc64 = crc;
+    for (; size >= 8; p += 8, size -= 8) {
+        uint64_t v;
+        std::memcpy(&v, p, 8);
+        crc64 = _mm_crc32_u64(crc64, v);
+    }
+    crc = static_cast<uint32_t>(crc64);
+    if (size >= 4) {
+        uint32_t v;
+        std::memcpy(&v, p, 4);
+        crc = _mm_crc32_u32(crc, v);
+        p += 4;
+        size -= 4;
+    }
+    for (; size > 0; ++p, --size) {
+        crc = _mm_crc32_u8(crc, *p);
+    }
+    return crc;
+}
+
+inline uint32_t storedCrc(const unsigned char* record, size_t crcOffset) {
+    uint32_t stored;
+    std::memcpy(&stored, record + crcOffset, 4);
+    return stored;
+}
+
+__attribute__((target("sse4.2"))) inline uint64_t crcWord(uint64_t crc, const unsigned char* p) {
+    uint64_t v;
+    std::memcpy(&v, p, 8);
+    return _mm_crc32_u64(crc, v);
+}
+
+__attribute__((target("sse4.2"))) inline uint32_t finishRecord(uint64_t crc, const unsigned char* record,
+                                                               size_t at, size_t crcOffset) {
+    uint32_t c = static_cast<uint32_t>(crc);
+    if (at < crcOffset) {
+        uint32_t v;
+        std::memcpy(&v, record + at, 4);
+        c = _mm_crc32_u32(c, v);
+    }
+    return ~c;
+}
+
+// Four records per step: the crc32 instruction has a latency of three
+// cycles but issues every cycle, so independent chains fill the gaps.
+__attribute__((target("sse4.2"))) void hardwareCheck(const unsigned char* p, size_t stride, size_t crcOffset,
+                                                     size_t count, std::vector<size_t>& failed) {
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        const unsigned char* r0 = p + i * stride;
+        const unsigned char* r1 = r0 + stride;
+        const unsigned char* r2 = r1 + stride;
+        const unsigned char* r3 = r2 + stride;
+        uint64_t c0 = 0xffffffffu, c1 = c0, c2 = c0, c3 = c0;
+        size_t at = 0;
+        for (; at + 8 <= crcOffset; at += 8) {
+            c0 = crcWord(c0, r0 + at);
+            c1 = crcWord(c1, r1 + at);
+            c2 = crcWord(c2, r2 + at);
+            c3 = crcWord(c3, r3 + at);
+        }
+        if (finishRecord(c0, r0, at, crcOffset) != storedCrc(r0, crcOffset)) failed.push_back(i);
+        if (finishRecord(c1, r1, at, crcOffset) != storedCrc(r1, crcOffset)) failed.push_back(i + 1);
+        if (finishRecord(c2, r2, at, crcOffset) != storedCrc(r2, crcOffset)) failed.push_back(i + 2);
+        if (finishRecord(c3, r3, at, crcOffset) != storedCrc(r3, crcOffset)) failed.push_back(i + 3);
+    }
+    for (; i < count; ++i) {
+        const unsigned char* record = p + i * stride;
+        if (~hardwareUpdate(record, crcOffset, 0xffffffffu) != storedCrc(record, crcOffset)) {
+            failed.push_back(i);
+        }
+    }
+}
+
+__attribute__((target("sse4.2"))) void hardwareMany(const unsigned char* const* p, const size_t* sizes, size_t count,
+                                                    uint32_t* out) {
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        size_t common = std::min(std::min(sizes[i], sizes[i + 1]), std::min(sizes[i + 2], sizes[i + 3])) & ~size_t(7);
+        uint64_t c0 = 0xffffffffu, c1 = c0, c2 = c0, c3 = c0;
+        for (size_t at = 0; at < common; at += 8) {
+            c0 = crcWord(c0, p[i] + at);
+            c1 = crcWord(c1, p[i + 1] + at);
+            c2 = crcWord(c2, p[i + 2] + at);
+            c3 = crcWord(c3, p[i + 3] + at);
+        }
+        out[i] = ~hardwareUpdate(p[i] + common, sizes[i] - common, static_cast<uint32_t>(c0));
+        out[i + 1] = ~hardwareUpdate(p[i + 1] + common, sizes[i + 1] - common, static_cast<uint32_t>(c1));
+        out[i + 2] = ~hardwareUpdate(p[i + 2] + common, sizes[i + 2] - common, static_cast<uint32_t>(c2));
+        out[i + 3] = ~hardwareUpdate(p[i + 3] + common, sizes[i + 3] - common, static_cast<uint32_t>(c3));
+    }
+    for (; i < count; ++i) {
+        out[i] = ~hardwareUpdate(p[i], sizes[i], 0xffffffffu);
+    }
+}
+
+#endif
+
+} // namespace
+
+bool crc32cHardware() {
+#ifdef TT_X86
+    static const bool supported = __builtin_cpu_supports("sse4.2");
+    return supported;
+#else
+    return false;
+#endif
+}
+
+uint32_t crc32c(const void* data, size_t size, uint32_t crc) {
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+#ifdef TT_X86
+    if (crc32cHardware()) {
+        return ~hardwareUpdate(p, size, ~crc);
+    }
+#endif
+    return ~softwareUpdate(p, size, ~crc);
+}
+
+void crc32cCheckRecords(const void* records, size_t stride, size_t crcOffset, size_t count,
+                        std::vector<size_t>& failed) {
+    const unsigned char* p = static_cast<const unsigned char*>(records);
+#ifdef TT_X86
+    if (crc32cHardware()) {
+        hardwareCheck(p, stride, crcOffset, count, failed);
+        return;
+    }
+#endif
+    for (size_t i = 0; i < count; ++i) {
+        const unsigned char* record = p + i * stride;
+        uint32_t stored;
+        std::memcpy(&stored, record + crcOffset, 4);
+        if (~softwareUpdate(record, crcOffset, 0xffffffffu) != stored) {
+            failed.push_back(i);
+        }
+    }
+}
+
+void crc32cMany(const char* const* data, const size_t* sizes, size_t count, uint32_t* out) {
+    const unsigned char* const* p = reinterpret_cast<const unsigned char* const*>(data);
+#ifdef TT_X86
+    if (crc32cHardware()) {
+        hardwareMany(p, sizes, count, out);
+        return;
+    }
+#endif
+    for (size_t i = 0; i < count; ++i) {
+        out[i] = ~softwareUpdate(p[i], sizes[i], 0xffffffffu);
+    }
+}
+
+uint32_t crc32cSoftware(const void* data, size_t size, uint32_t crc) {
+    return ~softwareUpdate(static_cast<const unsigned char*>(data), size, ~crc);
+}
+
+std::string hexBytes(const void* data, size_t size) {
+    static const char kDigits[] = "0123456789abcdef";
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    std::string out(size * 2, '0');
+    for (size_t i = 0; i < size; ++i) {
+        out[2 * i] = kDigits[p[i] >> 4];
+        out[2 * i + 1] = kDigits[p[i] & 0xf];
+    }
+    return out;
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// --- CRC32C Record Checksums ---
+//
+// CRC-32C (Castagnoli, as in iSCSI and ext4) over stored records. On x86-64
+// CPUs with SSE4.2 it runs on the crc32 instruction, eight bytes at a time;
+// elsewhere on a slicing-by-8 table. Both give the same value. Pass a
+// previous result as crc to extend it over more bytes.
+
+uint32_t crc32c(const void* data, size_t size, uint32_t crc = 0);
+// Checks count fixed-size records laid end to end, each holding at
+// crcOffset (a multiple of 4) the CRC32C of the bytes before it. Appends
+// the indices that fail. Works on several records at once, which is
+// several times faster than one crc32c() call per record.
+void crc32cCheckRecords(const void* records, size_t stride, size_t crcOffset, size_t count,
+                        std::vector<size_t>& failed);
+// The CRC32C of each of count buffers, four at a time in the same way.
+void crc32cMany(const char* const* data, const size_t* sizes, size_t count, uint32_t* out);
+// The table version, whatever the CPU supports.
+uint32_t crc32cSoftware(const void* data, size_t size, uint32_t crc = 0);
+bool crc32cHardware();
+
+// Lowercase hex of raw bytes, for logging records that failed their check.
+std::string hexBytes(const void* data, size_t size);
@@ -0,0 +1,186 @@
+#include "display_list.h"
+
+#include <algorithm>
+#include <string>
+
+DisplayRect unionRect(const DisplayRect& a, const DisplayRect& b) {
+    if (a.empty()) return b;
+    if (b.empty()) return a;
+    return { std::min(a.left, b.left), std::min(a.top, b.top), std::max(a.right, b.right), std::max(a.bottom, b.bottom) };
+}
+
+bool DisplayItem::sameAppearance(const DisplayItem& o) const {
+    return kind == o.kind && rect == o.rect && argb == o.argb && argb2 == o.argb2 && radius == o.radius &&
+           font == o.font && align == o.align && text == o.text;
+}
+
+static uint32_t argb(uint8_t a, uint8_t r, uint8_t g, uint8_t b) {
+    return (static_cast<uint32_t>(a) << 24) | (static_cast<uint32_t>(r) << 16) | (static_cast<uint32_t>(g) << 8) | b;
+}
+
+static void addText(DisplayList& list, uint32_t id, const DisplayRect& rect, const std::wstring& text,
+                    FontRole font, TextAlign align, uint32_t colour) {
+    DisplayItem item;
+    item.id = id;
+    item.kind = DisplayItemKind::Text;
+    item.rect = rect;
+    item.text = text;
+    item.font = font;
+    item.align = align;
+    item.argb = colour;
+    list.push_back(std::move(item));
+}
+
+static void addShape(DisplayList& list, uint32_t id, DisplayItemKind kind, const DisplayRect& rect, uint32_t colour, float radius = 0.0f) {
+    DisplayItem item;
+    item.id = id;
+    item.kind = kind;
+    item.rect = rect;
+    item.argb = colour;
+    item.radius = radius;
+    list.push_back(std::move(item));
+}
+
+DisplayList buildDisplayList(const DisplayState& s) {
+    const uint32_t white = argb(255, 240, 240, 240);
+    const uint32_t gray = argb(255, 204, 204, 204);
+
+    DisplayList list;
+    list.reserve(16 + s.calendar.size() * 2);
+
+    DisplayItem background;
+    background.id = kItemBackground;
+    background.kind = DisplayItemKind::Background;
+    background.rect = s.client;
+    background.argb = argb(255, 43, 46, 74);
+    background.argb2 = argb(255, 28, 29, 44);
+    list.push_back(background);
+
+    addText(list, kItemHeader, s.header, s.headerText, FontRole::Header, TextAlign::Center, white);
+
+    addShape(list, kItemPunchButton, DisplayItemKind::RoundedRect, s.punchButton,
+             s.isWorking ? argb(255, 244, 67, 54) : argb(255, 76, 175, 80), 10.0f);
+    addText(list, kItemPunchButtonText, s.punchButton, s.isWorking ? L"🔴 Pointer Sortie" : L"🟢 Pointer Entrée",
+            FontRole::Button, TextAlign::Center, white);
+
+    addText(list, kItemWorkedTimeLabel, s.workedTimeLabel, s.workedTimeLabelText, FontRole::Stats, TextAlign::Near, gray);
+    addText(list, kItemWorkedTimeValue, s.workedTimeValue, s.workedTimeText, FontRole::Stats, TextAlign::Far, white);
+    addText(list, kItemMonthStats, s.monthStats, s.monthStatsText, FontRole::Calendar, TextAlign::Near, gray);
+
+    addText(list, kItemMonthNavPrev, s.monthNavPrev, s.monthNavPrevText, FontRole::Button, TextAlign::Center, white);
+    addText(list, kItemMonthNavNext, s.monthNavNext, s.monthNavNextText, FontRole::Button, TextAlign::Center, white);
+    addText(list, kItemMonthTitle, s.monthNavDisplay, s.monthTitle, FontRole::Stats, TextAlign::Center, white);
+
+    static const wchar_t* weekdays[] = { L"L", L"M", L"M", L"J", L"V", L"S", L"D" };
+    int dayWidth = s.calendarHeader.width() / 7;
+    for (int i = 0; i < 7; ++i) {
+        DisplayRect r = { s.calendarHeader.left + i * dayWidth, s.calendarHeader.top,
+                          s.calendarHeader.left + (i + 1) * dayWidth, s.calendarHeader.bottom };
+        addText(list, kItemWeekdayFirst + i, r, weekdays[i], FontRole::Calendar, TextAlign::Center, gray);
+    }
+
+    for (size_t i = 0; i < s.calendar.size(); ++i) {
+        const CalendarCell& cell = s.calendar[i];
+        uint32_t id = kItemCalendarFirst + static_cast<uint32_t>(i) * 2;
+        if (cell.type != DayType::OtherMonth) {
+            uint32_t fill = 0;
+            switch (cell.type) {
+                case DayType::Normal:     fill = argb(0, 0, 0, 0); break;
+                case DayType::Today:      fill = argb(255, 33, 150, 243); break;
+                case DayType::OtherMonth: break;
+                case DayType::FullDay:    fill = argb(255, 76, 175, 80); break;
+                case DayType::PartialDay: fill = argb(255, 255, 152, 0); break;
+            }
+            addShape(list, id, DisplayItemKind::Ellipse, cell.rect, fill);
+        }
+        if (cell.dayNumber > 0) {
+            addText(list, id + 1, cell.rect, std::to_wstring(cell.dayNumber), FontRole::Calendar, TextAlign::Center,
+                    cell.type == DayType::OtherMonth ? gray : white);
+        }
+    }
+
+    addShape(list, kItemExportButton, DisplayItemKind::RoundedRect, s.exportButton, argb(255, 100, 100, 100), 5.0f);
+    addText(list, kItemExportButtonText, s.exportButton, s.exportButtonText, FontRole::Stats, TextAlign::Center, white);
+    return list;
+}
+
+static void addDirty(std::vector<DisplayRect>& dirty, DisplayRect r) {
+    if (r.empty()) {
+        return;
+    }
+    // Absorb every rect that overlaps the new one, repeating until stable.
+    bool merged = true;
+    while (merged) {
+        merged = false;
+        for (size_t i = 0; i < dirty.size(); ++i) {
+            if (dirty[i].intersects(r)) {
+                r = unionRect(r, dirty[i]);
+                dirty.erase(dirty.begin() + static_cast<std::ptrdiff_t>(i));
+                merged = true;
+                break;
+            }
+        }
+    }
+    dirty.push_back(r);
+}
+
+DisplayDiff diffDisplayLists(const DisplayList& before, const DisplayList& after, size_t maxRects) {
+    DisplayDiff diff;
+
+    auto byId = [](const DisplayList& list) {
+        std::vector<const DisplayItem*> sorted;
+        sorted.reserve(list.size());
+        for (const auto& item : list) {
+            sorted.push_back(&item);
+        }
+        std::sort(sorted.begin(), sorted.end(), [](const DisplayItem* a, const DisplayItem* b) { return a->id < b->id; });
+        return sorted;
+    };
+    std::vector<const DisplayItem*> a = byId(before);
+    std::vector<const DisplayItem*> b = byId(after);
+
+    size_t i = 0, j = 0;
+    while (i < a.size() || j < b.size()) {
+        const DisplayItem* oldItem = (i < a.size()) ? a[i] : nullptr;
+        const DisplayItem* newItem = (j < b.size()) ? b[j] : nullptr;
+        if (oldItem && newItem && oldItem->id == newItem->id) {
+            if (!oldItem->sameAppearance(*newItem)) {
+                if (newItem->kind == DisplayItemKind::Background) {
+                    diff.full = true;
+                }
+                if (newItem->kind == DisplayItemKind::Text && oldItem->text != newItem->text) {
+                    diff.changedText.push_back(newItem->id);
+                }
+                addDirty(diff.dirty, oldItem->rect);
+                addDirty(diff.dirty, newItem->rect);
+            }
+            i++;
+            j++;
+        } else if (newItem && (!oldItem || newItem->id < oldItem->id)) {
+            if (newItem->kind == DisplayItemKind::Background) {
+                diff.full = true;
+            }
+            addDirty(diff.dirty, newItem->rect);
+            j++;
+        } else {
+            addDirty(diff.dirty, oldItem->rect);
+            i++;
+        }
+    }
+
+    if (diff.full) {
+        diff.dirty.clear();
+        for (const auto& item : after) {
+            if (item.kind == DisplayItemKind::Background) {
+                diff.dirty.push_back(item.rect);
+            }
+        }
+    } else if (diff.dirty.size() > maxRects) {
+        DisplayRect bounds;
+        for (const auto& r : diff.dirty) {
+            bounds = unionRect(bounds, r);
+        }
+        diff.dirty.assign(1, bounds);
+    }
+    return diff;
+}
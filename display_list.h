@@ -0,0 +1,116 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "calendar_model.h"
+
+// --- Retained Display List ---
+//
+// A platform-neutral description of one frame: the items OnPaint used to
+// draw directly, each with a stable id. Diffing two lists yields the screen
+// regions that changed, so the renderer only re-rasterizes those into its
+// persistent back buffer. Nothing here depends on Win32 or GDI+.
+
+struct DisplayRect {
+    int left = 0;
+    int top = 0;
+    int right = 0;
+    int bottom = 0;
+
+    int width() const { return right - left; }
+    int height() const { return bottom - top; }
+    bool empty() const { return right <= left || bottom <= top; }
+    bool intersects(const DisplayRect& o) const {
+        return left < o.right && o.left < right && top < o.bottom && o.top < bottom;
+    }
+    bool operator==(const DisplayRect& o) const {
+        return left == o.left && top == o.top && right == o.right && bottom == o.bottom;
+    }
+    bool operator!=(const DisplayRect& o) const { return !(*this == o); }
+};
+
+DisplayRect unionRect(const DisplayRect& a, const DisplayRect& b);
+
+enum class DisplayItemKind { Background, RoundedRect, Ellipse, Text };
+enum class FontRole { Header, Button, Stats, Calendar };
+enum class TextAlign { Near, Center, Far };
+
+struct DisplayItem {
+    uint32_t id = 0;
+    DisplayItemKind kind = DisplayItemKind::Background;
+    DisplayRect rect;
+    uint32_t argb = 0;          // fill or text colour
+    uint32_t argb2 = 0;         // second gradient stop for Background
+    float radius = 0.0f;        // RoundedRect corner radius
+    FontRole font = FontRole::Stats;
+    TextAlign align = TextAlign::Center;
+    std::wstring text;
+
+    bool sameAppearance(const DisplayItem& o) const;
+};
+
+using DisplayList = std::vector<DisplayItem>;   // back-to-front
+
+struct CalendarCell {
+    DisplayRect rect;
+    int dayNumber = 0;
+    DayType type = DayType::Normal;
+};
+
+// Everything a frame depends on, gathered from AppState and the layout.
+struct DisplayState {
+    DisplayRect client;
+    DisplayRect header;
+    DisplayRect punchButton;
+    DisplayRect workedTimeLabel;
+    DisplayRect workedTimeValue;
+    DisplayRect monthStats;
+    DisplayRect monthNavPrev;
+    DisplayRect monthNavNext;
+    DisplayRect monthNavDisplay;
+    DisplayRect calendarHeader;
+    DisplayRect exportButton;
+    bool isWorking = false;
+    std::wstring headerText;
+    std::wstring workedTimeLabelText;
+    std::wstring workedTimeText;
+    std::wstring monthStatsText;
+    std::wstring monthNavPrevText;
+    std::wstring monthNavNextText;
+    std::wstring monthTitle;
+    std::wstring exportButtonText;
+    std::vector<CalendarCell> calendar;
+};
+
+// Stable ids for the fixed items; calendar items are derived from the cell index.
+enum DisplayItemId : uint32_t {
+    kItemBackground = 1,
+    kItemHeader,
+    kItemPunchButton,
+    kItemPunchButtonText,
+    kItemWorkedTimeLabel,
+    kItemWorkedTimeValue,
+    kItemMonthNavPrev,
+    kItemMonthNavNext,
+    kItemMonthTitle,
+    kItemExportButton,
+    kItemExportButtonText,
+    kItemMonthStats,
+    kItemWeekdayFirst = 100,    // 7 weekday letters
+    kItemCalendarFirst = 1000,  // 2 per cell: disc, then day number
+};
+
+DisplayList buildDisplayList(const DisplayState& state);
+
+struct DisplayDiff {
+    bool full = false;                  // background changed: redraw everything
+    std::vector<DisplayRect> dirty;     // merged so that no two overlap
+    std::vector<uint32_t> changedText;  // ids of text items whose string changed, ascending
+};
+
+// Regions whose pixels differ between the two frames. Rects of changed,
+// added and removed items are merged; past maxRects they collapse into one
+// bounding box.
+DisplayDiff diffDisplayLists(const DisplayList& before, const DisplayList& after, size_t maxRects = 8);
@@ -0,0 +1,132 @@
+#include "export.h"
+
+#include <cstring>
+
+#include "civil_time.h"
+#include "time_format.h"
+#include "trace.h"
+
+ExportOptions ExportOptions::month(int year, int month, ExportFormat format) {
+    ExportOptions options;
+    options.format = format;
+    options.firstDay = daysFromCivil(year, static_cast<unsigned>(month), 1);
+    options.lastDay = month == 12 ? daysFromCivil(year + 1, 1, 1) : daysFromCivil(year, static_cast<unsigned>(month) + 1, 1);
+    return options;
+}
+
+const char* frenchWeekdayName(int64_t dayKey) {
+    static const char* names[] = { "Lundi", "Mardi", "Mercredi", "Jeudi", "Vendredi", "Samedi", "Dimanche" };
+    return names[weekdayFromDays(dayKey)];
+}
+
+namespace {
+
+const size_t kMaxRowBytes = 512;
+
+size_t formatCsvRow(const WorkDay& wd, char* out) {
+    char date[kDateChars], start[kClockChars], end[kClockChars], duration[kDurationChars];
+    int64_t startMinutes = floorDiv(wd.startMs, 60000) + wd.startUtcOffsetMin;
+    formatLocalDate(startMinutes, date);
+    formatLocalClock(startMinutes, start);
+    formatLocalClock(floorDiv(wd.endMs, 60000) + wd.endUtcOffsetMin, end);
+    formatDurationHM(wd.durationMs(), duration);
+    int n = snprintf(out, kMaxRowBytes, "%s;%s;%s;%s;%s;%.2f;%.2f;%.2f;%.2f\n",
+                     date, frenchWeekdayName(wd.dayKey()), start, end, duration,
+                     wd.netEarning(), wd.hourlyNet(), wd.grossEarning(), wd.hourlyGross());
+    return n > 0 ? static_cast<size_t>(n) : 0;
+}
+
+// Keys match the web version's history objects.
+size_t formatJsonRow(const WorkDay& wd, char* out) {
+    char date[kDateChars], start[kClockChars], end[kClockChars], startISO[kISOChars], endISO[kISOChars];
+    int64_t startMinutes = floorDiv(wd.startMs, 60000) + wd.startUtcOffsetMin;
+    formatLocalDate(startMinutes, date);
+    formatLocalClock(startMinutes, start);
+    formatLocalClock(floorDiv(wd.endMs, 60000) + wd.endUtcOffsetMin, end);
+    formatUtcISO(wd.startMs, startISO);
+    formatUtcISO(wd.endMs, endISO);
+    int n = snprintf(out, kMaxRowBytes,
+                     "{\"date\":\"%s\",\"dayName\":\"%s\",\"startTime\":\"%s\",\"endTime\":\"%s\","
+                     "\"startDateTime\":\"%s\",\"endDateTime\":\"%s\",\"durationMs\":%lld,"
+                     "\"grossEarning\":%.2f,\"netEarning\":%.2f,\"hourlyGross\":%.2f,\"hourlyNet\":%.2f}\n",
+                     date, frenchWeekdayName(wd.dayKey()), start, end, startISO, endISO,
+                     static_cast<long long>(wd.durationMs()),
+                     wd.grossEarning(), wd.netEarning(), wd.hourlyGross(), wd.hourlyNet());
+    return n > 0 ? static_cast<size_t>(n) : 0;
+}
+
+} // namespace
+
+// --- Export stream ---
+
+ExportStream::ExportStream(FILE* file, ExportFormat format) : file(file), csv(format == ExportFormat::Csv) {
+    if (csv) {
+        write("Date;Jour;Heure Début;Heure Fin;Durée;Gains Nets (€);Taux Net (€/h);Gains Bruts (€);Taux Brut (€/h)\n");
+    }
+}
+
+// Guarantees `bytes` of free space, flushing with fwrite when a row might
+// not fit.
+char* ExportStream::reserve(size_t bytes) {
+    if (used + bytes > sizeof(buffer)) {
+        flush();
+    }
+    return buffer + used;
+}
+
+void ExportStream::write(const char* text) {
+    size_t length = strlen(text);
+    memcpy(reserve(length), text, length);
+    used += length;
+}
+
+void ExportStream::writeRow(const WorkDay& day) {
+    char* out = reserve(kMaxRowBytes);
+    used += csv ? formatCsvRow(day, out) : formatJsonRow(day, out);
+}
+
+bool ExportStream::flush() {
+    if (used > 0 && fwrite(buffer, 1, used, file) != used) {
+        failed = true;
+    }
+    used = 0;
+    return !failed;
+}
+
+bool ExportStream::finish() {
+    return flush() && fflush(file) == 0;
+}
+
+ExportJob::~ExportJob() {
+    cancel();
+    join();
+}
+
+bool ExportJob::launch(FILE* file, size_t expectedRows, std::function<void(ExportResult)> onDone,
+                       std::function<ExportResult()> write) {
+    if (busy) {
+        return false;
+    }
+    join();
+    busy = true;
+    progress.rowsWritten = 0;
+    progress.rowsTotal = expectedRows;
+    progress.cancelRequested = false;
+    worker = std::thread([this, file, onDone, write]() {
+        ExportResult result = write();
+        if (fclose(file) != 0 && result == ExportResult::Ok) {
+            result = ExportResult::IoError;
+        }
+        busy = false;
+        if (onDone) {
+            onDone(result);
+        }
+    });
+    return true;
+}
+
+void ExportJob::join() {
+    if (worker.joinable()) {
+        worker.join();
+    }
+}
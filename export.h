@@ -0,0 +1,138 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <thread>
+#include <vector>
+
+#include "history_query.h"
+#include "history_store.h"
+#include "trace.h"
+
+// --- History Export ---
+//
+// Streams sessions to a FILE* through a fixed-size write buffer, so memory
+// use does not depend on the export size. Only a window of the history is
+// resident, so the export reads the store range by range: a month of
+// sessions is read, written and dropped before the next, so memory stays
+// flat however long the history is. An optional query predicate
+// (history_query.h) selects the rows.
+
+enum class ExportFormat { Csv, JsonLines };
+
+enum class ExportResult { Ok, Cancelled, IoError };
+
+struct ExportOptions {
+    ExportFormat format = ExportFormat::Csv;
+    // Day keys [firstDay, lastDay); the defaults cover all history.
+    int64_t firstDay = -(int64_t(1) << 40);
+    int64_t lastDay = int64_t(1) << 40;
+
+    static ExportOptions month(int year, int month, ExportFormat format = ExportFormat::Csv);
+};
+
+struct ExportProgress {
+    std::atomic<size_t> rowsWritten{0};
+    std::atomic<size_t> rowsTotal{0};
+    std::atomic<bool> cancelRequested{false};
+};
+
+const size_t kExportBufferBytes = 64 * 1024;
+const int64_t kExportRangeDays = 31;
+
+// French weekday name for a day key ("Lundi" ... "Dimanche").
+const char* frenchWeekdayName(int64_t dayKey);
+
+// The formatting half of an export: the CSV header, rows into a fixed
+// buffer, flushes. Not thread-safe.
+class ExportStream {
+public:
+    ExportStream(FILE* file, ExportFormat format);
+    void writeRow(const WorkDay& day);
+    bool ok() const { return !failed; }
+    // Writes out the buffer and flushes the file.
+    bool finish();
+
+private:
+    char* reserve(size_t bytes);
+    void write(const char* text);
+    bool flush();
+
+    FILE* file;
+    bool csv;
+    char buffer[kExportBufferBytes];
+    size_t used = 0;
+    bool failed = false;
+};
+
+// Fills `sessions` with those whose local day is in [firstDay, lastDay),
+// oldest first (AppState::querySessions).
+using ExportRangeLoader = std::function<bool(int64_t firstDay, int64_t lastDay, std::vector<WorkDay>& sessions)>;
+
+// Writes the options' day range kExportRangeDays at a time through `load`,
+// keeping the sessions `where` matches: each range is put in a HistoryStore
+// and queried, as the resident history is. The range must be bounded: clamp
+// it to AppState::historyDays(). Progress counts the sessions scanned and
+// leaves progress.rowsTotal to the caller's estimate, raised if they pass it.
+template <class Pred = AnySession>
+ExportResult writeExportRanges(const ExportRangeLoader& load, FILE* file, const ExportOptions& options,
+                               ExportProgress& progress, const Pred& where = Pred()) {
+    TraceScope trace(TraceSpan::Export);
+    ExportStream stream(file, options.format);
+    progress.rowsWritten = 0;
+    std::vector<WorkDay> sessions;
+    HistoryStore range;
+    for (int64_t first = options.firstDay; first < options.lastDay && stream.ok(); first += kExportRangeDays) {
+        if (progress.cancelRequested) {
+            stream.finish();
+            return ExportResult::Cancelled;
+        }
+        int64_t last = std::min(options.lastDay, first + kExportRangeDays);
+        if (!load(first, last, sessions)) {
+            stream.finish();
+            return ExportResult::IoError;
+        }
+        size_t scanned = sessions.size();
+        range.assign(std::move(sessions));
+        query(range, inDays(first, last) && where).forEach([&stream](const WorkDay& day) { stream.writeRow(day); });
+        progress.rowsWritten += scanned;
+        if (progress.rowsWritten > progress.rowsTotal) {
+            progress.rowsTotal = progress.rowsWritten.load();
+        }
+    }
+    return stream.finish() ? ExportResult::Ok : ExportResult::IoError;
+}
+
+// Runs writeExportRanges on a worker thread. `onDone` is called on the
+// worker after the file has been closed.
+class ExportJob {
+public:
+    ~ExportJob();
+
+    // Takes ownership of `file`. Fails if a job is already running.
+    // expectedRows is only for progress.
+    template <class Pred = AnySession>
+    bool start(ExportRangeLoader load, FILE* file, const ExportOptions& options, size_t expectedRows,
+               std::function<void(ExportResult)> onDone, Pred where = Pred()) {
+        return launch(file, expectedRows, std::move(onDone), [this, load, file, options, where]() {
+            return writeExportRanges(load, file, options, progress, where);
+        });
+    }
+    void cancel() { progress.cancelRequested = true; }
+    void join();
+    bool running() const { return busy; }
+
+    size_t rowsWritten() const { return progress.rowsWritten; }
+    size_t rowsTotal() const { return progress.rowsTotal; }
+
+private:
+    bool launch(FILE* file, size_t expectedRows, std::function<void(ExportResult)> onDone,
+                std::function<ExportResult()> write);
+
+    std::thread worker;
+    std::atomic<bool> busy{false};
+    ExportProgress progress;
+};
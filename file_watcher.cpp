@@ -0,0 +1,255 @@
+#include "file_watcher.h"
+
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+FileWatcher::FileWatcher(ChangeFn onChange) : onChange(std::move(onChange)) {}
+
+FileWatcher::~FileWatcher() {
+    stop();
+}
+
+bool FileWatcher::start(const std::string& snapshotPath, bool poll) {
+    if (watcher.joinable()) {
+        return true;
+    }
+    path = snapshotPath;
+    size_t slash = path.find_last_of("/\\");
+    directory = slash == std::string::npos ? "." : path.substr(0, slash);
+    prefix = slash == std::string::npos ? path : path.substr(slash + 1);
+#ifdef _WIN32
+    stopEvent = CreateEventA(NULL, TRUE, FALSE, NULL);
+    if (stopEvent == NULL) {
+        return false;
+    }
+#else
+    if (pipe(wakeFds) != 0) {
+        return false;
+    }
+    fcntl(wakeFds[0], F_SETFD, FD_CLOEXEC);
+    fcntl(wakeFds[1], F_SETFD, FD_CLOEXEC);
+#endif
+    usePolling = poll || !watchNative();
+    watcher = std::thread([this] {
+        if (!usePolling && !runNative()) {
+            usePolling = true;
+        }
+        if (usePolling) {
+            runPolling();
+        }
+    });
+    return true;
+}
+
+void FileWatcher::stop() {
+    if (!watcher.joinable()) {
+        return;
+    }
+#ifdef _WIN32
+    SetEvent(static_cast<HANDLE>(stopEvent));
+    watcher.join();
+    if (directoryHandle) {
+        CloseHandle(static_cast<HANDLE>(directoryHandle));
+        directoryHandle = nullptr;
+    }
+    CloseHandle(static_cast<HANDLE>(stopEvent));
+    stopEvent = nullptr;
+#else
+    char wake = 1;
+    (void)!write(wakeFds[1], &wake, 1);
+    watcher.join();
+    if (inotifyFd >= 0) {
+        close(inotifyFd);
+        inotifyFd = -1;
+    }
+    close(wakeFds[0]);
+    close(wakeFds[1]);
+    wakeFds[0] = wakeFds[1] = -1;
+#endif
+}
+
+// The snapshot, its journal, lock, archive and temporary files.
+bool FileWatcher::matches(const std::string& name) const {
+    return name.compare(0, prefix.size(), prefix) == 0;
+}
+
+bool FileWatcher::waitForStop(int ms) {
+#ifdef _WIN32
+    return WaitForSingleObject(static_cast<HANDLE>(stopEvent), static_cast<DWORD>(ms)) == WAIT_TIMEOUT;
+#else
+    pollfd wake = { wakeFds[0], POLLIN, 0 };
+    int rc;
+    while ((rc = poll(&wake, 1, ms)) < 0 && errno == EINTR) {
+    }
+    return rc == 0;
+#endif
+}
+
+#ifdef _WIN32
+
+bool FileWatcher::watchNative() {
+    HANDLE handle = CreateFileA(directory.c_str(), FILE_LIST_DIRECTORY,
+                                FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL, OPEN_EXISTING,
+                                FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED, NULL);
+    if (handle == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    directoryHandle = handle;
+    return true;
+}
+
+bool FileWatcher::runNative() {
+    HANDLE handle = static_cast<HANDLE>(directoryHandle);
+    HANDLE io = CreateEventA(NULL, TRUE, FALSE, NULL);
+    if (io == NULL) {
+        return false;
+    }
+    // ReadDirectoryChangesW wants a DWORD-aligned buffer.
+    DWORD buffer[4096];
+    bool watched = false;
+    for (;;) {
+        OVERLAPPED overlapped = {};
+        overlapped.hEvent = io;
+        const DWORD kFilter = FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_SIZE | FILE_NOTIFY_CHANGE_LAST_WRITE;
+        if (!ReadDirectoryChangesW(handle, buffer, sizeof(buffer), FALSE, kFilter, NULL, &overlapped, NULL)) {
+            break;
+        }
+        watched = true;
+        HANDLE waits[2] = { io, static_cast<HANDLE>(stopEvent) };
+        DWORD bytes = 0;
+        if (WaitForMultipleObjects(2, waits, FALSE, INFINITE) != WAIT_OBJECT_0) {
+            CancelIo(handle);
+            GetOverlappedResult(handle, &overlapped, &bytes, TRUE);
+            break;
+        }
+        if (!GetOverlappedResult(handle, &overlapped, &bytes, FALSE)) {
+            break;
+        }
+        // No bytes: more changed than fit in the buffer.
+        bool changed = bytes == 0;
+        const char* at = reinterpret_cast<const char*>(buffer);
+        for (DWORD next = bytes ? 1 : 0; next != 0 && !changed; at += next) {
+            const FILE_NOTIFY_INFORMATION* info = reinterpret_cast<const FILE_NOTIFY_INFORMATION*>(at);
+            // Store file names are ASCII.
+            std::string name;
+            for (DWORD i = 0; i < info->FileNameLength / sizeof(WCHAR); ++i) {
+                name.push_back(info->FileName[i] < 0x80 ? static_cast<char>(info->FileName[i]) : '?');
+            }
+            changed = matches(name);
+            next = info->NextEntryOffset;
+        }
+        if (changed) {
+            if (!waitForStop(kSettleMs)) {
+                break;
+            }
+            onChange();
+        }
+    }
+    CloseHandle(io);
+    return watched;
+}
+
+#else
+
+bool FileWatcher::watchNative() {
+    inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotifyFd < 0) {
+        return false;
+    }
+    const uint32_t kMask = IN_MODIFY | IN_CLOSE_WRITE | IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO;
+    if (inotify_add_watch(inotifyFd, directory.c_str(), kMask) < 0) {
+        close(inotifyFd);
+        inotifyFd = -1;
+        return false;
+    }
+    return true;
+}
+
+bool FileWatcher::runNative() {
+    alignas(inotify_event) char buffer[8192];
+    for (;;) {
+        pollfd fds[2] = { { wakeFds[0], POLLIN, 0 }, { inotifyFd, POLLIN, 0 } };
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return true;
+        }
+        if (fds[0].revents) {
+            return true;
+        }
+        bool changed = false;
+        ssize_t n;
+        while ((n = read(inotifyFd, buffer, sizeof(buffer))) > 0) {
+            for (char* at = buffer; at < buffer + n;) {
+                const inotify_event* event = reinterpret_cast<const inotify_event*>(at);
+                changed = changed || (event->mask & IN_Q_OVERFLOW) || (event->len > 0 && matches(event->name));
+                at += sizeof(inotify_event) + event->len;
+            }
+        }
+        if (changed) {
+            if (!waitForStop(kSettleMs)) {
+                return true;
+            }
+            // The rest of the burst is covered by this call.
+            while (read(inotifyFd, buffer, sizeof(buffer)) > 0) {
+            }
+            onChange();
+        }
+    }
+}
+
+#endif
+
+namespace {
+
+struct FileStamp {
+    long long size = -1;
+    long long modified = 0;
+    unsigned long long inode = 0;
+
+    bool operator!=(const FileStamp& o) const { return size != o.size || modified != o.modified || inode != o.inode; }
+};
+
+FileStamp stampOf(const std::string& path) {
+    FileStamp stamp;
+    struct stat info;
+    if (stat(path.c_str(), &info) == 0) {
+        stamp.size = static_cast<long long>(info.st_size);
+        stamp.modified = static_cast<long long>(info.st_mtime);
+        stamp.inode = static_cast<unsigned long long>(info.st_ino);
+    }
+    return stamp;
+}
+
+} // namespace
+
+// Every append changes the journal's size and every compaction the lock
+// file's generation, so a one-second mtime is enough.
+void FileWatcher::runPolling() {
+    const std::string watched[] = { path, path + ".journal", path + ".lock" };
+    FileStamp last[3];
+    for (int i = 0; i < 3; ++i) {
+        last[i] = stampOf(watched[i]);
+    }
+    while (waitForStop(kPollIntervalMs)) {
+        bool changed = false;
+        for (int i = 0; i < 3; ++i) {
+            FileStamp now = stampOf(watched[i]);
+            changed = changed || now != last[i];
+            last[i] = now;
+        }
+        if (changed) {
+            onChange();
+        }
+    }
+}
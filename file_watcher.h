@@ -0,0 +1,64 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <string>
+#include <thread>
+
+// --- Store Change Notification ---
+//
+// Tells the app when another instance, or the import tool, has written to
+// the store, so it takes the new sessions in (AppState::syncExternalChanges)
+// rather than finding out at the next start. Watches the directory holding
+// the snapshot for changes to files named after it: inotify on Linux,
+// ReadDirectoryChangesW on Windows. Where neither is available, or on
+// request (network shares often deliver no notifications), it compares the
+// size and modification time of the snapshot, its journal and its lock file
+// every kPollIntervalMs instead.
+//
+// onChange runs on the watcher thread, once per burst of writes (they are
+// gathered for kSettleMs), this instance's own included. It should only
+// post a message to the thread that syncs.
+
+class FileWatcher {
+public:
+    using ChangeFn = std::function<void()>;
+
+    static const int kPollIntervalMs = 1000;
+    static const int kSettleMs = 50;
+
+    explicit FileWatcher(ChangeFn onChange);
+    ~FileWatcher();
+    FileWatcher(const FileWatcher&) = delete;
+    FileWatcher& operator=(const FileWatcher&) = delete;
+
+    // path: the snapshot. Falls back to polling when the directory cannot
+    // be watched; false only if no thread could be started.
+    bool start(const std::string& path, bool poll = false);
+    void stop();
+
+    bool polling() const { return usePolling.load(); }
+
+private:
+    bool watchNative();
+    // Returns false if the directory turned out not to be watchable.
+    bool runNative();
+    void runPolling();
+    bool matches(const std::string& name) const;
+    // Sleeps up to ms; false once stop() was called.
+    bool waitForStop(int ms);
+
+    ChangeFn onChange;
+    std::string path;
+    std::string directory;
+    std::string prefix;             // the snapshot's file name
+    std::atomic<bool> usePolling{false};
+    std::thread watcher;
+#ifdef _WIN32
+    void* directoryHandle = nullptr;
+    void* stopEvent = nullptr;
+#else
+    int inotifyFd = -1;
+    int wakeFds[2] = { -1, -1 };
+#endif
+};
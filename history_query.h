@@ -0,0 +1,303 @@
+#pragma once
+
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "civil_time.h"
+#include "history_store.h"
+#include "rollup.h"
+#include "workday.h"
+
+// --- History Queries ---
+//
+// Filters over a HistoryStore built from small predicate structs. `a && b`,
+// `a || b` and `!a` nest them into one template type, so the per-session
+// test compiles down to inline comparisons: no virtual call, no
+// std::function. Date bounds are pushed down: a query walks only the slice
+// of the day index its predicate can match.
+//
+//   auto weekendWork = query(history, inMonth(2024, 6) && onWeekend());
+//   Totals t = weekendWork.totals();
+//   for (const GroupTotals& week : weekendWork.groupBy(GroupBy::Week)) ...
+
+const int64_t kFirstQueryDay = -(int64_t(1) << 40);
+const int64_t kLastQueryDay = int64_t(1) << 40;
+
+// Base of every predicate. narrowDays() shrinks [first, last) to the day
+// keys outside which the predicate never matches; by default it cannot say.
+struct SessionPredicate {
+    void narrowDays(int64_t&, int64_t&) const {}
+};
+
+template <class P>
+using IfPredicate = std::enable_if_t<std::is_base_of<SessionPredicate, P>::value, int>;
+
+struct AnySession : SessionPredicate {
+    bool operator()(const WorkDay&) const { return true; }
+};
+
+// Sessions whose local start day is in [firstDay, lastDay).
+struct InDays : SessionPredicate {
+    int64_t firstDay;
+    int64_t lastDay;
+
+    InDays(int64_t firstDay, int64_t lastDay) : firstDay(firstDay), lastDay(lastDay) {}
+    bool operator()(const WorkDay& day) const {
+        int64_t key = day.dayKey();
+        return key >= firstDay && key < lastDay;
+    }
+    void narrowDays(int64_t& first, int64_t& last) const {
+        first = std::max(first, firstDay);
+        last = std::min(last, lastDay);
+    }
+};
+
+// Bit 0 is Monday, bit 6 Sunday.
+struct OnWeekdays : SessionPredicate {
+    unsigned mask;
+
+    explicit OnWeekdays(unsigned mask) : mask(mask) {}
+    bool operator()(const WorkDay& day) const { return (mask >> weekdayFromDays(day.dayKey())) & 1; }
+};
+
+// Durations in [minMs, maxMs).
+struct DurationBetween : SessionPredicate {
+    long long minMs;
+    long long maxMs;
+
+    DurationBetween(long long minMs, long long maxMs) : minMs(minMs), maxMs(maxMs) {}
+    bool operator()(const WorkDay& day) const { return day.durationMs() >= minMs && day.durationMs() < maxMs; }
+};
+
+struct AtRate : SessionPredicate {
+    uint32_t rateId;
+
+    explicit AtRate(uint32_t rateId) : rateId(rateId) {}
+    bool operator()(const WorkDay& day) const { return day.rateId == rateId; }
+};
+
+template <class A, class B>
+struct AllOf : SessionPredicate {
+    A a;
+    B b;
+
+    AllOf(A a, B b) : a(std::move(a)), b(std::move(b)) {}
+    bool operator()(const WorkDay& day) const { return a(day) && b(day); }
+    void narrowDays(int64_t& first, int64_t& last) const {
+        a.narrowDays(first, last);
+        b.narrowDays(first, last);
+    }
+};
+
+template <class A, class B>
+struct AnyOf : SessionPredicate {
+    A a;
+    B b;
+
+    AnyOf(A a, B b) : a(std::move(a)), b(std::move(b)) {}
+    bool operator()(const WorkDay& day) const { return a(day) || b(day); }
+    // The span covering both sides' ranges.
+    void narrowDays(int64_t& first, int64_t& last) const {
+        int64_t aFirst = first, aLast = last, bFirst = first, bLast = last;
+        a.narrowDays(aFirst, aLast);
+        b.narrowDays(bFirst, bLast);
+        if (aFirst >= aLast) {
+            first = bFirst;
+            last = bLast;
+        } else if (bFirst >= bLast) {
+            first = aFirst;
+            last = aLast;
+        } else {
+            first = std::min(aFirst, bFirst);
+            last = std::max(aLast, bLast);
+        }
+    }
+};
+
+template <class A>
+struct NoneOf : SessionPredicate {
+    A a;
+
+    explicit NoneOf(A a) : a(std::move(a)) {}
+    bool operator()(const WorkDay& day) const { return !a(day); }
+};
+
+template <class A, class B, IfPredicate<A> = 0, IfPredicate<B> = 0>
+AllOf<A, B> operator&&(A a, B b) {
+    return AllOf<A, B>(std::move(a), std::move(b));
+}
+
+template <class A, class B, IfPredicate<A> = 0, IfPredicate<B> = 0>
+AnyOf<A, B> operator||(A a, B b) {
+    return AnyOf<A, B>(std::move(a), std::move(b));
+}
+
+template <class A, IfPredicate<A> = 0>
+NoneOf<A> operator!(A a) {
+    return NoneOf<A>(std::move(a));
+}
+
+inline InDays inDays(int64_t firstDay, int64_t lastDay) { return InDays(firstDay, lastDay); }
+inline InDays onDay(int64_t dayKey) { return InDays(dayKey, dayKey + 1); }
+inline InDays inMonth(int year, int month) {
+    int nextYear = month == 12 ? year + 1 : year;
+    unsigned nextMonth = month == 12 ? 1 : static_cast<unsigned>(month) + 1;
+    return InDays(daysFromCivil(year, static_cast<unsigned>(month), 1), daysFromCivil(nextYear, nextMonth, 1));
+}
+inline OnWeekdays onWeekend() { return OnWeekdays(0x60); }
+inline OnWeekdays onWorkweek() { return OnWeekdays(0x1f); }
+inline DurationBetween shorterThan(long long ms) { return DurationBetween(LLONG_MIN, ms); }
+inline DurationBetween atLeast(long long ms) { return DurationBetween(ms, LLONG_MAX); }
+inline AtRate atRate(uint32_t rateId) { return AtRate(rateId); }
+inline AtRate atRate(double hourlyGross, double hourlyNet) { return AtRate(rateTable().intern(hourlyGross, hourlyNet)); }
+
+// --- Grouping ---
+
+enum class GroupBy { Day, Week, Month };
+
+// The first day key of the day, Monday-to-Sunday week or month holding dayKey.
+inline int64_t groupStart(int64_t dayKey, GroupBy by) {
+    switch (by) {
+    case GroupBy::Week:
+        return dayKey - weekdayFromDays(dayKey);
+    case GroupBy::Month: {
+        int year; unsigned month, day;
+        civilFromDays(dayKey, year, month, day);
+        return dayKey - (day - 1);
+    }
+    default:
+        return dayKey;
+    }
+}
+
+struct GroupTotals {
+    int64_t key = 0;        // groupStart() for the date groupings
+    Totals totals;
+};
+
+// --- Queries ---
+
+template <class Pred>
+class HistoryQuery {
+public:
+    HistoryQuery(const HistoryStore& history, Pred where) : history(&history), where(std::move(where)) {}
+
+    // The slice of the day index the predicate can match.
+    HistoryStore::Range candidates() const {
+        int64_t first = kFirstQueryDay, last = kLastQueryDay;
+        where.narrowDays(first, last);
+        return first < last ? history->days(first, last) : HistoryStore::Range{ history, 0, 0 };
+    }
+    bool matches(const WorkDay& day) const { return where(day); }
+
+    // Calls fn for each match, oldest first.
+    template <class Fn>
+    void forEach(Fn&& fn) const {
+        for (const WorkDay& day : candidates()) {
+            if (where(day)) {
+                fn(day);
+            }
+        }
+    }
+
+    size_t count() const {
+        size_t n = 0;
+        forEach([&n](const WorkDay&) { ++n; });
+        return n;
+    }
+
+    Totals totals() const {
+        Totals t;
+        int64_t lastDay = kFirstQueryDay - 1;
+        forEach([&](const WorkDay& day) {
+            int64_t key = day.dayKey();
+            addSession(t, day, key != lastDay);
+            lastDay = key;
+        });
+        return t;
+    }
+
+    // fn applied to each match, oldest first.
+    template <class Fn>
+    auto select(Fn fn) const -> std::vector<std::decay_t<decltype(fn(std::declval<const WorkDay&>()))>> {
+        std::vector<std::decay_t<decltype(fn(std::declval<const WorkDay&>()))>> out;
+        forEach([&](const WorkDay& day) { out.push_back(fn(day)); });
+        return out;
+    }
+
+    // Totals per group in key order; groups with no match are left out.
+    std::vector<GroupTotals> groupBy(GroupBy by) const {
+        return group([by](const WorkDay&, int64_t dayKey) { return groupStart(dayKey, by); }, true);
+    }
+
+    // Groups by any integer key of a session, e.g. its rate id.
+    template <class KeyFn>
+    std::vector<GroupTotals> groupBy(KeyFn keyOf) const {
+        return group([&keyOf](const WorkDay& day, int64_t) { return static_cast<int64_t>(keyOf(day)); }, false);
+    }
+
+private:
+    // keyOf(session, dayKey) -> group key; the day key is worked out once.
+    // dateOrdered: keys never decrease along the matches (the date groupings).
+    template <class KeyOf>
+    std::vector<GroupTotals> group(KeyOf keyOf, bool dateOrdered) const {
+        struct Group {
+            GroupTotals totals;
+            int64_t lastDay;
+        };
+        std::vector<Group> groups;
+        size_t current = 0;
+        forEach([&](const WorkDay& day) {
+            int64_t dayKey = day.dayKey();
+            int64_t key = keyOf(day, dayKey);
+            // Matches arrive in day order, so date keys only ever open a new
+            // last group; other keys can come back to any group, so they
+            // search the (few) groups so far.
+            if (groups.empty() || groups[current].totals.key != key) {
+                auto it = dateOrdered
+                              ? groups.end()
+                              : std::find_if(groups.begin(), groups.end(),
+                                             [key](const Group& g) { return g.totals.key == key; });
+                if (it == groups.end()) {
+                    groups.push_back(Group{ GroupTotals{ key, Totals() }, kFirstQueryDay - 1 });
+                    it = groups.end() - 1;
+                }
+                current = static_cast<size_t>(it - groups.begin());
+            }
+            Group& group = groups[current];
+            addSession(group.totals.totals, day, dayKey != group.lastDay);
+            group.lastDay = dayKey;
+        });
+        std::vector<GroupTotals> out;
+        out.reserve(groups.size());
+        for (const Group& group : groups) {
+            out.push_back(group.totals);
+        }
+        std::sort(out.begin(), out.end(), [](const GroupTotals& a, const GroupTotals& b) { return a.key < b.key; });
+        return out;
+    }
+
+    static void addSession(Totals& t, const WorkDay& day, bool newDay) {
+        t.durationMs += day.durationMs();
+        t.gross.add(grossMsCents(day));
+        t.net.add(netMsCents(day));
+        t.sessions++;
+        t.daysWorked += newDay ? 1 : 0;
+    }
+
+    const HistoryStore* history;
+    Pred where;
+};
+
+template <class Pred, IfPredicate<Pred> = 0>
+HistoryQuery<Pred> query(const HistoryStore& history, Pred where) {
+    return HistoryQuery<Pred>(history, std::move(where));
+}
+
+inline HistoryQuery<AnySession> query(const HistoryStore& history) {
+    return HistoryQuery<AnySession>(history, AnySession());
+}
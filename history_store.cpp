@@ -0,0 +1,99 @@
+#include "history_store.h"
+
+#include <algorithm>
+
+#include "civil_time.h"
+
+void HistoryStore::clear() {
+    sessions.clear();
+    dayStart.clear();
+    firstDay = 0;
+    layout++;
+}
+
+static bool startsBefore(const WorkDay& a, const WorkDay& b) {
+    int64_t ka = a.dayKey(), kb = b.dayKey();
+    return ka != kb ? ka < kb : a.startMs < b.startMs;
+}
+
+void HistoryStore::assign(std::vector<WorkDay> chronological) {
+    if (!std::is_sorted(chronological.begin(), chronological.end(), startsBefore)) {
+        std::stable_sort(chronological.begin(), chronological.end(), startsBefore);
+    }
+    sessions = std::move(chronological);
+    rebuildIndex();
+    layout++;
+}
+
+void HistoryStore::append(const WorkDay& day) {
+    int64_t key = day.dayKey();
+    if (sessions.empty()) {
+        firstDay = key;
+        dayStart.assign(1, 0);
+    } else if (key < sessions.back().dayKey()) {
+        sessions.insert(sessions.begin() + static_cast<std::ptrdiff_t>(upperBound(day)), day);
+        rebuildIndex();
+        layout++;
+        return;
+    }
+
+    // Days between the previous last day and this one start at the new index.
+    int64_t lastIndexed = firstDay + static_cast<int64_t>(dayStart.size()) - 1;
+    uint32_t index = static_cast<uint32_t>(sessions.size());
+    for (int64_t d = lastIndexed + 1; d <= key + 1; ++d) {
+        dayStart.push_back(index);
+    }
+    sessions.push_back(day);
+    dayStart.back() = static_cast<uint32_t>(sessions.size());
+}
+
+void HistoryStore::rebuildIndex() {
+    dayStart.clear();
+    if (sessions.empty()) {
+        firstDay = 0;
+        return;
+    }
+    firstDay = sessions.front().dayKey();
+    int64_t span = sessions.back().dayKey() - firstDay + 1;
+    dayStart.resize(static_cast<size_t>(span) + 1);
+    size_t s = 0;
+    for (int64_t d = 0; d <= span; ++d) {
+        while (s < sessions.size() && sessions[s].dayKey() < firstDay + d) {
+            s++;
+        }
+        dayStart[static_cast<size_t>(d)] = static_cast<uint32_t>(s);
+    }
+}
+
+size_t HistoryStore::upperBound(const WorkDay& day) const {
+    return static_cast<size_t>(std::upper_bound(sessions.begin(), sessions.end(), day, startsBefore) - sessions.begin());
+}
+
+size_t HistoryStore::lowerBound(int64_t dayKey) const {
+    if (dayStart.empty() || dayKey <= firstDay) {
+        return 0;
+    }
+    int64_t offset = dayKey - firstDay;
+    if (offset >= static_cast<int64_t>(dayStart.size())) {
+        return sessions.size();
+    }
+    return dayStart[static_cast<size_t>(offset)];
+}
+
+HistoryStore::Range HistoryStore::days(int64_t first, int64_t last) const {
+    if (last <= first) {
+        return { this, 0, 0 };
+    }
+    return { this, lowerBound(first), lowerBound(last) };
+}
+
+HistoryStore::Range HistoryStore::month(int year, int month) const {
+    int nextYear = month == 12 ? year + 1 : year;
+    unsigned nextMonth = month == 12 ? 1 : static_cast<unsigned>(month) + 1;
+    return days(daysFromCivil(year, static_cast<unsigned>(month), 1), daysFromCivil(nextYear, nextMonth, 1));
+}
+
+HistoryStore::Range HistoryStore::week(int64_t dayKey) const {
+    int64_t monday = dayKey - weekdayFromDays(dayKey);
+    return days(monday, monday + 7);
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "workday.h"
+
+// --- Indexed Session History ---
+//
+// Sessions are kept in chronological order. A dense per-day index maps a day
+// key (local days since 1970-01-01) to the half-open range of sessions that
+// started that day, so day, week and month lookups are O(1) regardless of
+// how much history there is.
+
+class HistoryStore {
+public:
+    using const_iterator = std::vector<WorkDay>::const_iterator;
+
+    // Index range [first, last) into the store. Stays valid across in-order
+    // appends; anything that moves sessions (an older append, assign(),
+    // clear()) bumps layoutVersion() and leaves it indexing other sessions.
+    struct Range {
+        const HistoryStore* store = nullptr;
+        size_t first = 0;
+        size_t last = 0;
+
+        const_iterator begin() const { return store->sessions.begin() + first; }
+        const_iterator end() const { return store->sessions.begin() + last; }
+        size_t size() const { return last - first; }
+        bool empty() const { return first == last; }
+        const WorkDay& front() const { return store->sessions[first]; }
+    };
+
+    void clear();
+
+    // Takes sessions in chronological order (they are sorted if not).
+    void assign(std::vector<WorkDay> chronological);
+
+    // Appends a session. In-order appends are amortized O(1); an older
+    // session is inserted in place and the index rebuilt.
+    void append(const WorkDay& day);
+
+    uint64_t layoutVersion() const { return layout; }
+    // Index of the first session ordered after day (by day key, then start).
+    size_t upperBound(const WorkDay& day) const;
+
+    size_t size() const { return sessions.size(); }
+    bool empty() const { return sessions.empty(); }
+    const WorkDay& operator[](size_t i) const { return sessions[i]; }
+    const_iterator begin() const { return sessions.begin(); }
+    const_iterator end() const { return sessions.end(); }
+    const std::vector<WorkDay>& chronological() const { return sessions; }
+
+    Range all() const { return { this, 0, sessions.size() }; }
+    Range day(int64_t dayKey) const { return days(dayKey, dayKey + 1); }
+    // Sessions whose day key is in [firstDay, lastDay).
+    Range days(int64_t firstDay, int64_t lastDay) const;
+    Range month(int year, int month) const;
+    // The Monday-to-Sunday week containing dayKey.
+    Range week(int64_t dayKey) const;
+
+private:
+    void rebuildIndex();
+    size_t lowerBound(int64_t dayKey) const;
+
+    std::vector<WorkDay> sessions;
+    int64_t firstDay = 0;
+    // dayStart[d - firstDay] = index of the first session on or after day d;
+    // one extra trailing entry so [d, d + 1) is always addressable.
+    std::vector<uint32_t> dayStart;
+    uint64_t layout = 0;
+};
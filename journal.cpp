@@ -0,0 +1,922 @@
+#include "journal.h"
+
+#include "archive.h"
+#include "binary_history.h"
+#include "crc32c.h"
+#include "text_parser.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cinttypes>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <sstream>
+#include <unordered_set>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <fcntl.h>
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static bool fileExists(const std::string& path) {
+    FILE* file = std::fopen(path.c_str(), "rb");
+    if (!file) {
+        return false;
+    }
+    std::fclose(file);
+    return true;
+}
+
+// On Windows the handle lets other instances rename and delete the journal
+// while it is open, as every instance keeps one across compactions.
+static FILE* openJournalFile(const std::string& path, bool append) {
+#ifdef _WIN32
+    HANDLE handle = CreateFileA(path.c_str(), append ? GENERIC_WRITE : GENERIC_READ,
+                                FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL,
+                                append ? OPEN_ALWAYS : OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (handle == INVALID_HANDLE_VALUE) {
+        return nullptr;
+    }
+    int fd = _open_osfhandle(reinterpret_cast<intptr_t>(handle), (append ? _O_APPEND : _O_RDONLY) | _O_BINARY);
+    if (fd < 0) {
+        CloseHandle(handle);
+        return nullptr;
+    }
+    FILE* file = _fdopen(fd, append ? "ab" : "rb");
+    if (!file) {
+        _close(fd);
+    }
+    return file;
+#else
+    return std::fopen(path.c_str(), append ? "ab" : "rb");
+#endif
+}
+
+// Cuts path back to its first size bytes, durably.
+static bool truncateFile(const std::string& path, long size) {
+#ifdef _WIN32
+    int fd = _open(path.c_str(), _O_WRONLY | _O_BINARY);
+    bool ok = fd >= 0 && _chsize_s(fd, size) == 0 && _commit(fd) == 0;
+    if (fd >= 0) {
+        _close(fd);
+    }
+#else
+    int fd = ::open(path.c_str(), O_WRONLY | O_CLOEXEC);
+    bool ok = fd >= 0 && ftruncate(fd, size) == 0 && fsync(fd) == 0;
+    if (fd >= 0) {
+        close(fd);
+    }
+#endif
+    return ok;
+}
+
+// False when path is gone or is another file than the one open. The open
+// handle keeps its inode (file index) from being reused.
+static bool sameFile(FILE* file, const std::string& path) {
+#ifdef _WIN32
+    BY_HANDLE_FILE_INFORMATION open, named;
+    HANDLE handle = CreateFileA(path.c_str(), 0, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL,
+                                OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (handle == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    bool ok = GetFileInformationByHandle(reinterpret_cast<HANDLE>(_get_osfhandle(_fileno(file))), &open) &&
+              GetFileInformationByHandle(handle, &named);
+    CloseHandle(handle);
+    return !ok || (open.dwVolumeSerialNumber == named.dwVolumeSerialNumber &&
+                   open.nFileIndexHigh == named.nFileIndexHigh && open.nFileIndexLow == named.nFileIndexLow);
+#else
+    struct stat open, named;
+    if (stat(path.c_str(), &named) != 0) {
+        return false;
+    }
+    return fstat(fileno(file), &open) != 0 || (open.st_dev == named.st_dev && open.st_ino == named.st_ino);
+#endif
+}
+
+// Same start second: the journal stores start times without milliseconds.
+static int64_t startSecond(const WorkDay& day) {
+    return day.startMs / 1000;
+}
+
+static bool containsSecond(const std::vector<WorkDay>& sorted, int64_t second) {
+    auto it = std::lower_bound(sorted.begin(), sorted.end(), second * 1000,
+                               [](const WorkDay& day, int64_t ms) { return day.startMs < ms; });
+    return it != sorted.end() && startSecond(*it) == second;
+}
+
+// Adds more to into (oldest first), keeping into's copy of a start second.
+static void mergeSessions(std::vector<WorkDay>& into, const std::vector<WorkDay>& more) {
+    into.insert(into.end(), more.begin(), more.end());
+    std::stable_sort(into.begin(), into.end(),
+                     [](const WorkDay& a, const WorkDay& b) { return startSecond(a) < startSecond(b); });
+    auto duplicates = std::unique(into.begin(), into.end(), [](const WorkDay& a, const WorkDay& b) {
+        return startSecond(a) == startSecond(b);
+    });
+    into.erase(duplicates, into.end());
+}
+
+Journal::~Journal() {
+    closeJournal();
+    stopFollowing();
+    closeStoreLock();
+}
+
+void Journal::open(const std::string& path, SnapshotFormat snapshotFormat, StoreAccess access) {
+    closeJournal();
+    {
+        std::lock_guard<std::recursive_mutex> store(storeMutex);
+        stopFollowing();
+        closeStoreLock();
+        following = false;
+        missedRecords = false;
+        caughtUp.clear();
+        unreadOwn.clear();
+    }
+    snapshotPath = path;
+    format = snapshotFormat;
+    readOnly = access == StoreAccess::ReadOnly;
+    journalPath = path + ".journal";
+    archivePath = path + ".archive";
+    quarantinePath = path + ".quarantine";
+    lockPath = path + ".lock";
+    journalRecords = 0;
+    checksummedStore = true;
+    std::lock_guard<std::mutex> guard(snapshotMutex);
+    cachedArchive.reset();
+    archiveLoaded = false;
+}
+
+static std::string withChecksum(std::string record) {
+    char field[16];
+    std::snprintf(field, sizeof(field), "|%08" PRIx32 "\n", crc32c(record.data(), record.size()));
+    return record + field;
+}
+
+std::string formatWorkDayRecord(const WorkDay& day) {
+    std::stringstream ss;
+    ss << "workday|" << day.date() << "|" << day.startTime() << "|" << day.endTime() << "|"
+       << day.startDateTime() << "|" << day.endDateTime() << "|" << day.duration() << "|"
+       << day.durationMs() << "|" << day.grossEarning() << "|" << day.netEarning() << "|"
+       << day.hourlyGross() << "|" << day.hourlyNet();
+    return withChecksum(ss.str());
+}
+
+std::string formatConfigRecord(const Config& config) {
+    std::stringstream ss;
+    ss << "config|" << config.hourlyGross << "|" << config.hourlyNet;
+    return withChecksum(ss.str());
+}
+
+bool Journal::load(Config& config, std::vector<WorkDay>& history) {
+    StoreLock lock(*this);
+    bool found = false;
+    int64_t snapshotHead = INT64_MIN;
+    history.clear();
+    {
+        std::lock_guard<std::mutex> guard(errorsMutex);
+        errors.clear();
+    }
+
+    if (format == SnapshotFormat::Binary) {
+        found = loadSnapshotRange(INT64_MIN, INT64_MAX, config, history, snapshotHead);
+    } else {
+        ParsedHistory parsed;
+        if (parseTextHistoryFile(snapshotPath, parsed)) {
+            found = true;
+            checksummedStore = parsed.checksummed;
+            if (parsed.haveConfig) {
+                config = parsed.config;
+            }
+            // data.txt lists sessions newest first.
+            history.assign(std::make_move_iterator(parsed.days.rbegin()), std::make_move_iterator(parsed.days.rend()));
+            collectErrors(snapshotPath, parsed);
+            if (!history.empty()) {
+                snapshotHead = history.back().startMs;
+            }
+        }
+    }
+
+    std::vector<WorkDay> tail;
+    if (loadJournal(snapshotHead, &history, config, tail)) {
+        found = true;
+        history.insert(history.end(), std::make_move_iterator(tail.begin()), std::make_move_iterator(tail.end()));
+    }
+    return found;
+}
+
+bool Journal::loadSnapshotRange(int64_t fromMs, int64_t toMs, Config& config, std::vector<WorkDay>& sessions,
+                                int64_t& snapshotHead) {
+    sessions.clear();
+    snapshotHead = INT64_MIN;
+    if (format != SnapshotFormat::Binary) {
+        return false;
+    }
+    std::lock_guard<std::mutex> guard(snapshotMutex);
+    std::shared_ptr<const HistoryArchive> sealed;
+    if (!loadArchive(sealed)) {
+        return false;
+    }
+    BinaryHistoryView view;
+    bool haveHot = view.open(snapshotPath);
+    if (!haveHot && (!sealed || fileExists(snapshotPath))) {
+        return false;
+    }
+    int64_t sealedEnd = INT64_MIN;
+    std::vector<QuarantinedRecord> corrupt;
+    if (sealed) {
+        std::vector<QuarantinedRecord> corruptMonths;
+        sealed->decodeRange(fromMs, toMs, sessions, &corruptMonths);
+        if (!corruptMonths.empty()) {
+            quarantine(archivePath, corruptMonths);
+        }
+        snapshotHead = sealed->lastStartMs();
+        sealedEnd = sealed->endDay();
+    }
+    if (haveHot) {
+        checksummedStore = view.checksummed();
+        config = view.config();
+        if (!view.headerIntact()) {
+            corrupt.push_back({ "header", "checksum mismatch, settings not loaded", hexBytes(view.headerBytes(), 64) });
+        }
+    }
+    if (view.size() > 0) {
+        snapshotHead = std::max(snapshotHead, view[view.size() - 1].startMs);
+        auto byStart = [](const BinaryWorkDay& record, int64_t ms) { return record.startMs < ms; };
+        const BinaryWorkDay* first = std::lower_bound(view.begin(), view.end(), fromMs, byStart);
+        const BinaryWorkDay* last = std::lower_bound(first, view.end(), toMs, byStart);
+        sessions.reserve(sessions.size() + static_cast<size_t>(last - first));
+        // Checked a block at a time (see binary_history.h), then converted
+        // while hot.
+        const size_t kCheckChunk = BinaryHistoryView::kCheckedBlockRecords;
+        std::vector<size_t> bad;
+        for (size_t at = static_cast<size_t>(first - view.begin()), end = static_cast<size_t>(last - view.begin()),
+                    chunkEnd; at < end; at = chunkEnd) {
+            chunkEnd = std::min((at / kCheckChunk + 1) * kCheckChunk, end);
+            bad.clear();
+            view.findCorrupt(at, chunkEnd, bad);
+            auto nextBad = bad.begin();
+            for (size_t i = at; i < chunkEnd; ++i) {
+                if (nextBad != bad.end() && *nextBad == i) {
+                    corrupt.push_back({ "record " + std::to_string(i), "checksum mismatch", hexBytes(&view[i], sizeof(view[i])) });
+                    ++nextBad;
+                    continue;
+                }
+                WorkDay day = fromBinaryWorkDay(view[i]);
+                // Already sealed: the compaction that sealed it stopped before
+                // rewriting history.bin.
+                if (day.dayKey() >= sealedEnd) {
+                    sessions.push_back(day);
+                }
+            }
+        }
+    }
+    auto byStartMs = [](const WorkDay& a, const WorkDay& b) { return a.startMs < b.startMs; };
+    if (!std::is_sorted(sessions.begin(), sessions.end(), byStartMs)) {
+        std::stable_sort(sessions.begin(), sessions.end(), byStartMs);
+    }
+    if (!corrupt.empty()) {
+        quarantine(snapshotPath, corrupt);
+    }
+    return true;
+}
+
+bool Journal::snapshotStarts(int64_t& firstMs, int64_t& lastMs) {
+    firstMs = INT64_MAX;
+    lastMs = INT64_MIN;
+    if (format != SnapshotFormat::Binary) {
+        return false;
+    }
+    std::lock_guard<std::mutex> guard(snapshotMutex);
+    std::shared_ptr<const HistoryArchive> sealed;
+    if (loadArchive(sealed) && sealed && !sealed->empty()) {
+        firstMs = sealed->block(0).firstStartMs;
+        lastMs = sealed->lastStartMs();
+    }
+    BinaryHistoryView view;
+    if (view.open(snapshotPath)) {
+        size_t first = 0, last = view.size();
+        while (first < last && !view.recordIntact(view[first])) {
+            first++;
+        }
+        while (last > first && !view.recordIntact(view[last - 1])) {
+            last--;
+        }
+        if (first < last) {
+            firstMs = std::min(firstMs, view[first].startMs);
+            lastMs = std::max(lastMs, view[last - 1].startMs);
+        }
+    }
+    return firstMs <= lastMs;
+}
+
+bool Journal::loadJournal(int64_t snapshotHead, Config& config, std::vector<WorkDay>& tail) {
+    return loadJournal(snapshotHead, nullptr, config, tail);
+}
+
+bool Journal::loadJournal(int64_t snapshotHead, const std::vector<WorkDay>* snapshot, Config& config,
+                          std::vector<WorkDay>& tail) {
+    tail.clear();
+    StoreLock lock(*this);
+    ParsedHistory parsed;
+    if (!readJournal(parsed)) {
+        return false;
+    }
+    if (parsed.haveConfig) {
+        config = parsed.config;
+    }
+    journalRecords = parsed.days.size();
+    collectErrors(journalPath, parsed);
+    // Records already in the snapshot were folded in by a compaction that
+    // stopped before removing the journal.
+    dropKnown(parsed.days, snapshotHead, snapshot);
+    tail = std::move(parsed.days);
+    return true;
+}
+
+void Journal::dropKnown(std::vector<WorkDay>& records, int64_t snapshotHead, const std::vector<WorkDay>* snapshot) {
+    std::unordered_set<int64_t> seen;
+    int64_t oldest = INT64_MAX;
+    for (const auto& day : records) {
+        if (day.startMs <= snapshotHead) {
+            oldest = std::min(oldest, day.startMs);
+        }
+    }
+    // Only records no newer than the snapshot's last session can be in it.
+    std::vector<WorkDay> stored;
+    if (oldest != INT64_MAX && !snapshot) {
+        Config unused;
+        int64_t head;
+        loadSnapshotRange(oldest / 1000 * 1000, (snapshotHead / 1000 + 1) * 1000, unused, stored, head);
+        snapshot = &stored;
+    }
+    auto known = std::remove_if(records.begin(), records.end(), [&](const WorkDay& day) {
+        int64_t second = startSecond(day);
+        return !seen.insert(second).second || (day.startMs <= snapshotHead && snapshot && containsSecond(*snapshot, second));
+    });
+    records.erase(known, records.end());
+}
+
+// --- Sharing the store ---
+
+bool Journal::lockStore(bool wait) {
+    if (wait) {
+        storeMutex.lock();
+    } else if (!storeMutex.try_lock()) {
+        return false;
+    }
+    if (storeDepth > 0 || lockPath.empty()) {
+        ++storeDepth;
+        return true;
+    }
+    // Without a lock file (a read-only directory, or read-only access before
+    // any writer made one) the store is used unlocked.
+    bool busy = false;
+#ifdef _WIN32
+    if (!lockHandle) {
+        HANDLE handle = CreateFileA(lockPath.c_str(), readOnly ? GENERIC_READ : GENERIC_READ | GENERIC_WRITE,
+                                    FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL,
+                                    readOnly ? OPEN_EXISTING : OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+        lockHandle = handle == INVALID_HANDLE_VALUE ? nullptr : handle;
+    }
+    if (lockHandle) {
+        OVERLAPPED region = {};
+        DWORD flags = (readOnly ? 0 : LOCKFILE_EXCLUSIVE_LOCK) | (wait ? 0 : LOCKFILE_FAIL_IMMEDIATELY);
+        busy = !LockFileEx(static_cast<HANDLE>(lockHandle), flags, 0, 1, 0, &region) && !wait;
+    }
+#else
+    if (lockFd < 0) {
+        lockFd = ::open(lockPath.c_str(), readOnly ? O_RDONLY | O_CLOEXEC : O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    }
+    if (lockFd >= 0) {
+        int rc, mode = readOnly ? LOCK_SH : LOCK_EX;
+        while ((rc = flock(lockFd, wait ? mode : mode | LOCK_NB)) != 0 && errno == EINTR) {
+        }
+        busy = rc != 0 && !wait;
+    }
+#endif
+    if (busy) {
+        storeMutex.unlock();
+        return false;
+    }
+    storeDepth = 1;
+    return true;
+}
+
+void Journal::unlockStore() {
+    if (--storeDepth == 0) {
+#ifdef _WIN32
+        if (lockHandle) {
+            OVERLAPPED region = {};
+            UnlockFileEx(static_cast<HANDLE>(lockHandle), 0, 1, 0, &region);
+        }
+#else
+        if (lockFd >= 0) {
+            flock(lockFd, LOCK_UN);
+        }
+#endif
+    }
+    storeMutex.unlock();
+}
+
+void Journal::closeStoreLock() {
+#ifdef _WIN32
+    if (lockHandle) {
+        CloseHandle(static_cast<HANDLE>(lockHandle));
+        lockHandle = nullptr;
+    }
+#else
+    if (lockFd >= 0) {
+        close(lockFd);
+        lockFd = -1;
+    }
+#endif
+}
+
+// The first 8 bytes of the lock file, little-endian; 0 when it is empty.
+uint64_t Journal::storeGeneration() {
+    unsigned char bytes[8] = {};
+#ifdef _WIN32
+    OVERLAPPED at = {};
+    DWORD read = 0;
+    if (!lockHandle || !ReadFile(static_cast<HANDLE>(lockHandle), bytes, sizeof(bytes), &read, &at) ||
+        read != sizeof(bytes)) {
+        return 0;
+    }
+#else
+    if (lockFd < 0 || pread(lockFd, bytes, sizeof(bytes), 0) != static_cast<ssize_t>(sizeof(bytes))) {
+        return 0;
+    }
+#endif
+    uint64_t value = 0;
+    for (int i = 7; i >= 0; --i) {
+        value = (value << 8) | bytes[i];
+    }
+    return value;
+}
+
+void Journal::setStoreGeneration(uint64_t value) {
+    unsigned char bytes[8];
+    for (int i = 0; i < 8; ++i) {
+        bytes[i] = static_cast<unsigned char>(value >> (8 * i));
+    }
+#ifdef _WIN32
+    OVERLAPPED at = {};
+    DWORD written;
+    if (lockHandle) {
+        WriteFile(static_cast<HANDLE>(lockHandle), bytes, sizeof(bytes), &written, &at);
+    }
+#else
+    if (lockFd >= 0 && pwrite(lockFd, bytes, sizeof(bytes), 0) != static_cast<ssize_t>(sizeof(bytes))) {
+        // Others then miss the compaction until their next full load.
+    }
+#endif
+}
+
+void Journal::stopFollowing() {
+    if (followedFile) {
+        std::fclose(followedFile);
+        followedFile = nullptr;
+    }
+    followedOffset = 0;
+    followedLines = 0;
+}
+
+bool Journal::readJournal(ParsedHistory& parsed) {
+    stopFollowing();
+    caughtUp.clear();
+    unreadOwn.clear();
+    missedRecords = false;
+    following = true;
+    followedGeneration = storeGeneration();
+    readFollowed(parsed, true);
+    return followedFile && (followedOffset > 0 || parsed.tornTail);
+}
+
+// Appends the complete lines past followedOffset to parsed. With open, a
+// journal not open yet is opened, and created if missing, so that records
+// appended to it are never lost to a compaction this instance did not see.
+void Journal::readFollowed(ParsedHistory& parsed, bool open) {
+    if (!followedFile && open) {
+        if (!readOnly && !fileExists(journalPath)) {
+            if (FILE* created = openJournalFile(journalPath, true)) {
+                std::fclose(created);
+            }
+        }
+        followedFile = openJournalFile(journalPath, false);
+    }
+    if (!followedFile || std::fseek(followedFile, static_cast<long>(followedOffset), SEEK_SET) != 0) {
+        return;
+    }
+    std::string data;
+    char buffer[16384];
+    size_t n;
+    while ((n = std::fread(buffer, 1, sizeof(buffer), followedFile)) > 0) {
+        data.append(buffer, n);
+    }
+    std::clearerr(followedFile);
+    size_t end = data.rfind('\n');
+    if (end == std::string::npos) {
+        parsed.tornTail = parsed.tornTail || !data.empty();
+        return;
+    }
+    ParsedHistory delta;
+    parseTextHistory(data.data(), end + 1, delta, true, 1,
+                     checksummedStore ? ChecksumMode::Required : ChecksumMode::Optional);
+    for (auto& error : delta.errors) {
+        error.line += followedLines;
+    }
+    followedOffset += end + 1;
+    followedLines += delta.lines;
+    if (delta.haveConfig) {
+        parsed.haveConfig = true;
+        parsed.config = delta.config;
+    }
+    parsed.days.insert(parsed.days.end(), delta.days.begin(), delta.days.end());
+    parsed.errors.insert(parsed.errors.end(), delta.errors.begin(), delta.errors.end());
+    parsed.lines += delta.lines;
+    parsed.tornTail = end + 1 < data.size();
+}
+
+void Journal::catchUp() {
+    if (!following) {
+        return;
+    }
+    ParsedHistory parsed;
+    uint64_t generation = storeGeneration();
+    if (generation != followedGeneration) {
+        if (generation == followedGeneration + 1) {
+            readFollowed(parsed, false); // the rest of the journal that was compacted
+        } else {
+            missedRecords = true;
+        }
+        stopFollowing();
+        followedGeneration = generation;
+    } else if (followedFile && !sameFile(followedFile, journalPath)) {
+        // Replaced or removed without a compaction (a copy, a sync tool):
+        // what changed cannot be told.
+        missedRecords = true;
+        stopFollowing();
+    }
+    readFollowed(parsed, true);
+    collectErrors(journalPath, parsed);
+    for (const auto& day : parsed.days) {
+        if (!unreadOwn.erase(startSecond(day))) {
+            caughtUp.push_back(day);
+            ++journalRecords;
+        }
+    }
+}
+
+bool Journal::readNewRecords(std::vector<WorkDay>& records, bool& reloadNeeded) {
+    records.clear();
+    reloadNeeded = false;
+    StoreLock lock(*this, false);
+    if (!lock.owns()) {
+        return false;
+    }
+    catchUp();
+    records.swap(caughtUp);
+    reloadNeeded = missedRecords;
+    missedRecords = false;
+    return true;
+}
+
+std::shared_ptr<const HistoryArchive> Journal::archive() {
+    std::lock_guard<std::mutex> guard(snapshotMutex);
+    std::shared_ptr<const HistoryArchive> sealed;
+    loadArchive(sealed);
+    return sealed;
+}
+
+// Read once and kept: the archive only changes through sealArchive().
+bool Journal::loadArchive(std::shared_ptr<const HistoryArchive>& out) {
+    if (format != SnapshotFormat::Binary) {
+        out.reset();
+        return true;
+    }
+    if (!archiveLoaded) {
+        auto loaded = std::make_shared<HistoryArchive>();
+        if (loaded->load(archivePath)) {
+            cachedArchive = loaded;
+            if (!loaded->quarantined().empty()) {
+                quarantine(archivePath, loaded->quarantined());
+            }
+        } else if (fileExists(archivePath)) {
+            return false;
+        }
+        archiveLoaded = true;
+    }
+    out = cachedArchive;
+    return true;
+}
+
+// Splits history at the seal point, rewriting the archive if that adds
+// sealed sessions: a year that just closed, or a late import. history need
+// not hold what is sealed already; the archive is decoded only when there is
+// something before the seal point to fold in.
+bool Journal::sealArchive(const std::vector<WorkDay>& history, std::vector<WorkDay>& hot) {
+    std::shared_ptr<const HistoryArchive> sealed;
+    {
+        std::lock_guard<std::mutex> guard(snapshotMutex);
+        if (!loadArchive(sealed)) {
+            return false; // never write over an archive we could not read
+        }
+    }
+    int64_t sealEnd = std::max(sealCutoff, sealed ? sealed->endDay() : INT64_MIN);
+    std::vector<WorkDay> old;
+    for (const auto& day : history) {
+        (day.dayKey() < sealEnd ? old : hot).push_back(day);
+    }
+    if (old.empty()) {
+        return true;
+    }
+    if (sealed) {
+        // Sessions are never removed, so an unchanged count means nothing new.
+        std::vector<WorkDay> archived;
+        sealed->decodeRange(INT64_MIN, INT64_MAX, archived);
+        mergeSessions(archived, old);
+        old.swap(archived);
+    }
+    if (old.size() == (sealed ? sealed->sessionCount() : 0)) {
+        return true;
+    }
+
+    // The archive is replaced before history.bin; readers skip the copies
+    // history.bin still holds if we stop in between.
+    std::string tmpPath = archivePath + ".tmp";
+    auto next = std::make_shared<HistoryArchive>();
+    bool ok = HistoryArchive::write(tmpPath, old, sealEnd) && next->load(tmpPath);
+    std::lock_guard<std::mutex> guard(snapshotMutex);
+    if (!ok || !atomicReplace(tmpPath, archivePath)) {
+        std::remove(tmpPath.c_str());
+        return false;
+    }
+    cachedArchive = next;
+    return true;
+}
+
+void Journal::collectErrors(const std::string& path, const ParsedHistory& parsed) {
+    std::vector<QuarantinedRecord> skipped;
+    for (const auto& e : parsed.errors) {
+        skipped.push_back({ std::to_string(e.line), e.message, e.record });
+    }
+    if (!skipped.empty()) {
+        quarantine(path, skipped);
+    }
+}
+
+std::vector<std::string> Journal::loadErrors() const {
+    std::lock_guard<std::mutex> guard(errorsMutex);
+    return errors;
+}
+
+// Loads repeat until a compaction drops the records, so entries already in
+// the file are not written again.
+void Journal::quarantine(const std::string& path, const std::vector<QuarantinedRecord>& records) {
+    std::lock_guard<std::mutex> guard(errorsMutex);
+    std::string existing;
+    if (FILE* file = std::fopen(quarantinePath.c_str(), "rb")) {
+        char buffer[4096];
+        size_t n;
+        while ((n = std::fread(buffer, 1, sizeof(buffer), file)) > 0) {
+            existing.append(buffer, n);
+        }
+        std::fclose(file);
+    }
+    std::string added;
+    for (const auto& record : records) {
+        std::string error = path + ":" + record.where + ": " + record.reason;
+        if (std::find(errors.begin(), errors.end(), error) == errors.end()) {
+            errors.push_back(error);
+        }
+        std::string entry = "# " + error + "\n" + record.stored + "\n";
+        if (existing.find(entry) == std::string::npos && added.find(entry) == std::string::npos) {
+            added += entry;
+        }
+    }
+    if (added.empty() || readOnly) {
+        return;
+    }
+    FILE* file = std::fopen(quarantinePath.c_str(), "ab");
+    if (file) {
+        std::fwrite(added.data(), 1, added.size(), file);
+        syncFile(file);
+        std::fclose(file);
+    }
+}
+
+bool Journal::openJournalForAppend() {
+    if (journalFile) {
+        return true;
+    }
+    journalFile = openJournalFile(journalPath, true);
+    return journalFile != nullptr;
+}
+
+void Journal::closeJournal() {
+    if (journalFile) {
+        std::fclose(journalFile);
+        journalFile = nullptr;
+    }
+}
+
+bool Journal::append(const WorkDay& day) {
+    return append(std::vector<WorkDay>(1, day));
+}
+
+bool Journal::append(const std::vector<WorkDay>& days) {
+    if (readOnly) {
+        return false;
+    }
+    StoreLock lock(*this);
+    // Another instance compacted since: our handle is on the old journal.
+    uint64_t generation = storeGeneration();
+    if (journalFile && journalFileGeneration != generation) {
+        closeJournal();
+    }
+    if (!openJournalForAppend()) {
+        return false;
+    }
+    journalFileGeneration = generation;
+    std::fseek(journalFile, 0, SEEK_END);
+    long before = std::ftell(journalFile);
+    // A write that fails part way would leave a partial line for the next
+    // append to run on into: cut the journal back to where this one began.
+    // The handle is closed first, as whatever it still buffers may be
+    // written when it is.
+    auto rollBack = [&]() {
+        closeJournal();
+        if (before >= 0) {
+            truncateFile(journalPath, before);
+        }
+        return false;
+    };
+    size_t bytes = 0;
+    for (const auto& day : days) {
+        std::string record = formatWorkDayRecord(day);
+        if (std::fwrite(record.data(), 1, record.size(), journalFile) != record.size()) {
+            return rollBack();
+        }
+        bytes += record.size();
+    }
+    if (!syncFile(journalFile)) {
+        return rollBack();
+    }
+    journalRecords += days.size();
+    // Nothing from other instances in between, so there is no need to read
+    // these back.
+    if (following && followedFile && followedGeneration == generation && before >= 0 &&
+        static_cast<uint64_t>(before) == followedOffset) {
+        followedOffset += bytes;
+        followedLines += days.size();
+    } else if (following) {
+        for (const auto& day : days) {
+            unreadOwn.insert(startSecond(day));
+        }
+    }
+    return true;
+}
+
+bool Journal::compact(const Config& config, const std::vector<WorkDay>& sessions) {
+    if (readOnly) {
+        return false;
+    }
+    StoreLock lock(*this);
+    // Fold in what other instances appended since we last read the journal.
+    catchUp();
+    std::vector<WorkDay> merged;
+    if (format == SnapshotFormat::Binary) {
+        // The hot part of history.bin, read back from the mapped file; that
+        // also covers a compaction by another instance we did not see.
+        std::shared_ptr<const HistoryArchive> sealed = archive();
+        // A session's local day is within 14 hours of its UTC start.
+        const int64_t kMaxOffsetMs = 14 * 3600000LL;
+        int64_t sealedEnd = sealed ? sealed->endDay() : INT64_MIN;
+        Config stored;
+        int64_t head;
+        if (!loadSnapshotRange(sealed ? sealedEnd * 86400000LL - kMaxOffsetMs : INT64_MIN, INT64_MAX, stored,
+                               merged, head) &&
+            (fileExists(snapshotPath) || fileExists(archivePath))) {
+            return false; // never write over a store we could not read
+        }
+        merged.erase(std::remove_if(merged.begin(), merged.end(),
+                                    [sealedEnd](const WorkDay& day) { return day.dayKey() < sealedEnd; }),
+                     merged.end());
+        mergeSessions(merged, sessions);
+        mergeSessions(merged, caughtUp);
+    } else if (!caughtUp.empty() || missedRecords) {
+        merged = sessions;
+        if (missedRecords) {
+            // Compacted more than once since: sessions may lack some that are
+            // only in the snapshot now. catchUp() read the whole journal.
+            ParsedHistory parsed;
+            if (parseTextHistoryFile(snapshotPath, parsed)) {
+                mergeSessions(merged, std::vector<WorkDay>(parsed.days.rbegin(), parsed.days.rend()));
+            }
+        }
+        mergeSessions(merged, caughtUp);
+    }
+    const std::vector<WorkDay>& history = format == SnapshotFormat::Binary || !merged.empty() ? merged : sessions;
+
+    std::vector<WorkDay> hot;
+    if (format == SnapshotFormat::Binary && !sealArchive(history, hot)) {
+        return false;
+    }
+    std::string tmpPath = snapshotPath + ".tmp";
+    bool ok = format == SnapshotFormat::Binary ? writeBinaryHistory(tmpPath, config, hot)
+                                               : writeTextHistory(tmpPath, config, history);
+    {
+        std::lock_guard<std::mutex> guard(snapshotMutex);
+        ok = ok && atomicReplace(tmpPath, snapshotPath);
+    }
+    if (!ok) {
+        std::remove(tmpPath.c_str());
+        return false;
+    }
+
+    // The snapshot now holds every journaled record. The generation moves
+    // first: if we stop before the journal is gone, others read it again
+    // and drop what they already have.
+    closeJournal();
+    uint64_t generation = storeGeneration() + 1;
+    setStoreGeneration(generation);
+#ifdef _WIN32
+    // Other instances hold the journal open; moving it aside frees the name
+    // for the next one at once, and it is deleted when they let go.
+    std::string aside = journalPath + "." + std::to_string(generation) + ".old";
+    if (MoveFileExA(journalPath.c_str(), aside.c_str(), MOVEFILE_REPLACE_EXISTING)) {
+        DeleteFileA(aside.c_str());
+    } else {
+        DeleteFileA(journalPath.c_str());
+    }
+#else
+    std::remove(journalPath.c_str());
+#endif
+    journalRecords = 0;
+    checksummedStore = true;
+    unreadOwn.clear();
+    stopFollowing();
+    following = true;
+    followedGeneration = generation;
+    ParsedHistory none;
+    readFollowed(none, true);
+    return true;
+}
+
+bool writeTextHistory(const std::string& path, const Config& config, const std::vector<WorkDay>& history) {
+    FILE* file = std::fopen(path.c_str(), "wb");
+    if (!file) {
+        return false;
+    }
+    // Written with one call, as history.bin is (see writeBinaryHistory).
+    std::string bytes = formatConfigRecord(config);
+    bytes.reserve(bytes.size() + history.size() * 128);
+    for (auto it = history.rbegin(); it != history.rend(); ++it) {
+        bytes += formatWorkDayRecord(*it);
+    }
+    bool ok = std::fwrite(bytes.data(), 1, bytes.size(), file) == bytes.size();
+    ok = ok && syncFile(file);
+    ok = (std::fclose(file) == 0) && ok;
+    return ok;
+}
+
+bool syncFile(FILE* file) {
+    if (std::fflush(file) != 0) {
+        return false;
+    }
+#ifdef _WIN32
+    return _commit(_fileno(file)) == 0;
+#else
+    return fsync(fileno(file)) == 0;
+#endif
+}
+
+bool atomicReplace(const std::string& from, const std::string& to) {
+#ifdef _WIN32
+    return MoveFileExA(from.c_str(), to.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+    if (std::rename(from.c_str(), to.c_str()) != 0) {
+        return false;
+    }
+    // Persist the directory entry as well.
+    std::string dir = ".";
+    size_t slash = to.find_last_of('/');
+    if (slash != std::string::npos) {
+        dir = to.substr(0, slash);
+    }
+    int fd = ::open(dir.c_str(), O_RDONLY);
+    if (fd >= 0) {
+        fsync(fd);
+        close(fd);
+    }
+    return true;
+#endif
+}
@@ -0,0 +1,241 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "workday.h"
+
+class HistoryArchive;
+struct ParsedHistory;
+
+// --- Journaled Persistence ---
+//
+// The store is a snapshot file plus an append-only text journal next to it.
+// The snapshot is either the historical data.txt format (one config line
+// followed by workday records, newest first) or history.bin (see
+// binary_history.h). Each punch appends a single record to the journal and
+// flushes it to disk, so punch latency does not depend on the size of the
+// history.
+// Compaction folds the journal into a fresh snapshot written to a temporary
+// file and atomically renamed over the old one.
+//
+// With history.bin, closed years are sealed into <snapshot>.archive (see
+// archive.h) when a compaction finds sessions older than the seal cutoff.
+// Snapshot reads merge both files, so callers see one history.
+//
+// Every record carries a CRC32C (see crc32c.h). Records that fail it, or
+// do not parse, are left out of the history and copied as stored to
+// <snapshot>.quarantine; the rest of the file loads normally. The next
+// compaction drops them from the store, so the quarantine file is then the
+// only copy.
+//
+// Several instances may share a store (two windows, or a data directory
+// synced between machines). Appends and compactions hold an exclusive lock
+// on <snapshot>.lock, which also holds the journal generation: compaction
+// folds the journal into the snapshot, bumps the generation and removes the
+// journal, and the next append starts a new one. Each instance keeps the
+// journal it last read open at the offset it reached, so after another
+// instance's compaction it still reads the rest of the old journal and then
+// the new one from the start: readNewRecords() costs what was appended, not
+// the size of the store. Every session reaches the snapshot through a
+// journal, so this sees them all.
+//
+// A store opened read-only (a report over other people's stores) creates
+// no file: not the journal, the lock file nor the quarantine file. Its
+// loads take a shared lock on <snapshot>.lock when the file exists, so they
+// wait out a compaction without holding up other readers.
+//
+// Merge rules: a session is identified by its start second and never
+// changes once recorded, so instances only ever add to a common set and the
+// order they see additions in does not matter. When two records share a
+// start second the copy already known wins: the snapshot over the journal,
+// an earlier journal line over a later one.
+
+enum class SnapshotFormat { Text, Binary };
+
+enum class StoreAccess { ReadWrite, ReadOnly };
+
+// A stored record that was left out of the history.
+struct QuarantinedRecord {
+    std::string where;      // within its file: "42" (line), "record 17", "2003-04"
+    std::string reason;
+    std::string stored;     // the text line, or the bytes in hex
+};
+
+class Journal {
+public:
+    // Compact once this many records have accumulated in the journal.
+    static const size_t kCompactThreshold = 1024;
+
+    Journal() = default;
+    ~Journal();
+    Journal(const Journal&) = delete;
+    Journal& operator=(const Journal&) = delete;
+
+    // ReadOnly: loads only; append() and compact() fail.
+    void open(const std::string& snapshotPath, SnapshotFormat format, StoreAccess access = StoreAccess::ReadWrite);
+    // history.bin only: compactions move sessions before this day key into
+    // the archive. Sealed sessions stay sealed if the cutoff moves back.
+    void setSealCutoff(int64_t dayKey) { sealCutoff = dayKey; }
+
+    // Replays the snapshot then the journal tail into history, oldest session
+    // first, and starts following the journal from where it ends. Returns
+    // false when neither file exists (or the journal is empty). A torn final
+    // journal line (crash mid-append) is ignored; other malformed or corrupt
+    // records are quarantined and listed in loadErrors().
+    bool load(Config& config, std::vector<WorkDay>& history);
+    // history.bin only: the snapshot sessions that start in [fromMs, toMs),
+    // found by binary search in the mapped file and by decoding the archive
+    // months they fall in, and the start of the snapshot's newest session
+    // (INT64_MIN if empty). Returns false when there is no binary snapshot
+    // or the archive is unreadable. Safe to call while the writer compacts.
+    bool loadSnapshotRange(int64_t fromMs, int64_t toMs, Config& config, std::vector<WorkDay>& sessions,
+                           int64_t& snapshotHead);
+    // history.bin only: the starts of the oldest and newest intact sessions
+    // in the snapshot and archive. False when both are empty or missing.
+    bool snapshotStarts(int64_t& firstMs, int64_t& lastMs);
+    // The journal records that are not in the snapshot, whose newest session
+    // starts at snapshotHead, and starts following the journal from where it
+    // ends. Returns false when there is no journal or it is empty.
+    bool loadJournal(int64_t snapshotHead, Config& config, std::vector<WorkDay>& tail);
+    std::vector<std::string> loadErrors() const;
+    // The sealed years, or null when there are none. Immutable; a compaction
+    // that seals more installs a new one.
+    std::shared_ptr<const HistoryArchive> archive();
+
+    // Appends one record and flushes it durably.
+    bool append(const WorkDay& day);
+    // Appends several records with a single flush to disk.
+    bool append(const std::vector<WorkDay>& days);
+
+    // Writes config + history (oldest first) to <snapshot>.tmp, syncs it,
+    // renames it over the snapshot and truncates the journal. Sealed
+    // sessions go to the archive instead, which is only rewritten when that
+    // set has changed. Records other instances appended since the last read
+    // are written as well, and handed out by the next readNewRecords().
+    // For history.bin, history need only hold the sessions not yet in the
+    // snapshot: the rest are read back from the mapped file, and the archive
+    // is decoded only when there is more to seal. A text snapshot is
+    // rewritten from history alone.
+    bool compact(const Config& config, const std::vector<WorkDay>& history);
+
+    // The records other instances appended to the journal since load() or
+    // loadJournal() or the last call, in append order. reloadNeeded is set
+    // when the journal was compacted more than once since the last read, so
+    // records were missed and the caller must load the store again. Returns
+    // false without waiting when another thread or instance holds the store
+    // lock.
+    bool readNewRecords(std::vector<WorkDay>& records, bool& reloadNeeded);
+
+    size_t pendingRecords() const { return journalRecords; }
+    bool needsCompaction() const { return journalRecords >= kCompactThreshold; }
+
+private:
+    // Recursive within the process; the file lock is taken on the way in
+    // and dropped on the way out.
+    class StoreLock {
+    public:
+        explicit StoreLock(Journal& journal, bool wait = true) : journal(journal), held(journal.lockStore(wait)) {}
+        ~StoreLock() {
+            if (held) {
+                journal.unlockStore();
+            }
+        }
+        bool owns() const { return held; }
+
+    private:
+        Journal& journal;
+        bool held;
+    };
+
+    bool loadJournal(int64_t snapshotHead, const std::vector<WorkDay>* snapshot, Config& config,
+                     std::vector<WorkDay>& tail);
+    bool lockStore(bool wait);
+    void unlockStore();
+    void closeStoreLock();
+    uint64_t storeGeneration();
+    void setStoreGeneration(uint64_t value);
+    // Under the store lock: reads the whole current journal and follows it.
+    bool readJournal(ParsedHistory& parsed);
+    // Under the store lock: appends what was written since the last read to
+    // caughtUp, following a compaction if there was one.
+    void catchUp();
+    void readFollowed(ParsedHistory& parsed, bool open);
+    void stopFollowing();
+    // Drops records with the same start second as a snapshot session or an
+    // earlier record. snapshot is sorted; null reads the snapshot instead.
+    void dropKnown(std::vector<WorkDay>& records, int64_t snapshotHead, const std::vector<WorkDay>* snapshot);
+
+    bool openJournalForAppend();
+    void closeJournal();
+    void collectErrors(const std::string& path, const ParsedHistory& parsed);
+    // Lists the records in loadErrors() and appends the ones not already
+    // there to the quarantine file.
+    void quarantine(const std::string& path, const std::vector<QuarantinedRecord>& records);
+    // Caller holds snapshotMutex. False if the archive exists but is invalid.
+    bool loadArchive(std::shared_ptr<const HistoryArchive>& out);
+    bool sealArchive(const std::vector<WorkDay>& history, std::vector<WorkDay>& hot);
+
+    std::string snapshotPath;
+    std::string journalPath;
+    std::string archivePath;
+    std::string quarantinePath;
+    int64_t sealCutoff = INT64_MIN;
+    std::shared_ptr<const HistoryArchive> cachedArchive;
+    bool archiveLoaded = false;
+    SnapshotFormat format = SnapshotFormat::Text;
+    bool readOnly = false;
+    // Whether journal records must carry a checksum: false only next to a
+    // snapshot written before checksums existed, whose journal may be as old.
+    std::atomic<bool> checksummedStore{ true };
+    FILE* journalFile = nullptr;
+    uint64_t journalFileGeneration = 0;
+    size_t journalRecords = 0;
+
+    // Sharing the store (see above). storeMutex also guards the fields after it.
+    std::string lockPath;
+    std::recursive_mutex storeMutex;
+    int storeDepth = 0;
+#ifdef _WIN32
+    void* lockHandle = nullptr;
+#else
+    int lockFd = -1;
+#endif
+    bool following = false;         // false until loaded
+    uint64_t followedGeneration = 0;
+    FILE* followedFile = nullptr;   // the journal of that generation, kept open
+    uint64_t followedOffset = 0;    // bytes of it already read
+    size_t followedLines = 0;
+    bool missedRecords = false;
+    std::vector<WorkDay> caughtUp;  // read by compact(), not yet handed out
+    // Start seconds of our appends that follow another instance's records,
+    // so catchUp() reads them back; it drops them instead.
+    std::unordered_set<int64_t> unreadOwn;
+
+    // The loader thread and the UI both read the snapshot.
+    mutable std::mutex errorsMutex;
+    std::vector<std::string> errors;
+    // Held while the snapshot is mapped or replaced; Windows cannot rename
+    // over a mapped file.
+    std::mutex snapshotMutex;
+};
+
+// Record helpers shared by the snapshot and the journal. Each line ends in a
+// field holding the CRC32C of the text before it, as 8 hex digits.
+std::string formatWorkDayRecord(const WorkDay& day);
+std::string formatConfigRecord(const Config& config);
+
+// Writes a complete data.txt-style file (newest first on disk) from a
+// chronological history.
+bool writeTextHistory(const std::string& path, const Config& config, const std::vector<WorkDay>& history);
+
+// Flushes stdio buffers and asks the OS to commit the file to disk.
+bool syncFile(FILE* file);
+// Replaces 'to' with 'from' in a single step.
+bool atomicReplace(const std::string& from, const std::string& to);
@@ -0,0 +1,418 @@
+#include "json_sax.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+JsonSaxParser::JsonSaxParser(JsonSaxHandler& handler) : handler(handler) {
+    stack.reserve(kMaxDepth);
+}
+
+bool JsonSaxParser::fail(const char* what) {
+    if (state != State::Failed) {
+        message = what;
+        state = State::Failed;
+    }
+    return false;
+}
+
+static bool isSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+static int hexValue(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+// -?(0|[1-9][0-9]*)(\.[0-9]+)?([eE][+-]?[0-9]+)?
+static bool isJsonNumber(const char* p, size_t n) {
+    size_t i = 0;
+    auto digits = [&]() {
+        size_t start = i;
+        while (i < n && p[i] >= '0' && p[i] <= '9') ++i;
+        return i > start;
+    };
+    if (i < n && p[i] == '-') ++i;
+    if (i < n && p[i] == '0') {
+        ++i;
+    } else if (!digits()) {
+        return false;
+    }
+    if (i < n && p[i] == '.') {
+        ++i;
+        if (!digits()) return false;
+    }
+    if (i < n && (p[i] == 'e' || p[i] == 'E')) {
+        ++i;
+        if (i < n && (p[i] == '+' || p[i] == '-')) ++i;
+        if (!digits()) return false;
+    }
+    return i == n;
+}
+
+bool JsonSaxParser::endValue() {
+    state = stack.empty() ? State::Done : State::AfterValue;
+    return true;
+}
+
+bool JsonSaxParser::beginValue(char c) {
+    switch (c) {
+        case '{':
+        case '[':
+            if (stack.size() == kMaxDepth) {
+                return fail("nesting too deep");
+            }
+            stack.push_back(c);
+            if (c == '{') {
+                state = State::FirstKey;
+                return handler.startObject() || fail("rejected by handler");
+            }
+            state = State::FirstElement;
+            return handler.startArray() || fail("rejected by handler");
+        case '"':
+            state = State::String;
+            stringIsKey = false;
+            partSize = 0;
+            return true;
+        case 't':
+        case 'f':
+        case 'n':
+            state = State::Literal;
+            token[0] = c;
+            tokenSize = 1;
+            return true;
+        default:
+            if (c == '-' || (c >= '0' && c <= '9')) {
+                state = State::Number;
+                token[0] = c;
+                tokenSize = 1;
+                return true;
+            }
+            return fail("unexpected character");
+    }
+}
+
+bool JsonSaxParser::closeContainer(char c) {
+    char open = c == '}' ? '{' : '[';
+    if (stack.empty() || stack.back() != open) {
+        return fail("mismatched bracket");
+    }
+    stack.pop_back();
+    bool ok = c == '}' ? handler.endObject() : handler.endArray();
+    return (ok || fail("rejected by handler")) && endValue();
+}
+
+bool JsonSaxParser::flushString(bool last) {
+    std::string_view view(part, partSize);
+    partSize = 0;
+    return handler.stringPart(view, last) || fail("rejected by handler");
+}
+
+bool JsonSaxParser::appendStringByte(char c) {
+    if (stringIsKey) {
+        if (key.size() < kMaxKeyBytes) {
+            key.push_back(c);
+        }
+        return true;
+    }
+    if (partSize == sizeof(part) && !flushString(false)) {
+        return false;
+    }
+    part[partSize++] = c;
+    return true;
+}
+
+bool JsonSaxParser::appendCodePoint(uint32_t cp) {
+    char utf8[4];
+    size_t n;
+    if (cp < 0x80) {
+        utf8[0] = static_cast<char>(cp);
+        n = 1;
+    } else if (cp < 0x800) {
+        utf8[0] = static_cast<char>(0xC0 | (cp >> 6));
+        utf8[1] = static_cast<char>(0x80 | (cp & 0x3F));
+        n = 2;
+    } else if (cp < 0x10000) {
+        utf8[0] = static_cast<char>(0xE0 | (cp >> 12));
+        utf8[1] = static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+        utf8[2] = static_cast<char>(0x80 | (cp & 0x3F));
+        n = 3;
+    } else {
+        utf8[0] = static_cast<char>(0xF0 | (cp >> 18));
+        utf8[1] = static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+        utf8[2] = static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+        utf8[3] = static_cast<char>(0x80 | (cp & 0x3F));
+        n = 4;
+    }
+    for (size_t i = 0; i < n; ++i) {
+        if (!appendStringByte(utf8[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool JsonSaxParser::finishNumber() {
+    if (!isJsonNumber(token, tokenSize)) {
+        return fail("malformed number");
+    }
+    return (handler.number(std::string_view(token, tokenSize)) || fail("rejected by handler")) && endValue();
+}
+
+bool JsonSaxParser::finishLiteral() {
+    std::string_view text(token, tokenSize);
+    JsonLiteral value;
+    if (text == "true") {
+        value = JsonLiteral::True;
+    } else if (text == "false") {
+        value = JsonLiteral::False;
+    } else if (text == "null") {
+        value = JsonLiteral::Null;
+    } else {
+        return fail("unknown literal");
+    }
+    return (handler.literal(value) || fail("rejected by handler")) && endValue();
+}
+
+bool JsonSaxParser::feed(const char* data, size_t size) {
+    const char* p = data;
+    const char* end = data + size;
+    consumed += size;
+    while (p < end) {
+        if (state == State::Failed) {
+            return false;
+        }
+        char c = *p;
+
+        if (state == State::String) {
+            // Copy the plain run up to the next quote, escape or control byte.
+            const char* run = p;
+            while (p < end && *p != '"' && *p != '\\' && static_cast<unsigned char>(*p) >= 0x20) {
+                ++p;
+            }
+            if (p > run && highSurrogate != 0) {
+                highSurrogate = 0;
+                if (!appendCodePoint(0xFFFD)) return false;
+            }
+            if (stringIsKey) {
+                size_t room = kMaxKeyBytes - key.size();
+                key.append(run, std::min(room, static_cast<size_t>(p - run)));
+            } else {
+                while (run < p) {
+                    if (partSize == sizeof(part) && !flushString(false)) {
+                        return false;
+                    }
+                    size_t n = std::min(sizeof(part) - partSize, static_cast<size_t>(p - run));
+                    std::memcpy(part + partSize, run, n);
+                    partSize += n;
+                    run += n;
+                }
+            }
+            if (p == end) {
+                break;
+            }
+            c = *p;
+            if (c == '\\') {
+                state = State::Escape;
+            } else if (c == '"') {
+                if (highSurrogate != 0) {
+                    highSurrogate = 0;
+                    if (!appendCodePoint(0xFFFD)) return false;
+                }
+                if (stringIsKey) {
+                    if (!handler.key(key)) {
+                        return fail("rejected by handler");
+                    }
+                    state = State::Colon;
+                } else if (!flushString(true) || !endValue()) {
+                    return false;
+                }
+            } else {
+                return fail("control character in string");
+            }
+            ++p;
+            continue;
+        }
+
+        switch (state) {
+            case State::Escape: {
+                char out = 0;
+                switch (c) {
+                    case '"': out = '"'; break;
+                    case '\\': out = '\\'; break;
+                    case '/': out = '/'; break;
+                    case 'b': out = '\b'; break;
+                    case 'f': out = '\f'; break;
+                    case 'n': out = '\n'; break;
+                    case 'r': out = '\r'; break;
+                    case 't': out = '\t'; break;
+                    case 'u':
+                        unicode = 0;
+                        unicodeDigits = 0;
+                        state = State::Unicode;
+                        break;
+                    default:
+                        return fail("bad escape");
+                }
+                if (state == State::Escape) {
+                    if (highSurrogate != 0) {
+                        highSurrogate = 0;
+                        if (!appendCodePoint(0xFFFD)) return false;
+                    }
+                    if (!appendStringByte(out)) return false;
+                    state = State::String;
+                }
+                break;
+            }
+            case State::Unicode: {
+                int v = hexValue(c);
+                if (v < 0) {
+                    return fail("bad \\u escape");
+                }
+                unicode = (unicode << 4) | static_cast<uint32_t>(v);
+                if (++unicodeDigits == 4) {
+                    state = State::String;
+                    if (unicode >= 0xDC00 && unicode <= 0xDFFF && highSurrogate != 0) {
+                        uint32_t cp = 0x10000 + ((highSurrogate - 0xD800) << 10) + (unicode - 0xDC00);
+                        highSurrogate = 0;
+                        if (!appendCodePoint(cp)) return false;
+                    } else {
+                        if (highSurrogate != 0) {
+                            highSurrogate = 0;
+                            if (!appendCodePoint(0xFFFD)) return false;
+                        }
+                        if (unicode >= 0xD800 && unicode <= 0xDBFF) {
+                            highSurrogate = unicode;
+                        } else if (!appendCodePoint(unicode >= 0xDC00 && unicode <= 0xDFFF ? 0xFFFD : unicode)) {
+                            return false;
+                        }
+                    }
+                }
+                break;
+            }
+            case State::Number:
+                if ((c >= '0' && c <= '9') || c == '-' || c == '+' || c == '.' || c == 'e' || c == 'E') {
+                    if (tokenSize == sizeof(token)) {
+                        return fail("number too long");
+                    }
+                    token[tokenSize++] = c;
+                    break;
+                }
+                if (!finishNumber()) return false;
+                continue;   // c belongs to whatever follows the number
+            case State::Literal:
+                if (c >= 'a' && c <= 'z') {
+                    if (tokenSize == sizeof(token)) {
+                        return fail("unknown literal");
+                    }
+                    token[tokenSize++] = c;
+                    break;
+                }
+                if (!finishLiteral()) return false;
+                continue;
+            default:
+                if (isSpace(c)) {
+                    if (c == '\n') {
+                        lineNumber++;
+                    }
+                    break;
+                }
+                switch (state) {
+                    case State::Value:
+                        if (!beginValue(c)) return false;
+                        break;
+                    case State::FirstElement:
+                        if (c == ']') {
+                            if (!closeContainer(c)) return false;
+                        } else if (!beginValue(c)) {
+                            return false;
+                        }
+                        break;
+                    case State::FirstKey:
+                    case State::Key:
+                        if (c == '}' && state == State::FirstKey) {
+                            if (!closeContainer(c)) return false;
+                        } else if (c == '"') {
+                            state = State::String;
+                            stringIsKey = true;
+                            key.clear();
+                        } else {
+                            return fail("expected a key");
+                        }
+                        break;
+                    case State::Colon:
+                        if (c != ':') return fail("expected ':'");
+                        state = State::Value;
+                        break;
+                    case State::AfterValue:
+                        if (c == ',') {
+                            state = stack.back() == '{' ? State::Key : State::Value;
+                        } else if (c == '}' || c == ']') {
+                            if (!closeContainer(c)) return false;
+                        } else {
+                            return fail("expected ',' or a closing bracket");
+                        }
+                        break;
+                    case State::Done:
+                        return fail("trailing data after the document");
+                    default:
+                        return fail("internal parser error");
+                }
+                break;
+        }
+        ++p;
+    }
+    return state != State::Failed;
+}
+
+bool JsonSaxParser::finish() {
+    if (state == State::Number && !finishNumber()) {
+        return false;
+    }
+    if (state == State::Literal && !finishLiteral()) {
+        return false;
+    }
+    if (state == State::Failed) {
+        return false;
+    }
+    if (state != State::Done) {
+        return fail("unexpected end of input");
+    }
+    return true;
+}
+
+bool parseJsonFile(const std::string& path, JsonSaxHandler& handler, std::string& error, uint64_t* bytes) {
+    FILE* file = std::fopen(path.c_str(), "rb");
+    if (!file) {
+        error = "cannot open " + path;
+        return false;
+    }
+    JsonSaxParser parser(handler);
+    static const size_t kReadBytes = 64 * 1024;
+    std::vector<char> buffer(kReadBytes);
+    bool ok = true;
+    size_t n;
+    bool first = true;
+    while (ok && (n = std::fread(buffer.data(), 1, buffer.size(), file)) > 0) {
+        const char* data = buffer.data();
+        // Files saved from a browser or Notepad may start with a UTF-8 BOM.
+        if (first && n >= 3 && std::memcmp(data, "\xEF\xBB\xBF", 3) == 0) {
+            data += 3;
+            n -= 3;
+        }
+        first = false;
+        ok = parser.feed(data, n);
+    }
+    ok = ok && !std::ferror(file) && parser.finish();
+    if (bytes) {
+        *bytes += parser.bytesFed();
+    }
+    std::fclose(file);
+    if (!ok) {
+        error = parser.error().empty() ? "read error" : "line " + std::to_string(parser.line()) + ": " + parser.error();
+    }
+    return ok;
+}
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// --- Streaming JSON (SAX) ---
+//
+// A push parser: feed() it bytes in chunks of any size and it reports
+// events to a handler as it goes, without building a document. Memory is
+// bounded by the nesting depth and the small token buffers below, whatever
+// the input size. String values are delivered unescaped in pieces, so a
+// multi-megabyte string (such as a JSON document stored inside a JSON
+// string) never has to be held in memory at once.
+
+enum class JsonLiteral { True, False, Null };
+
+class JsonSaxHandler {
+public:
+    virtual ~JsonSaxHandler() = default;
+
+    // Returning false from any event stops the parse with an error.
+    virtual bool startObject() = 0;
+    virtual bool endObject() = 0;
+    virtual bool startArray() = 0;
+    virtual bool endArray() = 0;
+    // Object keys longer than kMaxKeyBytes are truncated.
+    virtual bool key(std::string_view name) = 0;
+    // A string value, unescaped to UTF-8, in one or more pieces; the last
+    // piece has last == true (and may be empty).
+    virtual bool stringPart(std::string_view part, bool last) = 0;
+    // The number exactly as written.
+    virtual bool number(std::string_view text) = 0;
+    virtual bool literal(JsonLiteral value) = 0;
+};
+
+class JsonSaxParser {
+public:
+    static const size_t kMaxDepth = 64;
+    static const size_t kMaxKeyBytes = 256;
+    static const size_t kMaxNumberBytes = 64;
+    static const size_t kStringPartBytes = 4096;
+
+    explicit JsonSaxParser(JsonSaxHandler& handler);
+
+    // Returns false once the input is known to be invalid (see error()).
+    bool feed(const char* data, size_t size);
+    // Ends the input; fails if the document is incomplete.
+    bool finish();
+
+    const std::string& error() const { return message; }
+    // 1-based line of the error, or of the last byte consumed.
+    size_t line() const { return lineNumber; }
+    uint64_t bytesFed() const { return consumed; }
+
+private:
+    enum class State {
+        Value,          // expecting a value
+        FirstKey,       // after '{': a key or '}'
+        Key,            // after ',' in an object: a key
+        Colon,
+        AfterValue,     // ',' or a closing bracket, or end of document
+        FirstElement,   // after '[': a value or ']'
+        String,
+        Escape,
+        Unicode,
+        Number,
+        Literal,
+        Done,
+        Failed,
+    };
+
+    bool fail(const char* what);
+    bool beginValue(char c);
+    bool endValue();
+    bool closeContainer(char c);
+    bool flushString(bool last);
+    bool appendStringByte(char c);
+    bool appendCodePoint(uint32_t cp);
+    bool finishNumber();
+    bool finishLiteral();
+
+    JsonSaxHandler& handler;
+    State state = State::Value;
+    std::vector<char> stack;        // '{' or '['
+    bool stringIsKey = false;
+    std::string key;
+    char part[kStringPartBytes];
+    size_t partSize = 0;
+    uint32_t unicode = 0;
+    int unicodeDigits = 0;
+    uint32_t highSurrogate = 0;
+    char token[kMaxNumberBytes];
+    size_t tokenSize = 0;
+    std::string message;
+    size_t lineNumber = 1;
+    uint64_t consumed = 0;
+};
+
+// Parses a whole file through the parser in fixed-size reads, adding the
+// file size to *bytes when given.
+bool parseJsonFile(const std::string& path, JsonSaxHandler& handler, std::string& error, uint64_t* bytes = nullptr);
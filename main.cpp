@@ -3,220 +3,149 @@
 #include <string>
 #include <vector>
 #include <chrono>
-#include <iomanip>
 #include <sstream>
-#include <fstream>
+#include <cstdio>
+#include <cmath>
 #include <cstdlib> // For getenv
 #include <commdlg.h> // For GetSaveFileNameW
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <unordered_map>
+
+#include "app_state.h"
+#include "badge_ingest.h"
+#include "binary_history.h"
+#include "history_store.h"
+#include "civil_time.h"
+#include "time_format.h"
+#include "display_list.h"
+#include "text_cache.h"
+#include "tick_scheduler.h"
+#include "export.h"
+#include "file_watcher.h"
+#include "profiles.h"
+#include "query_service.h"
+#include "team_report.h"
+#include "web_import.h"
+#include "trace.h"
 
 #pragma comment (lib,"Gdiplus.lib")
 #pragma comment (lib,"Comdlg32.lib")
 
-// --- Data Structures ---
+AppState g_appState([](const char* message) { traceLog(message); });
+QueryService g_queryService(g_appState);
+QueryServer g_queryServer(g_queryService, [](const char* message) { traceLog(message); });
 
-struct Config {
-    double hourlyGross = 12.50;
-    double hourlyNet = 10.00;
-};
-
-struct WorkDay {
-    std::string date;
-    std::string startTime;
-    std::string endTime;
-    std::string startDateTime;
-    std::string endDateTime;
-    std::string duration;
-    long long durationMs = 0;
-    double grossEarning = 0.0;
-    double netEarning = 0.0;
-    double hourlyGross = 0.0;
-    double hourlyNet = 0.0;
-};
-
-struct CurrentSession {
-    std::chrono::system_clock::time_point startTime;
-    double sessionHourlyGross;
-    double sessionHourlyNet;
-};
-
-// --- Application State and Logic ---
+// --- Data Persistence (snapshot + append-only journal, see journal.h) ---
 
-class AppState {
-public:
-    bool isWorking = false;
-    Config config;
-    CurrentSession currentSession;
-    std::vector<WorkDay> history;
-    std::tm currentViewMonth;
-
-    void saveData();
-
-    void togglePunch() {
-        if (isWorking) {
-            punchOut();
-        } else {
-            punchIn();
-        }
-    }
-
-    void changeMonth(int delta) {
-        currentViewMonth.tm_mon += delta;
-        std::mktime(&currentViewMonth); // Normalize the date
-    }
-
-    std::string formatTime(const std::chrono::system_clock::time_point& tp) {
-        std::time_t time = std::chrono::system_clock::to_time_t(tp);
-        std::tm local_tm;
-        localtime_s(&local_tm, &time);
-        std::stringstream ss;
-        ss << std::put_time(&local_tm, "%H:%M");
-        return ss.str();
-    }
-
-    std::string formatDate(const std::chrono::system_clock::time_point& tp) {
-        std::time_t time = std::chrono::system_clock::to_time_t(tp);
-        std::tm local_tm;
-        localtime_s(&local_tm, &time);
-        std::stringstream ss;
-        ss << std::put_time(&local_tm, "%Y-%m-%d");
-        return ss.str();
-    }
-
-    std::string formatISO(const std::chrono::system_clock::time_point& tp) {
-        std::time_t time = std::chrono::system_clock::to_time_t(tp);
-        std::tm local_tm;
-        gmtime_s(&local_tm, &time);
-        std::stringstream ss;
-        ss << std::put_time(&local_tm, "%Y-%m-%dT%H:%M:%SZ");
-        return ss.str();
-    }
-
-    std::wstring formatDuration(long long ms) {
-        long long hours = ms / (1000 * 60 * 60);
-        long long minutes = (ms % (1000 * 60 * 60)) / (1000 * 60);
-        std::wstringstream wss;
-        wss << hours << "h " << std::setw(2) << std::setfill(L'0') << minutes << "m";
-        return wss.str();
-    }
-
-    void punchIn() {
-        isWorking = true;
-        currentSession.startTime = std::chrono::system_clock::now();
-        currentSession.sessionHourlyGross = config.hourlyGross;
-        currentSession.sessionHourlyNet = config.hourlyNet;
-        OutputDebugStringW(L"PUNCH IN\n");
+std::string GetDataRoot() {
+    const char* appdata = getenv("APPDATA");
+    if (appdata == NULL) {
+        return ".";
     }
+    std::string root = std::string(appdata) + "\\TimeTrackerPro";
+    CreateDirectoryA(root.c_str(), NULL);
+    return root;
+}
 
-    void punchOut() {
-        isWorking = false;
-
-        auto endTimePoint = std::chrono::system_clock::now();
-        auto durationChrono = endTimePoint - currentSession.startTime;
-        long long durationMs = std::chrono::duration_cast<std::chrono::milliseconds>(durationChrono).count();
-        double durationHours = durationMs / (1000.0 * 60.0 * 60.0);
+// Multi-profile mode: TIMETRACKER_PROFILE=<name> keeps this user's data in
+// its own shard, <root>\profiles\<name>\ (see profiles.h).
+std::string ActiveProfile() {
+    const char* profile = getenv("TIMETRACKER_PROFILE");
+    return (profile != NULL && isValidProfileName(profile)) ? profile : "";
+}
 
-        WorkDay day;
-        day.date = formatDate(currentSession.startTime);
-        day.startTime = formatTime(currentSession.startTime);
-        day.endTime = formatTime(endTimePoint);
-        day.startDateTime = formatISO(currentSession.startTime);
-        day.endDateTime = formatISO(endTimePoint);
-        std::wstring wduration = formatDuration(durationMs);
-        day.duration = std::string(wduration.begin(), wduration.end());
-        day.durationMs = durationMs;
-        day.hourlyGross = currentSession.sessionHourlyGross;
-        day.hourlyNet = currentSession.sessionHourlyNet;
-        day.grossEarning = durationHours * day.hourlyGross;
-        day.netEarning = durationHours * day.hourlyNet;
+// Tracing: TIMETRACKER_TRACE=<file> turns on spans and latency histograms
+// (see trace.h). F8 writes them to <file>, and so does closing the window.
+std::string TraceFilePath() {
+    const char* path = getenv("TIMETRACKER_TRACE");
+    return path != NULL ? path : "";
+}
 
-        history.insert(history.begin(), day);
+// Local queries: TIMETRACKER_QUERY=<name> answers payroll scripts on the
+// named pipe \\.\pipe\<name> (see query_service.h).
+std::string QueryEndpoint() {
+    const char* name = getenv("TIMETRACKER_QUERY");
+    return name != NULL ? name : "";
+}
 
-        OutputDebugStringW(L"PUNCH OUT, saving data...\n");
-        saveData();
-    }
+// Shared stores: another instance's sessions are picked up as the store
+// changes (see file_watcher.h). TIMETRACKER_WATCH=poll checks every second
+// instead, for network shares that send no change notifications.
+bool WatchByPolling() {
+    const char* watch = getenv("TIMETRACKER_WATCH");
+    return watch != NULL && std::string(watch) == "poll";
+}
 
-    std::wstring getWorkedDurationString() {
-        if (!isWorking) {
-            return L"0h 00m";
-        }
-        auto now = std::chrono::system_clock::now();
-        auto duration = now - currentSession.startTime;
-        long long ms = std::chrono::duration_cast<std::chrono::milliseconds>(duration).count();
-        return formatDuration(ms);
+std::string GetDataFilePath(const std::string& fileName) {
+    std::string profile = ActiveProfile();
+    if (!profile.empty()) {
+        ensureProfileDirectory(GetDataRoot(), profile);
+        return profileDirectory(GetDataRoot(), profile) + "\\" + fileName;
     }
-};
-
-AppState g_appState;
-
-// --- Data Persistence (Manual CSV-like format) ---
-
-std::string GetDataFilePath() {
     const char* appdata = getenv("APPDATA");
     std::string path;
     if (appdata != NULL) {
         path = std::string(appdata) + "\\TimeTrackerPro";
         CreateDirectoryA(path.c_str(), NULL);
-        path += "\\data.txt";
+        path += "\\" + fileName;
     } else {
-        path = "TimeTrackerPro_data.txt";
+        path = "TimeTrackerPro_" + fileName;
     }
     return path;
 }
 
-void AppState::saveData() {
-    std::string path = GetDataFilePath();
-    std::ofstream file(path);
-    if (!file.is_open()) {
-        OutputDebugStringW(L"Failed to open data file for writing.\n");
-        return;
-    }
-
-    file << "config|" << config.hourlyGross << "|" << config.hourlyNet << "\n";
+// Shops that need a human-readable store set TIMETRACKER_STORE=text to keep
+// data.txt instead of migrating to history.bin.
+bool UseTextStore() {
+    const char* store = getenv("TIMETRACKER_STORE");
+    return store != NULL && std::string(store) == "text";
+}
 
-    for (const auto& day : history) {
-        file << "workday|" << day.date << "|" << day.startTime << "|" << day.endTime << "|"
-             << day.startDateTime << "|" << day.endDateTime << "|" << day.duration << "|"
-             << day.durationMs << "|" << day.grossEarning << "|" << day.netEarning << "|"
-             << day.hourlyGross << "|" << day.hourlyNet << "\n";
-    }
-    OutputDebugStringW(L"Data saved successfully.\n");
+// Archiving: TIMETRACKER_HOT_YEARS=<n> keeps the last n calendar years in
+// history.bin; older ones are sealed into history.bin.archive.
+int HotYears() {
+    const char* years = getenv("TIMETRACKER_HOT_YEARS");
+    int n = years != NULL ? atoi(years) : 0;
+    return n > 0 ? n : AppState::kDefaultHotYears;
 }
 
 void loadData() {
-    std::string path = GetDataFilePath();
-    std::ifstream file(path);
-    if (!file.is_open()) {
-        OutputDebugStringW(L"No existing data file found. Using defaults.\n");
+    g_appState.hotYears = HotYears();
+    g_appState.loadData(GetDataFilePath("history.bin"), GetDataFilePath("data.txt"), UseTextStore());
+}
+
+// --- Session Recovery (see session_checkpoint.h) ---
+
+// A session was still running when the app last stopped. After a normal
+// exit it simply carries on; after a crash or a power cut the user chooses
+// between resuming it and closing it when the app was last seen alive.
+void RecoverInterruptedSession(HWND hwnd) {
+    SessionCheckpointState interrupted;
+    if (!g_appState.openCheckpoint(GetDataFilePath("session.chk"), interrupted)) {
         return;
     }
-
-    g_appState.history.clear();
-    std::string line;
-    while (std::getline(file, line)) {
-        std::stringstream ss(line);
-        std::string token;
-        std::getline(ss, token, '|');
-
-        if (token == "config") {
-            std::getline(ss, token, '|'); std::stringstream(token) >> g_appState.config.hourlyGross;
-            std::getline(ss, token, '|'); std::stringstream(token) >> g_appState.config.hourlyNet;
-        } else if (token == "workday") {
-            WorkDay day;
-            std::getline(ss, day.date, '|');
-            std::getline(ss, day.startTime, '|');
-            std::getline(ss, day.endTime, '|');
-            std::getline(ss, day.startDateTime, '|');
-            std::getline(ss, day.endDateTime, '|');
-            std::getline(ss, day.duration, '|');
-            std::getline(ss, token, '|'); std::stringstream(token) >> day.durationMs;
-            std::getline(ss, token, '|'); std::stringstream(token) >> day.grossEarning;
-            std::getline(ss, token, '|'); std::stringstream(token) >> day.netEarning;
-            std::getline(ss, token, '|'); std::stringstream(token) >> day.hourlyGross;
-            std::getline(ss, token, '|'); std::stringstream(token) >> day.hourlyNet;
-            g_appState.history.push_back(day);
-        }
+    if (interrupted.closedCleanly) {
+        g_appState.resumeSession(interrupted);
+        return;
+    }
+    int64_t startMin = interrupted.startMs / 60000 + localOffsetCache().offsetMinutes(interrupted.startMs / 1000);
+    int64_t seenMin = interrupted.lastSeenMs / 60000 + localOffsetCache().offsetMinutes(interrupted.lastSeenMs / 1000);
+    wchar_t date[kDateChars], start[kClockChars], seen[kClockChars];
+    formatLocalDate(startMin, date);
+    formatLocalClock(startMin, start);
+    formatLocalClock(seenMin, seen);
+    wchar_t message[320];
+    swprintf(message, 320,
+             L"La session commencée le %ls à %ls n'a pas été clôturée (dernière activité à %ls).\n\n"
+             L"Oui : reprendre la session.\nNon : la clôturer à %ls.",
+             date, start, seen, seen);
+    if (MessageBoxW(hwnd, message, L"Session interrompue", MB_YESNO | MB_ICONQUESTION) == IDYES) {
+        g_appState.resumeSession(interrupted);
+    } else {
+        g_appState.closeSessionAt(interrupted, interrupted.lastSeenMs);
     }
-    OutputDebugStringW(L"Data loaded successfully.\n");
 }
 
 // --- UI Structures and Globals ---
@@ -230,6 +159,7 @@ UIElement g_header;
 UIElement g_punchButton;
 UIElement g_workedTimeLabel;
 UIElement g_workedTimeValue;
+UIElement g_monthStats;
 UIElement g_calendarHeader;
 UIElement g_calendarGrid;
 UIElement g_monthNavPrev;
@@ -237,23 +167,214 @@ UIElement g_monthNavNext;
 UIElement g_monthNavDisplay;
 UIElement g_exportButton;
 
-enum DayType { Normal, Today, OtherMonth, FullDay, PartialDay };
 struct CalendarDay {
     RECT rect;
     int dayNumber;
     DayType type;
-    const WorkDay* workDayData = nullptr;
+    HistoryStore::Range sessions;   // every session that started that day
+    long long totalMs = 0;
 };
 std::vector<CalendarDay> g_calendarDays;
 
+// --- Painting ---
+
+// GDI+ objects and the back buffer, kept across paints. The back buffer holds
+// the last rendered frame; only regions whose display items changed are
+// re-rasterized into it, and their text is blitted from textCache.
+struct PaintResources {
+    Gdiplus::FontFamily fontFamily{L"Segoe UI"};
+    Gdiplus::Font headerFont{&fontFamily, 24, Gdiplus::FontStyleBold, Gdiplus::UnitPixel};
+    Gdiplus::Font buttonFont{&fontFamily, 18, Gdiplus::FontStyleBold, Gdiplus::UnitPixel};
+    Gdiplus::Font statsFont{&fontFamily, 16, Gdiplus::FontStyleRegular, Gdiplus::UnitPixel};
+    Gdiplus::Font calendarFont{&fontFamily, 14, Gdiplus::FontStyleRegular, Gdiplus::UnitPixel};
+    Gdiplus::StringFormat nearFormat;
+    Gdiplus::StringFormat centerFormat;
+    Gdiplus::StringFormat farFormat;
+    // No padding around the glyph, so runs of them space like the string.
+    Gdiplus::StringFormat glyphFormat{Gdiplus::StringFormat::GenericTypographic()};
+    Gdiplus::Bitmap measureBitmap{1, 1, PixelFormat32bppPARGB};
+    std::unique_ptr<Gdiplus::Bitmap> backBuffer;
+    int bufferWidth = 0;
+    int bufferHeight = 0;
+    DisplayList lastFrame;
+    std::unordered_map<uint32_t, std::unique_ptr<Gdiplus::SolidBrush>> brushes;
+    TextRasterCache<Gdiplus::Bitmap> textCache;
+    TextRasterCache<Gdiplus::Bitmap> glyphCache{1024 * 1024};
+    std::unordered_map<std::wstring, float> glyphAdvances[4];  // by FontRole
+
+    PaintResources() {
+        nearFormat.SetAlignment(Gdiplus::StringAlignmentNear);
+        nearFormat.SetLineAlignment(Gdiplus::StringAlignmentCenter);
+        centerFormat.SetAlignment(Gdiplus::StringAlignmentCenter);
+        centerFormat.SetLineAlignment(Gdiplus::StringAlignmentCenter);
+        farFormat.SetAlignment(Gdiplus::StringAlignmentFar);
+        farFormat.SetLineAlignment(Gdiplus::StringAlignmentCenter);
+        glyphFormat.SetAlignment(Gdiplus::StringAlignmentNear);
+        glyphFormat.SetLineAlignment(Gdiplus::StringAlignmentCenter);
+        glyphFormat.SetFormatFlags(glyphFormat.GetFormatFlags() | Gdiplus::StringFormatFlagsNoWrap |
+                                   Gdiplus::StringFormatFlagsMeasureTrailingSpaces);
+    }
+
+    const Gdiplus::Font* font(FontRole role) const {
+        switch (role) {
+            case FontRole::Header:   return &headerFont;
+            case FontRole::Button:   return &buttonFont;
+            case FontRole::Stats:    return &statsFont;
+            case FontRole::Calendar: return &calendarFont;
+        }
+        return &statsFont;
+    }
+
+    const Gdiplus::StringFormat* format(TextAlign align) const {
+        switch (align) {
+            case TextAlign::Near:   return &nearFormat;
+            case TextAlign::Center: return &centerFormat;
+            case TextAlign::Far:    return &farFormat;
+        }
+        return &centerFormat;
+    }
+
+    Gdiplus::SolidBrush* brush(uint32_t argb) {
+        std::unique_ptr<Gdiplus::SolidBrush>& slot = brushes[argb];
+        if (!slot) {
+            slot.reset(new Gdiplus::SolidBrush(Gdiplus::Color(argb)));
+        }
+        return slot.get();
+    }
+
+    // The item's text drawn once on transparent pixels; null for an empty rect.
+    Gdiplus::Bitmap* text(const DisplayItem& item) {
+        if (item.rect.empty()) {
+            return nullptr;
+        }
+        return textCache.fetch(textKeyOf(item), [&](const TextKey& key) {
+            std::unique_ptr<Gdiplus::Bitmap> image(new Gdiplus::Bitmap(key.width, key.height, PixelFormat32bppPARGB));
+            Gdiplus::Graphics graphics(image.get());
+            graphics.Clear(Gdiplus::Color(0, 0, 0, 0));
+            // Grayscale antialiasing: ClearType needs the final background.
+            graphics.SetTextRenderingHint(Gdiplus::TextRenderingHintAntiAlias);
+            Gdiplus::RectF layout(0, 0, (Gdiplus::REAL)key.width, (Gdiplus::REAL)key.height);
+            graphics.DrawString(key.text.c_str(), -1, font(key.font), layout, format(key.align), brush(key.argb));
+            return image;
+        });
+    }
+
+    float glyphAdvance(FontRole role, const std::wstring& glyph) {
+        auto& advances = glyphAdvances[static_cast<int>(role)];
+        auto it = advances.find(glyph);
+        if (it == advances.end()) {
+            Gdiplus::Graphics graphics(&measureBitmap);
+            graphics.SetTextRenderingHint(Gdiplus::TextRenderingHintAntiAlias);
+            Gdiplus::RectF box;
+            graphics.MeasureString(glyph.c_str(), -1, font(role), Gdiplus::RectF(0, 0, 1000, 1000), &glyphFormat, &box);
+            it = advances.emplace(glyph, box.Width).first;
+        }
+        return it->second;
+    }
+
+    // The item's text as a run of cached glyphs, for strings that change
+    // every tick; false if the run does not fit its rect.
+    bool drawGlyphRun(Gdiplus::Graphics& graphics, const DisplayItem& item) {
+        std::vector<std::wstring> glyphs = splitGlyphs(item.text);
+        std::vector<float> advances;
+        advances.reserve(glyphs.size());
+        for (const auto& glyph : glyphs) {
+            advances.push_back(glyphAdvance(item.font, glyph));
+        }
+        std::vector<int> lefts = layoutGlyphRun(advances, item.align, item.rect.width());
+        if (lefts.size() != glyphs.size() || item.rect.empty()) {
+            return false;
+        }
+        // Room for antialiasing and overhang on both sides of the advance.
+        const int kMargin = 2;
+        int height = item.rect.height();
+        for (size_t i = 0; i < glyphs.size(); ++i) {
+            TextKey key;
+            key.text = glyphs[i];
+            key.font = item.font;
+            key.align = TextAlign::Near;
+            key.argb = item.argb;
+            key.width = static_cast<int>(std::ceil(advances[i])) + 2 * kMargin;
+            key.height = height;
+            Gdiplus::Bitmap* image = glyphCache.fetch(key, [&](const TextKey& k) {
+                std::unique_ptr<Gdiplus::Bitmap> bitmap(new Gdiplus::Bitmap(k.width, k.height, PixelFormat32bppPARGB));
+                Gdiplus::Graphics glyphGraphics(bitmap.get());
+                glyphGraphics.Clear(Gdiplus::Color(0, 0, 0, 0));
+                glyphGraphics.SetTextRenderingHint(Gdiplus::TextRenderingHintAntiAlias);
+                Gdiplus::RectF layout((Gdiplus::REAL)kMargin, 0, (Gdiplus::REAL)(k.width - kMargin), (Gdiplus::REAL)k.height);
+                glyphGraphics.DrawString(k.text.c_str(), -1, font(k.font), layout, &glyphFormat, brush(k.argb));
+                return bitmap;
+            });
+            graphics.DrawImage(image, Gdiplus::Rect(item.rect.left + lefts[i] - kMargin, item.rect.top, key.width, height),
+                               0, 0, key.width, height, Gdiplus::UnitPixel);
+        }
+        return true;
+    }
+};
+std::unique_ptr<PaintResources> g_paint;
+
 // Forward declaration of functions
 void generateCalendar(int year, int month);
-void OnPaint(HDC hdc, HWND hwnd);
+void OnPaint(HDC hdc, HWND hwnd, const RECT& paintRect);
 void UpdateLayout(HWND hwnd);
-void DrawRoundedRectangle(Gdiplus::Graphics& graphics, Gdiplus::Rect r, Gdiplus::Color color, Gdiplus::REAL radius);
+void DrawRoundedRectangle(Gdiplus::Graphics& graphics, Gdiplus::Rect r, const Gdiplus::Brush* brush, Gdiplus::REAL radius);
 
 // Timer ID
 #define ID_TIMER_UPDATE 1
+#define ID_TIMER_EXPORT 2
+#define ID_TIMER_SYNC 3
+
+// Posted by the export worker when it finishes; wParam = ExportResult.
+#define WM_APP_EXPORT_DONE (WM_APP + 1)
+#define WM_APP_HISTORY_LOADED (WM_APP + 2)
+#define WM_APP_STORE_CHANGED (WM_APP + 3)
+
+ExportJob g_export;
+DWORD g_exportFilterIndex = 1;  // in the save dialog: 1 CSV, 2 CSV of the month shown, 3 JSON Lines
+
+// --- Store Sharing ---
+
+std::unique_ptr<FileWatcher> g_storeWatcher;
+std::atomic<bool> g_storeChangePosted{false};
+
+// Takes in what other instances wrote; retried shortly while one of them
+// (or our own writer) holds the store.
+void SyncStore(HWND hwnd) {
+    const UINT kRetryMs = 200;
+    bool changed;
+    if (!g_appState.syncExternalChanges(changed)) {
+        SetTimer(hwnd, ID_TIMER_SYNC, kRetryMs, NULL);
+        return;
+    }
+    if (changed) {
+        UpdateLayout(hwnd);
+        InvalidateRect(hwnd, NULL, FALSE);
+    }
+}
+
+// --- UI Tick Scheduling ---
+
+SystemClock g_clock;
+TickScheduler g_ticks(g_clock);
+int64_t g_tickDayKey = 0;
+
+// (Re)arms the one-shot update timer for the next moment the display changes.
+void ArmTickTimer(HWND hwnd) {
+    using namespace std::chrono;
+    int64_t startMs = duration_cast<milliseconds>(g_appState.currentSession.startTime.time_since_epoch()).count();
+    g_ticks.setSession(g_appState.isWorking, startMs);
+    int64_t delay = g_ticks.nextDelayMs();
+    SetTimer(hwnd, ID_TIMER_UPDATE, static_cast<UINT>(std::min<int64_t>(delay, 0x7FFFFFFF)), NULL);
+}
+
+// The wall clock jumped (resume from sleep, clock or time zone change).
+void OnClockDiscontinuity(HWND hwnd) {
+    localOffsetCache().invalidate();
+    g_tickDayKey = g_ticks.currentDayKey();
+    UpdateLayout(hwnd);
+    InvalidateRect(hwnd, NULL, FALSE);
+    ArmTickTimer(hwnd);
+}
 
 const char g_szClassName[] = "TimeTrackerProWindowClass";
 
@@ -264,20 +385,90 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam)
     {
         case WM_CREATE:
             {
-                loadData();
                 auto now = std::chrono::system_clock::now();
                 std::time_t time_now = std::chrono::system_clock::to_time_t(now);
                 localtime_s(&g_appState.currentViewMonth, &time_now);
                 g_appState.currentViewMonth.tm_mday = 1;
+                // The months around this one load now; the rest follows
+                // off the UI thread so the window paints at once.
+                loadData();
+                RecoverInterruptedSession(hwnd);
+                g_appState.persistence.start();
+                g_appState.startBackgroundLoad([hwnd] { PostMessageW(hwnd, WM_APP_HISTORY_LOADED, 0, 0); });
+                g_storeWatcher.reset(new FileWatcher([hwnd] {
+                    if (!g_storeChangePosted.exchange(true)) {
+                        PostMessageW(hwnd, WM_APP_STORE_CHANGED, 0, 0);
+                    }
+                }));
+                g_storeWatcher->start(g_appState.storePath(), WatchByPolling());
+                if (!QueryEndpoint().empty()) {
+                    g_queryServer.start(QueryEndpoint());
+                }
                 UpdateLayout(hwnd);
-                SetTimer(hwnd, ID_TIMER_UPDATE, 1000, NULL);
+                g_tickDayKey = g_ticks.currentDayKey();
+                ArmTickTimer(hwnd);
             }
             break;
         case WM_TIMER:
             if (wParam == ID_TIMER_UPDATE) {
-                if (g_appState.isWorking) {
+                int64_t dayKey = g_ticks.currentDayKey();
+                if (dayKey != g_tickDayKey) {
+                    // Midnight: the "today" marker moves.
+                    g_tickDayKey = dayKey;
+                    UpdateLayout(hwnd);
+                    InvalidateRect(hwnd, NULL, FALSE);
+                } else if (g_appState.isWorking) {
+                    g_appState.heartbeat();
                     InvalidateRect(hwnd, &g_workedTimeValue.rect, FALSE);
+                    InvalidateRect(hwnd, &g_monthStats.rect, FALSE);
                 }
+                ArmTickTimer(hwnd);
+            } else if (wParam == ID_TIMER_EXPORT) {
+                InvalidateRect(hwnd, &g_exportButton.rect, FALSE);
+            } else if (wParam == ID_TIMER_SYNC) {
+                KillTimer(hwnd, ID_TIMER_SYNC);
+                SyncStore(hwnd);
+            }
+            break;
+        case WM_APP_EXPORT_DONE:
+            g_export.join();
+            KillTimer(hwnd, ID_TIMER_EXPORT);
+            InvalidateRect(hwnd, &g_exportButton.rect, FALSE);
+            switch (static_cast<ExportResult>(wParam)) {
+                case ExportResult::Ok:
+                    MessageBoxW(hwnd, L"Exportation réussie !", L"Succès", MB_OK);
+                    break;
+                case ExportResult::Cancelled:
+                    MessageBoxW(hwnd, L"Exportation annulée.", L"Export", MB_OK);
+                    break;
+                case ExportResult::IoError:
+                    MessageBoxW(hwnd, L"Erreur lors de l'exportation.", L"Erreur", MB_OK);
+                    break;
+            }
+            break;
+        case WM_APP_HISTORY_LOADED:
+            g_appState.finishBackgroundLoad();
+            UpdateLayout(hwnd);
+            InvalidateRect(hwnd, NULL, FALSE);
+            break;
+        case WM_APP_STORE_CHANGED:
+            g_storeChangePosted = false;
+            SyncStore(hwnd);
+            break;
+        case WM_TIMECHANGE:
+            OnClockDiscontinuity(hwnd);
+            break;
+        case WM_POWERBROADCAST:
+            if (wParam == PBT_APMSUSPEND) {
+                g_appState.heartbeat(); // a machine that never wakes closes here
+            }
+            if (wParam == PBT_APMRESUMEAUTOMATIC) {
+                OnClockDiscontinuity(hwnd);
+            }
+            return TRUE;
+        case WM_KEYDOWN:
+            if (wParam == VK_F8 && traceEnabled()) {
+                traceDumpToFile(TraceFilePath());
             }
             break;
         case WM_SIZE:
@@ -292,7 +483,9 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam)
             if (PtInRect(&g_punchButton.rect, pt))
             {
                 g_appState.togglePunch();
+                UpdateLayout(hwnd);
                 InvalidateRect(hwnd, NULL, TRUE);
+                ArmTickTimer(hwnd);
                 return 0;
             }
             if (PtInRect(&g_monthNavPrev.rect, pt))
@@ -310,50 +503,78 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam)
                 return 0;
             }
             for (const auto& day : g_calendarDays) {
-                if (day.workDayData && PtInRect(&day.rect, pt)) {
+                if (!day.sessions.empty() && PtInRect(&day.rect, pt)) {
                     std::wstringstream wss;
-                    wss << L"Détails pour le " << day.workDayData->date.c_str() << L"\n"
-                        << L"Durée: " << day.workDayData->duration.c_str() << L"\n"
-                        << L"Gains nets: " << day.workDayData->netEarning << L"€";
+                    wss << L"Détails pour le " << day.sessions.front().date().c_str() << L"\n";
+                    for (const auto& session : day.sessions) {
+                        wss << L"\n" << session.startTime().c_str() << L" - " << session.endTime().c_str() << L"\n"
+                            << L"Durée: " << session.duration().c_str() << L"\n"
+                            << L"Gains nets: " << session.netEarning() << L"€\n";
+                    }
                     MessageBoxW(hwnd, wss.str().c_str(), L"Détails du jour", MB_OK);
                     return 0;
                 }
             }
             if (PtInRect(&g_exportButton.rect, pt))
             {
+                if (g_export.running()) {
+                    if (MessageBoxW(hwnd, L"Annuler l'exportation en cours ?", L"Export", MB_YESNO) == IDYES) {
+                        g_export.cancel();
+                    }
+                    return 0;
+                }
+
                 wchar_t szFile[260] = { 0 };
                 OPENFILENAMEW ofn;
                 ZeroMemory(&ofn, sizeof(ofn));
                 ofn.lStructSize = sizeof(ofn);
                 ofn.hwndOwner = hwnd;
                 ofn.lpstrFile = szFile;
-                ofn.nMaxFile = sizeof(szFile);
-                ofn.lpstrFilter = L"CSV (Comma delimited)\0*.csv\0All Files\0*.*\0";
-                ofn.nFilterIndex = 1;
+                ofn.nMaxFile = sizeof(szFile) / sizeof(szFile[0]);
+                ofn.lpstrFilter = L"CSV (Comma delimited)\0*.csv\0CSV - mois affiché\0*.csv\0JSON Lines\0*.jsonl\0";
+                // Opens on the format exported last, with its extension.
+                ofn.nFilterIndex = g_exportFilterIndex;
                 ofn.lpstrFileTitle = NULL;
                 ofn.nMaxFileTitle = 0;
                 ofn.lpstrInitialDir = NULL;
                 ofn.Flags = OFN_PATHMUSTEXIST | OFN_OVERWRITEPROMPT;
-                ofn.lpstrDefExt = L"csv";
+                ofn.lpstrDefExt = g_exportFilterIndex == 3 ? L"jsonl" : L"csv";
 
                 if (GetSaveFileNameW(&ofn) == TRUE)
                 {
-                    std::stringstream csv_content;
-                    csv_content << "Date;Jour;Heure Début;Heure Fin;Durée;Gains Nets (€);Taux Net (€/h);Gains Bruts (€);Taux Brut (€/h)\n";
-                    for(const auto& wd : g_appState.history) {
-                        csv_content << wd.date << ";" << "N/A" << ";" << wd.startTime << ";" << wd.endTime << ";"
-                                    << wd.duration << ";" << wd.netEarning << ";" << wd.hourlyNet << ";"
-                                    << wd.grossEarning << ";" << wd.hourlyGross << "\n";
+                    g_exportFilterIndex = ofn.nFilterIndex;
+                    ExportOptions options;
+                    if (ofn.nFilterIndex == 2) {
+                        options = ExportOptions::month(g_appState.currentViewMonth.tm_year + 1900,
+                                                       g_appState.currentViewMonth.tm_mon + 1);
+                    } else if (ofn.nFilterIndex == 3) {
+                        options.format = ExportFormat::JsonLines;
                     }
 
-                    std::ofstream outFile(ofn.lpstrFile);
-                    if(outFile.is_open()){
-                        outFile << csv_content.str();
-                        outFile.close();
-                        MessageBoxW(hwnd, L"Exportation réussie !", L"Succès", MB_OK);
-                    } else {
+                    FILE* file = _wfopen(ofn.lpstrFile, L"wb");
+                    if (file == NULL) {
                         MessageBoxW(hwnd, L"Erreur lors de l'exportation.", L"Erreur", MB_OK);
+                        return 0;
+                    }
+                    // Only a window of months is resident; the worker reads
+                    // the rest a range at a time from the mapped store.
+                    int64_t firstDay, lastDay;
+                    if (!g_appState.historyDays(firstDay, lastDay)) {
+                        firstDay = lastDay = 0;
                     }
+                    options.firstDay = std::max<int64_t>(options.firstDay, firstDay);
+                    options.lastDay = std::min<int64_t>(options.lastDay, lastDay);
+                    bool complete;
+                    Totals expected = g_appState.queryTotals(options.firstDay, options.lastDay, complete);
+                    auto load = [](int64_t first, int64_t last, std::vector<WorkDay>& sessions) {
+                        return g_appState.querySessions(first, last, sessions);
+                    };
+                    auto done = [hwnd](ExportResult result) {
+                        PostMessageW(hwnd, WM_APP_EXPORT_DONE, static_cast<WPARAM>(result), 0);
+                    };
+                    g_export.start(load, file, options, static_cast<size_t>(expected.sessions), done);
+                    SetTimer(hwnd, ID_TIMER_EXPORT, 250, NULL);
+                    InvalidateRect(hwnd, &g_exportButton.rect, FALSE);
                 }
                 return 0;
             }
@@ -363,14 +584,25 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam)
         {
             PAINTSTRUCT ps;
             HDC hdc = BeginPaint(hwnd, &ps);
-            OnPaint(hdc, hwnd);
+            OnPaint(hdc, hwnd, ps.rcPaint);
             EndPaint(hwnd, &ps);
         }
         break;
         case WM_CLOSE:
+            g_appState.persistence.flush();
             DestroyWindow(hwnd);
         break;
         case WM_DESTROY:
+            g_export.cancel();
+            g_export.join();
+            g_appState.checkpointOnExit();
+            g_storeWatcher.reset();
+            g_queryServer.stop();
+            g_appState.persistence.stop();
+            if (traceEnabled()) {
+                traceDumpToFile(TraceFilePath());
+            }
+            g_paint.reset(); // GDI+ objects must go before GdiplusShutdown
             PostQuitMessage(0);
         break;
         default:
@@ -379,8 +611,108 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam)
     return 0;
 }
 
-int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR, int nCmdShow)
+// --- Command-Line Modes ---
+
+// The exe is a GUI program, so what the command-line modes print only
+// reaches the console they were started from after attaching to it. Started
+// without one (a shortcut, Explorer), a failure is shown in a message box.
+void ReportCommandLine(const std::string& report, bool failed) {
+    OutputDebugStringA(report.c_str());
+    FILE* stream = failed ? stderr : stdout;
+    if (AttachConsole(ATTACH_PARENT_PROCESS) && freopen("CONOUT$", "w", stream) != NULL) {
+        fputs(report.c_str(), stream);
+        fflush(stream);
+    } else if (failed) {
+        MessageBoxA(NULL, report.c_str(), "TimeTracker Pro", MB_ICONERROR | MB_OK);
+    }
+}
+
+int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR lpCmdLine, int nCmdShow)
 {
+    // Debug aid: TimeTrackerPro.exe --export-text <file> dumps history.bin as text.
+    const std::string exportFlag = "--export-text ";
+    std::string cmdLine = lpCmdLine ? lpCmdLine : "";
+    if (cmdLine.compare(0, exportFlag.size(), exportFlag) == 0) {
+        bool ok = exportBinaryHistoryAsText(GetDataFilePath("history.bin"), cmdLine.substr(exportFlag.size()));
+        return ok ? 0 : 1;
+    }
+    // Migration from the web version: TimeTrackerPro.exe --import-web <file.json>
+    // merges an exported localStorage history into this store.
+    const std::string importFlag = "--import-web ";
+    if (cmdLine.compare(0, importFlag.size(), importFlag) == 0) {
+        WebImportStats stats;
+        std::string error;
+        bool text = UseTextStore();
+        bool ok = mergeWebHistoryIntoStore(cmdLine.substr(importFlag.size()),
+                                           GetDataFilePath(text ? "data.txt" : "history.bin"),
+                                           text ? SnapshotFormat::Text : SnapshotFormat::Binary, stats, error);
+        char summary[160];
+        snprintf(summary, sizeof(summary), "Web import: %zu days, %zu sessions, %zu pauses.\n",
+                 stats.days, stats.sessions, stats.pauses);
+        ReportCommandLine(ok ? summary : "Web import failed: " + error + "\n", !ok);
+        return ok ? 0 : 1;
+    }
+    // Team view: TimeTrackerPro.exe --team-report <file> reduces every profile
+    // shard into per-month, per-rate and per-day totals.
+    const std::string teamFlag = "--team-report ";
+    if (cmdLine.compare(0, teamFlag.size(), teamFlag) == 0) {
+        ThreadPool pool;
+        TeamReport report = aggregateTeam(GetDataRoot(), listProfiles(GetDataRoot()), pool);
+        std::string path = cmdLine.substr(teamFlag.size());
+        FILE* file = fopen(path.c_str(), "wb");
+        bool written = file != NULL && writeTeamReport(report, file);
+        if (file != NULL) {
+            written = (fclose(file) == 0) && written;
+        }
+        char summary[160];
+        snprintf(summary, sizeof(summary), "Team report: %zu profiles, %zu sessions.\n", report.profiles,
+                 report.sessions);
+        std::string text = written ? summary : "Could not write the team report to " + path + "\n";
+        for (const auto& name : report.failedProfiles) {
+            text += "Could not read profile: " + name + "\n";
+        }
+        // A report missing a profile is incomplete, so that fails too.
+        bool ok = written && report.failedProfiles.empty();
+        ReportCommandLine(text, !ok);
+        return ok ? 0 : 1;
+    }
+    // Door badge logs: TimeTrackerPro.exe --import-badges <file.csv> pairs
+    // the IN/OUT events per badge and adds the sessions to each badge's
+    // profile shard.
+    const std::string badgeFlag = "--import-badges ";
+    if (cmdLine.compare(0, badgeFlag.size(), badgeFlag) == 0) {
+        ThreadPool pool;
+        std::vector<BadgePerson> people;
+        BadgeIngestStats stats;
+        BadgeStoreStats stored;
+        std::string error;
+        bool ok = ingestBadgeLogFile(cmdLine.substr(badgeFlag.size()), BadgeIngestOptions(), &pool, people, stats,
+                                     error) &&
+                  storeBadgeSessions(GetDataRoot(), people, pool, stored);
+        char summary[256];
+        snprintf(summary, sizeof(summary),
+                 "Badge import: %llu events, %llu sessions, %llu duplicates, %llu missing IN, %llu missing OUT, "
+                 "%zu profiles updated.\n",
+                 static_cast<unsigned long long>(stats.events), static_cast<unsigned long long>(stats.sessions),
+                 static_cast<unsigned long long>(stats.duplicates), static_cast<unsigned long long>(stats.missingIn),
+                 static_cast<unsigned long long>(stats.missingOut), stored.profiles);
+        std::string text = error.empty() ? summary : "Badge import failed: " + error + "\n";
+        for (const auto& id : stored.invalidIds) {
+            text += "Badge id is not a valid profile name: " + id + "\n";
+        }
+        for (const auto& name : stored.failedProfiles) {
+            text += "Could not write profile: " + name + "\n";
+        }
+        // Sessions of a badge that is not a valid profile name were not stored.
+        ok = ok && stored.invalidIds.empty();
+        ReportCommandLine(text, !ok);
+        return ok ? 0 : 1;
+    }
+
+    if (!TraceFilePath().empty()) {
+        setTraceEnabled(true);
+    }
+
     Gdiplus::GdiplusStartupInput gdiplusStartupInput;
     ULONG_PTR gdiplusToken;
     Gdiplus::GdiplusStartup(&gdiplusToken, &gdiplusStartupInput, NULL);
@@ -436,6 +768,7 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR, int nCmdShow)
 }
 
 void UpdateLayout(HWND hwnd) {
+    TraceScope trace(TraceSpan::Layout);
     RECT rc;
     GetClientRect(hwnd, &rc);
     int width = rc.right - rc.left;
@@ -451,8 +784,9 @@ void UpdateLayout(HWND hwnd) {
     g_workedTimeLabel.rect = { 40, statsY, width / 2, statsY + 30 };
     g_workedTimeLabel.text = L"⏱️ Temps travaillé :";
     g_workedTimeValue.rect = { width / 2, statsY, width - 40, statsY + 30 };
+    g_monthStats.rect = { 40, statsY + 32, width - 40, statsY + 56 };
 
-    int monthNavY = statsY + 60;
+    int monthNavY = statsY + 70;
     g_monthNavPrev.rect = {20, monthNavY, 60, monthNavY + 30};
     g_monthNavPrev.text = L"◀️";
     g_monthNavNext.rect = {width - 60, monthNavY, width - 20, monthNavY + 30};
@@ -470,116 +804,137 @@ void UpdateLayout(HWND hwnd) {
     generateCalendar(g_appState.currentViewMonth.tm_year + 1900, g_appState.currentViewMonth.tm_mon + 1);
 }
 
-void OnPaint(HDC hdc, HWND hwnd)
-{
-    RECT rc;
-    GetClientRect(hwnd, &rc);
-    Gdiplus::Rect clientRect(rc.left, rc.top, rc.right - rc.left, rc.bottom - rc.top);
-
-    Gdiplus::Bitmap buffer(clientRect.Width, clientRect.Height);
-    Gdiplus::Graphics bufferGraphics(&buffer);
-
-    bufferGraphics.SetSmoothingMode(Gdiplus::SmoothingModeAntiAlias);
-    bufferGraphics.SetTextRenderingHint(Gdiplus::TextRenderingHintAntiAlias);
-
-    Gdiplus::LinearGradientBrush gradBrush(
-        Gdiplus::Point(clientRect.GetLeft(), clientRect.GetTop()),
-        Gdiplus::Point(clientRect.GetRight(), clientRect.GetBottom()),
-        Gdiplus::Color(255, 43, 46, 74),
-        Gdiplus::Color(255, 28, 29, 44)
-    );
-    bufferGraphics.FillRectangle(&gradBrush, clientRect);
-
-    Gdiplus::FontFamily fontFamily(L"Segoe UI");
-    Gdiplus::SolidBrush whiteBrush(Gdiplus::Color(255, 240, 240, 240));
-
-    Gdiplus::Font headerFont(&fontFamily, 24, Gdiplus::FontStyleBold, Gdiplus::UnitPixel);
-    Gdiplus::StringFormat strFormat;
-    strFormat.SetAlignment(Gdiplus::StringAlignmentCenter);
-    strFormat.SetLineAlignment(Gdiplus::StringAlignmentCenter);
-    Gdiplus::RectF headerRect((Gdiplus::REAL)g_header.rect.left, (Gdiplus::REAL)g_header.rect.top, (Gdiplus::REAL)(g_header.rect.right - g_header.rect.left), (Gdiplus::REAL)(g_header.rect.bottom - g_header.rect.top));
-    bufferGraphics.DrawString(g_header.text.c_str(), -1, &headerFont, headerRect, &strFormat, &whiteBrush);
-
-    Gdiplus::Rect buttonRect(g_punchButton.rect.left, g_punchButton.rect.top, g_punchButton.rect.right - g_punchButton.rect.left, g_punchButton.rect.bottom - g_punchButton.rect.top);
-
-    if (g_appState.isWorking) {
-        DrawRoundedRectangle(bufferGraphics, buttonRect, Gdiplus::Color(255, 244, 67, 54), 10.0f);
-        g_punchButton.text = L"🔴 Pointer Sortie";
-    } else {
-        DrawRoundedRectangle(bufferGraphics, buttonRect, Gdiplus::Color(255, 76, 175, 80), 10.0f);
-        g_punchButton.text = L"🟢 Pointer Entrée";
-    }
-
-    Gdiplus::Font buttonFont(&fontFamily, 18, Gdiplus::FontStyleBold, Gdiplus::UnitPixel);
-    Gdiplus::RectF buttonTextRect(static_cast<Gdiplus::REAL>(buttonRect.X), static_cast<Gdiplus::REAL>(buttonRect.Y), static_cast<Gdiplus::REAL>(buttonRect.Width), static_cast<Gdiplus::REAL>(buttonRect.Height));
-    bufferGraphics.DrawString(g_punchButton.text.c_str(), -1, &buttonFont, buttonTextRect, &strFormat, &whiteBrush);
-
-    Gdiplus::Font statsFont(&fontFamily, 16, Gdiplus::FontStyleRegular, Gdiplus::UnitPixel);
-    Gdiplus::SolidBrush grayBrush(Gdiplus::Color(255, 204, 204, 204));
+DisplayRect ToDisplayRect(const RECT& r) {
+    return { static_cast<int>(r.left), static_cast<int>(r.top), static_cast<int>(r.right), static_cast<int>(r.bottom) };
+}
 
-    Gdiplus::StringFormat labelFormat;
-    labelFormat.SetAlignment(Gdiplus::StringAlignmentNear);
-    labelFormat.SetLineAlignment(Gdiplus::StringAlignmentCenter);
-    Gdiplus::RectF workedTimeLabelRect((Gdiplus::REAL)g_workedTimeLabel.rect.left, (Gdiplus::REAL)g_workedTimeLabel.rect.top, (Gdiplus::REAL)(g_workedTimeLabel.rect.right - g_workedTimeLabel.rect.left), (Gdiplus::REAL)(g_workedTimeLabel.rect.bottom - g_workedTimeLabel.rect.top));
-    bufferGraphics.DrawString(g_workedTimeLabel.text.c_str(), -1, &statsFont, workedTimeLabelRect, &labelFormat, &grayBrush);
+DisplayState CollectDisplayState(const RECT& client) {
+    DisplayState state;
+    state.client = ToDisplayRect(client);
+    state.header = ToDisplayRect(g_header.rect);
+    state.punchButton = ToDisplayRect(g_punchButton.rect);
+    state.workedTimeLabel = ToDisplayRect(g_workedTimeLabel.rect);
+    state.workedTimeValue = ToDisplayRect(g_workedTimeValue.rect);
+    state.monthStats = ToDisplayRect(g_monthStats.rect);
+    state.monthNavPrev = ToDisplayRect(g_monthNavPrev.rect);
+    state.monthNavNext = ToDisplayRect(g_monthNavNext.rect);
+    state.monthNavDisplay = ToDisplayRect(g_monthNavDisplay.rect);
+    state.calendarHeader = ToDisplayRect(g_calendarHeader.rect);
+    state.exportButton = ToDisplayRect(g_exportButton.rect);
+    state.isWorking = g_appState.isWorking;
 
-    Gdiplus::StringFormat valueFormat;
-    valueFormat.SetAlignment(Gdiplus::StringAlignmentFar);
-    valueFormat.SetLineAlignment(Gdiplus::StringAlignmentCenter);
     g_workedTimeValue.text = g_appState.getWorkedDurationString();
-    Gdiplus::RectF workedTimeValueRect((Gdiplus::REAL)g_workedTimeValue.rect.left, (Gdiplus::REAL)g_workedTimeValue.rect.top, (Gdiplus::REAL)(g_workedTimeValue.rect.right - g_workedTimeValue.rect.left), (Gdiplus::REAL)(g_workedTimeValue.rect.bottom - g_workedTimeValue.rect.top));
-    bufferGraphics.DrawString(g_workedTimeValue.text.c_str(), -1, &statsFont, workedTimeValueRect, &valueFormat, &whiteBrush);
-
-    // --- Draw Month Navigation ---
-    bufferGraphics.DrawString(g_monthNavPrev.text.c_str(), -1, &buttonFont, Gdiplus::RectF((Gdiplus::REAL)g_monthNavPrev.rect.left, (Gdiplus::REAL)g_monthNavPrev.rect.top, (Gdiplus::REAL)(g_monthNavPrev.rect.right - g_monthNavPrev.rect.left), (Gdiplus::REAL)(g_monthNavPrev.rect.bottom - g_monthNavPrev.rect.top)), &strFormat, &whiteBrush);
-    bufferGraphics.DrawString(g_monthNavNext.text.c_str(), -1, &buttonFont, Gdiplus::RectF((Gdiplus::REAL)g_monthNavNext.rect.left, (Gdiplus::REAL)g_monthNavNext.rect.top, (Gdiplus::REAL)(g_monthNavNext.rect.right - g_monthNavNext.rect.left), (Gdiplus::REAL)(g_monthNavNext.rect.bottom - g_monthNavNext.rect.top)), &strFormat, &whiteBrush);
-
+    g_monthStats.text = g_appState.getMonthStatsString(g_ticks.currentDayKey());
     wchar_t monthBuffer[100];
     wcsftime(monthBuffer, 100, L"%B %Y", &g_appState.currentViewMonth);
     g_monthNavDisplay.text = monthBuffer;
-    bufferGraphics.DrawString(g_monthNavDisplay.text.c_str(), -1, &statsFont, Gdiplus::RectF((Gdiplus::REAL)g_monthNavDisplay.rect.left, (Gdiplus::REAL)g_monthNavDisplay.rect.top, (Gdiplus::REAL)(g_monthNavDisplay.rect.right - g_monthNavDisplay.rect.left), (Gdiplus::REAL)(g_monthNavDisplay.rect.bottom - g_monthNavDisplay.rect.top)), &strFormat, &whiteBrush);
-
 
-    // --- Draw Calendar ---
-    Gdiplus::Font calendarFont(&fontFamily, 14, Gdiplus::FontStyleRegular, Gdiplus::UnitPixel);
-    const wchar_t* weekdays[] = {L"L", L"M", L"M", L"J", L"V", L"S", L"D"};
-    int dayWidth = (g_calendarHeader.rect.right - g_calendarHeader.rect.left) / 7;
-    for (int i = 0; i < 7; ++i) {
-        Gdiplus::RectF weekdayRect((Gdiplus::REAL)(g_calendarHeader.rect.left + i * dayWidth), (Gdiplus::REAL)g_calendarHeader.rect.top, (Gdiplus::REAL)dayWidth, (Gdiplus::REAL)(g_calendarHeader.rect.bottom - g_calendarHeader.rect.top));
-        bufferGraphics.DrawString(weekdays[i], -1, &calendarFont, weekdayRect, &strFormat, &grayBrush);
+    state.headerText = g_header.text;
+    state.workedTimeLabelText = g_workedTimeLabel.text;
+    state.workedTimeText = g_workedTimeValue.text;
+    state.monthStatsText = g_monthStats.text;
+    state.monthNavPrevText = g_monthNavPrev.text;
+    state.monthNavNextText = g_monthNavNext.text;
+    state.monthTitle = g_monthNavDisplay.text;
+    state.exportButtonText = g_exportButton.text;
+    if (g_export.running()) {
+        size_t total = g_export.rowsTotal();
+        int percent = total ? static_cast<int>(g_export.rowsWritten() * 100 / total) : 0;
+        wchar_t buffer[64];
+        swprintf(buffer, 64, L"⏳ Export en cours… %d%% (cliquer pour annuler)", percent);
+        state.exportButtonText = buffer;
     }
 
+    state.calendar.reserve(g_calendarDays.size());
     for (const auto& day : g_calendarDays) {
-        Gdiplus::SolidBrush dayBrush(Gdiplus::Color(255, 0, 0, 0));
-        switch (day.type) {
-            case DayType::Normal:     dayBrush.SetColor(Gdiplus::Color(0, 0, 0, 0)); break;
-            case DayType::Today:      dayBrush.SetColor(Gdiplus::Color(255, 33, 150, 243)); break;
-            case DayType::OtherMonth: break;
-            case DayType::FullDay:    dayBrush.SetColor(Gdiplus::Color(255, 76, 175, 80)); break;
-            case DayType::PartialDay: dayBrush.SetColor(Gdiplus::Color(255, 255, 152, 0)); break;
-        }
+        state.calendar.push_back({ ToDisplayRect(day.rect), day.dayNumber, day.type });
+    }
+    return state;
+}
 
-        if (day.type != DayType::OtherMonth) {
-             bufferGraphics.FillEllipse(&dayBrush, static_cast<INT>(day.rect.left), static_cast<INT>(day.rect.top), static_cast<INT>(day.rect.right - day.rect.left), static_cast<INT>(day.rect.bottom - day.rect.top));
+// changedText: the item's string differs from the last frame's.
+void DrawDisplayItem(Gdiplus::Graphics& graphics, const DisplayItem& item, bool changedText) {
+    const DisplayRect& r = item.rect;
+    switch (item.kind) {
+        case DisplayItemKind::Background:
+        {
+            Gdiplus::LinearGradientBrush gradBrush(
+                Gdiplus::Point(r.left, r.top),
+                Gdiplus::Point(r.right, r.bottom),
+                Gdiplus::Color(item.argb),
+                Gdiplus::Color(item.argb2)
+            );
+            graphics.FillRectangle(&gradBrush, Gdiplus::Rect(r.left, r.top, r.width(), r.height()));
         }
+        break;
+        case DisplayItemKind::RoundedRect:
+            DrawRoundedRectangle(graphics, Gdiplus::Rect(r.left, r.top, r.width(), r.height()), g_paint->brush(item.argb), item.radius);
+        break;
+        case DisplayItemKind::Ellipse:
+            graphics.FillEllipse(g_paint->brush(item.argb), r.left, r.top, r.width(), r.height());
+        break;
+        case DisplayItemKind::Text:
+            if (changedText && g_paint->drawGlyphRun(graphics, item)) {
+                break;
+            }
+            if (Gdiplus::Bitmap* image = g_paint->text(item)) {
+                graphics.DrawImage(image, Gdiplus::Rect(r.left, r.top, r.width(), r.height()), 0, 0, r.width(), r.height(),
+                                   Gdiplus::UnitPixel);
+            }
+        break;
+    }
+}
 
-        Gdiplus::RectF dayTextRect((Gdiplus::REAL)day.rect.left, (Gdiplus::REAL)day.rect.top, (Gdiplus::REAL)(day.rect.right - day.rect.left), (Gdiplus::REAL)(day.rect.bottom - day.rect.top));
-        Gdiplus::SolidBrush& textColor = (day.type == DayType::OtherMonth) ? grayBrush : whiteBrush;
-        if (day.dayNumber > 0) {
-            bufferGraphics.DrawString(std::to_wstring(day.dayNumber).c_str(), -1, &calendarFont, dayTextRect, &strFormat, &textColor);
-        }
+void OnPaint(HDC hdc, HWND hwnd, const RECT& paintRect)
+{
+    TraceScope trace(TraceSpan::Paint);
+    RECT rc;
+    GetClientRect(hwnd, &rc);
+    int width = rc.right - rc.left;
+    int height = rc.bottom - rc.top;
+    if (width <= 0 || height <= 0) {
+        return;
     }
 
-    // Draw Export Button
-    Gdiplus::Rect exportButtonRect(g_exportButton.rect.left, g_exportButton.rect.top, g_exportButton.rect.right - g_exportButton.rect.left, g_exportButton.rect.bottom - g_exportButton.rect.top);
-    DrawRoundedRectangle(bufferGraphics, exportButtonRect, Gdiplus::Color(255, 100, 100, 100), 5.0f);
-    bufferGraphics.DrawString(g_exportButton.text.c_str(), -1, &statsFont, Gdiplus::RectF((Gdiplus::REAL)exportButtonRect.X, (Gdiplus::REAL)exportButtonRect.Y, (Gdiplus::REAL)exportButtonRect.Width, (Gdiplus::REAL)exportButtonRect.Height), &strFormat, &whiteBrush);
+    if (!g_paint) {
+        g_paint.reset(new PaintResources());
+    }
+    PaintResources& paint = *g_paint;
+    if (!paint.backBuffer || paint.bufferWidth != width || paint.bufferHeight != height) {
+        paint.backBuffer.reset(new Gdiplus::Bitmap(width, height, PixelFormat32bppPARGB));
+        paint.bufferWidth = width;
+        paint.bufferHeight = height;
+        paint.lastFrame.clear(); // forces a full redraw
+    }
 
+    DisplayList frame = buildDisplayList(CollectDisplayState(rc));
+    DisplayDiff diff = diffDisplayLists(paint.lastFrame, frame);
+
+    if (!diff.dirty.empty()) {
+        Gdiplus::Graphics bufferGraphics(paint.backBuffer.get());
+        bufferGraphics.SetSmoothingMode(Gdiplus::SmoothingModeAntiAlias);
+        for (const auto& dirty : diff.dirty) {
+            bufferGraphics.SetClip(Gdiplus::Rect(dirty.left, dirty.top, dirty.width(), dirty.height()));
+            for (const auto& item : frame) {
+                if (item.rect.intersects(dirty)) {
+                    bool changedText = std::binary_search(diff.changedText.begin(), diff.changedText.end(), item.id);
+                    DrawDisplayItem(bufferGraphics, item, changedText);
+                }
+            }
+        }
+        bufferGraphics.ResetClip();
+    }
+    paint.lastFrame = std::move(frame);
+
+    // Copy only what Windows asked us to repaint.
     Gdiplus::Graphics graphics(hdc);
-    graphics.DrawImage(&buffer, 0, 0);
+    int w = paintRect.right - paintRect.left;
+    int h = paintRect.bottom - paintRect.top;
+    graphics.DrawImage(paint.backBuffer.get(), Gdiplus::Rect(paintRect.left, paintRect.top, w, h),
+                       paintRect.left, paintRect.top, w, h, Gdiplus::UnitPixel);
 }
 
-void DrawRoundedRectangle(Gdiplus::Graphics& graphics, Gdiplus::Rect r, Gdiplus::Color color, Gdiplus::REAL radius)
+void DrawRoundedRectangle(Gdiplus::Graphics& graphics, Gdiplus::Rect r, const Gdiplus::Brush* brush, Gdiplus::REAL radius)
 {
     using Gdiplus::REAL;
     Gdiplus::GraphicsPath path;
@@ -590,70 +945,27 @@ void DrawRoundedRectangle(Gdiplus::Graphics& graphics, Gdiplus::Rect r, Gdiplus:
     path.AddArc(static_cast<REAL>(r.X), static_cast<REAL>(r.GetBottom()) - d, d, d, 90, 90);
     path.CloseFigure();
 
-    Gdiplus::SolidBrush brush(color);
-    graphics.FillPath(&brush, &path);
+    graphics.FillPath(brush, &path);
 }
 
 void generateCalendar(int year, int month) {
     g_calendarDays.clear();
 
-    std::tm first_day_tm = {};
-    first_day_tm.tm_year = year - 1900;
-    first_day_tm.tm_mon = month - 1;
-    first_day_tm.tm_mday = 1;
-    std::mktime(&first_day_tm);
+    auto now = std::chrono::system_clock::now();
+    int64_t now_ms = std::chrono::duration_cast<std::chrono::milliseconds>(now.time_since_epoch()).count();
+    int64_t today_key = floorDiv(localOffsetCache().toLocalMinutes(now_ms), 1440);
 
-    int weekday_start = (first_day_tm.tm_wday == 0) ? 6 : first_day_tm.tm_wday - 1;
-
-    int days_in_month = 31;
-    if (month == 4 || month == 6 || month == 9 || month == 11) {
-        days_in_month = 30;
-    } else if (month == 2) {
-        bool is_leap = (year % 4 == 0 && (year % 100 != 0 || year % 400 == 0));
-        days_in_month = is_leap ? 29 : 28;
-    }
+    static std::vector<CalendarDayModel> month_days;
+    buildCalendarMonth(g_appState.history, year, month, today_key, month_days);
 
     int day_size = (g_calendarGrid.rect.right - g_calendarGrid.rect.left) / 7;
-
-    int current_day = 1;
-    for (int row = 0; row < 6; ++row) {
-        for (int col = 0; col < 7; ++col) {
-            if ((row == 0 && col < weekday_start) || current_day > days_in_month) {
-                // empty day cell
-            } else {
-                CalendarDay day;
-                day.rect = {g_calendarGrid.rect.left + col * day_size, g_calendarGrid.rect.top + row * day_size, g_calendarGrid.rect.left + (col + 1) * day_size, g_calendarGrid.rect.top + (row + 1) * day_size};
-                day.dayNumber = current_day;
-
-                auto now = std::chrono::system_clock::now();
-                std::time_t time_now = std::chrono::system_clock::to_time_t(now);
-                std::tm local_tm_now;
-                localtime_s(&local_tm_now, &time_now);
-
-                if (current_day == local_tm_now.tm_mday && month == (local_tm_now.tm_mon + 1) && year == (local_tm_now.tm_year + 1900)) {
-                    day.type = DayType::Today;
-                } else {
-                    day.type = DayType::Normal;
-                }
-
-                std::stringstream ss;
-                ss << year << "-" << std::setw(2) << std::setfill('0') << month << "-" << std::setw(2) << std::setfill('0') << current_day;
-                std::string date_str = ss.str();
-
-                for(const auto& wd : g_appState.history) {
-                    if (wd.date == date_str) {
-                        day.workDayData = &wd;
-                        if (wd.durationMs >= 7 * 3600 * 1000) {
-                            day.type = DayType::FullDay;
-                        } else {
-                            day.type = DayType::PartialDay;
-                        }
-                        break;
-                    }
-                }
-                g_calendarDays.push_back(day);
-                current_day++;
-            }
-        }
+    for (const auto& model : month_days) {
+        CalendarDay day;
+        day.rect = {g_calendarGrid.rect.left + model.col * day_size, g_calendarGrid.rect.top + model.row * day_size, g_calendarGrid.rect.left + (model.col + 1) * day_size, g_calendarGrid.rect.top + (model.row + 1) * day_size};
+        day.dayNumber = model.dayNumber;
+        day.type = model.type;
+        day.sessions = model.sessions;
+        day.totalMs = model.totalMs;
+        g_calendarDays.push_back(day);
     }
 }
@@ -0,0 +1,124 @@
+#include "mapped_file.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::~MappedFile() {
+    close();
+}
+
+#ifdef _WIN32
+
+bool MappedFile::open(const std::string& path) {
+    close();
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL,
+                              OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (file == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    LARGE_INTEGER size;
+    BY_HANDLE_FILE_INFORMATION info;
+    FILE_BASIC_INFO times;
+    if (!GetFileSizeEx(file, &size) || !GetFileInformationByHandle(file, &info) ||
+        !GetFileInformationByHandleEx(file, FileBasicInfo, &times, sizeof(times))) {
+        CloseHandle(file);
+        return false;
+    }
+    opened = true;
+    length = static_cast<size_t>(size.QuadPart);
+    id.volume = info.dwVolumeSerialNumber;
+    id.file = (static_cast<uint64_t>(info.nFileIndexHigh) << 32) | info.nFileIndexLow;
+    id.size = static_cast<uint64_t>(size.QuadPart);
+    id.written = times.LastWriteTime.QuadPart;
+    id.changed = times.ChangeTime.QuadPart;
+    if (length == 0) {
+        CloseHandle(file);
+        return true;
+    }
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (mapping == NULL) {
+        CloseHandle(file);
+        opened = false;
+        return false;
+    }
+    base = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+    if (!base) {
+        CloseHandle(mapping);
+        CloseHandle(file);
+        opened = false;
+        return false;
+    }
+    fileHandle = file;
+    mappingHandle = mapping;
+    return true;
+}
+
+void MappedFile::close() {
+    if (base) {
+        UnmapViewOfFile(base);
+    }
+    if (mappingHandle) {
+        CloseHandle(mappingHandle);
+    }
+    if (fileHandle) {
+        CloseHandle(fileHandle);
+    }
+    base = nullptr;
+    mappingHandle = nullptr;
+    fileHandle = nullptr;
+    length = 0;
+    id = Identity();
+    opened = false;
+}
+
+#else
+
+bool MappedFile::open(const std::string& path) {
+    close();
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        ::close(fd);
+        return false;
+    }
+    opened = true;
+    length = static_cast<size_t>(st.st_size);
+    id.volume = static_cast<uint64_t>(st.st_dev);
+    id.file = static_cast<uint64_t>(st.st_ino);
+    id.size = static_cast<uint64_t>(st.st_size);
+    id.written = st.st_mtim.tv_sec * 1000000000LL + st.st_mtim.tv_nsec;
+    id.changed = st.st_ctim.tv_sec * 1000000000LL + st.st_ctim.tv_nsec;
+    if (length > 0) {
+        void* p = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p == MAP_FAILED) {
+            ::close(fd);
+            opened = false;
+            length = 0;
+            return false;
+        }
+        base = static_cast<const char*>(p);
+    }
+    ::close(fd); // the mapping keeps its own reference
+    return true;
+}
+
+void MappedFile::close() {
+    if (base) {
+        munmap(const_cast<char*>(base), length);
+    }
+    base = nullptr;
+    length = 0;
+    id = Identity();
+    opened = false;
+}
+
+#endif
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <tuple>
+
+// --- Read-only Memory-Mapped File ---
+
+class MappedFile {
+public:
+    // Which file is mapped, and which version of it: the volume and file
+    // ids, the size and the last write and change times. A rename over the
+    // file or a write to it gives a different identity.
+    struct Identity {
+        uint64_t volume = 0;
+        uint64_t file = 0;
+        uint64_t size = 0;
+        int64_t written = 0;
+        int64_t changed = 0;
+
+        bool operator<(const Identity& o) const {
+            return std::tie(volume, file, size, written, changed) <
+                   std::tie(o.volume, o.file, o.size, o.written, o.changed);
+        }
+    };
+
+    MappedFile() = default;
+    ~MappedFile();
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool open(const std::string& path);
+    void close();
+
+    const char* data() const { return base; }
+    size_t size() const { return length; }
+    bool isOpen() const { return opened; }
+    const Identity& identity() const { return id; }
+
+private:
+    const char* base = nullptr;
+    size_t length = 0;
+    Identity id;
+    bool opened = false; // empty files map to nothing but still count as open
+#ifdef _WIN32
+    void* fileHandle = nullptr;
+    void* mappingHandle = nullptr;
+#endif
+};
@@ -0,0 +1,102 @@
+#include "persistence.h"
+
+#include "trace.h"
+
+PersistenceService::PersistenceService(Journal& journal, SnapshotFn snapshot, LogFn log, CompactedFn compacted)
+    : journal(journal), snapshot(std::move(snapshot)), log(std::move(log)), compacted(std::move(compacted)) {}
+
+PersistenceService::~PersistenceService() {
+    stop();
+}
+
+void PersistenceService::start() {
+    if (writer.joinable()) {
+        return;
+    }
+    stopping = false;
+    writer = std::thread(&PersistenceService::run, this);
+}
+
+void PersistenceService::stop() {
+    {
+        std::lock_guard<std::mutex> guard(mutex);
+        stopping = true;
+    }
+    wake.notify_one();
+    if (writer.joinable()) {
+        writer.join();
+    }
+}
+
+void PersistenceService::enqueueAppend(const WorkDay& day) {
+    {
+        std::lock_guard<std::mutex> guard(mutex);
+        pendingAppends.push_back(day);
+    }
+    wake.notify_one();
+}
+
+void PersistenceService::enqueueCompact() {
+    {
+        std::lock_guard<std::mutex> guard(mutex);
+        compactRequested = true;
+    }
+    wake.notify_one();
+}
+
+void PersistenceService::flush() {
+    std::unique_lock<std::mutex> guard(mutex);
+    idle.wait(guard, [this] {
+        return !writer.joinable() || (!writing && pendingAppends.empty() && !compactRequested);
+    });
+}
+
+void PersistenceService::run() {
+    std::vector<WorkDay> appends;
+    Config config;
+    std::vector<WorkDay> history;
+
+    for (;;) {
+        bool compact;
+        {
+            std::unique_lock<std::mutex> guard(mutex);
+            writing = false;
+            idle.notify_all();
+            wake.wait(guard, [this] { return stopping || compactRequested || !pendingAppends.empty(); });
+            if (!compactRequested && pendingAppends.empty()) {
+                return; // stopping with nothing left to write
+            }
+            appends.swap(pendingAppends);
+            compact = compactRequested;
+            compactRequested = false;
+            writing = true;
+        }
+
+        TraceScope trace(TraceSpan::Save);
+        // Appended even when a compaction follows: other instances sharing
+        // the store pick sessions up from the journal (see journal.h).
+        if (!appends.empty()) {
+            if (!journal.append(appends)) {
+                log("Failed to append to journal, rewriting snapshot.\n");
+                compact = true;
+            } else if (journal.needsCompaction()) {
+                compact = true;
+            }
+        }
+        appends.clear();
+
+        if (compact) {
+            if (!snapshot(config, history)) {
+                log("Could not read the history, compaction skipped.\n");
+            } else if (journal.compact(config, history)) {
+                log("Data saved successfully.\n");
+                if (compacted) {
+                    compacted();
+                }
+            } else {
+                log("Failed to write data snapshot.\n");
+            }
+            history.clear();
+        }
+    }
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "journal.h"
+
+// --- Background Persistence ---
+//
+// Owns all disk writes once started: the UI thread only enqueues. A single
+// writer thread drains the queue, so a burst of punches becomes one journal
+// write and one fsync, and any number of save requests become one
+// compaction (temp file + fsync + atomic rename, see Journal::compact).
+
+class PersistenceService {
+public:
+    // Fills config and a chronological copy of the history, or returns false
+    // to skip the compaction (the history could not be read). With
+    // history.bin the sessions not yet in the snapshot are enough (see
+    // Journal::compact). Called on the writer thread; it must take whatever
+    // lock guards the history.
+    using SnapshotFn = std::function<bool(Config&, std::vector<WorkDay>&)>;
+    // Called on the writer thread once that copy is in the snapshot.
+    using CompactedFn = std::function<void()>;
+    using LogFn = std::function<void(const char*)>;
+
+    PersistenceService(Journal& journal, SnapshotFn snapshot, LogFn log, CompactedFn compacted = nullptr);
+    ~PersistenceService();
+    PersistenceService(const PersistenceService&) = delete;
+    PersistenceService& operator=(const PersistenceService&) = delete;
+
+    void start();
+    // Writes everything queued, then stops the writer thread.
+    void stop();
+
+    void enqueueAppend(const WorkDay& day);
+    void enqueueCompact();
+
+    // Blocks until everything enqueued so far is on disk.
+    void flush();
+
+private:
+    void run();
+
+    Journal& journal;
+    SnapshotFn snapshot;
+    LogFn log;
+    CompactedFn compacted;
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable idle;
+    std::vector<WorkDay> pendingAppends;
+    bool compactRequested = false;
+    bool writing = false;
+    bool stopping = false;
+    std::thread writer;
+};
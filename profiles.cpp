@@ -0,0 +1,89 @@
+#include "profiles.h"
+
+#include <algorithm>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <sys/stat.h>
+#endif
+
+#ifdef _WIN32
+static const char kPathSeparator = '\\';
+#else
+static const char kPathSeparator = '/';
+#endif
+
+bool isValidProfileName(const std::string& name) {
+    if (name.empty() || name.size() > 64 || name[0] == '.') {
+        return false;
+    }
+    for (char c : name) {
+        bool ok = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') ||
+                  c == '-' || c == '_' || c == '.';
+        if (!ok) {
+            return false;
+        }
+    }
+    return true;
+}
+
+std::string profilesDirectory(const std::string& root) {
+    return root + kPathSeparator + "profiles";
+}
+
+std::string profileDirectory(const std::string& root, const std::string& name) {
+    return profilesDirectory(root) + kPathSeparator + name;
+}
+
+std::string profileStorePath(const std::string& root, const std::string& name) {
+    return profileDirectory(root, name) + kPathSeparator + "history.bin";
+}
+
+static bool makeDirectory(const std::string& path) {
+#ifdef _WIN32
+    return CreateDirectoryA(path.c_str(), NULL) || GetLastError() == ERROR_ALREADY_EXISTS;
+#else
+    struct stat st;
+    return mkdir(path.c_str(), 0755) == 0 || (stat(path.c_str(), &st) == 0 && S_ISDIR(st.st_mode));
+#endif
+}
+
+bool ensureProfileDirectory(const std::string& root, const std::string& name) {
+    return isValidProfileName(name) && makeDirectory(profilesDirectory(root)) &&
+           makeDirectory(profileDirectory(root, name));
+}
+
+std::vector<std::string> listProfiles(const std::string& root) {
+    std::vector<std::string> names;
+    std::string dir = profilesDirectory(root);
+#ifdef _WIN32
+    WIN32_FIND_DATAA entry;
+    HANDLE find = FindFirstFileA((dir + "\\*").c_str(), &entry);
+    if (find == INVALID_HANDLE_VALUE) {
+        return names;
+    }
+    do {
+        if ((entry.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) && isValidProfileName(entry.cFileName)) {
+            names.push_back(entry.cFileName);
+        }
+    } while (FindNextFileA(find, &entry));
+    FindClose(find);
+#else
+    DIR* handle = opendir(dir.c_str());
+    if (!handle) {
+        return names;
+    }
+    while (dirent* entry = readdir(handle)) {
+        struct stat st;
+        if (isValidProfileName(entry->d_name) && stat((dir + "/" + entry->d_name).c_str(), &st) == 0 &&
+            S_ISDIR(st.st_mode)) {
+            names.push_back(entry->d_name);
+        }
+    }
+    closedir(handle);
+#endif
+    std::sort(names.begin(), names.end());
+    return names;
+}
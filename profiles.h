@@ -0,0 +1,26 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// --- Profile Shards ---
+//
+// In multi-profile mode every employee has a shard of their own under the
+// data root:
+//
+//   <root>/profiles/<name>/history.bin (+ .journal)
+//
+// Each shard is an ordinary store with its own config line and history, so
+// it is opened, journaled and compacted exactly like the single-user one.
+
+bool isValidProfileName(const std::string& name);
+
+std::string profilesDirectory(const std::string& root);
+std::string profileDirectory(const std::string& root, const std::string& name);
+std::string profileStorePath(const std::string& root, const std::string& name);
+
+// Creates <root>/profiles/<name>/ if needed.
+bool ensureProfileDirectory(const std::string& root, const std::string& name);
+
+// Names of every profile directory under the root, sorted.
+std::vector<std::string> listProfiles(const std::string& root);
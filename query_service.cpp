@@ -0,0 +1,488 @@
+#include "query_service.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#ifndef PIPE_REJECT_REMOTE_CLIENTS
+#define PIPE_REJECT_REMOTE_CLIENTS 0x00000008
+#endif
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+#include "civil_time.h"
+#include "json_sax.h"
+#include "time_format.h"
+#include "trace.h"
+
+namespace {
+
+void appendJsonString(std::string& out, std::string_view text) {
+    out += '"';
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            char escaped[8];
+            std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+            out += escaped;
+        } else {
+            out += c;
+        }
+    }
+    out += '"';
+}
+
+void appendf(std::string& out, const char* format, ...) __attribute__((format(printf, 2, 3)));
+
+void appendf(std::string& out, const char* format, ...) {
+    char buffer[256];
+    va_list args;
+    va_start(args, format);
+    int n = std::vsnprintf(buffer, sizeof(buffer), format, args);
+    va_end(args);
+    if (n > 0) {
+        out.append(buffer, std::min(static_cast<size_t>(n), sizeof(buffer) - 1));
+    }
+}
+
+void appendDate(std::string& out, int64_t dayKey) {
+    char date[kDateChars];
+    formatLocalDate(dayKey * 1440, date);
+    out += date;
+}
+
+// A flat request object: string and number fields, kept as written.
+class RequestReader : public JsonSaxHandler {
+public:
+    std::string op, id, date, month, from, to;
+
+    bool startObject() override { return ++depth == 1; }
+    bool endObject() override { --depth; return true; }
+    bool startArray() override { return false; }
+    bool endArray() override { return false; }
+    bool key(std::string_view name) override {
+        field = name == "op" ? &op : name == "id" ? &id : name == "date" ? &date : name == "month" ? &month
+              : name == "from" ? &from : name == "to" ? &to : nullptr;
+        partial.clear();
+        return true;
+    }
+    bool stringPart(std::string_view part, bool last) override {
+        partial.append(part.data(), part.size());
+        if (last && field) {
+            if (field == &id) {
+                id.clear();
+                appendJsonString(id, partial);
+            } else {
+                *field = partial;
+            }
+        }
+        return true;
+    }
+    bool number(std::string_view text) override {
+        if (field == &id) {
+            id.assign(text.data(), text.size());
+        }
+        return true;
+    }
+    bool literal(JsonLiteral) override { return true; }
+
+private:
+    int depth = 0;
+    std::string* field = nullptr;
+    std::string partial;
+};
+
+// "YYYY-MM" -> [first day, first day of the next month).
+bool parseMonth(std::string_view s, int64_t& first, int64_t& last) {
+    int year, month;
+    if (s.size() != 7 || s[4] != '-' || !parseDigits(s.data(), 4, year) || !parseDigits(s.data() + 5, 2, month) ||
+        month < 1 || month > 12) {
+        return false;
+    }
+    first = daysFromCivil(year, static_cast<unsigned>(month), 1);
+    last = month == 12 ? daysFromCivil(year + 1, 1, 1) : daysFromCivil(year, static_cast<unsigned>(month) + 1, 1);
+    return true;
+}
+
+bool parseRange(const RequestReader& request, int64_t& first, int64_t& last) {
+    if (!request.date.empty()) {
+        if (!parseDateKey(request.date, first) || request.date.size() != 10) {
+            return false;
+        }
+        last = first + 1;
+        return true;
+    }
+    if (!request.month.empty()) {
+        return parseMonth(request.month, first, last);
+    }
+    return request.from.size() == 10 && request.to.size() == 10 && parseDateKey(request.from, first) &&
+           parseDateKey(request.to, last) && first <= last;
+}
+
+void beginAnswer(std::string& out, const std::string& id) {
+    out += '{';
+    if (!id.empty()) {
+        out += "\"id\":";
+        out += id;
+        out += ',';
+    }
+}
+
+void answerError(std::string& out, const std::string& id, const char* error) {
+    beginAnswer(out, id);
+    out += "\"ok\":false,\"error\":";
+    appendJsonString(out, error);
+    out += "}\n";
+}
+
+} // namespace
+
+size_t QueryService::handle(std::string_view input, std::string& out) {
+    TraceScope trace(TraceSpan::Query);
+    size_t consumed = 0;
+    while (consumed < input.size()) {
+        size_t eol = input.find('\n', consumed);
+        if (eol == std::string_view::npos) {
+            break;
+        }
+        std::string_view line = input.substr(consumed, eol - consumed);
+        consumed = eol + 1;
+        if (line.find_first_not_of(" \t\r") != std::string_view::npos) {
+            answer(line, out);
+        }
+    }
+    return consumed;
+}
+
+void QueryService::answer(std::string_view line, std::string& out) {
+    requestCount.fetch_add(1, std::memory_order_relaxed);
+    RequestReader request;
+    JsonSaxParser parser(request);
+    if (!parser.feed(line.data(), line.size()) || !parser.finish()) {
+        answerError(out, request.id, "request is not a flat JSON object");
+        return;
+    }
+    int64_t first = 0, last = 0;
+    if (request.op == "totals") {
+        if (!parseRange(request, first, last)) {
+            answerError(out, request.id, "expected date, month or from/to");
+            return;
+        }
+        bool complete;
+        Totals t = state.queryTotals(first, last, complete);
+        beginAnswer(out, request.id);
+        out += "\"ok\":true,\"from\":\"";
+        appendDate(out, first);
+        out += "\",\"to\":\"";
+        appendDate(out, last);
+        appendf(out, "\",\"complete\":%s,\"durationMs\":%lld,\"gross\":%.2f,\"net\":%.2f,\"sessions\":%d,"
+                     "\"daysWorked\":%d}\n",
+                complete ? "true" : "false", t.durationMs, t.grossCents() / 100.0, t.netCents() / 100.0, t.sessions,
+                t.daysWorked);
+    } else if (request.op == "sessions") {
+        std::vector<WorkDay> sessions;
+        if (!parseRange(request, first, last)) {
+            answerError(out, request.id, "expected date, month or from/to");
+            return;
+        }
+        if (!state.querySessions(first, last, sessions)) {
+            answerError(out, request.id, "history is unreadable");
+            return;
+        }
+        beginAnswer(out, request.id);
+        out += "\"ok\":true,\"sessions\":[";
+        for (size_t i = 0; i < sessions.size(); ++i) {
+            const WorkDay& day = sessions[i];
+            char start[kISOChars], end[kISOChars];
+            formatUtcISO(day.startMs, start);
+            formatUtcISO(day.endMs, end);
+            appendf(out, "%s{\"start\":\"%s\",\"end\":\"%s\",\"startOffsetMin\":%d,\"endOffsetMin\":%d,"
+                         "\"durationMs\":%lld,\"hourlyGross\":%.2f,\"hourlyNet\":%.2f}",
+                    i == 0 ? "" : ",", start, end, day.startUtcOffsetMin, day.endUtcOffsetMin, day.durationMs(),
+                    day.hourlyGross(), day.hourlyNet());
+        }
+        out += "]}\n";
+    } else if (request.op == "state") {
+        AppState::SessionStatus status = state.querySession();
+        long long runningMs = 0;
+        if (status.working) {
+            using std::chrono::duration_cast;
+            using std::chrono::milliseconds;
+            int64_t now = duration_cast<milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+            runningMs = std::max<long long>(0, now - status.startMs);
+        }
+        beginAnswer(out, request.id);
+        appendf(out, "\"ok\":true,\"working\":%s,\"startMs\":%lld,\"runningMs\":%lld,\"hourlyGross\":%.2f,"
+                     "\"hourlyNet\":%.2f}\n",
+                status.working ? "true" : "false", static_cast<long long>(status.startMs), runningMs,
+                status.rate.hourlyGross, status.rate.hourlyNet);
+    } else {
+        answerError(out, request.id, "unknown op");
+    }
+}
+
+// --- Transport ---
+
+QueryServer::QueryServer(QueryService& service, LogFn logFn)
+    : service(service), log(logFn ? std::move(logFn) : LogFn([](const char*) {})) {}
+
+QueryServer::~QueryServer() {
+    stop();
+}
+
+#ifdef _WIN32
+
+bool QueryServer::start(const std::string& endpoint) {
+    if (acceptor.joinable()) {
+        return false;
+    }
+    path = endpoint.compare(0, 2, "\\\\") == 0 ? endpoint : "\\\\.\\pipe\\" + endpoint;
+    stopEvent = CreateEventA(NULL, TRUE, FALSE, NULL);
+    if (stopEvent == NULL) {
+        return false;
+    }
+    stopping = false;
+    acceptor = std::thread([this] { run(); });
+    return true;
+}
+
+void QueryServer::stop() {
+    if (!acceptor.joinable()) {
+        return;
+    }
+    stopping = true;
+    SetEvent(static_cast<HANDLE>(stopEvent));
+    acceptor.join();
+    for (Client& client : clients) {
+        client.thread.join();
+    }
+    clients.clear();
+    CloseHandle(static_cast<HANDLE>(stopEvent));
+    stopEvent = nullptr;
+}
+
+// Waits for an overlapped transfer, or cancels it when the server stops.
+static bool finishTransfer(HANDLE pipe, OVERLAPPED& overlapped, HANDLE stopEvent, DWORD& bytes) {
+    HANDLE waits[2] = { overlapped.hEvent, stopEvent };
+    if (WaitForMultipleObjects(2, waits, FALSE, INFINITE) != WAIT_OBJECT_0) {
+        CancelIo(pipe);
+        GetOverlappedResult(pipe, &overlapped, &bytes, TRUE);
+        return false;
+    }
+    return GetOverlappedResult(pipe, &overlapped, &bytes, FALSE) != 0;
+}
+
+void QueryServer::run() {
+    HANDLE connected = CreateEventA(NULL, TRUE, FALSE, NULL);
+    while (!stopping) {
+        // Finished clients are joined here rather than piling up.
+        for (auto it = clients.begin(); it != clients.end();) {
+            if (it->done) {
+                it->thread.join();
+                it = clients.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        HANDLE pipe = CreateNamedPipeA(path.c_str(), PIPE_ACCESS_DUPLEX | FILE_FLAG_OVERLAPPED,
+                                       PIPE_TYPE_BYTE | PIPE_READMODE_BYTE | PIPE_WAIT | PIPE_REJECT_REMOTE_CLIENTS,
+                                       PIPE_UNLIMITED_INSTANCES, 64 * 1024, 64 * 1024, 0, NULL);
+        if (pipe == INVALID_HANDLE_VALUE) {
+            log("Query service: cannot create the named pipe.\n");
+            break;
+        }
+        OVERLAPPED overlapped = {};
+        overlapped.hEvent = connected;
+        ResetEvent(connected);
+        DWORD bytes = 0;
+        bool ok = ConnectNamedPipe(pipe, &overlapped) != 0 || GetLastError() == ERROR_PIPE_CONNECTED;
+        if (!ok && GetLastError() == ERROR_IO_PENDING) {
+            ok = finishTransfer(pipe, overlapped, static_cast<HANDLE>(stopEvent), bytes);
+        }
+        if (!ok) {
+            CloseHandle(pipe);
+            continue;
+        }
+        clients.emplace_back();
+        Client& client = clients.back();
+        client.thread = std::thread([this, pipe, &client] { serveClient(pipe, client); });
+    }
+    CloseHandle(connected);
+}
+
+void QueryServer::serveClient(void* handle, Client& client) {
+    HANDLE pipe = static_cast<HANDLE>(handle);
+    HANDLE io = CreateEventA(NULL, TRUE, FALSE, NULL);
+    auto transfer = [&](bool write, char* data, DWORD size, DWORD& bytes) {
+        OVERLAPPED overlapped = {};
+        overlapped.hEvent = io;
+        ResetEvent(io);
+        BOOL ok = write ? WriteFile(pipe, data, size, NULL, &overlapped) : ReadFile(pipe, data, size, NULL, &overlapped);
+        if (!ok && GetLastError() != ERROR_IO_PENDING) {
+            return false;
+        }
+        return finishTransfer(pipe, overlapped, static_cast<HANDLE>(stopEvent), bytes);
+    };
+    std::vector<char> buffer(64 * 1024);
+    std::string in, out;
+    DWORD bytes = 0;
+    while (!stopping && transfer(false, buffer.data(), static_cast<DWORD>(buffer.size()), bytes) && bytes > 0) {
+        in.append(buffer.data(), bytes);
+        in.erase(0, service.handle(in, out));
+        if (in.size() > kMaxLineBytes) {
+            break;
+        }
+        size_t sent = 0;
+        while (sent < out.size() && transfer(true, &out[sent], static_cast<DWORD>(out.size() - sent), bytes)) {
+            sent += bytes;
+        }
+        if (sent < out.size()) {
+            break;
+        }
+        out.clear();
+    }
+    DisconnectNamedPipe(pipe);
+    CloseHandle(pipe);
+    CloseHandle(io);
+    client.done = true;
+}
+
+#else
+
+bool QueryServer::start(const std::string& endpoint) {
+    sockaddr_un address = {};
+    if (acceptor.joinable() || endpoint.empty() || endpoint.size() >= sizeof(address.sun_path)) {
+        return false;
+    }
+    path = endpoint;
+    address.sun_family = AF_UNIX;
+    std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+    listenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listenFd < 0) {
+        return false;
+    }
+    unlink(path.c_str());
+    if (bind(listenFd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+        chmod(path.c_str(), 0600) != 0 || listen(listenFd, 16) != 0 || pipe(wakeFds) != 0) {
+        log("Query service: cannot listen on the socket.\n");
+        close(listenFd);
+        listenFd = -1;
+        return false;
+    }
+    fcntl(listenFd, F_SETFL, O_NONBLOCK);
+    stopping = false;
+    acceptor = std::thread([this] { run(); });
+    return true;
+}
+
+void QueryServer::stop() {
+    if (!acceptor.joinable()) {
+        return;
+    }
+    stopping = true;
+    char wake = 1;
+    (void)!write(wakeFds[1], &wake, 1);
+    acceptor.join();
+    close(listenFd);
+    close(wakeFds[0]);
+    close(wakeFds[1]);
+    listenFd = wakeFds[0] = wakeFds[1] = -1;
+    unlink(path.c_str());
+}
+
+void QueryServer::run() {
+    struct Client {
+        int fd;
+        std::string in, out;
+        bool closing = false;   // no more input; close once out is sent
+    };
+    std::vector<Client> clients;
+    std::vector<pollfd> fds;
+    std::vector<char> buffer(64 * 1024);
+    while (!stopping) {
+        fds.clear();
+        fds.push_back(pollfd{ listenFd, POLLIN, 0 });
+        fds.push_back(pollfd{ wakeFds[0], POLLIN, 0 });
+        for (const Client& client : clients) {
+            short events = 0;
+            if (!client.closing && client.out.size() < kMaxPendingOutput) events |= POLLIN;
+            if (!client.out.empty()) events |= POLLOUT;
+            fds.push_back(pollfd{ client.fd, events, 0 });
+        }
+        if (poll(fds.data(), fds.size(), -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        if (fds[1].revents != 0) {
+            break;
+        }
+        for (size_t i = 0; i < clients.size(); ++i) {
+            Client& client = clients[i];
+            short revents = fds[i + 2].revents;
+            if (revents & (POLLIN | POLLHUP | POLLERR)) {
+                ssize_t n;
+                while ((n = read(client.fd, buffer.data(), buffer.size())) > 0) {
+                    client.in.append(buffer.data(), static_cast<size_t>(n));
+                    if (client.in.size() > kMaxLineBytes + buffer.size()) {
+                        break;
+                    }
+                }
+                if (n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+                    client.closing = true;
+                }
+                client.in.erase(0, service.handle(client.in, client.out));
+                if (client.in.size() > kMaxLineBytes) {
+                    client.closing = true;
+                    client.in.clear();
+                }
+            }
+            while (!client.out.empty()) {
+                ssize_t n = send(client.fd, client.out.data(), client.out.size(), MSG_NOSIGNAL);
+                if (n <= 0) {
+                    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                        break;
+                    }
+                    client.closing = true;
+                    client.out.clear();
+                    break;
+                }
+                client.out.erase(0, static_cast<size_t>(n));
+            }
+        }
+        for (size_t i = clients.size(); i-- > 0;) {
+            if (clients[i].closing && clients[i].out.empty()) {
+                close(clients[i].fd);
+                clients.erase(clients.begin() + static_cast<std::ptrdiff_t>(i));
+            }
+        }
+        if (fds[0].revents & POLLIN) {
+            int fd;
+            while ((fd = accept(listenFd, nullptr, nullptr)) >= 0) {
+                fcntl(fd, F_SETFL, O_NONBLOCK);
+                fcntl(fd, F_SETFD, FD_CLOEXEC);
+                clients.push_back(Client{ fd, std::string(), std::string() });
+            }
+        }
+    }
+    for (const Client& client : clients) {
+        close(client.fd);
+    }
+}
+
+#endif
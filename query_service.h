@@ -0,0 +1,101 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+
+#include "app_state.h"
+
+// --- Local Query Service ---
+//
+// Lets scripts on the same machine ask the running tracker for totals and
+// sessions instead of parsing its store, which races with compaction. The
+// answers come from the in-memory state (AppState's query* reads), so they
+// include the running session and what is still in the journal.
+//
+// Wire format: one JSON object per line in, one per line out, in order.
+// Clients may write any number of requests before reading the answers;
+// everything complete in one read is answered with a single write.
+//
+//   {"id":1,"op":"totals","month":"2024-06"}
+//   {"id":1,"ok":true,"from":"2024-06-01","to":"2024-07-01","complete":true,"durationMs":...,
+//    "gross":...,"net":...,"sessions":...,"daysWorked":...}
+//   {"id":2,"op":"sessions","date":"2024-06-03"}
+//   {"id":2,"ok":true,"sessions":[{"start":"2024-06-03T06:58:00Z","end":"...","startOffsetMin":120,
+//    "endOffsetMin":120,"durationMs":...,"hourlyGross":...,"hourlyNet":...}]}
+//   {"id":3,"op":"state"}
+//   {"id":3,"ok":true,"working":true,"startMs":...,"runningMs":...,"hourlyGross":...,"hourlyNet":...}
+//
+// A range is "date" (one day), "month" ("YYYY-MM") or "from" and "to"
+// ("YYYY-MM-DD", to exclusive). id is optional and echoed as sent. A
+// request that cannot be answered gets {"id":..,"ok":false,"error":"..."}.
+// totals are "complete":false until the background load has finished.
+
+class QueryService {
+public:
+    explicit QueryService(AppState& state) : state(state) {}
+
+    // Answers every complete line of input, appending one line to out for
+    // each, and returns the bytes consumed (through the last newline).
+    size_t handle(std::string_view input, std::string& out);
+
+    uint64_t requests() const { return requestCount.load(std::memory_order_relaxed); }
+
+private:
+    void answer(std::string_view line, std::string& out);
+
+    AppState& state;
+    std::atomic<uint64_t> requestCount{0};
+};
+
+// Serves a QueryService on a Unix-domain socket (mode 0600) or, on Windows,
+// a named pipe that refuses remote clients. One background thread on
+// Linux, polling every connection; on Windows one per connected client.
+class QueryServer {
+public:
+    using LogFn = std::function<void(const char*)>;
+
+    // A client whose request line grows past this is disconnected.
+    static const size_t kMaxLineBytes = 64 * 1024;
+    // Stop reading from a client while this much output is unsent.
+    static const size_t kMaxPendingOutput = 1024 * 1024;
+
+    explicit QueryServer(QueryService& service, LogFn log = nullptr);
+    ~QueryServer();
+    QueryServer(const QueryServer&) = delete;
+    QueryServer& operator=(const QueryServer&) = delete;
+
+    // endpoint: a socket path, or a pipe name ("timetracker" is
+    // \\.\pipe\timetracker). A stale socket file is replaced.
+    bool start(const std::string& endpoint);
+    // Closes every connection and waits for the threads.
+    void stop();
+
+private:
+    void run();
+#ifdef _WIN32
+    struct Client {
+        std::thread thread;
+        std::atomic<bool> done{false};
+    };
+    void serveClient(void* pipe, Client& client);
+
+    std::list<Client> clients;
+    void* stopEvent = nullptr;
+#else
+    int listenFd = -1;
+    int wakeFds[2] = { -1, -1 };
+#endif
+
+    QueryService& service;
+    LogFn log;
+    std::string path;
+    std::thread acceptor;
+    std::atomic<bool> stopping{false};
+};
@@ -0,0 +1,178 @@
+#include "rollup.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "archive.h"
+#include "civil_time.h"
+
+void RollupEngine::clear() {
+    baseDay = 0;
+    perDay.clear();
+    tree.clear();
+    archive.reset();
+}
+
+void RollupEngine::rebuild(const HistoryStore& history) {
+    clear();
+    if (history.empty()) {
+        return;
+    }
+    baseDay = history[0].dayKey();
+    perDay.assign(static_cast<size_t>(history[history.size() - 1].dayKey() - baseDay + 1), Cell());
+    for (const auto& session : history) {
+        Cell& cell = perDay[static_cast<size_t>(session.dayKey() - baseDay)];
+        cell.durationMs += session.durationMs();
+        cell.gross.add(grossMsCents(session));
+        cell.net.add(netMsCents(session));
+        cell.sessions++;
+        cell.daysWorked = 1;
+    }
+    rebuildTree();
+}
+
+void RollupEngine::ensureCovers(int64_t dayKey) {
+    if (perDay.empty()) {
+        baseDay = dayKey;
+    }
+    if (dayKey >= baseDay && dayKey < baseDay + static_cast<int64_t>(perDay.size())) {
+        return;
+    }
+    // Grow geometrically in the needed direction, then rebuild the tree.
+    int64_t first = std::min(baseDay, dayKey);
+    int64_t last = std::max(baseDay + static_cast<int64_t>(perDay.size()), dayKey + 1);
+    int64_t span = std::max<int64_t>(last - first, static_cast<int64_t>(perDay.size()) * 2);
+    span = std::max<int64_t>(span, 64);
+    if (dayKey < baseDay) {
+        first = last - span;
+    } else {
+        last = first + span;
+    }
+
+    std::vector<Cell> grown(static_cast<size_t>(last - first));
+    for (size_t i = 0; i < perDay.size(); ++i) {
+        grown[static_cast<size_t>(baseDay - first) + i] = perDay[i];
+    }
+    perDay.swap(grown);
+    baseDay = first;
+
+    rebuildTree();
+}
+
+// O(D) Fenwick construction: each node pushes its sum to its parent once.
+void RollupEngine::rebuildTree() {
+    tree.assign(perDay.size() + 1, Cell());
+    for (size_t i = 1; i <= perDay.size(); ++i) {
+        tree[i].add(perDay[i - 1]);
+        size_t parent = i + (i & (~i + 1));
+        if (parent <= perDay.size()) {
+            tree[parent].add(tree[i]);
+        }
+    }
+}
+
+void RollupEngine::fenwickAdd(size_t index, const Cell& delta) {
+    for (size_t i = index + 1; i < tree.size(); i += i & (~i + 1)) {
+        tree[i].add(delta);
+    }
+}
+
+void RollupEngine::add(const WorkDay& session) {
+    int64_t key = session.dayKey();
+    ensureCovers(key);
+    size_t index = static_cast<size_t>(key - baseDay);
+
+    Cell delta;
+    delta.durationMs = session.durationMs();
+    delta.gross.add(grossMsCents(session));
+    delta.net.add(netMsCents(session));
+    delta.sessions = 1;
+    delta.daysWorked = perDay[index].sessions == 0 ? 1 : 0;
+    perDay[index].add(delta);
+    fenwickAdd(index, delta);
+}
+
+RollupEngine::Cell RollupEngine::prefix(size_t count) const {
+    Cell sum;
+    for (size_t i = std::min(count, perDay.size()); i > 0; i -= i & (~i + 1)) {
+        sum.add(tree[i]);
+    }
+    return sum;
+}
+
+RollupEngine::Cell RollupEngine::prefixUntil(int64_t dayKey) const {
+    if (perDay.empty() || dayKey <= baseDay) {
+        return Cell();
+    }
+    return prefix(static_cast<size_t>(std::min<int64_t>(dayKey - baseDay, static_cast<int64_t>(perDay.size()))));
+}
+
+Totals RollupEngine::range(int64_t firstDay, int64_t lastDay) const {
+    Totals t;
+    if (lastDay <= firstDay) {
+        return t;
+    }
+    Cell hi = prefixUntil(lastDay);
+    Cell lo = prefixUntil(firstDay);
+    t.durationMs = hi.durationMs - lo.durationMs;
+    t.gross = hi.gross;
+    t.gross.subtract(lo.gross);
+    t.net = hi.net;
+    t.net.subtract(lo.net);
+    t.sessions = hi.sessions - lo.sessions;
+    t.daysWorked = hi.daysWorked - lo.daysWorked;
+    if (archive) {
+        Totals sealed = archive->totals(firstDay, lastDay);
+        t.durationMs += sealed.durationMs;
+        t.gross.add(sealed.gross);
+        t.net.add(sealed.net);
+        t.sessions += sealed.sessions;
+        t.daysWorked += sealed.daysWorked;
+    }
+    return t;
+}
+
+Totals RollupEngine::monthToDate(int64_t todayKey) const {
+    int y; unsigned m, d;
+    civilFromDays(todayKey, y, m, d);
+    return range(todayKey - (d - 1), todayKey + 1);
+}
+
+Totals RollupEngine::weekToDate(int64_t todayKey) const {
+    return range(todayKey - weekdayFromDays(todayKey), todayKey + 1);
+}
+
+Totals RollupEngine::yearToDate(int64_t todayKey) const {
+    int y; unsigned m, d;
+    civilFromDays(todayKey, y, m, d);
+    return range(daysFromCivil(y, 1, 1), todayKey + 1);
+}
+
+MonthProjection RollupEngine::projectMonth(int64_t todayKey, long long runningMs, const Rate& runningRate) const {
+    MonthProjection p;
+    p.monthToDate = monthToDate(todayKey);
+
+    if (runningMs > 0) {
+        p.monthToDate.durationMs += runningMs;
+        p.monthToDate.gross.add(runningMs * centsPerHour(runningRate.hourlyGross));
+        p.monthToDate.net.add(runningMs * centsPerHour(runningRate.hourlyNet));
+        if (day(todayKey).sessions == 0) {
+            p.monthToDate.daysWorked++;
+        }
+    }
+
+    int y; unsigned m, d;
+    civilFromDays(todayKey, y, m, d);
+    int64_t monthEnd = (m == 12) ? daysFromCivil(y + 1, 1, 1) : daysFromCivil(y, m + 1, 1);
+    for (int64_t k = todayKey + 1; k < monthEnd; ++k) {
+        if (weekdayFromDays(k) < 5) {
+            p.remainingWorkdays++;
+        }
+    }
+
+    const Totals& mtd = p.monthToDate;
+    p.projectedDurationMs = mtd.durationMs + static_cast<long long>(mtd.averageDurationMsPerDay() * p.remainingWorkdays);
+    p.projectedGrossCents = mtd.grossCents() + std::llround(mtd.averageGrossCentsPerDay() * p.remainingWorkdays);
+    p.projectedNetCents = mtd.netCents() + std::llround(mtd.averageNetCentsPerDay() * p.remainingWorkdays);
+    return p;
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "history_store.h"
+#include "session_columns.h"
+#include "workday.h"
+
+// --- Incremental Rollups ---
+//
+// Per-day totals kept in Fenwick trees indexed by day key, so the sum over
+// any day range is O(log D) and adding a session is O(log D). punchOut()
+// feeds new sessions in; nothing rescans the history.
+//
+// Sealed years are not in the trees: with an archive attached, ranges add
+// its per-month totals, so they cost nothing to load.
+//
+// Money is summed as MsCents, exactly, and rounded to cents only when read;
+// a range gives the same cents as SessionColumns::sum() over its sessions.
+
+class HistoryArchive;
+
+struct Totals {
+    long long durationMs = 0;
+    MsCents gross;
+    MsCents net;
+    int sessions = 0;
+    int daysWorked = 0;     // days in the range with at least one session
+
+    int64_t grossCents() const { return gross.rounded(); }
+    int64_t netCents() const { return net.rounded(); }
+    double averageDurationMsPerDay() const { return daysWorked ? static_cast<double>(durationMs) / daysWorked : 0.0; }
+    double averageNetCentsPerDay() const { return daysWorked ? static_cast<double>(netCents()) / daysWorked : 0.0; }
+    double averageGrossCentsPerDay() const { return daysWorked ? static_cast<double>(grossCents()) / daysWorked : 0.0; }
+};
+
+struct MonthProjection {
+    Totals monthToDate;         // closed sessions plus the running one
+    int remainingWorkdays = 0;  // Monday-Friday after today
+    long long projectedDurationMs = 0;
+    int64_t projectedGrossCents = 0;
+    int64_t projectedNetCents = 0;
+};
+
+class RollupEngine {
+public:
+    void clear();
+    void rebuild(const HistoryStore& history);
+    void add(const WorkDay& day);
+    // Sums over days before the archive's end come from it as well; the
+    // trees should hold only the sessions it does not.
+    void setArchive(std::shared_ptr<const HistoryArchive> sealed) { archive = std::move(sealed); }
+
+    // Sums over day keys in [firstDay, lastDay).
+    Totals range(int64_t firstDay, int64_t lastDay) const;
+    Totals day(int64_t dayKey) const { return range(dayKey, dayKey + 1); }
+    Totals monthToDate(int64_t todayKey) const;
+    Totals weekToDate(int64_t todayKey) const;
+    Totals yearToDate(int64_t todayKey) const;
+
+    // Month-to-date plus the running session, extrapolated over the remaining
+    // weekdays at the month's average per worked day. O(log D).
+    MonthProjection projectMonth(int64_t todayKey, long long runningMs, const Rate& runningRate) const;
+
+private:
+    struct Cell {
+        long long durationMs = 0;
+        MsCents gross;
+        MsCents net;
+        int sessions = 0;
+        int daysWorked = 0;
+
+        void add(const Cell& o) {
+            durationMs += o.durationMs;
+            gross.add(o.gross);
+            net.add(o.net);
+            sessions += o.sessions;
+            daysWorked += o.daysWorked;
+        }
+    };
+
+    void ensureCovers(int64_t dayKey);
+    void rebuildTree();
+    void fenwickAdd(size_t index, const Cell& delta);
+    Cell prefix(size_t count) const;  // sum of days [0, count)
+    Cell prefixUntil(int64_t dayKey) const;
+
+    int64_t baseDay = 0;
+    std::vector<Cell> perDay;   // raw totals per day, for rebuilding and daysWorked
+    std::vector<Cell> tree;     // 1-based Fenwick tree over perDay
+    std::shared_ptr<const HistoryArchive> archive;
+};
@@ -0,0 +1,190 @@
+#include "session_checkpoint.h"
+
+#include <cstring>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static const char kMagic[8] = { 'T', 'T', 'P', 'S', 'E', 'S', 'S', '\0' };
+static const uint32_t kCheckpointVersion = 1;
+static const size_t kSlots = 2;
+static const size_t kFileBytes = sizeof(SessionCheckpointHeader) + kSlots * sizeof(SessionCheckpointSlot);
+
+static uint32_t slotChecksum(const SessionCheckpointSlot& s) {
+    const unsigned char* bytes = reinterpret_cast<const unsigned char*>(&s);
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < offsetof(SessionCheckpointSlot, checksum); ++i) {
+        hash = (hash ^ bytes[i]) * 16777619u;
+    }
+    return hash;
+}
+
+SessionCheckpoint::~SessionCheckpoint() {
+    close();
+}
+
+bool SessionCheckpoint::open(const std::string& path) {
+    close();
+    bool fresh = false;
+    if (!mapFile(path, fresh)) {
+        return false;
+    }
+    SessionCheckpointHeader* header = reinterpret_cast<SessionCheckpointHeader*>(base);
+    if (fresh || std::memcmp(header->magic, kMagic, sizeof(kMagic)) != 0 || header->version != kCheckpointVersion ||
+        header->slotSize != sizeof(SessionCheckpointSlot)) {
+        std::memset(base, 0, kFileBytes);
+        std::memcpy(header->magic, kMagic, sizeof(kMagic));
+        header->version = kCheckpointVersion;
+        header->slotSize = sizeof(SessionCheckpointSlot);
+        flush();
+    }
+    return true;
+}
+
+#ifdef _WIN32
+
+bool SessionCheckpoint::mapFile(const std::string& path, bool& fresh) {
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, NULL, OPEN_ALWAYS,
+                              FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    LARGE_INTEGER size;
+    fresh = !GetFileSizeEx(file, &size) || size.QuadPart != static_cast<LONGLONG>(kFileBytes);
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READWRITE, 0, static_cast<DWORD>(kFileBytes), NULL);
+    if (mapping == NULL) {
+        CloseHandle(file);
+        return false;
+    }
+    base = static_cast<char*>(MapViewOfFile(mapping, FILE_MAP_WRITE, 0, 0, kFileBytes));
+    if (!base) {
+        CloseHandle(mapping);
+        CloseHandle(file);
+        return false;
+    }
+    fileHandle = file;
+    mappingHandle = mapping;
+    return true;
+}
+
+void SessionCheckpoint::close() {
+    if (base) {
+        UnmapViewOfFile(base);
+    }
+    if (mappingHandle) {
+        CloseHandle(mappingHandle);
+    }
+    if (fileHandle) {
+        CloseHandle(fileHandle);
+    }
+    base = nullptr;
+    mappingHandle = nullptr;
+    fileHandle = nullptr;
+}
+
+void SessionCheckpoint::flush() {
+    FlushViewOfFile(base, kFileBytes);
+    FlushFileBuffers(fileHandle);
+}
+
+#else
+
+bool SessionCheckpoint::mapFile(const std::string& path, bool& fresh) {
+    int fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st;
+    fresh = fstat(fd, &st) != 0 || st.st_size != static_cast<off_t>(kFileBytes);
+    if (fresh && ftruncate(fd, static_cast<off_t>(kFileBytes)) != 0) {
+        ::close(fd);
+        return false;
+    }
+    void* p = mmap(nullptr, kFileBytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd); // the mapping keeps its own reference
+    if (p == MAP_FAILED) {
+        return false;
+    }
+    base = static_cast<char*>(p);
+    return true;
+}
+
+void SessionCheckpoint::close() {
+    if (base) {
+        munmap(base, kFileBytes);
+    }
+    base = nullptr;
+}
+
+void SessionCheckpoint::flush() {
+    msync(base, kFileBytes, MS_SYNC);
+}
+
+#endif
+
+SessionCheckpointSlot* SessionCheckpoint::slot(size_t i) const {
+    return reinterpret_cast<SessionCheckpointSlot*>(base + sizeof(SessionCheckpointHeader)) + i;
+}
+
+const SessionCheckpointSlot* SessionCheckpoint::newest() const {
+    const SessionCheckpointSlot* best = nullptr;
+    for (size_t i = 0; i < kSlots; ++i) {
+        const SessionCheckpointSlot* s = slot(i);
+        if (s->sequence != 0 && s->checksum == slotChecksum(*s) && (!best || s->sequence > best->sequence)) {
+            best = s;
+        }
+    }
+    return best;
+}
+
+bool SessionCheckpoint::read(SessionCheckpointState& state) const {
+    const SessionCheckpointSlot* s = base ? newest() : nullptr;
+    if (!s) {
+        return false;
+    }
+    state.working = s->working != 0;
+    state.closedCleanly = s->closedCleanly != 0;
+    state.startMs = s->startMs;
+    state.endMs = s->endMs;
+    state.lastSeenMs = s->lastSeenMs;
+    state.hourlyGross = s->hourlyGross;
+    state.hourlyNet = s->hourlyNet;
+    return true;
+}
+
+void SessionCheckpoint::write(const SessionCheckpointState& state, bool durable) {
+    if (!base) {
+        return;
+    }
+    const SessionCheckpointSlot* current = newest();
+    uint64_t sequence = current ? current->sequence + 1 : 1;
+
+    SessionCheckpointSlot next = {};
+    next.sequence = sequence;
+    next.startMs = state.startMs;
+    next.endMs = state.endMs;
+    next.lastSeenMs = state.lastSeenMs;
+    next.hourlyGross = state.hourlyGross;
+    next.hourlyNet = state.hourlyNet;
+    next.working = state.working ? 1 : 0;
+    next.closedCleanly = state.closedCleanly ? 1 : 0;
+    next.checksum = slotChecksum(next);
+    std::memcpy(slot(sequence % kSlots), &next, sizeof(next));
+    if (durable) {
+        flush();
+    }
+}
+
+void SessionCheckpoint::touch(int64_t nowMs) {
+    SessionCheckpointState state;
+    if (read(state) && state.working && nowMs > state.lastSeenMs) {
+        state.lastSeenMs = nowMs;
+        write(state, false);
+    }
+}
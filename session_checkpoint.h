@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// --- Live Session Checkpoint ---
+//
+// session.chk holds the punch state (working or not, session start and
+// rates, last time the app was seen alive) so a session survives a crash,
+// a kill or a reboot. After a punch out it keeps the closed session until
+// the next punch in, since the journal append that saves it is still in
+// flight on the writer thread. The file is 192 bytes: a header and two 64-byte slots
+// written alternately, each with a sequence number and a checksum, so a
+// write torn by power loss leaves the previous slot intact. It is mapped
+// read-write; an update is a 64-byte store, and a durable update flushes
+// that one page.
+
+struct SessionCheckpointHeader {
+    char magic[8];          // "TTPSESS\0"
+    uint32_t version;
+    uint32_t slotSize;
+    uint8_t reserved[48];
+};
+
+struct SessionCheckpointSlot {
+    uint64_t sequence;
+    int64_t startMs;        // UTC, milliseconds since epoch
+    int64_t endMs;          // set once punched out, 0 while working
+    int64_t lastSeenMs;
+    double hourlyGross;
+    double hourlyNet;
+    uint8_t working;
+    uint8_t closedCleanly;  // the app exited normally while punched in
+    uint8_t reserved[10];
+    uint32_t checksum;      // FNV-1a over the bytes above
+};
+
+static_assert(sizeof(SessionCheckpointHeader) == 64, "header must stay 64 bytes");
+static_assert(sizeof(SessionCheckpointSlot) == 64, "slot must stay 64 bytes");
+
+struct SessionCheckpointState {
+    bool working = false;
+    bool closedCleanly = false;
+    int64_t startMs = 0;
+    int64_t endMs = 0;
+    int64_t lastSeenMs = 0;
+    double hourlyGross = 0.0;
+    double hourlyNet = 0.0;
+};
+
+class SessionCheckpoint {
+public:
+    SessionCheckpoint() = default;
+    ~SessionCheckpoint();
+    SessionCheckpoint(const SessionCheckpoint&) = delete;
+    SessionCheckpoint& operator=(const SessionCheckpoint&) = delete;
+
+    // Maps the file, creating or reinitializing it if it is missing or not a
+    // checkpoint. Returns false if it cannot be mapped.
+    bool open(const std::string& path);
+    void close();
+    bool isOpen() const { return base != nullptr; }
+
+    // The newest valid slot; false when there is none (a fresh file).
+    bool read(SessionCheckpointState& state) const;
+    // Writes the other slot. `durable` flushes the page to disk before
+    // returning; otherwise the OS writes it back on its own schedule, which
+    // still survives the process dying.
+    void write(const SessionCheckpointState& state, bool durable);
+    // Moves lastSeenMs forward without a flush; cheap enough for every tick.
+    void touch(int64_t nowMs);
+
+private:
+    bool mapFile(const std::string& path, bool& fresh);
+    SessionCheckpointSlot* slot(size_t i) const;
+    const SessionCheckpointSlot* newest() const;
+    void flush();
+
+    char* base = nullptr;
+#ifdef _WIN32
+    void* fileHandle = nullptr;
+    void* mappingHandle = nullptr;
+#endif
+};
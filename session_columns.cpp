@@ -0,0 +1,243 @@
+#include "session_columns.h"
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define TT_X86 1
+#include <immintrin.h>
+#endif
+
+namespace {
+
+// Sessions summed before the 64-bit lanes are folded into quotient and
+// remainder; keeps a lane below 2^63 at the documented per-session bound.
+const size_t kChunk = 4096;
+
+struct KernelInput {
+    const int64_t* durations;
+    const uint32_t* rates;
+    const int32_t* days;
+    const int64_t* grossByRate;
+    const int64_t* netByRate;
+    int32_t firstDay;
+    int32_t lastDay;
+};
+
+struct Accumulator {
+    int64_t durationMs = 0;
+    int64_t sessions = 0;
+    MsCents gross;
+    MsCents net;
+
+    MoneyTotals totals() const {
+        MoneyTotals t;
+        t.durationMs = durationMs;
+        t.grossCents = gross.rounded();
+        t.netCents = net.rounded();
+        t.sessions = sessions;
+        return t;
+    }
+};
+
+// Unsigned arithmetic wraps; the chunk bound keeps the true sums in range,
+// so the wrapped result reinterpreted as signed is exact.
+void scalarChunk(const KernelInput& in, size_t first, size_t last, Accumulator& acc) {
+    uint64_t duration = 0, gross = 0, net = 0;
+    int64_t sessions = 0;
+    for (size_t i = first; i < last; ++i) {
+        if (in.days[i] < in.firstDay || in.days[i] >= in.lastDay) {
+            continue;
+        }
+        uint64_t d = static_cast<uint64_t>(in.durations[i]);
+        duration += d;
+        gross += d * static_cast<uint64_t>(in.grossByRate[in.rates[i]]);
+        net += d * static_cast<uint64_t>(in.netByRate[in.rates[i]]);
+        sessions++;
+    }
+    acc.durationMs += static_cast<int64_t>(duration);
+    acc.gross.add(static_cast<int64_t>(gross));
+    acc.net.add(static_cast<int64_t>(net));
+    acc.sessions += sessions;
+}
+
+#ifdef TT_X86
+
+// 64-bit lanes times rates below 2^32: the low 64 bits of the product from
+// two 32x32 multiplies, which is all SSE2 and AVX2 offer.
+inline __m128i mulRate128(__m128i d, __m128i rate) {
+    __m128i lo = _mm_mul_epu32(d, rate);
+    __m128i hi = _mm_mul_epu32(_mm_srli_epi64(d, 32), rate);
+    return _mm_add_epi64(lo, _mm_slli_epi64(hi, 32));
+}
+
+inline uint64_t laneSum128(__m128i v) {
+    return static_cast<uint64_t>(_mm_cvtsi128_si64(v)) +
+           static_cast<uint64_t>(_mm_cvtsi128_si64(_mm_unpackhi_epi64(v, v)));
+}
+
+void sse2Chunk(const KernelInput& in, size_t first, size_t last, Accumulator& acc) {
+    const __m128i firstDay = _mm_set1_epi32(in.firstDay);
+    const __m128i lastDay = _mm_set1_epi32(in.lastDay);
+    const __m128i one = _mm_set1_epi64x(1);
+    __m128i duration = _mm_setzero_si128(), gross = duration, net = duration, sessions = duration;
+    size_t i = first;
+    for (; i + 2 <= last; i += 2) {
+        __m128i keys = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(in.days + i));
+        __m128i inRange = _mm_andnot_si128(_mm_cmplt_epi32(keys, firstDay), _mm_cmplt_epi32(keys, lastDay));
+        __m128i mask = _mm_unpacklo_epi32(inRange, inRange);
+        __m128i d = _mm_and_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(in.durations + i)), mask);
+        __m128i g = _mm_set_epi64x(in.grossByRate[in.rates[i + 1]], in.grossByRate[in.rates[i]]);
+        __m128i n = _mm_set_epi64x(in.netByRate[in.rates[i + 1]], in.netByRate[in.rates[i]]);
+        duration = _mm_add_epi64(duration, d);
+        gross = _mm_add_epi64(gross, mulRate128(d, g));
+        net = _mm_add_epi64(net, mulRate128(d, n));
+        sessions = _mm_add_epi64(sessions, _mm_and_si128(mask, one));
+    }
+    acc.durationMs += static_cast<int64_t>(laneSum128(duration));
+    acc.gross.add(static_cast<int64_t>(laneSum128(gross)));
+    acc.net.add(static_cast<int64_t>(laneSum128(net)));
+    acc.sessions += static_cast<int64_t>(laneSum128(sessions));
+    scalarChunk(in, i, last, acc);
+}
+
+__attribute__((target("avx2"))) inline __m256i mulRate256(__m256i d, __m256i rate) {
+    __m256i lo = _mm256_mul_epu32(d, rate);
+    __m256i hi = _mm256_mul_epu32(_mm256_srli_epi64(d, 32), rate);
+    return _mm256_add_epi64(lo, _mm256_slli_epi64(hi, 32));
+}
+
+__attribute__((target("avx2"))) inline uint64_t laneSum256(__m256i v) {
+    __m128i half = _mm_add_epi64(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+    return laneSum128(half);
+}
+
+__attribute__((target("avx2"))) void avx2Chunk(const KernelInput& in, size_t first, size_t last,
+                                               Accumulator& acc) {
+    const __m128i firstDay = _mm_set1_epi32(in.firstDay);
+    const __m128i lastDay = _mm_set1_epi32(in.lastDay);
+    const __m256i one = _mm256_set1_epi64x(1);
+    const long long* grossByRate = reinterpret_cast<const long long*>(in.grossByRate);
+    const long long* netByRate = reinterpret_cast<const long long*>(in.netByRate);
+    __m256i duration = _mm256_setzero_si256(), gross = duration, net = duration, sessions = duration;
+    size_t i = first;
+    for (; i + 4 <= last; i += 4) {
+        __m128i keys = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in.days + i));
+        __m128i inRange = _mm_andnot_si128(_mm_cmplt_epi32(keys, firstDay), _mm_cmplt_epi32(keys, lastDay));
+        __m256i mask = _mm256_cvtepi32_epi64(inRange);
+        __m256i d = _mm256_and_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(in.durations + i)), mask);
+        __m128i ids = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in.rates + i));
+        __m256i g = _mm256_i32gather_epi64(grossByRate, ids, 8);
+        __m256i n = _mm256_i32gather_epi64(netByRate, ids, 8);
+        duration = _mm256_add_epi64(duration, d);
+        gross = _mm256_add_epi64(gross, mulRate256(d, g));
+        net = _mm256_add_epi64(net, mulRate256(d, n));
+        sessions = _mm256_add_epi64(sessions, _mm256_and_si256(mask, one));
+    }
+    acc.durationMs += static_cast<int64_t>(laneSum256(duration));
+    acc.gross.add(static_cast<int64_t>(laneSum256(gross)));
+    acc.net.add(static_cast<int64_t>(laneSum256(net)));
+    acc.sessions += static_cast<int64_t>(laneSum256(sessions));
+    scalarChunk(in, i, last, acc);
+}
+
+#endif
+
+int32_t clampDay(int64_t dayKey) {
+    return static_cast<int32_t>(std::min<int64_t>(std::max<int64_t>(dayKey, INT32_MIN), INT32_MAX));
+}
+
+} // namespace
+
+SimdLevel bestSimdLevel() {
+#ifdef TT_X86
+    static const SimdLevel level = __builtin_cpu_supports("avx2") ? SimdLevel::Avx2 : SimdLevel::Sse2;
+    return level;
+#else
+    return SimdLevel::Scalar;
+#endif
+}
+
+const char* simdLevelName(SimdLevel level) {
+    switch (level) {
+    case SimdLevel::Avx2: return "avx2";
+    case SimdLevel::Sse2: return "sse2";
+    default: return "scalar";
+    }
+}
+
+int64_t MsCents::rounded() const {
+    // Fold the remainder in, then give it the quotient's sign.
+    int64_t q = quotient + remainder / kMsPerHour;
+    int64_t r = remainder % kMsPerHour;
+    if (q > 0 && r < 0) {
+        q--;
+        r += kMsPerHour;
+    } else if (q < 0 && r > 0) {
+        q++;
+        r -= kMsPerHour;
+    }
+    int64_t half = kMsPerHour / 2;
+    return q + (r >= 0 ? (r + half) / kMsPerHour : -((-r + half) / kMsPerHour));
+}
+
+uint32_t centsPerHour(double hourlyRate) {
+    double cents = std::round(hourlyRate * 100.0);
+    return cents <= 0 ? 0 : cents >= UINT32_MAX ? UINT32_MAX : static_cast<uint32_t>(cents);
+}
+
+void SessionColumns::clear() {
+    durations.clear();
+    rates.clear();
+    days.clear();
+}
+
+void SessionColumns::assign(const std::vector<WorkDay>& sessions) {
+    clear();
+    durations.reserve(sessions.size());
+    rates.reserve(sessions.size());
+    days.reserve(sessions.size());
+    for (const auto& day : sessions) {
+        append(day);
+    }
+}
+
+void SessionColumns::append(const WorkDay& day) {
+    coverRate(day.rateId);
+    durations.push_back(day.durationMs());
+    rates.push_back(day.rateId);
+    days.push_back(clampDay(day.dayKey()));
+}
+
+// Rate table entries never change once published, so cached cents stay valid.
+void SessionColumns::coverRate(uint32_t rateId) {
+    for (uint32_t id = static_cast<uint32_t>(grossCentsByRate.size()); id <= rateId; ++id) {
+        const Rate& rate = rateTable()[id];
+        grossCentsByRate.push_back(centsPerHour(rate.hourlyGross));
+        netCentsByRate.push_back(centsPerHour(rate.hourlyNet));
+    }
+}
+
+MoneyTotals SessionColumns::sum(int64_t firstDay, int64_t lastDay, SimdLevel level) const {
+    Accumulator acc;
+    if (lastDay <= firstDay || durations.empty()) {
+        return acc.totals();
+    }
+    KernelInput in = { durations.data(), rates.data(), days.data(), grossCentsByRate.data(), netCentsByRate.data(),
+                       clampDay(firstDay), clampDay(lastDay) };
+    void (*chunk)(const KernelInput&, size_t, size_t, Accumulator&) = scalarChunk;
+#ifdef TT_X86
+    if (level == SimdLevel::Avx2 && bestSimdLevel() == SimdLevel::Avx2) {
+        chunk = avx2Chunk;
+    } else if (level != SimdLevel::Scalar) {
+        chunk = sse2Chunk;
+    }
+#else
+    (void)level;
+#endif
+    for (size_t first = 0; first < durations.size(); first += kChunk) {
+        chunk(in, first, std::min(first + kChunk, durations.size()), acc);
+    }
+    return acc.totals();
+}
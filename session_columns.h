@@ -0,0 +1,105 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "workday.h"
+
+// --- Columnar Sessions and Exact Money ---
+//
+// The history as parallel arrays (duration, rate id, local day key) for
+// totals that scan many sessions. Earnings are summed in integer cents:
+// rates are taken in cents per hour, each session contributes
+// durationMs * centsPerHour exactly, and the sum is divided by 3,600,000
+// once, rounding half away from zero. The result does not depend on the
+// order of the sessions or on the kernel used, unlike summing
+// grossEarning() doubles.
+//
+// Kernels exist for plain C++, SSE2 and AVX2; sum() picks the best one the
+// CPU supports unless told otherwise. Exact while each session's
+// durationMs * centsPerHour is below 2^51, i.e. a 24-hour session at up to
+// 26 million cents an hour.
+//
+// The app itself only uses MsCents and centsPerHour() from here. Its bulk
+// totals need per-day cells (RollupEngine::rebuild, aggregateTeam) or are
+// summed while the sessions are encoded (archive blocks), which one range
+// sum does not give. SessionColumns is a library piece: the bench checks
+// the kernels and the rollups against it.
+
+enum class SimdLevel { Scalar, Sse2, Avx2 };
+
+SimdLevel bestSimdLevel();
+const char* simdLevelName(SimdLevel level);
+
+// An hourly rate in cents, rounded to the nearest cent.
+uint32_t centsPerHour(double hourlyRate);
+
+// Money as sum(durationMs * centsPerHour) / 3,600,000, kept as quotient and
+// remainder so it cannot overflow and is rounded only when read. Sums and
+// differences are exact in any order; the rollup trees rely on both.
+struct MsCents {
+    static constexpr int64_t kMsPerHour = 3600000;
+
+    int64_t quotient = 0;
+    int64_t remainder = 0;
+
+    void add(int64_t msCents) {
+        quotient += msCents / kMsPerHour;
+        remainder += msCents % kMsPerHour;
+    }
+    void add(const MsCents& o) {
+        quotient += o.quotient;
+        remainder += o.remainder;
+    }
+    void subtract(const MsCents& o) {
+        quotient -= o.quotient;
+        remainder -= o.remainder;
+    }
+    // Whole cents, rounded half away from zero.
+    int64_t rounded() const;
+};
+
+// What a session adds to an MsCents sum: its duration times its rate in cents.
+inline int64_t grossMsCents(const WorkDay& day) { return day.durationMs() * centsPerHour(day.hourlyGross()); }
+inline int64_t netMsCents(const WorkDay& day) { return day.durationMs() * centsPerHour(day.hourlyNet()); }
+
+struct MoneyTotals {
+    int64_t durationMs = 0;
+    int64_t grossCents = 0;
+    int64_t netCents = 0;
+    int64_t sessions = 0;
+
+    bool operator==(const MoneyTotals& o) const {
+        return durationMs == o.durationMs && grossCents == o.grossCents && netCents == o.netCents &&
+               sessions == o.sessions;
+    }
+    bool operator!=(const MoneyTotals& o) const { return !(*this == o); }
+};
+
+class SessionColumns {
+public:
+    void clear();
+    void assign(const std::vector<WorkDay>& sessions);
+    void append(const WorkDay& day);
+
+    size_t size() const { return durations.size(); }
+    const std::vector<int64_t>& durationMs() const { return durations; }
+    const std::vector<uint32_t>& rateIds() const { return rates; }
+    const std::vector<int32_t>& dayKeys() const { return days; }
+
+    // Sums the sessions whose day key is in [firstDay, lastDay). The
+    // sessions do not need to be in order.
+    MoneyTotals sum(int64_t firstDay, int64_t lastDay) const { return sum(firstDay, lastDay, bestSimdLevel()); }
+    MoneyTotals sum(int64_t firstDay, int64_t lastDay, SimdLevel level) const;
+
+private:
+    void coverRate(uint32_t rateId);
+
+    std::vector<int64_t> durations;
+    std::vector<uint32_t> rates;
+    std::vector<int32_t> days;
+    // Indexed by rate id, filled as ids show up. 64-bit for the AVX2 gather.
+    std::vector<int64_t> grossCentsByRate;
+    std::vector<int64_t> netCentsByRate;
+};
@@ -0,0 +1,170 @@
+#include "team_report.h"
+
+#include <algorithm>
+
+#include "civil_time.h"
+#include "history_query.h"
+#include "journal.h"
+#include "profiles.h"
+
+static void addTotals(Totals& into, const Totals& from) {
+    into.durationMs += from.durationMs;
+    into.gross.add(from.gross);
+    into.net.add(from.net);
+    into.sessions += from.sessions;
+    into.daysWorked += from.daysWorked;
+}
+
+void TeamReport::ensureCovers(int64_t dayKey) {
+    if (perDay.empty()) {
+        baseDay = dayKey;
+        perDay.resize(1);
+        return;
+    }
+    if (dayKey >= baseDay && dayKey < lastDay()) {
+        return;
+    }
+    // Grow geometrically towards the new day so shards of any order stay amortized O(1).
+    int64_t first = std::min(baseDay, dayKey);
+    int64_t last = std::max(lastDay(), dayKey + 1);
+    int64_t span = std::max<int64_t>(last - first, static_cast<int64_t>(perDay.size()) * 2);
+    if (dayKey < baseDay) {
+        first = last - span;
+    } else {
+        last = first + span;
+    }
+    std::vector<Totals> grown(static_cast<size_t>(last - first));
+    std::copy(perDay.begin(), perDay.end(), grown.begin() + (baseDay - first));
+    perDay.swap(grown);
+    baseDay = first;
+}
+
+void TeamReport::addDay(int64_t dayKey, const Totals& totals) {
+    ensureCovers(dayKey);
+    addTotals(perDay[static_cast<size_t>(dayKey - baseDay)], totals);
+    sessions += static_cast<size_t>(totals.sessions);
+}
+
+void TeamReport::addRate(uint32_t rateId, const Totals& totals) {
+    if (rateId >= rates.size()) {
+        rates.resize(rateId + 1);
+    }
+    addTotals(rates[rateId], totals);
+}
+
+void TeamReport::merge(const TeamReport& other) {
+    profiles += other.profiles;
+    sessions += other.sessions;
+    failedProfiles.insert(failedProfiles.end(), other.failedProfiles.begin(), other.failedProfiles.end());
+    if (!other.perDay.empty()) {
+        ensureCovers(other.baseDay);
+        ensureCovers(other.lastDay() - 1);
+        for (size_t i = 0; i < other.perDay.size(); ++i) {
+            addTotals(perDay[static_cast<size_t>(other.baseDay - baseDay) + i], other.perDay[i]);
+        }
+    }
+    if (other.rates.size() > rates.size()) {
+        rates.resize(other.rates.size());
+    }
+    for (size_t i = 0; i < other.rates.size(); ++i) {
+        addTotals(rates[i], other.rates[i]);
+    }
+}
+
+Totals TeamReport::day(int64_t dayKey) const {
+    return range(dayKey, dayKey + 1);
+}
+
+Totals TeamReport::range(int64_t first, int64_t last) const {
+    Totals sum;
+    first = std::max(first, baseDay);
+    last = std::min(last, lastDay());
+    for (int64_t d = first; d < last; ++d) {
+        addTotals(sum, perDay[static_cast<size_t>(d - baseDay)]);
+    }
+    return sum;
+}
+
+Totals TeamReport::month(int year, int month) const {
+    int64_t first = daysFromCivil(year, static_cast<unsigned>(month), 1);
+    int64_t last = month == 12 ? daysFromCivil(year + 1, 1, 1) : daysFromCivil(year, static_cast<unsigned>(month) + 1, 1);
+    return range(first, last);
+}
+
+TeamReport aggregateTeam(const std::string& root, const std::vector<std::string>& profiles, ThreadPool& pool) {
+    std::vector<TeamReport> partials(pool.concurrency());
+    pool.parallelFor(profiles.size(), [&](size_t index, unsigned participant) {
+        TeamReport& partial = partials[participant];
+        Journal journal;
+        journal.open(profileStorePath(root, profiles[index]), SnapshotFormat::Binary, StoreAccess::ReadOnly);
+        Config config;
+        std::vector<WorkDay> sessions;
+        if (!journal.load(config, sessions)) {
+            partial.failedProfiles.push_back(profiles[index]);
+            return;
+        }
+        partial.profiles++;
+        HistoryStore history;
+        history.assign(std::move(sessions));
+        auto all = query(history);
+        for (const GroupTotals& day : all.groupBy(GroupBy::Day)) {
+            partial.addDay(day.key, day.totals);
+        }
+        for (GroupTotals rate : all.groupBy([](const WorkDay& session) { return session.rateId; })) {
+            rate.totals.daysWorked = 0;
+            partial.addRate(static_cast<uint32_t>(rate.key), rate.totals);
+        }
+    });
+
+    TeamReport report;
+    for (const auto& partial : partials) {
+        report.merge(partial);
+    }
+    std::sort(report.failedProfiles.begin(), report.failedProfiles.end());
+    return report;
+}
+
+static bool writeRow(FILE* file, const char* type, const char* key, const Totals& t) {
+    return std::fprintf(file, "%s;%s;%.2f;%.2f;%.2f;%d;%d\n", type, key, t.durationMs / 3600000.0,
+                        t.netCents() / 100.0, t.grossCents() / 100.0, t.sessions, t.daysWorked) > 0;
+}
+
+bool writeTeamReport(const TeamReport& report, FILE* file) {
+    bool ok = std::fprintf(file, "Type;Clé;Heures;Gains Nets (€);Gains Bruts (€);Sessions;Jours-personne\n") > 0;
+    char key[64];
+    if (!report.empty()) {
+        int year; unsigned month, day;
+        civilFromDays(report.firstDay(), year, month, day);
+        int lastYear; unsigned lastMonth, lastDayOfMonth;
+        civilFromDays(report.lastDay() - 1, lastYear, lastMonth, lastDayOfMonth);
+        while (ok && (year < lastYear || (year == lastYear && month <= lastMonth))) {
+            Totals t = report.month(year, static_cast<int>(month));
+            if (t.sessions > 0) {
+                std::snprintf(key, sizeof(key), "%04d-%02u", year, month);
+                ok = writeRow(file, "mois", key, t);
+            }
+            if (++month == 13) {
+                month = 1;
+                year++;
+            }
+        }
+    }
+    const auto& rates = report.perRate();
+    for (size_t id = 0; ok && id < rates.size(); ++id) {
+        if (rates[id].sessions > 0) {
+            const Rate& rate = rateTable()[static_cast<uint32_t>(id)];
+            std::snprintf(key, sizeof(key), "%.2f/%.2f", rate.hourlyGross, rate.hourlyNet);
+            ok = writeRow(file, "taux", key, rates[id]);
+        }
+    }
+    for (int64_t d = report.firstDay(); ok && d < report.lastDay(); ++d) {
+        Totals t = report.day(d);
+        if (t.sessions > 0) {
+            int year; unsigned month, day;
+            civilFromDays(d, year, month, day);
+            std::snprintf(key, sizeof(key), "%04d-%02u-%02u", year, month, day);
+            ok = writeRow(file, "jour", key, t);
+        }
+    }
+    return ok && std::fflush(file) == 0;
+}
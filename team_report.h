@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "rollup.h"
+#include "thread_pool.h"
+
+// --- Team Aggregation ---
+//
+// Loads every profile shard in parallel and reduces them into team totals
+// per day, month and rate. Each pool participant accumulates into a private
+// partial report; the partials are merged once at the end, so workers never
+// contend on shared totals.
+//
+// In these totals, daysWorked counts person-days: one per employee who
+// worked on that day.
+
+class TeamReport {
+public:
+    size_t profiles = 0;
+    size_t sessions = 0;
+    std::vector<std::string> failedProfiles;   // shards that could not be read
+
+    // One employee's totals for a day (daysWorked 1) or at a rate (0).
+    void addDay(int64_t dayKey, const Totals& totals);
+    void addRate(uint32_t rateId, const Totals& totals);
+    void merge(const TeamReport& other);
+
+    bool empty() const { return perDay.empty(); }
+    int64_t firstDay() const { return baseDay; }
+    int64_t lastDay() const { return baseDay + static_cast<int64_t>(perDay.size()); }   // exclusive
+
+    Totals day(int64_t dayKey) const;
+    // Sums over day keys in [first, last).
+    Totals range(int64_t first, int64_t last) const;
+    Totals month(int year, int month) const;
+    // Indexed by rate id (see rateTable()); unused ids are all-zero.
+    const std::vector<Totals>& perRate() const { return rates; }
+
+private:
+    void ensureCovers(int64_t dayKey);
+
+    int64_t baseDay = 0;
+    std::vector<Totals> perDay;
+    std::vector<Totals> rates;
+};
+
+// Loads <root>/profiles/<name>/ for each name, read-only, and reduces them.
+TeamReport aggregateTeam(const std::string& root, const std::vector<std::string>& profiles, ThreadPool& pool);
+
+// Writes the report as semicolon-separated rows (month, then rate, then day).
+bool writeTeamReport(const TeamReport& report, FILE* file);
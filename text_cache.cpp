@@ -0,0 +1,69 @@
+#include "text_cache.h"
+
+#include <cmath>
+#include <functional>
+
+size_t TextKeyHash::operator()(const TextKey& key) const {
+    size_t h = std::hash<std::wstring>()(key.text);
+    auto mix = [&h](uint64_t v) { h ^= std::hash<uint64_t>()(v) + 0x9e3779b97f4a7c15ULL + (h << 6) + (h >> 2); };
+    mix((static_cast<uint64_t>(key.font) << 8) | static_cast<uint64_t>(key.align));
+    mix(key.argb);
+    mix((static_cast<uint64_t>(static_cast<uint32_t>(key.width)) << 32) | static_cast<uint32_t>(key.height));
+    return h;
+}
+
+TextKey textKeyOf(const DisplayItem& item) {
+    TextKey key;
+    key.text = item.text;
+    key.font = item.font;
+    key.align = item.align;
+    key.argb = item.argb;
+    key.width = item.rect.width();
+    key.height = item.rect.height();
+    return key;
+}
+
+static bool joinsPrevious(uint32_t c) {
+    return (c >= 0xDC00 && c <= 0xDFFF) ||     // low surrogate (UTF-16 wchar_t)
+           (c >= 0x0300 && c <= 0x036F) ||     // combining diacritics
+           (c >= 0xFE00 && c <= 0xFE0F) ||     // variation selectors
+           c == 0x200D;                        // zero-width joiner
+}
+
+std::vector<std::wstring> splitGlyphs(const std::wstring& text) {
+    std::vector<std::wstring> glyphs;
+    bool joined = false;
+    for (wchar_t ch : text) {
+        uint32_t c = static_cast<uint32_t>(ch);
+        if (glyphs.empty() || !(joined || joinsPrevious(c))) {
+            glyphs.emplace_back();
+        }
+        glyphs.back().push_back(ch);
+        // What follows a joiner belongs to the same glyph.
+        joined = c == 0x200D;
+    }
+    return glyphs;
+}
+
+std::vector<int> layoutGlyphRun(const std::vector<float>& advances, TextAlign align, int width) {
+    float total = 0.0f;
+    for (float advance : advances) {
+        total += advance;
+    }
+    std::vector<int> lefts;
+    if (total > static_cast<float>(width)) {
+        return lefts;
+    }
+    float pen = 0.0f;
+    switch (align) {
+        case TextAlign::Near:   pen = 0.0f; break;
+        case TextAlign::Center: pen = (static_cast<float>(width) - total) / 2; break;
+        case TextAlign::Far:    pen = static_cast<float>(width) - total; break;
+    }
+    lefts.reserve(advances.size());
+    for (float advance : advances) {
+        lefts.push_back(static_cast<int>(std::lround(pen)));
+        pen += advance;
+    }
+    return lefts;
+}
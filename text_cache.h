@@ -0,0 +1,143 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "display_list.h"
+
+// --- Rasterized Text Cache ---
+//
+// Antialiased DrawString is the most expensive thing OnPaint does, and
+// almost none of the text changes between frames: weekday letters, day
+// numbers, button captions, the month title. The renderer rasterizes each
+// text item once into a transparent bitmap the size of its rect and from
+// then on only blits it. The key is everything that decides the pixels;
+// entries are evicted least recently used once their bitmaps pass a byte
+// budget.
+//
+// A string that changed since the last frame (the running time, the month
+// earnings, on every tick) would miss and push out the stable entries, so
+// it is drawn as a run of cached glyphs instead: splitGlyphs() and
+// layoutGlyphRun() place them the way DrawString aligns the whole string.
+// After the first minute a tick rasterizes nothing.
+//
+// Image is whatever the renderer draws with (Gdiplus::Bitmap in main.cpp);
+// nothing here depends on Win32 or GDI+.
+
+struct TextKey {
+    std::wstring text;
+    FontRole font = FontRole::Stats;
+    TextAlign align = TextAlign::Center;
+    uint32_t argb = 0;
+    int width = 0;
+    int height = 0;
+
+    bool operator==(const TextKey& o) const {
+        return font == o.font && align == o.align && argb == o.argb && width == o.width && height == o.height &&
+               text == o.text;
+    }
+};
+
+struct TextKeyHash {
+    size_t operator()(const TextKey& key) const;
+};
+
+// The key of a DisplayItemKind::Text item.
+TextKey textKeyOf(const DisplayItem& item);
+
+// The units a glyph run draws one at a time: a character together with the
+// low surrogate, variation selectors and combining marks that follow it.
+std::vector<std::wstring> splitGlyphs(const std::wstring& text);
+
+// Left edges, in pixels from the rect's left, of glyphs with these advances
+// aligned in a rect `width` wide. Empty if the run does not fit.
+std::vector<int> layoutGlyphRun(const std::vector<float>& advances, TextAlign align, int width);
+
+// 32-bit pixels for a key's rect.
+inline size_t textImageBytes(const TextKey& key) {
+    return static_cast<size_t>(key.width) * static_cast<size_t>(key.height) * 4;
+}
+
+template <typename Image>
+class TextRasterCache {
+public:
+    // About a dozen full-window strings, or every calendar cell many times over.
+    static const size_t kDefaultBudgetBytes = 4 * 1024 * 1024;
+
+    explicit TextRasterCache(size_t budgetBytes = kDefaultBudgetBytes) : budget(budgetBytes) {}
+
+    // The cached image for key, marked most recently used; null on a miss.
+    Image* find(const TextKey& key) {
+        auto it = index.find(key);
+        if (it == index.end()) {
+            ++missCount;
+            return nullptr;
+        }
+        ++hitCount;
+        entries.splice(entries.begin(), entries, it->second);
+        return it->second->image.get();
+    }
+
+    // Adds (or replaces) key's image, then evicts from the least recently
+    // used end until the cache fits its budget again. The new entry stays
+    // even if it alone is over budget.
+    Image* insert(const TextKey& key, std::unique_ptr<Image> image) {
+        auto it = index.find(key);
+        if (it != index.end()) {
+            usedBytes -= it->second->bytes;
+            entries.erase(it->second);
+            index.erase(it);
+        }
+        size_t bytes = textImageBytes(key);
+        entries.push_front(Entry{ key, std::move(image), bytes });
+        index.emplace(key, entries.begin());
+        usedBytes += bytes;
+        while (usedBytes > budget && entries.size() > 1) {
+            usedBytes -= entries.back().bytes;
+            index.erase(entries.back().key);
+            entries.pop_back();
+            ++evictionCount;
+        }
+        return entries.front().image.get();
+    }
+
+    // find(), or render(key) -> std::unique_ptr<Image> and insert() on a miss.
+    template <typename Render>
+    Image* fetch(const TextKey& key, Render&& render) {
+        Image* image = find(key);
+        return image ? image : insert(key, render(key));
+    }
+
+    void clear() {
+        entries.clear();
+        index.clear();
+        usedBytes = 0;
+    }
+
+    size_t size() const { return entries.size(); }
+    size_t bytes() const { return usedBytes; }
+    uint64_t hits() const { return hitCount; }
+    uint64_t misses() const { return missCount; }
+    uint64_t evictions() const { return evictionCount; }
+
+private:
+    struct Entry {
+        TextKey key;
+        std::unique_ptr<Image> image;
+        size_t bytes;
+    };
+
+    std::list<Entry> entries;   // most recently used first
+    std::unordered_map<TextKey, typename std::list<Entry>::iterator, TextKeyHash> index;
+    size_t budget;
+    size_t usedBytes = 0;
+    uint64_t hitCount = 0;
+    uint64_t missCount = 0;
+    uint64_t evictionCount = 0;
+};
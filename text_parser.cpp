@@ -0,0 +1,293 @@
+#include "text_parser.h"
+
+#include <algorithm>
+#include <iterator>
+#include <charconv>
+#include <cstring>
+#include <string_view>
+#include <thread>
+
+#include "civil_time.h"
+#include "crc32c.h"
+#include "mapped_file.h"
+
+namespace {
+
+const size_t kWorkDayFields = 12;
+const size_t kConfigFields = 3;
+
+struct ChunkResult {
+    bool haveConfig = false;
+    Config config;
+    std::vector<WorkDay> days;
+    std::vector<ParseError> errors; // line numbers relative to the chunk
+    size_t lines = 0;
+};
+
+template <typename T>
+bool parseNumber(std::string_view field, T& value) {
+    const char* end = field.data() + field.size();
+    auto result = std::from_chars(field.data(), end, value);
+    return result.ec == std::errc() && result.ptr == end;
+}
+
+// Splits line on '|' into fields; returns the field count (may exceed max).
+size_t splitFields(std::string_view line, std::string_view* fields, size_t max) {
+    size_t count = 0;
+    size_t start = 0;
+    while (true) {
+        size_t bar = line.find('|', start);
+        std::string_view field = line.substr(start, bar == std::string_view::npos ? std::string_view::npos : bar - start);
+        if (count < max) {
+            fields[count] = field;
+        }
+        count++;
+        if (bar == std::string_view::npos) {
+            return count;
+        }
+        start = bar + 1;
+    }
+}
+
+// A line without its '\r', and the CRC32C of it up to its last bar.
+struct Line {
+    std::string_view text;
+    uint32_t crc;
+};
+
+// Hex digit values, 0x10 for anything else.
+struct HexDigits {
+    uint8_t value[256];
+    HexDigits() {
+        std::memset(value, 0x10, sizeof(value));
+        for (int i = 0; i < 10; ++i) {
+            value['0' + i] = static_cast<uint8_t>(i);
+        }
+        for (int i = 0; i < 6; ++i) {
+            value['a' + i] = value['A' + i] = static_cast<uint8_t>(10 + i);
+        }
+    }
+};
+const HexDigits kHexDigits;
+
+// Exactly eight hex digits. A lookup per digit and no branches: which
+// digits are letters is random, and base-16 from_chars, mispredicting on
+// them, was most of what checksums added to a load.
+bool parseHex8(std::string_view field, uint32_t& value) {
+    if (field.size() != 8) {
+        return false;
+    }
+    uint32_t v = 0, invalid = 0;
+    for (char ch : field) {
+        uint32_t digit = kHexDigits.value[static_cast<unsigned char>(ch)];
+        invalid |= digit;
+        v = v << 4 | (digit & 0xf);
+    }
+    value = v;
+    return (invalid & 0x10) == 0;
+}
+
+// Only meaningful when field is the line's last one, which crc stops before.
+bool checksumMatches(const Line& line, std::string_view field) {
+    uint32_t expected = 0;
+    return parseHex8(field, expected) && line.crc == expected;
+}
+
+void parseLine(const Line& checked, size_t lineNo, bool required, ChunkResult& r) {
+    std::string_view line = checked.text;
+    if (line.empty()) {
+        return;
+    }
+    auto addError = [&](const char* what) { r.errors.push_back({ lineNo, what, std::string(line) }); };
+
+    std::string_view f[kWorkDayFields + 1];
+    size_t count = splitFields(line, f, kWorkDayFields + 1);
+
+    if (f[0] == "config") {
+        Config config;
+        if ((count != kConfigFields && count != kConfigFields + 1) || !parseNumber(f[1], config.hourlyGross) ||
+            !parseNumber(f[2], config.hourlyNet)) {
+            addError("malformed config record");
+            return;
+        }
+        if (required && count == kConfigFields) {
+            addError("missing checksum");
+            return;
+        }
+        if (count > kConfigFields && !checksumMatches(checked, f[kConfigFields])) {
+            addError("checksum mismatch");
+            return;
+        }
+        r.config = config;
+        r.haveConfig = true;
+    } else if (f[0] == "workday") {
+        if (count != kWorkDayFields && count != kWorkDayFields + 1) {
+            addError("workday record must have 12 fields");
+            return;
+        }
+        if (required && count == kWorkDayFields) {
+            addError("missing checksum");
+            return;
+        }
+        if (count > kWorkDayFields && !checksumMatches(checked, f[kWorkDayFields])) {
+            addError("checksum mismatch");
+            return;
+        }
+        int64_t dayKey;
+        long long durationMs;
+        double grossEarning, netEarning, hourlyGross, hourlyNet;
+        if (!parseDateKey(f[1], dayKey)) { addError("invalid date"); return; }
+        if (!parseNumber(f[7], durationMs)) { addError("invalid durationMs"); return; }
+        if (!parseNumber(f[8], grossEarning)) { addError("invalid grossEarning"); return; }
+        if (!parseNumber(f[9], netEarning)) { addError("invalid netEarning"); return; }
+        if (!parseNumber(f[10], hourlyGross)) { addError("invalid hourlyGross"); return; }
+        if (!parseNumber(f[11], hourlyNet)) { addError("invalid hourlyNet"); return; }
+        // Earnings and the duration string are derived from the other fields.
+        WorkDay day;
+        if (!workDayFromText(f[1], f[2], f[3], f[4], f[5], durationMs, hourlyGross, hourlyNet, day)) {
+            addError("invalid start time");
+            return;
+        }
+        r.days.push_back(day);
+    } else {
+        addError("unknown record type");
+    }
+}
+
+void parseChunk(const char* begin, const char* end, bool required, ChunkResult& r) {
+    // Rough pre-size: records are ~110 bytes.
+    r.days.reserve(static_cast<size_t>(end - begin) / 100);
+    // Lines are checksummed a batch at a time: one line's CRC is a short
+    // dependent chain, several interleave at the instruction's throughput.
+    const size_t kBatch = 8;
+    Line lines[kBatch];
+    const char* covered[kBatch];
+    size_t coveredBytes[kBatch];
+    uint32_t crcs[kBatch];
+    const char* p = begin;
+    while (p < end) {
+        size_t n = 0;
+        for (; n < kBatch && p < end; ++n) {
+            const char* nl = static_cast<const char*>(std::memchr(p, '\n', static_cast<size_t>(end - p)));
+            std::string_view text(p, static_cast<size_t>((nl ? nl : end) - p));
+            if (!text.empty() && text.back() == '\r') {
+                text.remove_suffix(1);
+            }
+            size_t bar = text.rfind('|');
+            lines[n].text = text;
+            covered[n] = text.data();
+            coveredBytes[n] = bar == std::string_view::npos ? 0 : bar;
+            p = nl ? nl + 1 : end;
+        }
+        crc32cMany(covered, coveredBytes, n, crcs);
+        for (size_t i = 0; i < n; ++i) {
+            lines[i].crc = crcs[i];
+            r.lines++;
+            parseLine(lines[i], r.lines, required, r);
+        }
+    }
+}
+
+// Whether the first non-empty line has a field past what its record type
+// needs: the checksum, in files written since checksums exist.
+bool firstLineChecksummed(const char* data, size_t size) {
+    std::string_view rest(data, size);
+    while (!rest.empty()) {
+        size_t nl = rest.find('\n');
+        std::string_view line = rest.substr(0, nl);
+        if (!line.empty() && line.back() == '\r') {
+            line.remove_suffix(1);
+        }
+        if (!line.empty()) {
+            std::string_view f[1];
+            size_t count = splitFields(line, f, 1);
+            return count == (f[0] == "config" ? kConfigFields : kWorkDayFields) + 1;
+        }
+        rest = nl == std::string_view::npos ? std::string_view() : rest.substr(nl + 1);
+    }
+    return true;
+}
+
+} // namespace
+
+void parseTextHistory(const char* data, size_t size, ParsedHistory& out, bool dropUnterminatedTail, unsigned threads,
+                      ChecksumMode checksums) {
+    out = ParsedHistory();
+    if (size > 0 && data[size - 1] != '\n') {
+        out.tornTail = true;
+        if (dropUnterminatedTail) {
+            const char* lastNl = nullptr;
+            for (size_t i = size; i-- > 0;) {
+                if (data[i] == '\n') { lastNl = data + i; break; }
+            }
+            size = lastNl ? static_cast<size_t>(lastNl - data) + 1 : 0;
+        }
+    }
+
+    bool required = checksums == ChecksumMode::Required ||
+                    (checksums == ChecksumMode::FromFirstLine && firstLineChecksummed(data, size));
+    out.checksummed = required;
+
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    size_t chunkCount = std::max<size_t>(1, std::min<size_t>(threads, size / kParallelChunkBytes));
+
+    // Cut at line boundaries.
+    std::vector<const char*> cuts;
+    cuts.push_back(data);
+    for (size_t i = 1; i < chunkCount; ++i) {
+        const char* target = data + size * i / chunkCount;
+        if (target <= cuts.back()) {
+            continue;
+        }
+        const char* nl = static_cast<const char*>(std::memchr(target, '\n', static_cast<size_t>(data + size - target)));
+        if (!nl) {
+            break;
+        }
+        cuts.push_back(nl + 1);
+    }
+    cuts.push_back(data + size);
+
+    std::vector<ChunkResult> results(cuts.size() - 1);
+    if (results.size() == 1) {
+        parseChunk(cuts[0], cuts[1], required, results[0]);
+    } else {
+        std::vector<std::thread> workers;
+        for (size_t i = 1; i < results.size(); ++i) {
+            workers.emplace_back(parseChunk, cuts[i], cuts[i + 1], required, std::ref(results[i]));
+        }
+        parseChunk(cuts[0], cuts[1], required, results[0]);
+        for (auto& worker : workers) {
+            worker.join();
+        }
+    }
+
+    size_t totalDays = 0;
+    for (const auto& r : results) {
+        totalDays += r.days.size();
+    }
+    out.days.reserve(totalDays);
+    for (auto& r : results) {
+        for (auto& e : r.errors) {
+            out.errors.push_back({ e.line + out.lines, std::move(e.message), std::move(e.record) });
+        }
+        if (r.haveConfig) {
+            out.haveConfig = true;
+            out.config = r.config;
+        }
+        std::move(r.days.begin(), r.days.end(), std::back_inserter(out.days));
+        out.lines += r.lines;
+    }
+}
+
+bool parseTextHistoryFile(const std::string& path, ParsedHistory& out, bool dropUnterminatedTail, unsigned threads,
+                          ChecksumMode checksums) {
+    MappedFile file;
+    if (!file.open(path)) {
+        out = ParsedHistory();
+        return false;
+    }
+    parseTextHistory(file.data(), file.size(), out, dropUnterminatedTail, threads, checksums);
+    return true;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "workday.h"
+
+// --- Pipe-Delimited Text Parser ---
+//
+// Parses the data.txt format from a single buffer. Fields are split on '|'
+// and '\n' in place and numbers are converted with std::from_chars. Inputs
+// larger than kParallelChunkBytes are cut at line boundaries and the chunks
+// are parsed on worker threads, then merged back in file order. Malformed
+// lines are skipped and reported with their 1-based line number. A record
+// with a trailing checksum field (see formatWorkDayRecord) must match it.
+// Whether a record may lack one is decided once per file (ChecksumMode), so
+// a line that lost a '|' or its checksum field is not taken for a record
+// from before checksums existed.
+
+enum class ChecksumMode {
+    FromFirstLine,  // required if the first record has one (data.txt)
+    Required,       // a journal next to a checksummed snapshot
+    Optional,       // a journal next to a snapshot from before checksums
+};
+
+struct ParseError {
+    size_t line;
+    std::string message;
+    std::string record;     // the skipped line
+};
+
+struct ParsedHistory {
+    bool haveConfig = false;
+    Config config;
+    std::vector<WorkDay> days;      // in file order
+    std::vector<ParseError> errors;
+    size_t lines = 0;
+    bool tornTail = false;          // last line had no terminating newline
+    bool checksummed = true;        // records without a checksum were skipped
+};
+
+const size_t kParallelChunkBytes = 1 << 20;
+
+// threads == 0 picks std::thread::hardware_concurrency().
+// With dropUnterminatedTail, a last line without '\n' is treated as a torn
+// append and ignored (used for the journal).
+void parseTextHistory(const char* data, size_t size, ParsedHistory& out, bool dropUnterminatedTail = false,
+                      unsigned threads = 0, ChecksumMode checksums = ChecksumMode::FromFirstLine);
+
+// Maps the file and parses it. Returns false if it cannot be opened.
+bool parseTextHistoryFile(const std::string& path, ParsedHistory& out, bool dropUnterminatedTail = false,
+                          unsigned threads = 0, ChecksumMode checksums = ChecksumMode::FromFirstLine);
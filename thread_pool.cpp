@@ -0,0 +1,70 @@
+#include "thread_pool.h"
+
+#include <algorithm>
+
+ThreadPool::ThreadPool(unsigned threads) {
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    for (unsigned i = 1; i < threads; ++i) {
+        workers.emplace_back(&ThreadPool::workerLoop, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> guard(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+void ThreadPool::runIndices(unsigned participant) {
+    for (size_t i = nextIndex.fetch_add(1); i < jobCount; i = nextIndex.fetch_add(1)) {
+        (*job)(i, participant);
+    }
+}
+
+void ThreadPool::workerLoop(unsigned participant) {
+    unsigned long long seen = 0;
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> guard(mutex);
+            wake.wait(guard, [&] { return stopping || generation != seen; });
+            if (stopping) {
+                return;
+            }
+            seen = generation;
+            busyWorkers++;
+        }
+        runIndices(participant);
+        {
+            std::lock_guard<std::mutex> guard(mutex);
+            busyWorkers--;
+        }
+        done.notify_one();
+    }
+}
+
+void ThreadPool::parallelFor(size_t count, const std::function<void(size_t, unsigned)>& fn) {
+    if (count == 0) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> guard(mutex);
+        job = &fn;
+        jobCount = count;
+        nextIndex = 0;
+        generation++;
+    }
+    wake.notify_all();
+    runIndices(0);
+
+    // Workers that woke late find the counter exhausted and leave at once.
+    std::unique_lock<std::mutex> guard(mutex);
+    done.wait(guard, [&] { return busyWorkers == 0 && nextIndex >= jobCount; });
+    job = nullptr;
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// --- Thread Pool ---
+//
+// A fixed set of worker threads for data-parallel jobs. parallelFor() hands
+// out indices from a shared counter, so uneven items (a ten-year shard next
+// to a one-month one) balance themselves. The calling thread takes part.
+
+class ThreadPool {
+public:
+    // threads == 0 uses the hardware concurrency.
+    explicit ThreadPool(unsigned threads = 0);
+    ~ThreadPool();
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Participants in a job: the workers plus the caller.
+    unsigned concurrency() const { return static_cast<unsigned>(workers.size()) + 1; }
+
+    // Runs fn(index, participant) for every index in [0, count) and returns
+    // when all calls have finished. participant is in [0, concurrency()).
+    // Jobs do not nest.
+    void parallelFor(size_t count, const std::function<void(size_t, unsigned)>& fn);
+
+private:
+    void workerLoop(unsigned participant);
+    void runIndices(unsigned participant);
+
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+    const std::function<void(size_t, unsigned)>* job = nullptr;
+    size_t jobCount = 0;
+    std::atomic<size_t> nextIndex{0};
+    unsigned busyWorkers = 0;
+    unsigned long long generation = 0;
+    bool stopping = false;
+};
@@ -0,0 +1,48 @@
+#include "tick_scheduler.h"
+
+#include <algorithm>
+#include <chrono>
+
+#include "civil_time.h"
+#include "time_format.h"
+
+int64_t SystemClock::nowMs() const {
+    using namespace std::chrono;
+    return duration_cast<milliseconds>(system_clock::now().time_since_epoch()).count();
+}
+
+int SystemClock::localOffsetMinutes(int64_t utcMs) const {
+    return localOffsetCache().offsetMinutes(floorDiv(utcMs, 1000));
+}
+
+int64_t TickScheduler::currentDayKey() const {
+    int64_t now = clock.nowMs();
+    return floorDiv(floorDiv(now, 60000) + clock.localOffsetMinutes(now), 1440);
+}
+
+int64_t TickScheduler::nextDelayMs() const {
+    int64_t now = clock.nowMs();
+    int offset = clock.localOffsetMinutes(now);
+    int64_t nextMidnight = (floorDiv(floorDiv(now, 60000) + offset, 1440) + 1) * 1440 * 60000 - offset * 60000LL;
+    int64_t next = nextMidnight;
+
+    if (isWorking) {
+        int64_t elapsed = std::max<int64_t>(0, now - startMs);
+        int64_t nextMinute = startMs + (elapsed / 60000 + 1) * 60000;
+        next = std::min(next, nextMinute);
+    }
+    return next - now + kSlackMs;
+}
+
+int countWakeups(const TickScheduler& scheduler, VirtualClock& clock, int64_t untilMs) {
+    int wakeups = 0;
+    while (true) {
+        int64_t delay = scheduler.nextDelayMs();
+        if (clock.nowMs() + delay >= untilMs) {
+            clock.set(untilMs);
+            return wakeups;
+        }
+        clock.advance(delay);
+        wakeups++;
+    }
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstdint>
+
+// --- Adaptive UI Tick Scheduling ---
+//
+// The worked-time display only shows whole minutes and the calendar only
+// changes at local midnight, so instead of a fixed 1-second timer the UI asks
+// the scheduler how long it may sleep and arms a one-shot timer for exactly
+// that long. The clock is injectable so the policy can be exercised on a
+// virtual timeline.
+
+class Clock {
+public:
+    virtual ~Clock() = default;
+    virtual int64_t nowMs() const = 0;                       // UTC epoch ms
+    virtual int localOffsetMinutes(int64_t utcMs) const = 0; // local = UTC + offset
+};
+
+class SystemClock : public Clock {
+public:
+    int64_t nowMs() const override;
+    int localOffsetMinutes(int64_t utcMs) const override;
+};
+
+class VirtualClock : public Clock {
+public:
+    explicit VirtualClock(int64_t startMs = 0, int offsetMinutes = 0) : now(startMs), offset(offsetMinutes) {}
+    int64_t nowMs() const override { return now; }
+    int localOffsetMinutes(int64_t) const override { return offset; }
+    void advance(int64_t ms) { now += ms; }
+    void set(int64_t ms) { now = ms; }
+
+private:
+    int64_t now;
+    int offset;
+};
+
+class TickScheduler {
+public:
+    // Wake slightly after the boundary so the new value is already current.
+    static const int64_t kSlackMs = 5;
+
+    explicit TickScheduler(const Clock& clock) : clock(clock) {}
+
+    // Call on punch in/out.
+    void setSession(bool working, int64_t sessionStartMs) {
+        isWorking = working;
+        startMs = sessionStartMs;
+    }
+
+    // Delay until the displayed state can next change: the next whole minute
+    // of the running session or the next local midnight, whichever is first.
+    int64_t nextDelayMs() const;
+
+    // Local day of 'now'; the UI compares it across wakeups to detect midnight.
+    int64_t currentDayKey() const;
+
+private:
+    const Clock& clock;
+    bool isWorking = false;
+    int64_t startMs = 0;
+};
+
+// Drives the scheduler over [clock.now, untilMs) on a virtual clock, as the
+// UI would, and returns how many timer wakeups that takes.
+int countWakeups(const TickScheduler& scheduler, VirtualClock& clock, int64_t untilMs);
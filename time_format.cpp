@@ -0,0 +1,127 @@
+#include "time_format.h"
+
+#include <charconv>
+#include <ctime>
+
+#include "civil_time.h"
+#include "workday.h"
+
+namespace {
+
+template <typename CharT>
+inline CharT* put2(CharT* p, unsigned v) {
+    p[0] = static_cast<CharT>('0' + v / 10);
+    p[1] = static_cast<CharT>('0' + v % 10);
+    return p + 2;
+}
+
+template <typename CharT>
+inline CharT* put4(CharT* p, int v) {
+    unsigned u = static_cast<unsigned>(v < 0 ? 0 : v) % 10000;
+    p = put2(p, u / 100);
+    return put2(p, u % 100);
+}
+
+template <typename CharT>
+size_t formatDateImpl(int64_t localMinutes, CharT* out) {
+    int y; unsigned m, d;
+    civilFromDays(floorDiv(localMinutes, 1440), y, m, d);
+    CharT* p = put4(out, y);
+    *p++ = '-';
+    p = put2(p, m);
+    *p++ = '-';
+    p = put2(p, d);
+    *p = 0;
+    return static_cast<size_t>(p - out);
+}
+
+template <typename CharT>
+size_t formatClockImpl(int64_t localMinutes, CharT* out) {
+    unsigned minuteOfDay = static_cast<unsigned>(localMinutes - floorDiv(localMinutes, 1440) * 1440);
+    CharT* p = put2(out, minuteOfDay / 60);
+    *p++ = ':';
+    p = put2(p, minuteOfDay % 60);
+    *p = 0;
+    return static_cast<size_t>(p - out);
+}
+
+template <typename CharT>
+size_t formatISOImpl(int64_t utcMs, CharT* out) {
+    int64_t sec = floorDiv(utcMs, 1000);
+    int64_t days = floorDiv(sec, 86400);
+    unsigned secOfDay = static_cast<unsigned>(sec - days * 86400);
+    int y; unsigned m, d;
+    civilFromDays(days, y, m, d);
+    CharT* p = put4(out, y);
+    *p++ = '-';
+    p = put2(p, m);
+    *p++ = '-';
+    p = put2(p, d);
+    *p++ = 'T';
+    p = put2(p, secOfDay / 3600);
+    *p++ = ':';
+    p = put2(p, secOfDay / 60 % 60);
+    *p++ = ':';
+    p = put2(p, secOfDay % 60);
+    *p++ = 'Z';
+    *p = 0;
+    return static_cast<size_t>(p - out);
+}
+
+template <typename CharT>
+size_t formatDurationImpl(long long ms, CharT* out) {
+    if (ms < 0) {
+        ms = 0;
+    }
+    char hours[24];
+    auto result = std::to_chars(hours, hours + sizeof(hours), ms / 3600000);
+    CharT* p = out;
+    for (const char* c = hours; c < result.ptr; ++c) {
+        *p++ = static_cast<CharT>(*c);
+    }
+    *p++ = 'h';
+    *p++ = ' ';
+    p = put2(p, static_cast<unsigned>((ms % 3600000) / 60000));
+    *p++ = 'm';
+    *p = 0;
+    return static_cast<size_t>(p - out);
+}
+
+} // namespace
+
+size_t formatLocalDate(int64_t localMinutes, char* out) { return formatDateImpl(localMinutes, out); }
+size_t formatLocalDate(int64_t localMinutes, wchar_t* out) { return formatDateImpl(localMinutes, out); }
+size_t formatLocalClock(int64_t localMinutes, char* out) { return formatClockImpl(localMinutes, out); }
+size_t formatLocalClock(int64_t localMinutes, wchar_t* out) { return formatClockImpl(localMinutes, out); }
+size_t formatUtcISO(int64_t utcMs, char* out) { return formatISOImpl(utcMs, out); }
+size_t formatUtcISO(int64_t utcMs, wchar_t* out) { return formatISOImpl(utcMs, out); }
+size_t formatDurationHM(long long ms, char* out) { return formatDurationImpl(ms, out); }
+size_t formatDurationHM(long long ms, wchar_t* out) { return formatDurationImpl(ms, out); }
+
+int16_t LocalOffsetCache::offsetMinutes(int64_t utcSeconds) {
+    if (utcSeconds >= validFrom && utcSeconds < validTo) {
+        return offset;
+    }
+    offset = localUtcOffsetMinutes(static_cast<std::time_t>(utcSeconds));
+    int64_t localDay = floorDiv(floorDiv(utcSeconds, 60) + offset, 1440);
+    int64_t dayStart = localDay * 86400 - offset * 60;
+    int64_t dayEnd = dayStart + 86400;
+    if (localUtcOffsetMinutes(static_cast<std::time_t>(dayStart)) == offset &&
+        localUtcOffsetMinutes(static_cast<std::time_t>(dayEnd - 1)) == offset) {
+        validFrom = dayStart;
+        validTo = dayEnd;
+    } else {
+        validFrom = floorDiv(utcSeconds, 3600) * 3600;
+        validTo = validFrom + 3600;
+    }
+    return offset;
+}
+
+int64_t LocalOffsetCache::toLocalMinutes(int64_t utcMs) {
+    return floorDiv(utcMs, 60000) + offsetMinutes(floorDiv(utcMs, 1000));
+}
+
+LocalOffsetCache& localOffsetCache() {
+    thread_local LocalOffsetCache cache;
+    return cache;
+}
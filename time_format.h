@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// --- Time and Duration Formatting ---
+//
+// Allocation-free formatters writing into caller-provided buffers, for both
+// narrow and wide output. Each returns the number of characters written and
+// NUL-terminates. Buffers must hold at least the k*Chars constants below.
+
+const size_t kDateChars = 11;       // "YYYY-MM-DD"
+const size_t kClockChars = 6;       // "HH:MM"
+const size_t kISOChars = 21;        // "YYYY-MM-DDTHH:MM:SSZ"
+const size_t kDurationChars = 32;   // "Xh YYm"
+
+// localMinutes = minutes since 1970-01-01 00:00 local wall-clock time.
+size_t formatLocalDate(int64_t localMinutes, char* out);
+size_t formatLocalDate(int64_t localMinutes, wchar_t* out);
+size_t formatLocalClock(int64_t localMinutes, char* out);
+size_t formatLocalClock(int64_t localMinutes, wchar_t* out);
+size_t formatUtcISO(int64_t utcMs, char* out);
+size_t formatUtcISO(int64_t utcMs, wchar_t* out);
+size_t formatDurationHM(long long ms, char* out);
+size_t formatDurationHM(long long ms, wchar_t* out);
+
+// Caches the local UTC offset. One lookup covers a whole local day; a day
+// that contains a DST change is cached an hour at a time instead.
+class LocalOffsetCache {
+public:
+    int16_t offsetMinutes(int64_t utcSeconds);
+    int64_t toLocalMinutes(int64_t utcMs);
+    void invalidate() { validFrom = 1; validTo = 0; }
+
+private:
+    int64_t validFrom = 1;  // [validFrom, validTo) in UTC seconds
+    int64_t validTo = 0;
+    int16_t offset = 0;
+};
+
+// Per-thread cache used by the UI and the loaders.
+LocalOffsetCache& localOffsetCache();
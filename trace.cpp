@@ -0,0 +1,300 @@
+#include "trace.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <vector>
+
+std::atomic<bool> g_traceEnabled{false};
+
+namespace {
+
+const size_t kRingEvents = 2048;
+const size_t kNoteBytes = 43;
+const uint8_t kNoteKind = static_cast<uint8_t>(TraceSpan::Count);
+
+struct TraceEvent {
+    uint64_t startNs;
+    uint64_t durationNs;
+    uint32_t thread;
+    uint8_t kind;               // a TraceSpan, or kNoteKind
+    char note[kNoteBytes];      // NUL-terminated unless full
+};
+static_assert(sizeof(TraceEvent) == 64, "one cache line per event");
+
+// One per live thread that has traced something. Rings are never freed: a
+// thread's ring goes back to the pool when it exits and the next new thread
+// picks it up, keeping the events for the dump.
+struct ThreadTrace {
+    std::atomic<bool> inUse{true};
+    uint32_t thread = 0;
+    // Seqlock-style publication: `claimed` moves before an event is written,
+    // `head` after, so a reader can tell which slots it may have torn.
+    std::atomic<uint64_t> claimed{0};
+    std::atomic<uint64_t> head{0};
+    TraceEvent events[kRingEvents];
+    LatencyHistogram histograms[static_cast<size_t>(TraceSpan::Count)];
+    ThreadTrace* next = nullptr;
+};
+
+std::atomic<ThreadTrace*> g_traces{nullptr};
+std::atomic<uint32_t> g_nextThread{1};
+std::atomic<uint64_t> g_epochNs{0};
+
+ThreadTrace* acquireTrace() {
+    uint32_t thread = g_nextThread.fetch_add(1, std::memory_order_relaxed);
+    for (ThreadTrace* t = g_traces.load(std::memory_order_acquire); t != nullptr; t = t->next) {
+        bool expected = false;
+        if (!t->inUse.load(std::memory_order_relaxed) &&
+            t->inUse.compare_exchange_strong(expected, true, std::memory_order_acquire)) {
+            t->thread = thread;
+            return t;
+        }
+    }
+    ThreadTrace* t = new ThreadTrace();
+    t->thread = thread;
+    t->next = g_traces.load(std::memory_order_relaxed);
+    while (!g_traces.compare_exchange_weak(t->next, t, std::memory_order_release, std::memory_order_relaxed)) {
+    }
+    return t;
+}
+
+struct TraceOwner {
+    ThreadTrace* trace = nullptr;
+    ~TraceOwner() {
+        if (trace != nullptr) {
+            trace->inUse.store(false, std::memory_order_release);
+        }
+    }
+};
+
+thread_local TraceOwner t_owner;
+
+ThreadTrace& localTrace() {
+    if (t_owner.trace == nullptr) {
+        t_owner.trace = acquireTrace();
+    }
+    return *t_owner.trace;
+}
+
+TraceEvent& claimEvent(ThreadTrace& trace) {
+    uint64_t h = trace.head.load(std::memory_order_relaxed);
+    trace.claimed.store(h + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    return trace.events[h % kRingEvents];
+}
+
+void publishEvent(ThreadTrace& trace) {
+    trace.head.store(trace.claimed.load(std::memory_order_relaxed), std::memory_order_release);
+}
+
+// Copies the events a ring still holds, dropping any that were being
+// overwritten while they were read.
+void snapshotRing(const ThreadTrace& trace, std::vector<TraceEvent>& out) {
+    uint64_t head = trace.head.load(std::memory_order_acquire);
+    uint64_t first = head > kRingEvents ? head - kRingEvents : 0;
+    size_t base = out.size();
+    for (uint64_t i = first; i < head; ++i) {
+        out.push_back(trace.events[i % kRingEvents]);
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+    uint64_t claimed = trace.claimed.load(std::memory_order_relaxed);
+    uint64_t torn = claimed > kRingEvents ? claimed - kRingEvents : 0;
+    if (torn > first) {
+        size_t drop = static_cast<size_t>(std::min(torn, head) - first);
+        out.erase(out.begin() + base, out.begin() + base + drop);
+    }
+}
+
+void writeJsonString(FILE* file, const char* text, size_t size) {
+    std::fputc('"', file);
+    for (size_t i = 0; i < size; ++i) {
+        unsigned char c = static_cast<unsigned char>(text[i]);
+        if (c == '"' || c == '\\') {
+            std::fputc('\\', file);
+            std::fputc(c, file);
+        } else if (c < 0x20) {
+            std::fprintf(file, "\\u%04x", c);
+        } else {
+            std::fputc(c, file);
+        }
+    }
+    std::fputc('"', file);
+}
+
+uint64_t percentile(const uint64_t* counts, uint64_t total, double fraction) {
+    uint64_t rank = static_cast<uint64_t>(fraction * total + 0.5);
+    rank = std::max<uint64_t>(rank, 1);
+    uint64_t seen = 0;
+    for (size_t b = 0; b < LatencyHistogram::kBuckets; ++b) {
+        seen += counts[b];
+        if (seen >= rank) {
+            return LatencyHistogram::bucketLowerBound(b);
+        }
+    }
+    return 0;
+}
+
+} // namespace
+
+const char* traceSpanName(TraceSpan span) {
+    static const char* const kNames[] = { "load", "save", "punch", "layout", "paint", "export", "query", "sync" };
+    size_t index = static_cast<size_t>(span);
+    return index < static_cast<size_t>(TraceSpan::Count) ? kNames[index] : "note";
+}
+
+void setTraceEnabled(bool enabled) {
+    if (enabled) {
+        uint64_t expected = 0;
+        g_epochNs.compare_exchange_strong(expected, traceNowNs());
+    }
+    g_traceEnabled.store(enabled, std::memory_order_relaxed);
+}
+
+uint64_t traceNowNs() {
+    auto now = std::chrono::steady_clock::now().time_since_epoch();
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(now).count());
+}
+
+void traceRecord(TraceSpan span, uint64_t startNs, uint64_t endNs) {
+    ThreadTrace& trace = localTrace();
+    uint64_t durationNs = endNs > startNs ? endNs - startNs : 0;
+    TraceEvent& event = claimEvent(trace);
+    event.startNs = startNs;
+    event.durationNs = durationNs;
+    event.thread = trace.thread;
+    event.kind = static_cast<uint8_t>(span);
+    event.note[0] = '\0';
+    publishEvent(trace);
+    trace.histograms[static_cast<size_t>(span)].add(durationNs);
+}
+
+void traceLog(const char* message) {
+    if (!traceEnabled()) {
+        return;
+    }
+    ThreadTrace& trace = localTrace();
+    TraceEvent& event = claimEvent(trace);
+    event.startNs = traceNowNs();
+    event.durationNs = 0;
+    event.thread = trace.thread;
+    event.kind = kNoteKind;
+    size_t size = std::strlen(message);
+    while (size > 0 && message[size - 1] == '\n') {
+        --size; // log lines carry their own newline
+    }
+    size = std::min(size, kNoteBytes);
+    std::memcpy(event.note, message, size);
+    if (size < kNoteBytes) {
+        event.note[size] = '\0';
+    }
+    publishEvent(trace);
+}
+
+// --- Latency histogram ---
+
+size_t LatencyHistogram::bucketOf(uint64_t ns) {
+    const uint64_t kSub = 1u << kSubBits;
+    if (ns < 2 * kSub) {
+        return static_cast<size_t>(ns);
+    }
+    int exponent = 63;
+    while ((ns >> exponent) == 0) {
+        --exponent;
+    }
+    if (exponent > kMaxExponent) {
+        return kBuckets - 1;
+    }
+    uint64_t top = ns >> (exponent - kSubBits);     // in [kSub, 2 * kSub)
+    return static_cast<size_t>((exponent - kSubBits) * kSub + top);
+}
+
+uint64_t LatencyHistogram::bucketLowerBound(size_t bucket) {
+    const size_t kSub = 1u << kSubBits;
+    if (bucket < 2 * kSub) {
+        return bucket;
+    }
+    int exponent = static_cast<int>(bucket / kSub) + kSubBits - 1;
+    uint64_t top = kSub + bucket % kSub;
+    return top << (exponent - kSubBits);
+}
+
+void LatencyHistogram::add(uint64_t ns) {
+    std::atomic<uint64_t>& count = counts[bucketOf(ns)];
+    count.store(count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    total.store(total.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    sumNs.store(sumNs.load(std::memory_order_relaxed) + ns, std::memory_order_relaxed);
+    if (ns > maxNs.load(std::memory_order_relaxed)) {
+        maxNs.store(ns, std::memory_order_relaxed);
+    }
+}
+
+void LatencyHistogram::mergeInto(uint64_t* outCounts, uint64_t& outTotal, uint64_t& outSum, uint64_t& outMax) const {
+    for (size_t b = 0; b < kBuckets; ++b) {
+        outCounts[b] += counts[b].load(std::memory_order_relaxed);
+    }
+    outTotal += total.load(std::memory_order_relaxed);
+    outSum += sumNs.load(std::memory_order_relaxed);
+    outMax = std::max(outMax, maxNs.load(std::memory_order_relaxed));
+}
+
+TraceSummary traceSummary(TraceSpan span) {
+    std::vector<uint64_t> counts(LatencyHistogram::kBuckets, 0);
+    uint64_t total = 0, sum = 0, max = 0;
+    for (ThreadTrace* t = g_traces.load(std::memory_order_acquire); t != nullptr; t = t->next) {
+        t->histograms[static_cast<size_t>(span)].mergeInto(counts.data(), total, sum, max);
+    }
+    TraceSummary summary;
+    summary.count = total;
+    if (total == 0) {
+        return summary;
+    }
+    summary.meanNs = sum / total;
+    summary.p50Ns = std::min(percentile(counts.data(), total, 0.50), max);
+    summary.p90Ns = std::min(percentile(counts.data(), total, 0.90), max);
+    summary.p99Ns = std::min(percentile(counts.data(), total, 0.99), max);
+    summary.maxNs = max;
+    return summary;
+}
+
+bool traceDump(FILE* file) {
+    for (size_t s = 0; s < static_cast<size_t>(TraceSpan::Count); ++s) {
+        TraceSpan span = static_cast<TraceSpan>(s);
+        TraceSummary summary = traceSummary(span);
+        std::fprintf(file,
+                     "{\"trace\":\"histogram\",\"span\":\"%s\",\"count\":%llu,\"mean_us\":%.3f,\"p50_us\":%.3f,"
+                     "\"p90_us\":%.3f,\"p99_us\":%.3f,\"max_us\":%.3f}\n",
+                     traceSpanName(span), static_cast<unsigned long long>(summary.count), summary.meanNs / 1e3,
+                     summary.p50Ns / 1e3, summary.p90Ns / 1e3, summary.p99Ns / 1e3, summary.maxNs / 1e3);
+    }
+
+    std::vector<TraceEvent> events;
+    for (ThreadTrace* t = g_traces.load(std::memory_order_acquire); t != nullptr; t = t->next) {
+        snapshotRing(*t, events);
+    }
+    std::stable_sort(events.begin(), events.end(),
+                     [](const TraceEvent& a, const TraceEvent& b) { return a.startNs < b.startNs; });
+    uint64_t epoch = g_epochNs.load(std::memory_order_relaxed);
+    for (const TraceEvent& event : events) {
+        double startUs = (event.startNs > epoch ? event.startNs - epoch : 0) / 1e3;
+        if (event.kind == kNoteKind) {
+            std::fprintf(file, "{\"trace\":\"note\",\"thread\":%u,\"start_us\":%.3f,\"text\":", event.thread, startUs);
+            writeJsonString(file, event.note, strnlen(event.note, kNoteBytes));
+            std::fputs("}\n", file);
+        } else {
+            std::fprintf(file, "{\"trace\":\"span\",\"span\":\"%s\",\"thread\":%u,\"start_us\":%.3f,\"duration_us\":%.3f}\n",
+                         traceSpanName(static_cast<TraceSpan>(event.kind)), event.thread, startUs,
+                         event.durationNs / 1e3);
+        }
+    }
+    return !std::ferror(file);
+}
+
+bool traceDumpToFile(const std::string& path) {
+    FILE* file = std::fopen(path.c_str(), "wb");
+    if (file == nullptr) {
+        return false;
+    }
+    bool ok = traceDump(file);
+    return (std::fclose(file) == 0) && ok;
+}
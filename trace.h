@@ -0,0 +1,89 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+// --- Tracing ---
+//
+// Timed spans for the paths worth watching (load, save, punch, layout, paint,
+// export, query, sync) and short log notes, recorded into a ring buffer owned by the
+// calling thread: no locks and no kernel calls on the hot path. Each thread
+// also keeps a log-linear latency histogram per span (HDR-style, ~3% bucket
+// width), so percentiles survive after the ring has wrapped.
+//
+// Off by default. While off, a TraceScope is one relaxed load and a branch.
+//
+//   { TraceScope scope(TraceSpan::Paint); ... }
+//   traceLog("Data loaded successfully.\n");
+//   traceDump(file);    // histograms, then the ring contents, as JSON Lines
+
+enum class TraceSpan : uint8_t { Load, Save, Punch, Layout, Paint, Export, Query, Sync, Count };
+
+const char* traceSpanName(TraceSpan span);
+
+extern std::atomic<bool> g_traceEnabled;
+
+inline bool traceEnabled() { return g_traceEnabled.load(std::memory_order_relaxed); }
+void setTraceEnabled(bool enabled);
+
+uint64_t traceNowNs();
+void traceRecord(TraceSpan span, uint64_t startNs, uint64_t endNs);
+// Records a note (truncated to a few dozen bytes); no-op while disabled.
+void traceLog(const char* message);
+
+class TraceScope {
+public:
+    explicit TraceScope(TraceSpan span) : span(span), startNs(traceEnabled() ? traceNowNs() : 0) {}
+    ~TraceScope() {
+        if (startNs != 0) {
+            traceRecord(span, startNs, traceNowNs());
+        }
+    }
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+private:
+    TraceSpan span;
+    uint64_t startNs;
+};
+
+// --- Latency histogram ---
+
+class LatencyHistogram {
+public:
+    // Exact below 64 ns, then 32 buckets per power of two up to ~36 min.
+    static const int kSubBits = 5;
+    static const int kMaxExponent = 40;
+    static const size_t kBuckets = (kMaxExponent - kSubBits + 2) * (1 << kSubBits);
+
+    static size_t bucketOf(uint64_t ns);
+    static uint64_t bucketLowerBound(size_t bucket);
+
+    // Single writer; readers on other threads see a consistent-enough view.
+    void add(uint64_t ns);
+    void mergeInto(uint64_t* counts, uint64_t& total, uint64_t& sum, uint64_t& max) const;
+
+private:
+    std::atomic<uint64_t> counts[kBuckets] = {};
+    std::atomic<uint64_t> total{0};
+    std::atomic<uint64_t> sumNs{0};
+    std::atomic<uint64_t> maxNs{0};
+};
+
+// Summary of every thread's histogram for one span.
+struct TraceSummary {
+    uint64_t count = 0;
+    uint64_t meanNs = 0;
+    uint64_t p50Ns = 0;
+    uint64_t p90Ns = 0;
+    uint64_t p99Ns = 0;
+    uint64_t maxNs = 0;
+};
+
+TraceSummary traceSummary(TraceSpan span);
+
+bool traceDump(FILE* file);
+bool traceDumpToFile(const std::string& path);
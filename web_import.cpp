@@ -0,0 +1,398 @@
+#include "web_import.h"
+
+#include <algorithm>
+#include <charconv>
+#include <memory>
+#include <string_view>
+#include <unordered_set>
+
+#include "civil_time.h"
+#include "json_sax.h"
+
+namespace {
+
+// "YYYY-MM-DDTHH:MM:SS[.fff]Z" as produced by Date.toISOString().
+bool parseISOMillis(std::string_view s, int64_t& ms) {
+    int64_t seconds;
+    if (!parseISOSeconds(s, seconds)) {
+        return false;
+    }
+    ms = seconds * 1000;
+    if (s.size() > 20 && s[19] == '.') {
+        int fraction = 0, digits = 0;
+        for (size_t i = 20; i < s.size() && s[i] >= '0' && s[i] <= '9'; ++i) {
+            if (digits < 3) {
+                fraction = fraction * 10 + (s[i] - '0');
+                digits++;
+            }
+        }
+        while (digits++ < 3) {
+            fraction *= 10;
+        }
+        ms += fraction;
+    }
+    return true;
+}
+
+template <typename T>
+bool parseNumber(std::string_view text, T& value) {
+    const char* end = text.data() + text.size();
+    auto result = std::from_chars(text.data(), end, value);
+    return result.ec == std::errc() && result.ptr == end;
+}
+
+// Integer fields occasionally arrive as floats (e.g. after an edit in the web UI).
+bool parseMillis(std::string_view text, long long& value) {
+    if (parseNumber(text, value)) {
+        return true;
+    }
+    double d;
+    if (!parseNumber(text, d)) {
+        return false;
+    }
+    value = static_cast<long long>(d);
+    return true;
+}
+
+// UTC offset implied by a local "HH:MM" for an instant. The web `date` field
+// cannot anchor this: it is a UTC date, moved back a day before 07:30.
+int16_t offsetFromClock(std::string_view clock, int64_t utcMs, int16_t fallback) {
+    int localClock;
+    if (!parseClockMinutes(clock, localClock)) {
+        return fallback;
+    }
+    int64_t utcMinutes = floorDiv(utcMs, 60000);
+    int64_t diff = localClock - (utcMinutes - floorDiv(utcMinutes, 1440) * 1440);
+    if (diff > 14 * 60) diff -= 1440;
+    if (diff < -12 * 60) diff += 1440;
+    return static_cast<int16_t>(floorDiv(diff + 7, 15) * 15);
+}
+
+struct WebPause {
+    int64_t startMs = -1;
+    int64_t endMs = -1;
+    long long durationMs = -1;
+};
+
+struct WebDay {
+    std::string date, startTime, endTime, startDateTime, endDateTime;
+    long long durationMs = -1;
+    double hourlyGross = -1.0;
+    double hourlyNet = -1.0;
+    std::vector<std::pair<int64_t, int64_t>> pauses;
+
+    void clear() {
+        date.clear();
+        startTime.clear();
+        endTime.clear();
+        startDateTime.clear();
+        endDateTime.clear();
+        durationMs = -1;
+        hourlyGross = hourlyNet = -1.0;
+        pauses.clear();
+    }
+};
+
+// Two clocks closer than this are the same instant; web durations are
+// computed from Date objects and the ISO strings can differ by rounding.
+const long long kToleranceMs = 1000;
+
+void emitDay(WebDay& day, const WorkDaySink& sink, WebImportStats& stats) {
+    stats.days++;
+    double gross = day.hourlyGross >= 0 ? day.hourlyGross : stats.config.hourlyGross;
+    double net = day.hourlyNet >= 0 ? day.hourlyNet : stats.config.hourlyNet;
+
+    int64_t startMs, endMs = -1;
+    if (!parseISOMillis(day.startDateTime, startMs)) {
+        // No UTC timestamp: fall back to the data.txt rules on the wall clock.
+        WorkDay wd;
+        if (day.durationMs < 0 ||
+            !workDayFromText(day.date, day.startTime, "", "", "", day.durationMs, gross, net, wd)) {
+            stats.skippedDays++;
+            return;
+        }
+        sink(wd);
+        stats.sessions++;
+        return;
+    }
+    parseISOMillis(day.endDateTime, endMs);
+
+    // Merge overlapping pauses and clip them to the day.
+    std::sort(day.pauses.begin(), day.pauses.end());
+    long long pausedMs = 0;
+    int64_t cursor = startMs;
+    std::vector<std::pair<int64_t, int64_t>> segments;
+    for (auto pause : day.pauses) {
+        stats.pauses++;
+        pause.first = std::max(pause.first, cursor);
+        if (endMs >= 0) {
+            pause.second = std::min(pause.second, endMs);
+        }
+        if (pause.second <= pause.first) {
+            continue;
+        }
+        segments.push_back({ cursor, pause.first });
+        pausedMs += pause.second - pause.first;
+        cursor = pause.second;
+    }
+    if (endMs < 0) {
+        endMs = cursor + std::max(0LL, day.durationMs - (cursor - startMs - pausedMs));
+    }
+    segments.push_back({ cursor, endMs });
+    long long workedMs = (endMs - startMs) - pausedMs;
+    if (day.durationMs < 0) {
+        day.durationMs = workedMs;
+    }
+
+    WorkDay whole;
+    whole.rateId = rateTable().intern(gross, net);
+    whole.startUtcOffsetMin = offsetFromClock(day.startTime, startMs, localUtcOffsetMinutes(startMs / 1000));
+    whole.endUtcOffsetMin = offsetFromClock(day.endTime, endMs, whole.startUtcOffsetMin);
+
+    long long diff = workedMs - day.durationMs;
+    if (diff > kToleranceMs || diff < -kToleranceMs) {
+        WorkDay block = whole;
+        block.startMs = startMs;
+        block.endMs = startMs + day.durationMs;
+        block.endUtcOffsetMin = whole.startUtcOffsetMin;
+        sink(block);
+        stats.sessions++;
+        stats.mergedDays++;
+        return;
+    }
+    for (size_t i = 0; i < segments.size(); ++i) {
+        if (segments[i].second <= segments[i].first) {
+            continue;
+        }
+        WorkDay wd = whole;
+        wd.startMs = segments[i].first;
+        wd.endMs = segments[i].second;
+        wd.endUtcOffsetMin = (i + 1 == segments.size()) ? whole.endUtcOffsetMin : whole.startUtcOffsetMin;
+        sink(wd);
+        stats.sessions++;
+    }
+}
+
+class WebImportHandler : public JsonSaxHandler {
+public:
+    enum class Root { Any, History, Config };
+
+    WebImportHandler(Root root, const WorkDaySink& sink, WebImportStats& stats)
+        : root(root), sink(sink), stats(stats) {}
+
+    const std::string& nestedError() const { return error; }
+
+    bool startObject() override {
+        Ctx parent = current();
+        Ctx next = Ctx::Skip;
+        if (parent == Ctx::Root) {
+            next = root == Root::Any ? Ctx::Wrapper : root == Root::Config ? Ctx::Config : Ctx::Skip;
+        } else if (parent == Ctx::Wrapper && currentKey == "timetracker_config") {
+            next = Ctx::Config;
+        } else if (parent == Ctx::History) {
+            next = Ctx::Day;
+            day.clear();
+        } else if (parent == Ctx::Pauses) {
+            next = Ctx::Pause;
+            pause = WebPause();
+        }
+        stack.push_back(next);
+        return true;
+    }
+
+    bool endObject() override {
+        Ctx ctx = current();
+        stack.pop_back();
+        if (ctx == Ctx::Day) {
+            emitDay(day, sink, stats);
+        } else if (ctx == Ctx::Pause) {
+            if (pause.endMs < 0 && pause.startMs >= 0 && pause.durationMs >= 0) {
+                pause.endMs = pause.startMs + pause.durationMs;
+            }
+            if (pause.startMs >= 0 && pause.endMs > pause.startMs) {
+                day.pauses.push_back({ pause.startMs, pause.endMs });
+            }
+        } else if (ctx == Ctx::Config) {
+            stats.haveConfig = true;
+        }
+        return true;
+    }
+
+    bool startArray() override {
+        Ctx parent = current();
+        Ctx next = Ctx::Skip;
+        if (parent == Ctx::Root && root != Root::Config) {
+            next = Ctx::History;
+        } else if (parent == Ctx::Wrapper && currentKey == "timetracker_history") {
+            next = Ctx::History;
+        } else if (parent == Ctx::Day && currentKey == "pauses") {
+            next = Ctx::Pauses;
+        }
+        stack.push_back(next);
+        return true;
+    }
+
+    bool endArray() override {
+        stack.pop_back();
+        return true;
+    }
+
+    bool key(std::string_view name) override {
+        currentKey.assign(name.data(), name.size());
+        return true;
+    }
+
+    bool stringPart(std::string_view part, bool last) override {
+        Ctx ctx = current();
+        if (ctx == Ctx::Wrapper && (currentKey == "timetracker_history" || currentKey == "timetracker_config")) {
+            return feedNested(part, last);
+        }
+        if (ctx != Ctx::Day && ctx != Ctx::Pause && ctx != Ctx::Config) {
+            return true;
+        }
+        // Only short fields are used; cap the scratch so huge strings cost nothing.
+        if (value.size() < 64) {
+            value.append(part.data(), std::min(part.size(), 64 - value.size()));
+        }
+        if (last) {
+            assignValue(ctx, value);
+            value.clear();
+        }
+        return true;
+    }
+
+    bool number(std::string_view text) override {
+        assignValue(current(), text);
+        return true;
+    }
+
+    bool literal(JsonLiteral) override {
+        return true;
+    }
+
+private:
+    enum class Ctx { Root, Wrapper, History, Day, Pauses, Pause, Config, Skip };
+
+    Ctx current() const { return stack.empty() ? Ctx::Root : stack.back(); }
+
+    void assignValue(Ctx ctx, std::string_view text) {
+        if (ctx == Ctx::Day) {
+            if (currentKey == "date") day.date.assign(text.data(), text.size());
+            else if (currentKey == "startTime") day.startTime.assign(text.data(), text.size());
+            else if (currentKey == "endTime") day.endTime.assign(text.data(), text.size());
+            else if (currentKey == "startDateTime") day.startDateTime.assign(text.data(), text.size());
+            else if (currentKey == "endDateTime") day.endDateTime.assign(text.data(), text.size());
+            else if (currentKey == "durationMs") parseMillis(text, day.durationMs);
+            else if (currentKey == "hourlyGross") parseNumber(text, day.hourlyGross);
+            else if (currentKey == "hourlyNet") parseNumber(text, day.hourlyNet);
+        } else if (ctx == Ctx::Pause) {
+            if (currentKey == "start") parseISOMillis(text, pause.startMs);
+            else if (currentKey == "end") parseISOMillis(text, pause.endMs);
+            else if (currentKey == "duration") parseMillis(text, pause.durationMs);
+        } else if (ctx == Ctx::Config) {
+            if (currentKey == "hourlyGross") parseNumber(text, stats.config.hourlyGross);
+            else if (currentKey == "hourlyNet") parseNumber(text, stats.config.hourlyNet);
+        }
+    }
+
+    bool feedNested(std::string_view part, bool last) {
+        if (!nestedParser) {
+            nestedHandler.reset(new WebImportHandler(currentKey == "timetracker_config" ? Root::Config : Root::History,
+                                                     sink, stats));
+            nestedParser.reset(new JsonSaxParser(*nestedHandler));
+        }
+        bool ok = nestedParser->feed(part.data(), part.size()) && (!last || nestedParser->finish());
+        if (!ok) {
+            error = currentKey + ": line " + std::to_string(nestedParser->line()) + ": " + nestedParser->error();
+        }
+        if (last || !ok) {
+            nestedParser.reset();
+            nestedHandler.reset();
+        }
+        return ok;
+    }
+
+    Root root;
+    const WorkDaySink& sink;
+    WebImportStats& stats;
+    std::vector<Ctx> stack;
+    std::string currentKey;
+    std::string value;
+    WebDay day;
+    WebPause pause;
+    std::unique_ptr<WebImportHandler> nestedHandler;
+    std::unique_ptr<JsonSaxParser> nestedParser;
+    std::string error;
+};
+
+bool describeFailure(const JsonSaxParser& parser, const WebImportHandler& handler, std::string& error) {
+    error = !handler.nestedError().empty() ? handler.nestedError()
+                                           : "line " + std::to_string(parser.line()) + ": " + parser.error();
+    return false;
+}
+
+} // namespace
+
+bool importWebHistory(const char* data, size_t size, const WorkDaySink& sink, WebImportStats& stats,
+                      std::string& error) {
+    WebImportHandler handler(WebImportHandler::Root::Any, sink, stats);
+    JsonSaxParser parser(handler);
+    if (size >= 3 && std::string_view(data, 3) == "\xEF\xBB\xBF") {
+        data += 3;
+        size -= 3;
+    }
+    stats.bytes += size;
+    if (!parser.feed(data, size) || !parser.finish()) {
+        return describeFailure(parser, handler, error);
+    }
+    return true;
+}
+
+bool importWebHistoryFile(const std::string& path, const WorkDaySink& sink, WebImportStats& stats,
+                          std::string& error) {
+    WebImportHandler handler(WebImportHandler::Root::Any, sink, stats);
+    if (!parseJsonFile(path, handler, error, &stats.bytes)) {
+        if (!handler.nestedError().empty()) {
+            error = handler.nestedError();
+        }
+        return false;
+    }
+    return true;
+}
+
+bool mergeWebHistoryIntoStore(const std::string& jsonPath, const std::string& storePath, SnapshotFormat format,
+                              WebImportStats& stats, std::string& error) {
+    Journal journal;
+    journal.open(storePath, format);
+    Config config;
+    std::vector<WorkDay> history;
+    bool haveStore = journal.load(config, history);
+
+    std::unordered_set<int64_t> known;
+    for (const auto& wd : history) {
+        known.insert(wd.startMs);
+    }
+    size_t before = history.size();
+    bool ok = importWebHistoryFile(jsonPath, [&](const WorkDay& wd) {
+        if (known.insert(wd.startMs).second) {
+            history.push_back(wd);
+        }
+    }, stats, error);
+    if (!ok) {
+        return false;
+    }
+    if (!haveStore && stats.haveConfig) {
+        config = stats.config;
+    }
+    if (history.size() == before && haveStore) {
+        return true;   // nothing new
+    }
+    std::stable_sort(history.begin(), history.end(), [](const WorkDay& a, const WorkDay& b) {
+        return a.startMs < b.startMs;
+    });
+    if (!journal.compact(config, history)) {
+        error = "cannot write " + storePath;
+        return false;
+    }
+    return true;
+}
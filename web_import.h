@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "journal.h"
+#include "workday.h"
+
+// --- Web History Import ---
+//
+// Reads the web version's localStorage data in one streaming pass (see
+// json_sax.h). Accepted inputs:
+//
+//   [ {day}, ... ]                                  timetracker_history as stored
+//   { "timetracker_history": [...], "timetracker_config": {...} }
+//   { "timetracker_history": "[...]", "timetracker_config": "{...}" }
+//
+// The last form is a raw localStorage dump, where each value is itself a
+// JSON document inside a string; it is parsed in the same pass.
+//
+// A web day is one record per date, with the pauses taken during it. It is
+// split into one WorkDay per stretch of work between pauses. Days the web
+// app merged from several punches carry no record of the gaps between them;
+// those become a single WorkDay of the worked duration, like a data.txt row.
+
+struct WebImportStats {
+    bool haveConfig = false;
+    Config config;
+    size_t days = 0;            // web day records read
+    size_t sessions = 0;        // WorkDay records produced
+    size_t pauses = 0;
+    size_t mergedDays = 0;      // days imported as a single worked block
+    size_t skippedDays = 0;     // days without a usable date/start time
+    uint64_t bytes = 0;
+};
+
+using WorkDaySink = std::function<void(const WorkDay&)>;
+
+bool importWebHistory(const char* data, size_t size, const WorkDaySink& sink, WebImportStats& stats,
+                      std::string& error);
+bool importWebHistoryFile(const std::string& path, const WorkDaySink& sink, WebImportStats& stats,
+                          std::string& error);
+
+// Adds the sessions from a web export to a store, skipping any that are
+// already there (same start time), and compacts it. The web config is used
+// only when the store has no data yet.
+bool mergeWebHistoryIntoStore(const std::string& jsonPath, const std::string& storePath, SnapshotFormat format,
+                              WebImportStats& stats, std::string& error);
@@ -0,0 +1,165 @@
+#include "workday.h"
+
+#include <ctime>
+#include <functional>
+#include <stdexcept>
+
+#include "civil_time.h"
+#include "time_format.h"
+
+RateTable::RateTable() {
+    // Id 0 reads as a zero rate before anything is interned.
+    chunks[0].reset(new Rate[kFirstChunkSize]);
+}
+
+size_t RateTable::RateHash::operator()(const Rate& r) const {
+    // + 0.0 folds -0.0 into 0.0, which compares equal to it.
+    size_t h = std::hash<double>()(r.hourlyGross + 0.0);
+    return h ^ (std::hash<double>()(r.hourlyNet + 0.0) + 0x9e3779b97f4a7c15ULL + (h << 6) + (h >> 2));
+}
+
+uint32_t RateTable::intern(double hourlyGross, double hourlyNet) {
+    const Rate rate{ hourlyGross, hourlyNet };
+    // Sessions arrive in runs at the same rate, so this thread's last answer
+    // or one of the newest entries usually matches.
+    struct LastHit {
+        const RateTable* table;
+        Rate rate;
+        uint32_t id;
+    };
+    thread_local LastHit last = { nullptr, {}, 0 };
+    if (last.table == this && RateEqual()(last.rate, rate)) {
+        return last.id;
+    }
+    uint32_t n = count.load(std::memory_order_acquire);
+    for (uint32_t i = n; i-- > 0 && n - i <= kRecentRates;) {
+        if (RateEqual()((*this)[i], rate)) {
+            last = { this, rate, i };
+            return i;
+        }
+    }
+    std::lock_guard<std::mutex> lock(internMutex);
+    auto found = ids.find(rate);
+    if (found != ids.end()) {
+        last = { this, rate, found->second };
+        return found->second;
+    }
+    n = count.load(std::memory_order_relaxed);
+    if (n == UINT32_MAX - kFirstChunkSize) {
+        throw std::length_error("rate table full");
+    }
+    uint32_t v = n + kFirstChunkSize;
+    int chunk = 31 - __builtin_clz(v) - kFirstChunkBits;
+    if (!chunks[chunk]) {
+        chunks[chunk].reset(new Rate[static_cast<size_t>(kFirstChunkSize) << chunk]);
+    }
+    chunks[chunk][v - (kFirstChunkSize << chunk)] = rate;
+    ids.emplace(rate, n);
+    count.store(n + 1, std::memory_order_release);
+    last = { this, rate, n };
+    return n;
+}
+
+RateTable& rateTable() {
+    static RateTable table;
+    return table;
+}
+
+int64_t WorkDay::dayKey() const {
+    return floorDiv(floorDiv(startMs, 60000) + startUtcOffsetMin, 1440);
+}
+
+std::string WorkDay::date() const {
+    char buf[kDateChars];
+    return std::string(buf, formatLocalDate(floorDiv(startMs, 60000) + startUtcOffsetMin, buf));
+}
+
+std::string WorkDay::startTime() const {
+    char buf[kClockChars];
+    return std::string(buf, formatLocalClock(floorDiv(startMs, 60000) + startUtcOffsetMin, buf));
+}
+
+std::string WorkDay::endTime() const {
+    char buf[kClockChars];
+    return std::string(buf, formatLocalClock(floorDiv(endMs, 60000) + endUtcOffsetMin, buf));
+}
+
+std::string WorkDay::startDateTime() const {
+    char buf[kISOChars];
+    return std::string(buf, formatUtcISO(startMs, buf));
+}
+
+std::string WorkDay::endDateTime() const {
+    char buf[kISOChars];
+    return std::string(buf, formatUtcISO(endMs, buf));
+}
+
+std::string WorkDay::duration() const {
+    char buf[kDurationChars];
+    return std::string(buf, formatDurationHM(durationMs(), buf));
+}
+
+// Offset rounded to a quarter hour; out-of-range values mean bad input.
+static int16_t offsetFromLocal(int64_t localMinutes, int64_t utcMinutes) {
+    int64_t rounded = floorDiv(localMinutes - utcMinutes + 7, 15) * 15;
+    if (rounded < -16 * 60 || rounded > 16 * 60) {
+        return 0;
+    }
+    return static_cast<int16_t>(rounded);
+}
+
+bool workDayFromText(std::string_view date, std::string_view startTime, std::string_view endTime,
+                     std::string_view startDateTime, std::string_view endDateTime, long long durationMs,
+                     double hourlyGross, double hourlyNet, WorkDay& day) {
+    day = WorkDay();
+    day.rateId = rateTable().intern(hourlyGross, hourlyNet);
+
+    int64_t days = 0;
+    int startClock = 0, endClock = 0;
+    bool haveLocalStart = parseDateKey(date, days) && parseClockMinutes(startTime, startClock);
+    int64_t localStartMin = days * 1440 + startClock;
+
+    int64_t startSec = 0;
+    if (parseISOSeconds(startDateTime, startSec)) {
+        day.startMs = startSec * 1000;
+        if (haveLocalStart) {
+            day.startUtcOffsetMin = offsetFromLocal(localStartMin, floorDiv(startSec, 60));
+        }
+    } else if (haveLocalStart) {
+        day.startMs = localStartMin * 60000; // no UTC timestamp, assume UTC wall clock
+    } else {
+        return false;
+    }
+
+    // The end timestamp is rebuilt from the duration so durations stay exact;
+    // the ISO end only serves as a fallback when the duration is missing.
+    int64_t endSec = 0;
+    if (durationMs <= 0 && parseISOSeconds(endDateTime, endSec) && endSec * 1000 >= day.startMs) {
+        durationMs = endSec * 1000 - day.startMs;
+    }
+    day.endMs = day.startMs + durationMs;
+
+    // endTime only carries the wall clock; pick the offset closest to the start one.
+    day.endUtcOffsetMin = day.startUtcOffsetMin;
+    if (parseClockMinutes(endTime, endClock)) {
+        int64_t localEnd = floorDiv(day.endMs, 60000) + day.startUtcOffsetMin;
+        int64_t diff = (endClock - (localEnd - floorDiv(localEnd, 1440) * 1440)) % 1440;
+        if (diff > 720) diff -= 1440;
+        if (diff < -720) diff += 1440;
+        day.endUtcOffsetMin = offsetFromLocal(localEnd + diff, localEnd - day.startUtcOffsetMin);
+    }
+    return true;
+}
+
+int16_t localUtcOffsetMinutes(std::time_t t) {
+    std::tm local_tm;
+#ifdef _WIN32
+    localtime_s(&local_tm, &t);
+#else
+    localtime_r(&t, &local_tm);
+#endif
+    int64_t localMinutes = daysFromCivil(local_tm.tm_year + 1900, static_cast<unsigned>(local_tm.tm_mon + 1),
+                                         static_cast<unsigned>(local_tm.tm_mday)) * 1440 +
+                           local_tm.tm_hour * 60 + local_tm.tm_min;
+    return offsetFromLocal(localMinutes, floorDiv(static_cast<int64_t>(t), 60));
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+// --- Data Structures ---
+
+struct Config {
+    double hourlyGross = 12.50;
+    double hourlyNet = 10.00;
+};
+
+struct Rate {
+    double hourlyGross = 0.0;
+    double hourlyNet = 0.0;
+};
+
+// Process-wide deduplicated table of hourly rates. Sessions store an index
+// into it. Interning takes a lock; lookups are lock-free because entries are
+// never moved or modified once published. The table grows in chunks (the
+// c-th holds 4096 << c rates), so every distinct rate gets its own id.
+class RateTable {
+public:
+    RateTable();
+    uint32_t intern(double hourlyGross, double hourlyNet);
+    const Rate& operator[](uint32_t id) const {
+        uint32_t v = id + kFirstChunkSize;
+        int chunk = 31 - __builtin_clz(v) - kFirstChunkBits;
+        return chunks[chunk][v - (kFirstChunkSize << chunk)];
+    }
+    uint32_t size() const { return count.load(std::memory_order_acquire); }
+
+private:
+    struct RateHash {
+        size_t operator()(const Rate& r) const;
+    };
+    struct RateEqual {
+        bool operator()(const Rate& a, const Rate& b) const {
+            return a.hourlyGross == b.hourlyGross && a.hourlyNet == b.hourlyNet;
+        }
+    };
+
+    static const int kFirstChunkBits = 12;
+    static const uint32_t kFirstChunkSize = 1u << kFirstChunkBits;
+    // Enough for every id below 2^32 - kFirstChunkSize.
+    static const int kChunks = 32 - kFirstChunkBits;
+    // Interning looks at this many of the newest rates before taking the lock.
+    static const uint32_t kRecentRates = 16;
+
+    std::unique_ptr<Rate[]> chunks[kChunks];
+    std::atomic<uint32_t> count{0};
+    std::mutex internMutex;
+    std::unordered_map<Rate, uint32_t, RateHash, RateEqual> ids;   // guarded by internMutex
+};
+
+RateTable& rateTable();
+
+// One work session: two UTC timestamps, the UTC offsets in effect at each end
+// and a rate id. Everything the UI shows is derived from these on demand.
+struct WorkDay {
+    int64_t startMs = 0;            // UTC, milliseconds since epoch
+    int64_t endMs = 0;
+    uint32_t rateId = 0;
+    int16_t startUtcOffsetMin = 0;  // local = UTC + offset
+    int16_t endUtcOffsetMin = 0;
+
+    long long durationMs() const { return endMs - startMs; }
+    double durationHours() const { return durationMs() / (1000.0 * 60.0 * 60.0); }
+    const Rate& rate() const { return rateTable()[rateId]; }
+    double hourlyGross() const { return rate().hourlyGross; }
+    double hourlyNet() const { return rate().hourlyNet; }
+    double grossEarning() const { return durationHours() * hourlyGross(); }
+    double netEarning() const { return durationHours() * hourlyNet(); }
+    // Local calendar day the session started on, in days since 1970-01-01.
+    int64_t dayKey() const;
+
+    // Formatted on demand: "YYYY-MM-DD", "HH:MM" (local), ISO 8601 (UTC)
+    // and "Xh YYm".
+    std::string date() const;
+    std::string startTime() const;
+    std::string endTime() const;
+    std::string startDateTime() const;
+    std::string endDateTime() const;
+    std::string duration() const;
+};
+
+static_assert(sizeof(WorkDay) == 24, "WorkDay should stay compact");
+
+// Builds a session from the string fields of the data.txt format. The UTC
+// offsets are recovered from the local date/time and the ISO timestamps.
+// Returns false if neither the ISO start nor the local date/time parse.
+bool workDayFromText(std::string_view date, std::string_view startTime, std::string_view endTime,
+                     std::string_view startDateTime, std::string_view endDateTime, long long durationMs,
+                     double hourlyGross, double hourlyNet, WorkDay& day);
+
+// Minutes between local wall-clock time and UTC at the given instant.
+int16_t localUtcOffsetMinutes(std::time_t t);
+
+struct CurrentSession {
+    std::chrono::system_clock::time_point startTime;
+    double sessionHourlyGross;
+    double sessionHourlyNet;
+};